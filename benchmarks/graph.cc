@@ -0,0 +1,174 @@
+/*
+ * graph.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "harness.h"
+#include "core.h"
+#include "graph.h"
+#include "nn.h"
+
+#include <memory>
+#include <random>
+
+namespace ncg {
+namespace bench {
+
+namespace {
+
+const ssize_t kBatchSize = 100;
+const ssize_t kChainLength = 100;
+const ssize_t kNrVariables = 1000;
+
+/* A graph with its own session, made the default ones only while the graph is being built. */
+struct GraphFixture {
+    GraphFixture() : graph(), session(graph) {}
+
+    template <typename Func>
+    void build(Func func) {
+        as_default_graph(graph);
+        as_default_session(session);
+        func();
+        restore_default_session();
+        restore_default_graph();
+    }
+
+    Graph graph;
+    Session session;
+};
+
+/* The MLPModel of examples/mnist. */
+GTensorVec build_mlp(std::mt19937 &rng) {
+    auto image = G::placeholder("image", {kBatchSize, 784}, DTypeName::Float32);
+    auto label = G::placeholder("label", {kBatchSize}, DTypeName::Int64);
+    auto linear1 = G::linear("linear1", image, 512, rng);
+    auto logits = G::linear("linear2", G::tanh(linear1), 10, rng);
+    auto prob = G::softmax(logits, -1);
+    auto loss = G::xent_sparse(prob, label, -1).mean(0);
+    auto accuracy = (logits.max(-1)[1].eq(label)).float32().mean(0);
+
+    auto &graph = get_default_graph();
+    graph.backward(loss);
+    GTensorVec ops{loss, accuracy};
+    for (const auto &name : {"linear1:W", "linear2:W", "linear1:b", "linear2:b"}) {
+        auto W = graph.find_op(name)->outputs()[0];
+        ops.push_back(G::assign(W, W - W->grad(loss) * 0.01f));
+    }
+    return ops;
+}
+
+/* A file removed with the last copy of the pointer. */
+struct TemporaryFile {
+    TemporaryFile(const std::string &filename) : filename(filename) {}
+    ~TemporaryFile() { remove(filename.c_str()); }
+
+    std::string filename;
+};
+
+} /* !namespace <anonymous> */
+
+void register_graph_benchmarks(BenchmarkSuite &suite) {
+    suite.add("graph/build_mlp_with_backward", []() {
+        return []() {
+            std::mt19937 rng(0);
+            GraphFixture fixture;
+            fixture.build([&]() { do_not_optimize(build_mlp(rng)); });
+        };
+    });
+
+    // Each op works on a scalar, so the time is dominated by the graph and op dispatch.
+    suite.add("graph/dispatch_100_scalar_adds", []() {
+        auto fixture = std::make_shared<GraphFixture>();
+        auto target = std::make_shared<GTensorPtr>();
+        fixture->build([&]() {
+            auto x = G::placeholder("x", {}, DTypeName::Float32);
+            auto y = x;
+            for (ssize_t i = 0; i < kChainLength; ++i) {
+                y = y + 1.0f;
+            }
+            *target = y;
+        });
+        auto x = scalar(DTypeName::Float32, 1.0);
+        return [=]() {
+            GraphForwardContext ctx(fixture->session);
+            ctx.feed("x", x);
+            do_not_optimize(ctx.eval({*target}));
+        };
+    });
+
+    // Each variable is looked up by name (Graph::find_op); the graph also has many unnamed ops.
+    suite.add("graph/load_1000_shared_tensors", []() {
+        auto fixture = std::make_shared<GraphFixture>();
+        fixture->build([&]() {
+            for (ssize_t i = 0; i < kNrVariables; ++i) {
+                auto var = G::variable("var" + std::to_string(i), scalar(DTypeName::Float32, i));
+                for (ssize_t j = 0; j < 4; ++j) {
+                    var = var + 1.0f;
+                }
+            }
+        });
+        for (const auto &op : fixture->graph.ops()) {
+            auto var_op = dynamic_cast<GOpVariable *>(op.get());
+            if (var_op != nullptr) {
+                fixture->session.set_shared_tensor(op->outputs()[0], var_op->desc<GOpVariableDesc>().tensor);
+            }
+        }
+
+        auto file = std::make_shared<TemporaryFile>("ncg_bench_shared_tensors.ncg");
+        fixture->session.save_shared_tensors(file->filename);
+        return [=]() {
+            fixture->session.load_shared_tensors(file->filename);
+        };
+    });
+
+    suite.add("train/mnist_mlp_step", []() {
+        auto fixture = std::make_shared<GraphFixture>();
+        auto train_ops = std::make_shared<GTensorVec>();
+        std::mt19937 rng(0);
+        fixture->build([&]() { *train_ops = build_mlp(rng); });
+
+        auto images = rand_uniform(rng, DTypeName::Float32, {kBatchSize, 784}, -0.5, 0.5);
+        auto labels = empty(DTypeName::Int64, {kBatchSize});
+        for (ssize_t i = 0; i < kBatchSize; ++i) {
+            labels->as<DTypeName::Int64>()->mutable_elat(i) = i % 10;
+        }
+        return [=]() {
+            GraphForwardContext ctx(fixture->session);
+            ctx.feed("image", images);
+            ctx.feed("label", labels);
+            auto outputs = ctx.eval(*train_ops);
+            ncg_assert_msg(ctx.ok(), ctx.error_str());
+            do_not_optimize(outputs);
+        };
+    }, 0, 3 * 2.0 * kBatchSize * (784 * 512 + 512 * 10));
+
+    // An SGD step of a 100000 x 64 embedding table through the graph: the update of the session variable
+    // (GOpAssignAddRows) only touches the rows of the batch, in place.
+    suite.add("train/embedding_sgd_step", []() {
+        const ssize_t nr_rows = 100000, dim = 64, batch = 4096;
+        auto fixture = std::make_shared<GraphFixture>();
+        auto update = std::make_shared<GTensorPtr>();
+        std::mt19937 rng(0);
+        fixture->build([&]() {
+            auto indices = G::placeholder("indices", {batch}, DTypeName::Int64);
+            auto loss = G::reduce_sum(G::embedding("emb", indices, nr_rows, dim, rng), 1).sum(0);
+            auto &graph = get_default_graph();
+            graph.backward(loss);
+            auto table = graph.find_op("emb:table")->outputs()[0];
+            *update = G::sgd_update(table, table->grad(loss), 0.01f);
+        });
+
+        auto indices = rand_uniform(rng, DTypeName::Float32, {batch}, 0, nr_rows).int64();
+        return [=]() {
+            GraphForwardContext ctx(fixture->session);
+            ctx.feed("indices", indices);
+            ctx.eval({*update});
+            ncg_assert_msg(ctx.ok(), ctx.error_str());
+        };
+    }, 3.0 * sizeof(float) * 4096 * 64);
+}
+
+} /* !namespace bench */
+} /* !namespace ncg */
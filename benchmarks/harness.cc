@@ -0,0 +1,99 @@
+/*
+ * harness.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "harness.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <numeric>
+
+namespace ncg {
+namespace bench {
+
+void BenchmarkSuite::add(const std::string &name, Setup setup, double bytes, double flops) {
+    m_entries.emplace_back(Entry{name, setup, bytes, flops});
+}
+
+void BenchmarkSuite::run(const BenchmarkOptions &options) {
+    ncg_assert(options.repeats > 0);
+    m_options = options;
+    m_results.clear();
+
+    for (const auto &entry : m_entries) {
+        if (entry.name.find(options.filter) == std::string::npos) {
+            continue;
+        }
+
+        auto body = entry.setup();
+        for (size_t i = 0; i < options.warmup; ++i) {
+            body();
+        }
+
+        std::vector<double> times;
+        for (size_t i = 0; i < options.repeats; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            body();
+            times.emplace_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        std::sort(times.begin(), times.end());
+
+        BenchmarkResult result;
+        result.name = entry.name;
+        result.repeats = times.size();
+        result.median = times.size() % 2 == 1 ? times[times.size() / 2] : (times[times.size() / 2 - 1] + times[times.size() / 2]) / 2;
+        result.p95 = times[static_cast<size_t>(std::ceil(0.95 * times.size())) - 1];
+        result.mean = std::accumulate(times.begin(), times.end(), 0.0) / times.size();
+        result.min = times.front();
+        result.max = times.back();
+        result.bytes = entry.bytes;
+        result.flops = entry.flops;
+        m_results.emplace_back(result);
+
+        std::cerr << result.name << ": " << std::fixed << std::setprecision(3) << result.median << " ms" << std::defaultfloat << std::endl;
+    }
+}
+
+const std::vector<BenchmarkResult> &BenchmarkSuite::results() const {
+    return m_results;
+}
+
+void BenchmarkSuite::dump_json(std::ostream &out) const {
+    out << std::setprecision(6);
+    out << "{\n  \"warmup\": " << m_options.warmup << ",\n  \"repeats\": " << m_options.repeats << ",\n  \"benchmarks\": [";
+    for (size_t i = 0; i < m_results.size(); ++i) {
+        const auto &r = m_results[i];
+        out << (i == 0 ? "\n" : ",\n");
+        out << "    {\"name\": \"" << r.name << "\", \"repeats\": " << r.repeats
+            << ", \"median_ms\": " << r.median << ", \"p95_ms\": " << r.p95 << ", \"mean_ms\": " << r.mean
+            << ", \"min_ms\": " << r.min << ", \"max_ms\": " << r.max;
+        if (r.bytes > 0) out << ", \"gbytes_per_second\": " << r.gbytes_per_second();
+        if (r.flops > 0) out << ", \"gflops_per_second\": " << r.gflops_per_second();
+        out << "}";
+    }
+    out << "\n  ]\n}" << std::endl;
+    out << std::defaultfloat;
+}
+
+std::ostream &operator << (std::ostream &out, const BenchmarkSuite &suite) {
+    out << std::left << std::setw(40) << "benchmark" << std::right
+        << std::setw(12) << "median(ms)" << std::setw(12) << "p95(ms)" << std::setw(12) << "min(ms)"
+        << std::setw(10) << "GB/s" << std::setw(10) << "GFLOP/s" << std::endl;
+    out << std::fixed << std::setprecision(3);
+    for (const auto &r : suite.results()) {
+        out << std::left << std::setw(40) << r.name << std::right
+            << std::setw(12) << r.median << std::setw(12) << r.p95 << std::setw(12) << r.min
+            << std::setw(10) << std::setprecision(2) << r.gbytes_per_second() << std::setw(10) << r.gflops_per_second()
+            << std::setprecision(3) << std::endl;
+    }
+    out << std::defaultfloat;
+    return out;
+}
+
+} /* !namespace bench */
+} /* !namespace ncg */
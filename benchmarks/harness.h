@@ -0,0 +1,84 @@
+/*
+ * harness.h
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#pragma once
+
+#include "core/common.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace ncg {
+namespace bench {
+
+struct BenchmarkOptions {
+    size_t warmup = 2;
+    size_t repeats = 10;
+    // Only run the benchmarks whose name contains this string.
+    std::string filter;
+};
+
+struct BenchmarkResult {
+    std::string name;
+    size_t repeats = 0;
+    // All times are in milliseconds per iteration.
+    double median = 0;
+    double p95 = 0;
+    double mean = 0;
+    double min = 0;
+    double max = 0;
+    // Work done by one iteration, 0 if not applicable.
+    double bytes = 0;
+    double flops = 0;
+
+    double gbytes_per_second() const { return median > 0 ? bytes / median / 1e6 : 0; }
+    double gflops_per_second() const { return median > 0 ? flops / median / 1e6 : 0; }
+};
+
+/*
+ * A benchmark is registered as a setup function returning the body to be timed, so that the
+ * (possibly expensive) setup only runs for the benchmarks selected by the filter.
+ */
+class BenchmarkSuite {
+public:
+    using Body = std::function<void()>;
+    using Setup = std::function<Body()>;
+
+    void add(const std::string &name, Setup setup, double bytes = 0, double flops = 0);
+    void run(const BenchmarkOptions &options);
+
+    const std::vector<BenchmarkResult> &results() const;
+    void dump_json(std::ostream &out) const;
+
+    friend std::ostream &operator << (std::ostream &out, const BenchmarkSuite &suite);
+
+protected:
+    struct Entry {
+        std::string name;
+        Setup setup;
+        double bytes;
+        double flops;
+    };
+
+    std::vector<Entry> m_entries;
+    std::vector<BenchmarkResult> m_results;
+    BenchmarkOptions m_options;
+};
+
+/* Keeps the compiler from optimizing away the computation of value. */
+template <typename T>
+inline void do_not_optimize(const T &value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+void register_kernel_benchmarks(BenchmarkSuite &suite);
+void register_io_benchmarks(BenchmarkSuite &suite);
+void register_graph_benchmarks(BenchmarkSuite &suite);
+
+} /* !namespace bench */
+} /* !namespace ncg */
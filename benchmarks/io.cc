@@ -0,0 +1,83 @@
+/*
+ * io.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "harness.h"
+#include "core.h"
+
+#include <memory>
+#include <sstream>
+
+namespace ncg {
+namespace bench {
+
+namespace {
+
+// One large tensor (bandwidth-bound) and many small ones (dominated by the per-record overhead).
+const ssize_t kLargeSize = 1 << 22;
+const ssize_t kNrSmall = 5000;
+
+TensorVec make_small_tensors() {
+    TensorVec tensors;
+    for (ssize_t i = 0; i < kNrSmall; ++i) {
+        ssize_t n = 1 + i % 64;
+        tensors.emplace_back(arange(DTypeName::Float32, n * 4).reshape({n, 4}));
+    }
+    return tensors;
+}
+
+size_t total_memsize(const TensorVec &tensors) {
+    size_t nbytes = 0;
+    for (const auto &t : tensors) nbytes += t->storage()->memsize();
+    return nbytes;
+}
+
+std::string pickle_tensors(const TensorVec &tensors) {
+    std::ostringstream out;
+    NCGPickler pickler(out);
+    for (const auto &t : tensors) {
+        t->pickle(pickler);
+    }
+    pickler.close();
+    return out.str();
+}
+
+void unpickle_tensors(const std::string &data, size_t nr_tensors) {
+    std::istringstream in(data);
+    NCGUnpickler unpickler(in);
+    for (size_t i = 0; i < nr_tensors; ++i) {
+        do_not_optimize(tensor(unpickler));
+    }
+    unpickler.close();
+}
+
+} /* !namespace <anonymous> */
+
+void register_io_benchmarks(BenchmarkSuite &suite) {
+    suite.add("pickle/save_f32_16MB", []() {
+        TensorVec tensors{arange(DTypeName::Float32, kLargeSize)};
+        return [=]() { do_not_optimize(pickle_tensors(tensors)); };
+    }, sizeof(float) * kLargeSize);
+
+    suite.add("pickle/load_f32_16MB", []() {
+        auto data = std::make_shared<std::string>(pickle_tensors({arange(DTypeName::Float32, kLargeSize)}));
+        return [=]() { unpickle_tensors(*data, 1); };
+    }, sizeof(float) * kLargeSize);
+
+    const double small_bytes = static_cast<double>(total_memsize(make_small_tensors()));
+    suite.add("pickle/save_5000_small", []() {
+        auto tensors = make_small_tensors();
+        return [=]() { do_not_optimize(pickle_tensors(tensors)); };
+    }, small_bytes);
+
+    suite.add("pickle/load_5000_small", []() {
+        auto data = std::make_shared<std::string>(pickle_tensors(make_small_tensors()));
+        return [=]() { unpickle_tensors(*data, kNrSmall); };
+    }, small_bytes);
+}
+
+} /* !namespace bench */
+} /* !namespace ncg */
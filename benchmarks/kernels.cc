@@ -0,0 +1,361 @@
+/*
+ * kernels.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "harness.h"
+#include "core.h"
+
+#include <random>
+#include <sstream>
+
+namespace ncg {
+namespace bench {
+
+namespace {
+
+const ssize_t kElemwiseSize = 1 << 20;
+const ssize_t kRows = 1024;
+const ssize_t kCols = 1024;
+const ssize_t kMatMulSize = 256;
+// The embedding benchmarks look up kEmbeddingBatch rows of a kEmbeddingRows x kEmbeddingDim table.
+const ssize_t kEmbeddingRows = 100000;
+const ssize_t kEmbeddingDim = 64;
+const ssize_t kEmbeddingBatch = 4096;
+// The sparse operand of the SpMM benchmarks is kSpMMRows x kSpMMCols; the dense one has kSpMMOutputCols columns.
+const ssize_t kSpMMRows = 512;
+const ssize_t kSpMMCols = 4096;
+const ssize_t kSpMMOutputCols = 64;
+// The conv benchmarks run on batches of kConvBatch small images.
+const ssize_t kConvBatch = 64;
+
+// The shapes of the conv benchmarks: {C, H, W} images, O filters of K x K, and the padding (stride 1).
+struct ConvShape {
+    const char *name;
+    ssize_t C, H, W, O, K, padding;
+};
+
+const ConvShape kConvShapes[] = {
+    {"mnist_conv1_1x28x28_8x5x5", 1, 28, 28, 8, 5, 0},
+    {"mnist_conv2_8x12x12_16x5x5", 8, 12, 12, 16, 5, 0},
+    {"3x3_16x14x14_32x3x3", 16, 14, 14, 32, 3, 1},
+};
+
+TensorPtr random_indices(URBG &rng, const ShapeVec &shape, ssize_t upper) {
+    auto indices = empty(DTypeName::Int64, shape);
+    auto ptr = indices->as<DTypeName::Int64>()->mutable_data_ptr();
+    std::uniform_int_distribution<int64_t> dist(0, upper - 1);
+    for (size_t i = 0; i < indices->desc().numel(); ++i) {
+        ptr[i] = dist(rng);
+    }
+    return indices;
+}
+
+SparseTensor random_sparse(URBG &rng, ssize_t rows, ssize_t cols, double density) {
+    ssize_t nnz = static_cast<ssize_t>(density * rows * cols);
+    return SparseTensor::from_coo(
+        {rows, cols}, random_indices(rng, {nnz}, rows), random_indices(rng, {nnz}, cols),
+        rand_normal(rng, DTypeName::Float32, {nnz})
+    );
+}
+
+} /* !namespace <anonymous> */
+
+void register_kernel_benchmarks(BenchmarkSuite &suite) {
+    const double elemwise_bytes = 3.0 * sizeof(float) * kElemwiseSize;
+    suite.add("elemwise/add_f32_1M", []() {
+        URBG rng(0);
+        auto a = rand_normal(rng, DTypeName::Float32, {kElemwiseSize});
+        auto b = rand_normal(rng, DTypeName::Float32, {kElemwiseSize});
+        return [=]() { do_not_optimize(a + b); };
+    }, elemwise_bytes, kElemwiseSize);
+
+    suite.add("elemwise/add_broadcast_f32_1M", []() {
+        URBG rng(0);
+        auto a = rand_normal(rng, DTypeName::Float32, {kRows, kCols});
+        auto b = rand_normal(rng, DTypeName::Float32, {1, kCols}).expand({kRows, kCols});
+        return [=]() { do_not_optimize(a + b); };
+    }, 2.0 * sizeof(float) * kRows * kCols, kRows * kCols);
+
+    suite.add("elemwise/div_f32_1M", []() {
+        URBG rng(0);
+        auto a = rand_normal(rng, DTypeName::Float32, {kElemwiseSize});
+        auto b = rand_normal(rng, DTypeName::Float32, {kElemwiseSize});
+        return [=]() { do_not_optimize(a / b); };
+    }, elemwise_bytes, kElemwiseSize);
+
+    suite.add("elemwise/log_f32_1M", []() {
+        URBG rng(0);
+        auto a = exp(rand_normal(rng, DTypeName::Float32, {kElemwiseSize}));
+        return [=]() { do_not_optimize(log(a)); };
+    }, 2.0 * sizeof(float) * kElemwiseSize);
+
+    suite.add("elemwise/tanh_f32_1M", []() {
+        URBG rng(0);
+        auto a = rand_normal(rng, DTypeName::Float32, {kElemwiseSize});
+        return [=]() { do_not_optimize(tanh(a)); };
+    }, 2.0 * sizeof(float) * kElemwiseSize);
+
+    suite.add("elemwise/cast_f32_to_f64_1M", []() {
+        URBG rng(0);
+        auto a = rand_normal(rng, DTypeName::Float32, {kElemwiseSize});
+        return [=]() { do_not_optimize(a.float64()); };
+    }, (sizeof(float) + sizeof(double)) * kElemwiseSize);
+
+    suite.add("elemwise/cast_f32_to_f16_1M", []() {
+        URBG rng(0);
+        auto a = rand_normal(rng, DTypeName::Float32, {kElemwiseSize});
+        return [=]() { do_not_optimize(a.float16()); };
+    }, (sizeof(float) + sizeof(float16)) * kElemwiseSize);
+
+    suite.add("elemwise/add_f16_1M", []() {
+        URBG rng(0);
+        auto a = rand_normal(rng, DTypeName::Float32, {kRows, kCols}).float16();
+        auto b = rand_normal(rng, DTypeName::Float32, {kRows, kCols}).float16();
+        return [=]() { do_not_optimize(a + b); };
+    }, 3.0 * sizeof(float16) * kRows * kCols, kRows * kCols);
+
+    suite.add("elemwise/ge_f32_1M", []() {
+        URBG rng(0);
+        auto a = rand_normal(rng, DTypeName::Float32, {kElemwiseSize});
+        auto b = rand_normal(rng, DTypeName::Float32, {kElemwiseSize});
+        return [=]() { do_not_optimize(ge(a, b)); };
+    }, (2.0 * sizeof(float) + sizeof(bool)) * kElemwiseSize, kElemwiseSize);
+
+    suite.add("elemwise/cond_bool_f32_1M", []() {
+        URBG rng(0);
+        auto a = rand_normal(rng, DTypeName::Float32, {kElemwiseSize});
+        auto b = rand_normal(rng, DTypeName::Float32, {kElemwiseSize});
+        auto mask = ge(a, b);
+        return [=]() { do_not_optimize(cond(mask, a, b)); };
+    }, (3.0 * sizeof(float) + sizeof(bool)) * kElemwiseSize, kElemwiseSize);
+
+    suite.add("elemwise/pack_mask_1M", []() {
+        URBG rng(0);
+        auto a = rand_normal(rng, DTypeName::Float32, {kElemwiseSize});
+        auto b = rand_normal(rng, DTypeName::Float32, {kElemwiseSize});
+        auto mask = ge(a, b);
+        return [=]() { do_not_optimize(PackedMask(mask).count()); };
+    }, (sizeof(bool) + 1.0 / 8) * kElemwiseSize, kElemwiseSize);
+
+    suite.add("reduction/sum_rows_f32_1M", []() {
+        URBG rng(0);
+        auto a = rand_normal(rng, DTypeName::Float32, {kRows, kCols});
+        return [=]() { do_not_optimize(a.sum(1)); };
+    }, sizeof(float) * kRows * kCols, kRows * kCols);
+
+    suite.add("reduction/sum_cols_f32_1M", []() {
+        URBG rng(0);
+        auto a = rand_normal(rng, DTypeName::Float32, {kRows, kCols});
+        return [=]() { do_not_optimize(a.sum(0)); };
+    }, sizeof(float) * kRows * kCols, kRows * kCols);
+
+    suite.add("reduction/max_rows_f32_1M", []() {
+        URBG rng(0);
+        auto a = rand_normal(rng, DTypeName::Float32, {kRows, kCols});
+        return [=]() { do_not_optimize(a.max(1)); };
+    }, sizeof(float) * kRows * kCols, kRows * kCols);
+
+    const double matmul_flops = 2.0 * kMatMulSize * kMatMulSize * kMatMulSize;
+    suite.add("matmul/f32_256", []() {
+        URBG rng(0);
+        auto a = rand_normal(rng, DTypeName::Float32, {kMatMulSize, kMatMulSize});
+        auto b = rand_normal(rng, DTypeName::Float32, {kMatMulSize, kMatMulSize});
+        return [=]() { do_not_optimize(matmul(a, b)); };
+    }, 3.0 * sizeof(float) * kMatMulSize * kMatMulSize, matmul_flops);
+
+    suite.add("matmul/f32_256_transpose_b", []() {
+        URBG rng(0);
+        auto a = rand_normal(rng, DTypeName::Float32, {kMatMulSize, kMatMulSize});
+        auto b = rand_normal(rng, DTypeName::Float32, {kMatMulSize, kMatMulSize});
+        return [=]() { do_not_optimize(matmul(a, b, false, true)); };
+    }, 3.0 * sizeof(float) * kMatMulSize * kMatMulSize, matmul_flops);
+
+    suite.add("matmul/bf16_256", []() {
+        URBG rng(0);
+        auto a = rand_normal(rng, DTypeName::Float32, {kMatMulSize, kMatMulSize}).bfloat16();
+        auto b = rand_normal(rng, DTypeName::Float32, {kMatMulSize, kMatMulSize}).bfloat16();
+        return [=]() { do_not_optimize(matmul(a, b)); };
+    }, 3.0 * sizeof(bfloat16) * kMatMulSize * kMatMulSize, matmul_flops);
+
+    suite.add("matmul/i8_256", []() {
+        URBG rng(0);
+        auto params = QuantizationParams::from_range(-4, 4);
+        auto a = quantize(rand_normal(rng, DTypeName::Float32, {kMatMulSize, kMatMulSize}), params);
+        auto b = quantize(rand_normal(rng, DTypeName::Float32, {kMatMulSize, kMatMulSize}), params);
+        return [=]() { do_not_optimize(quantized_matmul(a, b, nullptr, DTypeName::Int32, QuantizationParams(), true)); };
+    }, 2.0 * sizeof(int8_t) * kMatMulSize * kMatMulSize + sizeof(int32_t) * kMatMulSize * kMatMulSize, matmul_flops);
+
+    // The same product at several sparsities, against the dense matmul.
+    for (double density : {0.001, 0.01, 0.1}) {
+        std::ostringstream name;
+        name << "spmm/f32_" << kSpMMRows << "x" << kSpMMCols << "x" << kSpMMOutputCols << "_density_" << density;
+        double nnz = density * kSpMMRows * kSpMMCols;
+        suite.add(name.str(), [density]() {
+            URBG rng(0);
+            auto a = random_sparse(rng, kSpMMRows, kSpMMCols, density);
+            auto b = rand_normal(rng, DTypeName::Float32, {kSpMMCols, kSpMMOutputCols});
+            return [=]() { do_not_optimize(sparse_matmul(a, b)); };
+        }, (2.0 * sizeof(float) + sizeof(int64_t)) * nnz + sizeof(float) * kSpMMRows * kSpMMOutputCols, 2.0 * nnz * kSpMMOutputCols);
+    }
+
+    suite.add("spmm/dense_f32_512x4096x64", []() {
+        URBG rng(0);
+        auto a = rand_normal(rng, DTypeName::Float32, {kSpMMRows, kSpMMCols});
+        auto b = rand_normal(rng, DTypeName::Float32, {kSpMMCols, kSpMMOutputCols});
+        return [=]() { do_not_optimize(matmul(a, b)); };
+    }, sizeof(float) * (kSpMMRows * kSpMMCols + kSpMMCols * kSpMMOutputCols + kSpMMRows * kSpMMOutputCols), 2.0 * kSpMMRows * kSpMMCols * kSpMMOutputCols);
+
+    suite.add("slice/index_select_rows_f32", []() {
+        URBG rng(0);
+        auto a = rand_normal(rng, DTypeName::Float32, {kRows * 16, 64});
+        auto indices = random_indices(rng, {kRows}, kRows * 16);
+        return [=]() { do_not_optimize(a.index_select(0, indices)); };
+    }, 2.0 * sizeof(float) * kRows * 64);
+
+    suite.add("slice/gather_f32", []() {
+        URBG rng(0);
+        auto a = rand_normal(rng, DTypeName::Float32, {kRows, kCols});
+        auto indices = random_indices(rng, {kRows, 64}, kCols);
+        return [=]() { do_not_optimize(a.gather(1, indices)); };
+    }, 2.0 * sizeof(float) * kRows * 64);
+
+    const double embedding_bytes = 2.0 * sizeof(float) * kEmbeddingBatch * kEmbeddingDim;
+    suite.add("embedding/lookup_f32", []() {
+        URBG rng(0);
+        auto table = rand_normal(rng, DTypeName::Float32, {kEmbeddingRows, kEmbeddingDim});
+        auto indices = random_indices(rng, {kEmbeddingBatch}, kEmbeddingRows);
+        return [=]() { do_not_optimize(embedding(table, indices)); };
+    }, embedding_bytes);
+
+    // One SGD step of the table: the row-sparse gradient and the in-place update of the touched rows, against the
+    // dense gradient and the update of the whole table.
+    suite.add("embedding/sgd_sparse_f32", []() {
+        URBG rng(0);
+        auto table = rand_normal(rng, DTypeName::Float32, {kEmbeddingRows, kEmbeddingDim});
+        auto indices = random_indices(rng, {kEmbeddingBatch}, kEmbeddingRows);
+        auto output_grad = rand_normal(rng, DTypeName::Float32, {kEmbeddingBatch, kEmbeddingDim});
+        return [=]() mutable {
+            auto grad = embedding_grad(output_grad, indices);
+            add_rows_inplace(table, grad[0], grad[1], -0.01);
+        };
+    }, 2.0 * embedding_bytes);
+
+    suite.add("embedding/sgd_dense_f32", []() {
+        URBG rng(0);
+        auto table = rand_normal(rng, DTypeName::Float32, {kEmbeddingRows, kEmbeddingDim});
+        auto indices = random_indices(rng, {kEmbeddingBatch}, kEmbeddingRows);
+        auto output_grad = rand_normal(rng, DTypeName::Float32, {kEmbeddingBatch, kEmbeddingDim});
+        auto lr = fill(DTypeName::Float32, {kEmbeddingRows, kEmbeddingDim}, 0.01);
+        return [=]() {
+            do_not_optimize(table - index_select_backward(output_grad, 0, indices, kEmbeddingRows) * lr);
+        };
+    }, 4.0 * sizeof(float) * kEmbeddingRows * kEmbeddingDim);
+
+    suite.add("slice/index_select_backward_rows_f32", []() {
+        URBG rng(0);
+        auto grad = rand_normal(rng, DTypeName::Float32, {kRows * 4, 64});
+        auto indices = random_indices(rng, {kRows * 4}, kRows);
+        return [=]() { do_not_optimize(index_select_backward(grad, 0, indices, kRows)); };
+    }, sizeof(float) * (kRows * 64 + 2 * kRows * 4 * 64));
+
+    suite.add("slice/gather_backward_f32", []() {
+        URBG rng(0);
+        auto grad = rand_normal(rng, DTypeName::Float32, {kRows, 64});
+        auto indices = random_indices(rng, {kRows, 64}, 256);
+        return [=]() { do_not_optimize(gather_backward(grad, 1, indices, 256)); };
+    }, sizeof(float) * (kRows * 256 + 2 * kRows * 64));
+
+    suite.add("slice/concat_f32_4x256K", []() {
+        URBG rng(0);
+        TensorVec parts;
+        for (int i = 0; i < 4; ++i) {
+            parts.emplace_back(rand_normal(rng, DTypeName::Float32, {kRows / 4, kCols}));
+        }
+        return [=]() { do_not_optimize(concat(parts, 0)); };
+    }, 2.0 * sizeof(float) * kRows * kCols);
+
+    suite.add("slice/concat_axis1_f32_4x256K", []() {
+        URBG rng(0);
+        TensorVec parts;
+        for (int i = 0; i < 4; ++i) {
+            parts.emplace_back(rand_normal(rng, DTypeName::Float32, {kRows, kCols / 4}));
+        }
+        return [=]() { do_not_optimize(concat(parts, 1)); };
+    }, 2.0 * sizeof(float) * kRows * kCols);
+
+    // The parts are adjacent views of one storage: concat returns a view.
+    suite.add("slice/concat_split_views_f32_4x256K", []() {
+        URBG rng(0);
+        auto parts = split(rand_normal(rng, DTypeName::Float32, {kRows, kCols}), 0, {kRows / 4, kRows / 4, kRows / 4, kRows / 4});
+        return [=]() { do_not_optimize(concat(parts, 0)); };
+    });
+
+    // Each conv shape with both kernels (Auto picks one of them), forward and backward.
+    for (const auto &shape : kConvShapes) {
+        ssize_t OH = shape.H + 2 * shape.padding - shape.K + 1, OW = shape.W + 2 * shape.padding - shape.K + 1;
+        double flops = 2.0 * kConvBatch * shape.O * OH * OW * shape.C * shape.K * shape.K;
+        double bytes = sizeof(float) * (kConvBatch * shape.C * shape.H * shape.W + shape.O * shape.C * shape.K * shape.K + kConvBatch * shape.O * OH * OW);
+        for (auto algorithm : {Conv2dAlgorithm::Im2col, Conv2dAlgorithm::Direct}) {
+            std::string suffix = std::string(shape.name) + (algorithm == Conv2dAlgorithm::Im2col ? "_im2col" : "_direct");
+            auto make_inputs = [shape, OH, OW](URBG &rng) {
+                return TensorVec{
+                    rand_normal(rng, DTypeName::Float32, {kConvBatch, shape.C, shape.H, shape.W}),
+                    rand_normal(rng, DTypeName::Float32, {shape.O, shape.C, shape.K, shape.K}),
+                    rand_normal(rng, DTypeName::Float32, {kConvBatch, shape.O, OH, OW})
+                };
+            };
+            suite.add("conv/forward_" + suffix, [=]() {
+                URBG rng(0);
+                auto inputs = make_inputs(rng);
+                return [=]() { do_not_optimize(conv2d(inputs[0], inputs[1], 1, shape.padding, algorithm)); };
+            }, bytes, flops);
+            suite.add("conv/backward_data_" + suffix, [=]() {
+                URBG rng(0);
+                auto inputs = make_inputs(rng);
+                return [=]() { do_not_optimize(conv2d_backward_data(inputs[1], inputs[2], shape.H, shape.W, 1, shape.padding, algorithm)); };
+            }, bytes, flops);
+            suite.add("conv/backward_filter_" + suffix, [=]() {
+                URBG rng(0);
+                auto inputs = make_inputs(rng);
+                return [=]() { do_not_optimize(conv2d_backward_filter(inputs[0], inputs[2], shape.K, shape.K, 1, shape.padding, algorithm)); };
+            }, bytes, flops);
+        }
+    }
+
+    // 2x2 pooling with stride 2 of the {16, 28, 28} feature maps.
+    const double pool_bytes = 1.25 * sizeof(float) * kConvBatch * 16 * 28 * 28;
+    suite.add("conv/max_pool2d_f32_16x28x28", []() {
+        URBG rng(0);
+        auto a = rand_normal(rng, DTypeName::Float32, {kConvBatch, 16, 28, 28});
+        return [=]() { do_not_optimize(max_pool2d(a, 2, 2)); };
+    }, pool_bytes);
+
+    suite.add("conv/max_pool2d_backward_f32_16x28x28", []() {
+        URBG rng(0);
+        auto a = rand_normal(rng, DTypeName::Float32, {kConvBatch, 16, 28, 28});
+        auto grad = rand_normal(rng, DTypeName::Float32, {kConvBatch, 16, 14, 14});
+        return [=]() { do_not_optimize(max_pool2d_backward(a, grad, 2, 2)); };
+    }, 2 * pool_bytes);
+
+    suite.add("conv/avg_pool2d_f32_16x28x28", []() {
+        URBG rng(0);
+        auto a = rand_normal(rng, DTypeName::Float32, {kConvBatch, 16, 28, 28});
+        return [=]() { do_not_optimize(avg_pool2d(a, 2, 2)); };
+    }, pool_bytes);
+
+    suite.add("shape/make_contiguous_transpose_f32_1M", []() {
+        URBG rng(0);
+        auto a = rand_normal(rng, DTypeName::Float32, {kRows, kCols}).permute({1, 0});
+        return [=]() {
+            auto copy = tensor(a->desc(), a->storage(), false, a->data_ptr_offset());
+            copy->make_contiguous();
+            do_not_optimize(copy);
+        };
+    }, 2.0 * sizeof(float) * kRows * kCols);
+}
+
+} /* !namespace bench */
+} /* !namespace ncg */
@@ -0,0 +1,51 @@
+/*
+ * main.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ *
+ * Usage: bench [--warmup N] [--repeats N] [--json FILE] [FILTER]
+ */
+
+#include "harness.h"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace ncg::bench;
+
+int main(int argc, char *argv[]) {
+    BenchmarkOptions options;
+    std::string json_filename;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--warmup" && i + 1 < argc) {
+            options.warmup = std::stoul(argv[++i]);
+        } else if (arg == "--repeats" && i + 1 < argc) {
+            options.repeats = std::stoul(argv[++i]);
+        } else if (arg == "--json" && i + 1 < argc) {
+            json_filename = argv[++i];
+        } else if (arg.size() > 0 && arg[0] != '-') {
+            options.filter = arg;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--warmup N] [--repeats N] [--json FILE] [FILTER]" << std::endl;
+            return 1;
+        }
+    }
+
+    BenchmarkSuite suite;
+    register_kernel_benchmarks(suite);
+    register_io_benchmarks(suite);
+    register_graph_benchmarks(suite);
+    suite.run(options);
+
+    std::cout << suite;
+    if (json_filename.size() > 0) {
+        std::ofstream out(json_filename);
+        suite.dump_json(out);
+    }
+
+    return 0;
+}
@@ -24,5 +24,30 @@ int main() {
     cerr << *t2->as<DTypeName::Float32>() << endl;
     cerr << *t3->as<DTypeName::Float32>() << endl;
 
+    // Domain errors are reported once by the op; without the domain checks, the IEEE semantics apply.
+    auto zeros = fill(DTypeName::Float32, {4}, 0);
+    auto ones = fill(DTypeName::Float32, {4}, 1);
+    OpDiv div;
+    OpLog log;
+    OpContext ctx;
+    div.execute(ctx, {ones, zeros});
+    ncg_assert(ctx.is_error() && ctx.error_str() == "Division by zero");
+    OpContext log_ctx;
+    log.execute(log_ctx, {zeros});
+    ncg_assert(log_ctx.is_error() && log_ctx.error_str() == "LOG operator's input must be positive");
+
+    OpContext ieee_ctx;
+    ieee_ctx.set_domain_checks(false);
+    auto t4 = div.execute(ieee_ctx, {ones, zeros})[0];
+    auto t5 = log.execute(ieee_ctx, {zeros})[0];
+    ncg_assert(ieee_ctx.ok());
+    ncg_assert(std::isinf(t4->as<DTypeName::Float32>()->elat(0)) && std::isinf(t5->as<DTypeName::Float32>()->elat(3)));
+    cerr << *t4->as<DTypeName::Float32>() << endl;
+
+    auto i1 = fill(DTypeName::Int32, {4}, 1);
+    OpContext int_ctx;
+    div.execute(int_ctx, {i1, i1});
+    ncg_assert(int_ctx.error_str() == "Division for integer not implemented");
+
     return 0;
 }
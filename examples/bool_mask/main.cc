@@ -0,0 +1,170 @@
+/*
+ * main.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "ncg.h"
+
+#include <iostream>
+#include <random>
+
+using namespace ncg;
+using namespace std;
+
+// Elements in the logical order, cast to float32.
+std::vector<float> values(TensorPtr a) {
+    auto fa = a.float32();
+    std::vector<float> result(fa->desc().numel());
+    for (ssize_t i = 0; i < fa->desc().numel(); ++i) {
+        result[i] = fa->as<DTypeName::Float32>()->elat(i);
+    }
+    return result;
+}
+
+void test_comparisons() {
+    std::mt19937 rng(1234);
+    // Not a multiple of the blocks of the kernels, so that the remainders run too.
+    const ssize_t n = 1003;
+    auto a = rand_normal(rng, DTypeName::Float32, {n});
+    auto b = rand_normal(rng, DTypeName::Float32, {n});
+    auto va = values(a), vb = values(b);
+
+    auto check = [&](TensorPtr result, std::function<bool(float, float)> expected) {
+        ncg_assert(result->desc().dtype() == DTypeName::Bool);
+        auto vr = values(result);
+        for (ssize_t i = 0; i < n; ++i) {
+            ncg_assert(vr[i] == expected(va[i], vb[i]));
+        }
+    };
+    check(ge(a, b), [](float x, float y) { return x > y; });
+    check(le(a, b), [](float x, float y) { return x < y; });
+    check(geq(a, b), [](float x, float y) { return x >= y; });
+    check(leq(a, b), [](float x, float y) { return x <= y; });
+    check(a.eq(a.narrow(0, 0, n)), [](float x, float y) { return true; });
+    check(neq(a, b), [](float x, float y) { return x != y; });
+
+    // One byte per element: an Int64 comparison used to take eight.
+    auto labels = cast(a, DTypeName::Int64), preds = cast(b, DTypeName::Int64);
+    auto correct = labels.eq(preds);
+    ncg_assert(correct->desc().dtype() == DTypeName::Bool && correct->storage()->memsize() == n);
+
+    // The reduced-precision and the strided paths agree with the contiguous Float32 one.
+    check(ge(a.float16(), b.float16()), [](float x, float y) { return float(float16(x)) > float(float16(y)); });
+    auto m = rand_normal(rng, DTypeName::Float32, {17, 33});
+    auto mt = m.permute({1, 0});
+    ncg_assert(values(ge(mt, mt.float64().float32())) == values(ge(m, m).permute({1, 0})));
+    ncg_assert(values(geq(mt, mt.float64().float32())) == std::vector<float>(17 * 33, 1));
+
+    // Bool tensors support the logic ops (min is the and, max the or) and the casts, not the arithmetic.
+    auto x = ge(a, b), y = ge(b, fill(DTypeName::Float32, {n}, 0));
+    auto vx = values(x), vy = values(y);
+    auto vand = values(min(x, y)), vor = values(max(x, y));
+    for (ssize_t i = 0; i < n; ++i) {
+        ncg_assert(vand[i] == (vx[i] && vy[i]) && vor[i] == (vx[i] || vy[i]));
+    }
+    ncg_assert(values(fromcc(DTypeName::Float32, std::vector<float>{0, -2, 0.5}).boolean()) == (std::vector<float>{0, 1, 1}));
+
+    OpAdd add;
+    OpContext ctx;
+    add.execute(ctx, {x, y});
+    ncg_assert(ctx.is_error() && ctx.error_str() == "Arithmetic on Bool tensors is not supported; cast them first.");
+}
+
+void test_cond() {
+    std::mt19937 rng(1234);
+    const ssize_t n = 1003;
+    auto a = rand_normal(rng, DTypeName::Float32, {n});
+    auto b = rand_normal(rng, DTypeName::Float32, {n});
+    auto mask = ge(a, b);
+    auto va = values(a), vb = values(b);
+
+    // max(a, b) as a select, for every dtype of the values.
+    for (DTypeName dtype : {DTypeName::Float32, DTypeName::Float64, DTypeName::Int64, DTypeName::Int32, DTypeName::Int8, DTypeName::Float16}) {
+        auto ten = fill(DTypeName::Float32, {n}, 10);
+        auto ca = cast(a * ten, dtype), cb = cast(b * ten, dtype);
+        auto result = cond(mask, ca, cb);
+        ncg_assert(result->desc().dtype() == dtype);
+        ncg_assert(values(result) == values(max(ca, cb)));
+    }
+
+    // A condition of the dtype of the values still selects on its sign; strided inputs take the generic path.
+    ncg_assert(values(cond(a - b, a, b)) == values(cond(mask, a, b)));
+    auto m = rand_normal(rng, DTypeName::Float32, {17, 33});
+    auto mt = m.permute({1, 0});
+    auto zeros = fill(DTypeName::Float32, {33, 17}, 0);
+    ncg_assert(values(cond(ge(mt, zeros), mt, zeros)) == values(max(m, fill(DTypeName::Float32, {17, 33}, 0)).permute({1, 0})));
+
+    OpCond op;
+    OpContext ctx;
+    op.execute(ctx, {cast(mask, DTypeName::Int32), a, b});
+    ncg_assert(ctx.is_error());
+    OpContext values_ctx;
+    op.execute(values_ctx, {mask, a, cast(b, DTypeName::Float64)});
+    ncg_assert(values_ctx.is_error());
+}
+
+void test_graph() {
+    std::mt19937 rng(1234);
+    auto value = rand_normal(rng, DTypeName::Float32, {8, 16});
+    auto x = G::placeholder("x", {8, 16});
+    auto zero = G::zeros({8, 16});
+
+    // The backward of max selects the gradient with a Bool mask.
+    auto relu = G::max(x, zero);
+    auto loss = G::reduce_sum(relu, 1).sum(0);
+    auto &graph = get_default_graph();
+    graph.backward(loss);
+    auto grad = x->grad(loss);
+
+    auto positive = G::ge(x, zero);
+    auto fraction = G::reduce_mean(positive.float32(), 1).mean(0);
+    auto gated = G::cond(positive, x, zero);
+
+    GraphForwardContext ctx;
+    ctx.feed("x", value);
+    auto outputs = ctx.eval({grad, positive, fraction, gated, relu});
+    ncg_assert_msg(ctx.ok(), ctx.error_str());
+    ncg_assert(outputs[1]->desc().dtype() == DTypeName::Bool);
+
+    auto vx = values(value), vg = values(outputs[0]), vp = values(outputs[1]);
+    float nr_positive = 0;
+    for (size_t i = 0; i < vx.size(); ++i) {
+        ncg_assert(vg[i] == (vx[i] >= 0 ? 1 : 0) && vp[i] == (vx[i] > 0));
+        nr_positive += vp[i];
+    }
+    ncg_assert(std::fabs(values(outputs[2])[0] - nr_positive / vx.size()) < 1e-6);
+    ncg_assert(values(outputs[3]) == values(outputs[4]));
+}
+
+void test_packed_mask() {
+    std::mt19937 rng(1234);
+    for (ssize_t n : {0, 1, 63, 64, 65, 1003}) {
+        auto mask = ge(rand_normal(rng, DTypeName::Float32, {n}), rand_normal(rng, DTypeName::Float32, {n}));
+        PackedMask packed(mask);
+        ncg_assert(packed.numel() == n && packed.memsize() == get_packed_words(n) * sizeof(uint64_t));
+
+        auto unpacked = packed.unpack();
+        ncg_assert(unpacked->desc().dtype() == DTypeName::Bool && unpacked->desc().shape_vec() == mask->desc().shape_vec());
+        auto vm = values(mask);
+        ncg_assert(values(unpacked) == vm);
+        ncg_assert(packed.count() == std::count(vm.begin(), vm.end(), 1.0f));
+    }
+
+    // Packed in the logical order, whatever the layout.
+    auto m = rand_normal(rng, DTypeName::Float32, {70, 30});
+    auto mask = ge(m, fill(DTypeName::Float32, {70, 30}, 0)).permute({1, 0});
+    PackedMask packed(mask);
+    ncg_assert(packed.shape() == (ShapeVec{30, 70}) && values(packed.unpack()) == values(mask));
+    ncg_assert(packed.memsize() * 8 < mask->storage()->memsize() + 64);
+}
+
+int main() {
+    test_comparisons();
+    test_cond();
+    test_graph();
+    test_packed_mask();
+    cerr << "OK" << endl;
+    return 0;
+}
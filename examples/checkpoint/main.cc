@@ -0,0 +1,174 @@
+/*
+ * main.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "ncg.h"
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace ncg;
+using namespace std;
+
+// A "model" with a large frozen embedding table and a few small trainable layers.
+const ssize_t kNrLayers = 32;
+const ssize_t kHidden = 256;
+
+double now() {
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+float first_value(Session &session, const GTensorPtr &var) {
+    return session.shared_tensor(var)->as<DTypeName::Float32>()->elat(0);
+}
+
+int main() {
+    Graph graph;
+    Session session(graph);
+    as_default_graph(graph);
+    as_default_session(session);
+
+    std::mt19937 rng(1234);
+    auto embedding = G::variable("embedding", rand_normal(rng, DTypeName::Float32, {20000, kHidden}));
+    vector<GTensorPtr> weights;
+    GTensorVec updates;
+    for (ssize_t i = 0; i < kNrLayers; ++i) {
+        auto w = G::variable("layer" + to_string(i) + ":W", rand_normal(rng, DTypeName::Float32, {kHidden, kHidden}));
+        weights.emplace_back(w);
+        updates.emplace_back(G::assign(w, w * 0.5f));
+    }
+
+    {
+        GraphForwardContext ctx;
+        GTensorVec variables{embedding};
+        variables.insert(variables.end(), weights.begin(), weights.end());
+        ctx.eval(variables);
+    }
+
+    CheckpointOptions options;
+    options.shard_size = 4 * 1024 * 1024;
+
+    for (bool content_hash : {false, true}) {
+        options.content_hash = content_hash;
+        Checkpointer checkpointer(session, "dumps/checkpoint", options);
+
+        double start = now();
+        size_t written = checkpointer.save();
+        double full_time = now() - start;
+
+        // Train one step: only the small layers change, the embedding is frozen.
+        {
+            GraphForwardContext ctx;
+            ctx.eval(updates);
+        }
+
+        start = now();
+        size_t written_delta = checkpointer.save();
+        double delta_time = now() - start;
+
+        cerr << fixed << setprecision(2);
+        cerr << "change detection: " << (content_hash ? "content hash" : "storage identity") << endl;
+        cerr << "  full save:  " << written << "/" << checkpointer.shards().size() << " shards, " << full_time * 1000 << " ms" << endl;
+        cerr << "  delta save: " << written_delta << "/" << checkpointer.shards().size() << " shards, " << delta_time * 1000 << " ms" << endl;
+    }
+
+    float expected = first_value(session, weights[0]);
+    {
+        GraphForwardContext ctx;
+        ctx.eval(updates);
+    }
+    ncg_assert(first_value(session, weights[0]) != expected);
+
+    options.content_hash = false;
+    Checkpointer loader(session, "dumps/checkpoint", options);
+    double start = now();
+    loader.load();
+    cerr << "  load: " << (now() - start) * 1000 << " ms" << endl;
+    ncg_assert(first_value(session, weights[0]) == expected);
+    ncg_assert(loader.save() == 0);
+
+    // Re-sharding into fewer, larger shards: the new manifest lists only the new shards, and the
+    // shards it no longer lists are removed after it has been written.
+    {
+        CheckpointOptions resharded_options = options;
+        resharded_options.content_hash = true;
+        resharded_options.shard_size = 64 * 1024 * 1024;
+        Checkpointer resharder(session, "dumps/checkpoint", resharded_options);
+        resharder.save();
+
+        size_t nr_files = 0;
+        for (const auto &entry : std::filesystem::directory_iterator("dumps/checkpoint")) {
+            ncg_assert(entry.path().extension() != ".tmp");
+            ++nr_files;
+        }
+        ncg_assert(nr_files == resharder.shards().size() + 1);
+
+        Checkpointer loader(session, "dumps/checkpoint", resharded_options);
+        loader.load();
+        ncg_assert(loader.shards().size() == resharder.shards().size());
+        ncg_assert(first_value(session, weights[0]) == expected);
+    }
+
+    // Compression: a full save and load with each codec.
+    for (auto codec : {CompressionCodec::None, CompressionCodec::ShuffleLZ, CompressionCodec::FloatDelta}) {
+        CheckpointOptions compressed_options = options;
+        compressed_options.codec = codec;
+        compressed_options.delta = false;
+
+        Checkpointer saver(session, string("dumps/checkpoint_") + get_codec_name(codec), compressed_options);
+        saver.save();
+        Checkpointer loader(session, saver.dirname(), compressed_options);
+        loader.load();
+        ncg_assert(first_value(session, weights[0]) == expected);
+
+        cerr << "codec: " << get_codec_name(codec) << endl;
+        cerr << "  compress:   " << saver.compression_stats() << endl;
+        cerr << "  decompress: " << loader.decompression_stats() << endl;
+    }
+
+    // An embedding table updated in place by a row-sparse SGD step (GOpAssignAddRows) keeps its tensor and storage
+    // objects: the version of the storage tells the delta save that it changed.
+    {
+        auto indices = G::placeholder("indices", {16}, DTypeName::Int64);
+        auto loss = G::reduce_sum(G::embedding("emb", indices, 1000, 8, rng), 1).sum(0);
+        auto &graph = get_default_graph();
+        graph.backward(loss);
+        auto table = graph.find_op("emb:table")->outputs()[0];
+        auto update = G::sgd_update(table, table->grad(loss), 0.1f);
+        auto batch = arange(DTypeName::Int64, 16);
+        auto step = [&]() {
+            GraphForwardContext ctx;
+            ctx.feed("indices", batch);
+            ctx.eval({update});
+            ncg_assert_msg(ctx.ok(), ctx.error_str());
+        };
+
+        step();
+        Checkpointer checkpointer(session, "dumps/checkpoint_sparse", CheckpointOptions());
+        checkpointer.save();
+        ncg_assert(checkpointer.save() == 0);
+
+        auto storage = session.shared_tensor(table)->storage().get();
+        step();
+        ncg_assert(session.shared_tensor(table)->storage().get() == storage);
+        ncg_assert(checkpointer.save() == 1);
+
+        float saved = first_value(session, table);
+        step();
+        Checkpointer loader(session, "dumps/checkpoint_sparse", CheckpointOptions());
+        loader.load();
+        ncg_assert(first_value(session, table) == saved);
+    }
+
+    restore_default_session();
+    restore_default_graph();
+    return 0;
+}
@@ -0,0 +1,120 @@
+/*
+ * main.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "ncg.h"
+
+#include <iostream>
+#include <random>
+
+using namespace ncg;
+using namespace std;
+
+std::vector<double> values(TensorPtr a) {
+    auto fa = cast(a, DTypeName::Float64);
+    std::vector<double> result(fa->desc().numel());
+    for (ssize_t i = 0; i < fa->desc().numel(); ++i) {
+        result[i] = fa->as<DTypeName::Float64>()->elat(i);
+    }
+    return result;
+}
+
+// The element-by-element definition, as a reference.
+std::vector<double> ref_concat(const TensorVec &inputs, ssize_t axis) {
+    ssize_t outer = 1, inner = 1, total = 0;
+    for (ssize_t i = 0; i < inputs[0]->desc().dim(); ++i) {
+        if (i < axis) outer *= inputs[0]->desc().shape(i);
+        if (i > axis) inner *= inputs[0]->desc().shape(i);
+    }
+    for (auto &input : inputs) total += input->desc().shape(axis);
+
+    std::vector<double> result(outer * total * inner);
+    ssize_t offset = 0;
+    for (auto &input : inputs) {
+        auto v = values(input);
+        ssize_t size = input->desc().shape(axis);
+        for (ssize_t p = 0; p < v.size(); ++p) {
+            ssize_t o = p / (size * inner), j = p / inner % size, i = p % inner;
+            result[(o * total + offset + j) * inner + i] = v[p];
+        }
+        offset += size;
+    }
+    return result;
+}
+
+bool shares_storage(TensorPtr a, TensorPtr b) {
+    return a->storage() == b->storage();
+}
+
+// Small shapes run on a single thread; the large ones are split across the workers.
+const std::vector<ShapeVec> kShapes = {{5, 6, 7}, {13}, {3, 1, 4}, {2, 70000}, {300, 3, 100}};
+
+void test_copy() {
+    std::mt19937 rng(1234);
+    for (auto &shape : kShapes) {
+        for (ssize_t axis = 0; axis < shape.size(); ++axis) {
+            for (auto dtype : {DTypeName::Float32, DTypeName::Int64, DTypeName::Float16}) {
+                TensorVec inputs;
+                for (ssize_t size : {shape[axis], ssize_t(1), shape[axis] * 2}) {
+                    auto part_shape = shape;
+                    part_shape[axis] = size;
+                    inputs.emplace_back(cast(rand_normal(rng, DTypeName::Float64, part_shape) * fill(DTypeName::Float64, part_shape, 100), dtype));
+                }
+                auto output = concat(inputs, axis);
+                ncg_assert(output->desc().dtype() == dtype && output->desc().is_contiguous());
+                ncg_assert(values(output) == ref_concat(inputs, axis));
+                ncg_assert(values(concat(inputs, axis - shape.size())) == values(output));
+            }
+        }
+    }
+
+    // A strided input among contiguous ones.
+    auto a = rand_normal(rng, DTypeName::Float32, {20, 30});
+    auto b = rand_normal(rng, DTypeName::Float32, {30, 20}).permute({1, 0});
+    ncg_assert(values(concat({a, b, a}, 0)) == ref_concat({a, b, a}, 0));
+    ncg_assert(values(concat({a, b, a}, 1)) == ref_concat({a, b, a}, 1));
+}
+
+void test_view() {
+    std::mt19937 rng(4321);
+    auto a = rand_normal(rng, DTypeName::Float32, {6, 8, 5});
+
+    for (ssize_t axis = 0; axis < 3; ++axis) {
+        // Split and concatenated back: the parts are adjacent, so the result is a view of a.
+        auto parts = split(a, axis, {1, a->desc().shape(axis) - 3, 2});
+        auto joined = concat(parts, axis);
+        ncg_assert(shares_storage(joined, a) && values(joined) == values(a));
+        ncg_assert(joined->desc().is_contiguous());
+
+        // A part of the parts, still adjacent.
+        auto partial = concat({parts[1], parts[2]}, axis);
+        ncg_assert(shares_storage(partial, a) && values(partial) == ref_concat({parts[1], parts[2]}, axis));
+        auto expected = values(partial);
+        partial->make_contiguous();
+        ncg_assert(partial->desc().is_contiguous() && values(partial) == expected);
+
+        // Out of order: copied.
+        auto swapped = concat({parts[2], parts[0]}, axis);
+        ncg_assert(!shares_storage(swapped, a) && values(swapped) == ref_concat({parts[2], parts[0]}, axis));
+    }
+
+    // Adjacent narrows of the same rows; the same part twice is not adjacent.
+    auto n1 = a.narrow(1, 0, 3), n2 = a.narrow(1, 3, 2);
+    ncg_assert(shares_storage(concat({n1, n2}, 1), a));
+    ncg_assert(!shares_storage(concat({n1, n1}, 1), a) && values(concat({n1, n1}, 1)) == ref_concat({n1, n1}, 1));
+}
+
+int main() {
+    for (size_t workers : {1, 4}) {
+        set_kernel_workers(workers);
+        test_copy();
+        test_view();
+    }
+    set_kernel_workers(get_hardware_concurrency());
+
+    cout << "OK" << endl;
+    return 0;
+}
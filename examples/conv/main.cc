@@ -0,0 +1,269 @@
+/*
+ * main.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "ncg.h"
+
+#include <cmath>
+#include <iostream>
+#include <random>
+
+using namespace ncg;
+using namespace std;
+
+std::vector<double> values(TensorPtr a) {
+    auto fa = cast(a, DTypeName::Float64);
+    std::vector<double> result(fa->desc().numel());
+    for (ssize_t i = 0; i < fa->desc().numel(); ++i) {
+        result[i] = fa->as<DTypeName::Float64>()->elat(i);
+    }
+    return result;
+}
+
+// The references sum in double precision.
+bool all_close(const std::vector<double> &a, const std::vector<double> &b, double tol = 1e-4) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (std::abs(a[i] - b[i]) > tol * (1 + std::abs(b[i]))) return false;
+    }
+    return true;
+}
+
+struct ConvCase {
+    ssize_t N, C, H, W, O, K, stride, padding;
+
+    ssize_t OH() const { return (H + 2 * padding - K) / stride + 1; }
+    ssize_t OW() const { return (W + 2 * padding - K) / stride + 1; }
+    // The input position read by the output position o at the kernel position k, or -1 in the padding.
+    ssize_t in_h(ssize_t o, ssize_t k) const { ssize_t i = o * stride - padding + k; return i >= 0 && i < H ? i : -1; }
+    ssize_t in_w(ssize_t o, ssize_t k) const { ssize_t i = o * stride - padding + k; return i >= 0 && i < W ? i : -1; }
+};
+
+// The element-by-element definitions, as references; `visit` calls func(input index, filter index, output index).
+template <typename Func>
+void visit(const ConvCase &c, Func &&func) {
+    for (ssize_t n = 0; n < c.N; ++n) for (ssize_t o = 0; o < c.O; ++o)
+    for (ssize_t oh = 0; oh < c.OH(); ++oh) for (ssize_t ow = 0; ow < c.OW(); ++ow)
+    for (ssize_t ch = 0; ch < c.C; ++ch) for (ssize_t kh = 0; kh < c.K; ++kh) for (ssize_t kw = 0; kw < c.K; ++kw) {
+        ssize_t ih = c.in_h(oh, kh), iw = c.in_w(ow, kw);
+        if (ih < 0 || iw < 0) continue;
+        func(((n * c.C + ch) * c.H + ih) * c.W + iw, ((o * c.C + ch) * c.K + kh) * c.K + kw, ((n * c.O + o) * c.OH() + oh) * c.OW() + ow);
+    }
+}
+
+std::vector<double> ref_conv2d(const ConvCase &c, TensorPtr input, TensorPtr filter) {
+    auto x = values(input), w = values(filter);
+    std::vector<double> y(c.N * c.O * c.OH() * c.OW(), 0);
+    visit(c, [&](ssize_t i, ssize_t f, ssize_t o) { y[o] += x[i] * w[f]; });
+    return y;
+}
+
+std::vector<double> ref_conv2d_backward_data(const ConvCase &c, TensorPtr filter, TensorPtr grad) {
+    auto w = values(filter), g = values(grad);
+    std::vector<double> gx(c.N * c.C * c.H * c.W, 0);
+    visit(c, [&](ssize_t i, ssize_t f, ssize_t o) { gx[i] += w[f] * g[o]; });
+    return gx;
+}
+
+std::vector<double> ref_conv2d_backward_filter(const ConvCase &c, TensorPtr input, TensorPtr grad) {
+    auto x = values(input), g = values(grad);
+    std::vector<double> gw(c.O * c.C * c.K * c.K, 0);
+    visit(c, [&](ssize_t i, ssize_t f, ssize_t o) { gw[f] += x[i] * g[o]; });
+    return gw;
+}
+
+// Single-channel images (the direct kernels), deeper ones (im2col), strides, paddings, and non-square images.
+const std::vector<ConvCase> kCases = {
+    {2, 1, 28, 28, 8, 5, 1, 0}, {3, 1, 13, 11, 4, 3, 1, 1}, {2, 3, 9, 10, 5, 3, 2, 1}, {2, 16, 14, 14, 32, 3, 1, 1},
+    {1, 8, 12, 12, 16, 5, 1, 2}, {4, 2, 7, 7, 3, 7, 1, 3}, {2, 4, 11, 9, 6, 4, 3, 0}, {1, 1, 1, 1, 1, 1, 1, 0},
+};
+
+void test_conv2d() {
+    std::mt19937 rng(1234);
+    for (auto &c : kCases) {
+        for (auto dtype : {DTypeName::Float32, DTypeName::Float64}) {
+            auto x = rand_normal(rng, dtype, {c.N, c.C, c.H, c.W});
+            auto w = rand_normal(rng, dtype, {c.O, c.C, c.K, c.K});
+            auto g = rand_normal(rng, dtype, {c.N, c.O, c.OH(), c.OW()});
+            auto y_ref = ref_conv2d(c, x, w);
+            auto gx_ref = ref_conv2d_backward_data(c, w, g);
+            auto gw_ref = ref_conv2d_backward_filter(c, x, g);
+
+            for (auto algorithm : {Conv2dAlgorithm::Auto, Conv2dAlgorithm::Im2col, Conv2dAlgorithm::Direct}) {
+                auto y = conv2d(x, w, c.stride, c.padding, algorithm);
+                ncg_assert(y->desc().dtype() == dtype && y->desc().shape_vec() == (ShapeVec{c.N, c.O, c.OH(), c.OW()}));
+                ncg_assert(all_close(values(y), y_ref));
+                ncg_assert(all_close(values(conv2d_backward_data(w, g, c.H, c.W, c.stride, c.padding, algorithm)), gx_ref));
+                ncg_assert(all_close(values(conv2d_backward_filter(x, g, c.K, c.K, c.stride, c.padding, algorithm)), gw_ref));
+            }
+        }
+    }
+
+    // Strided inputs, and the 16-bit dtypes (computed in float32).
+    auto c = kCases[2];
+    auto x = rand_normal(rng, DTypeName::Float32, {c.C, c.N, c.H, c.W}).permute({1, 0, 2, 3});
+    auto w = rand_normal(rng, DTypeName::Float32, {c.O, c.C, c.K, c.K});
+    ncg_assert(all_close(values(conv2d(x, w, c.stride, c.padding)), ref_conv2d(c, x, w)));
+    auto y_half = conv2d(cast(x, DTypeName::Float16), cast(w, DTypeName::Float16), c.stride, c.padding);
+    ncg_assert(y_half->desc().dtype() == DTypeName::Float16);
+    ncg_assert(all_close(values(y_half), ref_conv2d(c, cast(x, DTypeName::Float16), cast(w, DTypeName::Float16)), 1e-2));
+}
+
+std::vector<double> ref_pool2d(const ConvCase &c, TensorPtr input, bool max) {
+    auto x = values(input);
+    std::vector<double> y(c.N * c.C * c.OH() * c.OW());
+    for (ssize_t p = 0; p < c.N * c.C; ++p) for (ssize_t oh = 0; oh < c.OH(); ++oh) for (ssize_t ow = 0; ow < c.OW(); ++ow) {
+        double acc = max ? -INFINITY : 0;
+        for (ssize_t kh = 0; kh < c.K; ++kh) for (ssize_t kw = 0; kw < c.K; ++kw) {
+            ssize_t ih = c.in_h(oh, kh), iw = c.in_w(ow, kw);
+            if (ih < 0 || iw < 0) continue;
+            double v = x[(p * c.H + ih) * c.W + iw];
+            acc = max ? std::max(acc, v) : acc + v;
+        }
+        y[(p * c.OH() + oh) * c.OW() + ow] = max ? acc : acc / (c.K * c.K);
+    }
+    return y;
+}
+
+void test_pool2d() {
+    std::mt19937 rng(4321);
+    // O is unused; the windows of the first case do not overlap, those of the others do.
+    const std::vector<ConvCase> cases = {{2, 3, 8, 8, 0, 2, 2, 0}, {2, 3, 9, 7, 0, 3, 2, 1}, {1, 64, 28, 28, 0, 3, 1, 1}, {3, 2, 5, 6, 0, 4, 3, 2}};
+    for (auto &c : cases) {
+        for (auto dtype : {DTypeName::Float32, DTypeName::Float64}) {
+            auto x = rand_normal(rng, dtype, {c.N, c.C, c.H, c.W});
+            auto g = rand_normal(rng, dtype, {c.N, c.C, c.OH(), c.OW()});
+
+            ncg_assert(values(max_pool2d(x, c.K, c.stride, c.padding)) == ref_pool2d(c, x, true));
+            ncg_assert(all_close(values(avg_pool2d(x, c.K, c.stride, c.padding)), ref_pool2d(c, x, false)));
+
+            // The gradient goes to the first maximum of the window, and evenly to the window for the average.
+            auto vx = values(x), vg = values(g);
+            std::vector<double> gx_max(vx.size(), 0), gx_avg(vx.size(), 0);
+            for (ssize_t p = 0; p < c.N * c.C; ++p) for (ssize_t oh = 0; oh < c.OH(); ++oh) for (ssize_t ow = 0; ow < c.OW(); ++ow) {
+                ssize_t best = -1;
+                double grad = vg[(p * c.OH() + oh) * c.OW() + ow];
+                for (ssize_t kh = 0; kh < c.K; ++kh) for (ssize_t kw = 0; kw < c.K; ++kw) {
+                    ssize_t ih = c.in_h(oh, kh), iw = c.in_w(ow, kw);
+                    if (ih < 0 || iw < 0) continue;
+                    ssize_t i = (p * c.H + ih) * c.W + iw;
+                    if (best < 0 || vx[i] > vx[best]) best = i;
+                    gx_avg[i] += grad / (c.K * c.K);
+                }
+                gx_max[best] += grad;
+            }
+            ncg_assert(all_close(values(max_pool2d_backward(x, g, c.K, c.stride, c.padding)), gx_max));
+            ncg_assert(all_close(values(avg_pool2d_backward(g, c.H, c.W, c.K, c.stride, c.padding)), gx_avg));
+        }
+    }
+}
+
+// The kernels sum every output element on a single thread, in a fixed order.
+void test_deterministic() {
+    std::mt19937 rng(42);
+    ConvCase c{16, 8, 14, 14, 16, 3, 1, 1};
+    auto x = rand_normal(rng, DTypeName::Float32, {c.N, c.C, c.H, c.W});
+    auto w = rand_normal(rng, DTypeName::Float32, {c.O, c.C, c.K, c.K});
+    auto g = rand_normal(rng, DTypeName::Float32, {c.N, c.O, c.OH(), c.OW()});
+
+    for (auto algorithm : {Conv2dAlgorithm::Im2col, Conv2dAlgorithm::Direct}) {
+        set_kernel_workers(1);
+        auto y = values(conv2d(x, w, c.stride, c.padding, algorithm));
+        auto gx = values(conv2d_backward_data(w, g, c.H, c.W, c.stride, c.padding, algorithm));
+        auto gw = values(conv2d_backward_filter(x, g, c.K, c.K, c.stride, c.padding, algorithm));
+        set_kernel_workers(4);
+        ncg_assert(values(conv2d(x, w, c.stride, c.padding, algorithm)) == y);
+        ncg_assert(values(conv2d_backward_data(w, g, c.H, c.W, c.stride, c.padding, algorithm)) == gx);
+        ncg_assert(values(conv2d_backward_filter(x, g, c.K, c.K, c.stride, c.padding, algorithm)) == gw);
+    }
+    set_kernel_workers(get_hardware_concurrency());
+}
+
+void test_errors() {
+    std::mt19937 rng(7);
+    auto x = rand_normal(rng, DTypeName::Float32, {2, 3, 8, 8});
+
+    auto expect_error = [](Op &op, const TensorVec &inputs) {
+        OpContext ctx;
+        op.execute(ctx, inputs);
+        ncg_assert(ctx.is_error());
+    };
+
+    OpConv2d conv;
+    conv.set_desc(OpDescPtr(new OpConv2dDesc(1, 1, 0, 0)));
+    expect_error(conv, {x, rand_normal(rng, DTypeName::Float32, {4, 2, 3, 3})});   // channels
+    expect_error(conv, {x, rand_normal(rng, DTypeName::Float32, {4, 3, 9, 9})});   // kernel larger than the input
+    expect_error(conv, {x.int32(), rand_normal(rng, DTypeName::Float32, {4, 3, 3, 3}).int32()});
+    conv.set_desc(OpDescPtr(new OpConv2dDesc(0, 1, 0, 0)));
+    expect_error(conv, {x, rand_normal(rng, DTypeName::Float32, {4, 3, 3, 3})});
+
+    OpMaxPool2d pool;
+    pool.set_desc(OpDescPtr(new OpPool2dDesc(2, 2, 2, 2, 2, 2)));                    // padding > kernel / 2
+    expect_error(pool, {x});
+    pool.set_desc(OpDescPtr(new OpPool2dDesc(2, 2, 2, 2, 0, 0)));
+    expect_error(pool, {rand_normal(rng, DTypeName::Float32, {3, 8, 8})});
+}
+
+// The graph gradients against finite differences, in Float64: conv -> max pooling -> average pooling -> conv.
+void test_graph() {
+    std::mt19937 rng(1234);
+    auto x_value = rand_normal(rng, DTypeName::Float64, {2, 2, 9, 9});
+    auto x = G::variable("x", x_value);
+    auto h = G::conv2d("conv1", x, 3, 3, 1, 1, rng, 0.5);
+    h = G::max_pool2d(h, 3, 2, 1);
+    h = G::avg_pool2d(h, 2, 1);
+    h = G::conv2d("conv2", h, 2, 2, 2, 0, rng, 0.5);
+    auto r = G::constant(rand_normal(rng, DTypeName::Float64, h->desc().shape_vec()));
+    auto loss = (h * r).sum(0).sum(0).sum(0).sum(0);
+
+    auto &graph = get_default_graph();
+    graph.backward(loss);
+    std::vector<GTensorPtr> params = {x};
+    for (auto name : {"conv1:W", "conv1:b", "conv2:W"}) {
+        params.push_back(graph.find_op(name)->outputs()[0]);
+    }
+
+    GraphForwardContext ctx;
+    GTensorVec targets = {loss};
+    for (auto &param : params) targets.push_back(param->grad(loss));
+    auto outputs = ctx.eval(targets);
+    ncg_assert_msg(ctx.ok(), ctx.error_str());
+
+    // Perturbs a few entries of each parameter through the Session storage.
+    const double eps = 1e-6;
+    for (ssize_t p = 0; p < params.size(); ++p) {
+        auto grad = values(outputs[p + 1]);
+        auto base = get_default_session().shared_tensor(params[p]);
+        for (ssize_t i = 0; i < grad.size(); i += 7) {
+            double f[2];
+            for (int side = 0; side < 2; ++side) {
+                auto value = cast(base, DTypeName::Float64);
+                value->as<DTypeName::Float64>()->mutable_elat(i) += side ? eps : -eps;
+                get_default_session().set_shared_tensor(params[p], value);
+                GraphForwardContext fd_ctx;
+                f[side] = values(fd_ctx.eval({loss})[0])[0];
+            }
+            get_default_session().set_shared_tensor(params[p], base);
+            double numeric = (f[1] - f[0]) / (2 * eps);
+            ncg_assert_msg(std::abs(numeric - grad[i]) <= 1e-5 * (1 + std::abs(numeric)), "gradient mismatch at " + std::to_string(i));
+        }
+    }
+}
+
+int main() {
+    for (size_t workers : {1, 4}) {
+        set_kernel_workers(workers);
+        test_conv2d();
+        test_pool2d();
+    }
+    set_kernel_workers(get_hardware_concurrency());
+    test_deterministic();
+    test_errors();
+    test_graph();
+
+    cout << "OK" << endl;
+    return 0;
+}
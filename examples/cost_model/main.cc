@@ -0,0 +1,80 @@
+/*
+ * main.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "ncg.h"
+
+#include <iostream>
+#include <random>
+
+using namespace ncg;
+using namespace std;
+
+const ssize_t kBatchSize = 100;
+const ssize_t kNrSteps = 20;
+
+int main() {
+    std::mt19937 rng(1234);
+
+    auto image = G::placeholder("image", {kBatchSize, 784}, DTypeName::Float32);
+    auto label = G::placeholder("label", {kBatchSize}, DTypeName::Int64);
+    auto hidden = G::tanh(G::linear("linear1", image, 512, rng));
+    auto logits = G::linear("linear2", hidden, 10, rng);
+    auto loss = G::xent_sparse(G::softmax(logits, -1), label, -1).mean(0);
+
+    auto &graph = get_default_graph();
+    graph.backward(loss);
+    GTensorVec train_ops{loss};
+    for (const auto &name : {"linear1:W", "linear2:W", "linear1:b", "linear2:b"}) {
+        auto W = graph.find_op(name)->outputs()[0];
+        train_ops.push_back(G::assign(W, W - W->grad(loss) * 0.01f));
+    }
+
+    auto images = rand_normal(rng, DTypeName::Float32, {kBatchSize, 784});
+    auto labels = empty(DTypeName::Int64, {kBatchSize});
+    for (ssize_t i = 0; i < kBatchSize; ++i) {
+        labels->as<DTypeName::Int64>()->mutable_data_ptr()[i] = i % 10;
+    }
+
+    GraphProfiler profiler;
+    for (ssize_t i = 0; i < kNrSteps; ++i) {
+        GraphForwardContext ctx;
+        ctx.set_profiler(&profiler);
+        ctx.feed("image", images);
+        ctx.feed("label", labels);
+        ctx.eval(train_ops);
+        ncg_assert_msg(ctx.ok(), ctx.error_str());
+    }
+
+    // The forward matmul of linear1: (100 x 784) x (784 x 512).
+    bool found_matmul = false;
+    for (const auto &event : profiler.events()) {
+        if (event.input_shapes.size() == 2 && event.input_shapes[0] == ShapeVec{kBatchSize, 784} &&
+            event.input_shapes[1] == ShapeVec{784, 512} && event.output_shapes[0] == ShapeVec{kBatchSize, 512}) {
+            ncg_assert(event.cost.flops == 2.0 * kBatchSize * 784 * 512);
+            ncg_assert(event.cost.bytes_read == 4.0 * (kBatchSize * 784 + 784 * 512));
+            ncg_assert(event.cost.bytes_written == 4.0 * kBatchSize * 512);
+            found_matmul = true;
+        }
+        if (event.op_name == "GOpPlaceholder") {
+            ncg_assert(event.cost.flops == 0 && event.cost.bytes() == 0);
+        }
+    }
+    ncg_assert(found_matmul);
+
+    auto peak = measure_machine_peak();
+    ncg_assert(peak.gflops > 0 && peak.gbytes_per_second > 0);
+
+    RooflineReport report(profiler, peak);
+    ncg_assert(report.by_op_type().size() == profiler.summary_by_op_type().size());
+    ncg_assert(report.total().cost.flops > 0);
+    for (size_t i = 1; i < report.by_name().size(); ++i) {
+        ncg_assert(report.by_name()[i - 1].headroom >= report.by_name()[i].headroom);
+    }
+
+    cerr << report;
+    return 0;
+}
@@ -0,0 +1,103 @@
+/*
+ * main.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "ncg.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <random>
+
+using namespace ncg;
+using namespace std;
+
+const ssize_t kNrSamples = 20000;
+const ssize_t kBatchSize = 100;
+
+double now() {
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// A stand-in for a training step, so that there is something to overlap with.
+void train_step(const TensorPtr &images) {
+    auto x = images.reshape({kBatchSize, -1});
+    auto w = ones(DTypeName::Float32, {784, 8});
+    matmul(x, w);
+}
+
+int main() {
+    std::mt19937 rng(1234);
+    auto images = rand_uniform(rng, DTypeName::Float32, {kNrSamples, 1, 28, 28});
+    auto labels = arange(DTypeName::Int64, kNrSamples);
+
+    // Baseline: synchronous gathering with index_select on the training thread.
+    double start = now();
+    for (ssize_t i = 0; i < kNrSamples / kBatchSize; ++i) {
+        auto perm = rand_permutation(rng, kNrSamples);
+        auto idx = perm.narrow(0, 0, kBatchSize);
+        auto batch = images.index_select(0, idx);
+        labels.index_select(0, idx);
+        train_step(batch);
+    }
+    double sync_time = now() - start;
+
+    DataLoaderOptions options;
+    options.batch_size = kBatchSize;
+    options.nr_workers = 2;
+    options.prefetch = 4;
+    DataLoader loader({images, labels}, options, rng);
+
+    start = now();
+    for (ssize_t i = 0; i < loader.epoch_size(); ++i) {
+        auto inputs = loader.next();
+        train_step(inputs[1]);
+
+        // The labels are the sample indices, so each batch can be checked against its indices.
+        auto indices = inputs[0]->as<DTypeName::Int64>();
+        auto batch_labels = inputs[2]->as<DTypeName::Int64>();
+        for (ssize_t j = 0; j < kBatchSize; ++j) {
+            ncg_assert(batch_labels->elat(j) == indices->elat(j));
+            ncg_assert(inputs[1]->as<DTypeName::Float32>()->elat(j * 784 + 17) == images->as<DTypeName::Float32>()->elat(indices->elat(j) * 784 + 17));
+        }
+    }
+    double loader_time = now() - start;
+
+    // IDX input: the images stay uint8 in the mapped file and are normalized while gathering.
+    {
+        ofstream out("images.idx", ios::binary);
+        const unsigned char header[] = {0, 0, 0x08, 3, 0, 0, 0x4e, 0x20, 0, 0, 0, 28, 0, 0, 0, 28};
+        out.write(reinterpret_cast<const char *>(header), sizeof(header));
+        for (ssize_t i = 0; i < kNrSamples * 784; ++i) out.put(static_cast<char>(i % 251));
+    }
+    auto idx_images = read_idx("images.idx");
+    ncg_assert(idx_images->desc().dtype() == DTypeName::UInt8 && idx_images->desc().shape(0) == kNrSamples);
+
+    options.transforms[0] = DataLoaderTransform{DTypeName::Float32, 1.0 / 255, -0.5};
+    DataLoader idx_loader({idx_images, labels}, options, rng);
+
+    start = now();
+    for (ssize_t i = 0; i < idx_loader.epoch_size(); ++i) {
+        auto inputs = idx_loader.next();
+        train_step(inputs[1]);
+
+        auto indices = inputs[0]->as<DTypeName::Int64>();
+        for (ssize_t j = 0; j < kBatchSize; ++j) {
+            float expected = static_cast<float>((indices->elat(j) * 784 + 17) % 251) * (1.0f / 255) - 0.5f;
+            ncg_assert(inputs[1]->as<DTypeName::Float32>()->elat(j * 784 + 17) == expected);
+        }
+    }
+    double idx_loader_time = now() - start;
+    remove("images.idx");
+
+    cerr << fixed << setprecision(2);
+    cerr << "synchronous index_select: " << sync_time * 1000 << " ms/epoch" << endl;
+    cerr << "prefetching DataLoader:   " << loader_time * 1000 << " ms/epoch" << endl;
+    cerr << "mmapped uint8 IDX + fused normalization: " << idx_loader_time * 1000 << " ms/epoch" << endl;
+    return 0;
+}
@@ -0,0 +1,151 @@
+/*
+ * main.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "ncg.h"
+
+#include <cmath>
+#include <iostream>
+#include <random>
+
+using namespace ncg;
+using namespace std;
+
+std::vector<float> values(TensorPtr a) {
+    auto fa = a.float32();
+    std::vector<float> result(fa->desc().numel());
+    for (ssize_t i = 0; i < fa->desc().numel(); ++i) {
+        result[i] = fa->as<DTypeName::Float32>()->elat(i);
+    }
+    return result;
+}
+
+void assert_close(TensorPtr a, TensorPtr b, float tol = 1e-5) {
+    ncg_assert(a->desc().shape_vec() == b->desc().shape_vec());
+    auto va = values(a), vb = values(b);
+    for (size_t i = 0; i < va.size(); ++i) {
+        ncg_assert_msg(std::abs(va[i] - vb[i]) <= tol * (1 + std::abs(vb[i])), "mismatch at " + std::to_string(i));
+    }
+}
+
+TensorPtr scale(TensorPtr a, float s) {
+    return a * fill(a->desc().dtype(), a->desc().shape_vec(), s);
+}
+
+void test_lookup() {
+    std::mt19937 rng(1234);
+    auto table = rand_normal(rng, DTypeName::Float32, {50, 7});
+    auto indices = fromcc(DTypeName::Int64, std::vector<int64_t>{3, 0, 49, 3, 17, 3});
+
+    auto rows = embedding(table, indices);
+    ncg_assert(rows->desc().shape_vec() == (ShapeVec{6, 7}));
+    ncg_assert(values(rows) == values(index_select(table, 0, indices)));
+
+    // Int32 indices of any shape; a strided table.
+    auto indices2d = cast(indices, DTypeName::Int32).reshape({2, 3});
+    auto rows2d = embedding(table, indices2d);
+    ncg_assert(rows2d->desc().shape_vec() == (ShapeVec{2, 3, 7}) && values(rows2d) == values(rows));
+    auto table_t = rand_normal(rng, DTypeName::Float32, {7, 50}).permute({1, 0});
+    ncg_assert(values(embedding(table_t, indices)) == values(index_select(table_t, 0, indices)));
+
+    // Out-of-range indices are reported.
+    OpEmbedding op;
+    OpContext ctx;
+    op.execute(ctx, {table, fromcc(DTypeName::Int64, std::vector<int64_t>{0, 50})});
+    ncg_assert(ctx.is_error());
+}
+
+void test_grad() {
+    std::mt19937 rng(1234);
+    const ssize_t nr_rows = 300, dim = 70, n = 2000;
+    auto indices = rand_uniform(rng, DTypeName::Float32, {n}, 0, nr_rows).int64();
+    auto output_grad = rand_normal(rng, DTypeName::Float32, {n, dim});
+
+    auto nr_workers = get_kernel_workers();
+    set_kernel_workers(1);
+    auto grad1 = embedding_grad(output_grad, indices);
+    set_kernel_workers(4);
+    auto grad4 = embedding_grad(output_grad, indices);
+    set_kernel_workers(nr_workers);
+
+    // Sorted distinct indices, and the same sums whatever the number of threads.
+    auto unique = tocc_vector<int64_t>(grad1[0]);
+    for (size_t i = 1; i < unique.size(); ++i) {
+        ncg_assert(unique[i - 1] < unique[i]);
+    }
+    ncg_assert(grad1[1]->desc().shape_vec() == (ShapeVec{static_cast<ssize_t>(unique.size()), dim}));
+    ncg_assert(values(grad1[0]) == values(grad4[0]) && values(grad1[1]) == values(grad4[1]));
+
+    OpSparseRowsToDense to_dense;
+    to_dense.set_desc(OpDescPtr(new OpSparseRowsToDenseDesc(nr_rows)));
+    OpContext ctx;
+    auto dense = to_dense.execute(ctx, grad1);
+    ncg_assert_msg(ctx.ok(), ctx.error_str());
+    assert_close(dense[0], index_select_backward(output_grad, 0, indices, nr_rows), 1e-4);
+}
+
+void test_graph() {
+    std::mt19937 rng(1234);
+    const ssize_t nr_rows = 1000, dim = 16, batch = 32;
+    const float lr = 0.1;
+
+    auto indices = G::placeholder("indices", {batch}, DTypeName::Int64);
+    auto x = G::embedding("emb", indices, nr_rows, dim, rng);
+    auto loss = G::reduce_sum(x * x, 1).sum(0);
+    auto &graph = get_default_graph();
+    graph.backward(loss);
+
+    auto table = graph.find_op("emb:table")->outputs()[0];
+    auto update = G::sgd_update(table, table->grad(loss), lr);
+    ncg_assert(update->owner_op<GOpAssignAddRows>() != nullptr);
+    auto init_value = values(table->owner_op<GOpVariable>()->desc<GOpVariableDesc>().tensor);
+
+    // Repeated indices in the batch.
+    auto batch_indices = rand_uniform(rng, DTypeName::Float32, {batch}, 0, 100).int64();
+    TensorPtr expected = table->owner_op<GOpVariable>()->desc<GOpVariableDesc>().tensor;
+    const Tensor *session_tensor = nullptr;
+    const TensorStorage *session_storage = nullptr;
+    for (int step = 0; step < 3; ++step) {
+        GraphForwardContext ctx;
+        ctx.feed("indices", batch_indices);
+        ctx.eval({update});
+        ncg_assert_msg(ctx.ok(), ctx.error_str());
+
+        // d(sum x^2)/dx = 2x, summed over the repeats of each row.
+        auto grad = index_select_backward(scale(embedding(expected, batch_indices), 2), 0, batch_indices, nr_rows);
+        expected = expected - scale(grad, lr);
+        assert_close(get_default_session().shared_tensor(table), expected);
+
+        // The first step copies the initial value; the next ones update the same tensor in place.
+        auto value = get_default_session().shared_tensor(table);
+        if (step > 0) {
+            ncg_assert(value.get() == session_tensor && value->storage().get() == session_storage);
+        }
+        session_tensor = value.get();
+        session_storage = value->storage().get();
+    }
+
+    // The initial value is untouched, and so are the rows which are not in the batch.
+    ncg_assert(values(table->owner_op<GOpVariable>()->desc<GOpVariableDesc>().tensor) == init_value);
+    auto final_value = values(get_default_session().shared_tensor(table));
+    for (ssize_t i = 100 * dim; i < nr_rows * dim; ++i) {
+        ncg_assert(final_value[i] == init_value[i]);
+    }
+
+    // A table which is also used densely gets a dense gradient, and a dense update.
+    auto W = G::variable("W", rand_normal(rng, DTypeName::Float32, {10, dim}));
+    auto both = G::embedding(W, indices.narrow(0, 0, 4)).sum(0).sum(0) + W.sum(0).sum(0);
+    graph.backward(both);
+    ncg_assert(G::sgd_update(W, W->grad(both), lr)->owner_op<GOpAssign>() != nullptr);
+}
+
+int main() {
+    test_lookup();
+    test_grad();
+    test_graph();
+    cerr << "OK" << endl;
+    return 0;
+}
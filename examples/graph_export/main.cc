@@ -0,0 +1,81 @@
+/*
+ * main.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "ncg.h"
+
+#include <fstream>
+#include <iostream>
+#include <random>
+
+using namespace ncg;
+using namespace std;
+
+const ssize_t kBatchSize = 16;
+
+size_t count(const string &str, const string &pattern) {
+    size_t n = 0;
+    for (size_t pos = str.find(pattern); pos != string::npos; pos = str.find(pattern, pos + 1)) ++n;
+    return n;
+}
+
+int main() {
+    std::mt19937 rng(1234);
+
+    auto image = G::placeholder("image", {kBatchSize, 784}, DTypeName::Float32);
+    auto label = G::placeholder("label", {kBatchSize}, DTypeName::Int64);
+    auto hidden = G::tanh(G::linear("linear1", image, 64, rng));
+    auto logits = G::linear("linear2", hidden, 10, rng);
+    auto pred = G::softmax(logits, -1);
+    auto loss = G::xent_sparse(pred, label, -1).mean(0);
+
+    auto &graph = get_default_graph();
+    size_t nr_forward_ops = graph.ops().size();
+    graph.backward(loss);
+    size_t nr_backward_ops = graph.ops().size() - nr_forward_ops;
+    auto W = graph.find_op("linear1:W")->outputs()[0];
+    auto update = G::assign(W, W - W->grad(loss) * 0.01f);
+
+    for (size_t i = 0; i < graph.ops().size(); ++i) {
+        ncg_assert(graph.is_backward_op(graph.ops()[i].get()) == (i >= nr_forward_ops && i < nr_forward_ops + nr_backward_ops));
+    }
+
+    GraphProfiler profiler;
+    GraphForwardContext ctx;
+    ctx.set_profiler(&profiler);
+    ctx.feed("image", rand_normal(rng, DTypeName::Float32, {kBatchSize, 784}));
+    ctx.feed("label", zeros(DTypeName::Int64, {kBatchSize}));
+    ctx.eval({loss, update});
+    ncg_assert_msg(ctx.ok(), ctx.error_str());
+
+    // The inference subgraph only.
+    GraphExporter inference(graph);
+    inference.set_targets({pred});
+    ostringstream inference_dot;
+    inference.dump_dot(inference_dot);
+    ncg_assert(count(inference_dot.str(), "cluster_backward") == 1);
+    ncg_assert(count(inference_dot.str(), "GOpGradLoss") == 0);
+    ncg_assert(count(inference_dot.str(), "\"label\"") == 0);
+    ncg_assert(count(inference_dot.str(), "\"image\\nGOpPlaceholder\\nFloat32[16, 784]") == 1);
+
+    // The whole graph, with the measured times.
+    GraphExporter exporter(graph);
+    exporter.set_profiler(&profiler);
+    exporter.dump_dot("graph.dot");
+    exporter.dump_json("graph.json");
+
+    ostringstream json;
+    exporter.dump_json(json);
+    ncg_assert(count(json.str(), "\"id\": ") == graph.ops().size());
+    ncg_assert(count(json.str(), "\"group\": \"backward\"") == nr_backward_ops);
+    ncg_assert(count(json.str(), "\"profile\": ") == profiler.summary_by_name().size());
+    // 2 * 16 * 784 * 64: the forward matmul of linear1 and the two matmuls of its backward.
+    ncg_assert(count(json.str(), "\"flops\": 1605632,") == 3);
+
+    cerr << "ops: " << graph.ops().size() << " (" << nr_forward_ops << " forward, " << nr_backward_ops << " backward), profiled: " << profiler.summary_by_name().size() << endl;
+    cerr << "wrote graph.dot and graph.json" << endl;
+    return 0;
+}
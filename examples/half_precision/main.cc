@@ -0,0 +1,119 @@
+/*
+ * main.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "ncg.h"
+
+#include <cmath>
+#include <iostream>
+#include <random>
+
+using namespace ncg;
+using namespace std;
+
+// Largest elementwise |a - b| / (1 + |b|), both tensors being cast to float32.
+double max_rel_error(TensorPtr a, TensorPtr b) {
+    auto fa = a.float32(), fb = b.float32();
+    ncg_assert(fa->desc().numel() == fb->desc().numel());
+    const float *pa = fa->template as<DTypeName::Float32>()->data_ptr();
+    const float *pb = fb->template as<DTypeName::Float32>()->data_ptr();
+    double error = 0;
+    for (ssize_t i = 0; i < fa->desc().numel(); ++i) {
+        error = std::max(error, std::fabs(double(pa[i]) - pb[i]) / (1 + std::fabs(double(pb[i]))));
+    }
+    return error;
+}
+
+void test_scalar_conversions() {
+    // Exact values, rounding and the special values.
+    ncg_assert(float(float16(1.5f)) == 1.5f && float(bfloat16(-2.0f)) == -2.0f);
+    ncg_assert(float16(1.0f + 1.0f / 4096).bits == float16(1.0f).bits);  // rounds to the nearest even
+    ncg_assert(float16(65504.0f).bits == 0x7bff && float16(1e6f).bits == 0x7c00);
+    ncg_assert(float(float16(5.96e-8f)) > 0);  // the smallest subnormal
+    ncg_assert(std::isnan(float(float16(NAN))) && std::isnan(float(bfloat16(NAN))));
+    ncg_assert(float(bfloat16(3e38f)) > 2e38f);  // bfloat16 keeps the float32 range
+    ncg_assert(float(numeric_limits<float16>::max()) == 65504.0f);
+
+    // The bulk converters agree with the scalar ones, including the remainder of the blocks.
+    std::mt19937 rng(1234);
+    std::normal_distribution<float> dist(0, 100);
+    const size_t n = 1003;
+    std::vector<float> src(n), dst(n);
+    std::vector<float16> h(n);
+    std::vector<bfloat16> bh(n);
+    for (auto &x : src) x = dist(rng);
+    convert_float32_to_float16(src.data(), h.data(), n);
+    convert_float16_to_float32(h.data(), dst.data(), n);
+    for (size_t i = 0; i < n; ++i) {
+        ncg_assert(h[i].bits == float_to_float16_bits(src[i]) && dst[i] == float(float16(src[i])));
+        ncg_assert(std::fabs(dst[i] - src[i]) <= std::fabs(src[i]) / 1024);
+    }
+    convert_float32_to_bfloat16(src.data(), bh.data(), n);
+    convert_bfloat16_to_float32(bh.data(), dst.data(), n);
+    for (size_t i = 0; i < n; ++i) {
+        ncg_assert(bh[i].bits == float_to_bfloat16_bits(src[i]));
+        ncg_assert(std::fabs(dst[i] - src[i]) <= std::fabs(src[i]) / 128);
+    }
+}
+
+void test_tensor_ops(DTypeName dtype, double tolerance) {
+    std::mt19937 rng(1234);
+    auto a = rand_uniform(rng, DTypeName::Float32, {64, 48}, 0.5, 2.0);
+    auto b = rand_uniform(rng, DTypeName::Float32, {48, 32}, -1.0, 1.0);
+    auto ha = cast(a, dtype), hb = cast(b, dtype);
+
+    ncg_assert(ha->desc().dtype() == dtype && ha->storage()->memsize() * 2 == a->storage()->memsize());
+    ncg_assert(max_rel_error(ha, a) < tolerance);
+
+    ncg_assert(max_rel_error(log(ha), log(a)) < tolerance);
+    ncg_assert(max_rel_error(ha * ha + ha, a * a + a) < 4 * tolerance);
+    ncg_assert(max_rel_error(ha.narrow(0, 0, 32).narrow(1, 0, 32) - hb.narrow(0, 0, 32).permute({1, 0}), a.narrow(0, 0, 32).narrow(1, 0, 32) - b.narrow(0, 0, 32).permute({1, 0})) < 4 * tolerance);
+    ncg_assert(max_rel_error(reduce_sum(ha, 1), reduce_sum(a, 1)) < 48 * tolerance);
+    ncg_assert(max_rel_error(reduce_max(ha, 0)[0], reduce_max(a, 0)[0]) < tolerance);
+    ncg_assert(max_rel_error(matmul(ha, hb), matmul(a, b)) < 48 * tolerance);
+
+    auto c = matmul(ha, hb);
+    ncg_assert(c->desc().dtype() == dtype && log(ha)->desc().dtype() == dtype && reduce_sum(ha, 1)->desc().dtype() == dtype);
+
+    // Pickle round trip.
+    {
+        NCGPickler pkl("test_half.bin");
+        ha->pickle(pkl);
+    }
+    {
+        NCGUnpickler unpkl("test_half.bin");
+        auto t = tensor(unpkl);
+        ncg_assert(t->desc().dtype() == dtype && max_rel_error(t, ha) == 0);
+    }
+    std::remove("test_half.bin");
+
+    cerr << get_dtype_name(dtype) << ": " << ha.narrow(0, 0, 1).narrow(1, 0, 4) << endl;
+}
+
+void test_graph(DTypeName dtype, double tolerance) {
+    std::mt19937 rng(1234);
+    auto W = rand_normal(rng, DTypeName::Float32, {16, 4});
+    auto x = G::placeholder(string("x_") + get_dtype_name(dtype), {8, 16}, DTypeName::Float32);
+    auto y = G::tanh(G::matmul(x.cast(dtype), G::constant(cast(W, dtype))));
+
+    auto value = rand_normal(rng, DTypeName::Float32, {8, 16});
+    GraphForwardContext ctx;
+    ctx.feed(string("x_") + get_dtype_name(dtype), value);
+    auto outputs = ctx.eval(GTensorVec{y});
+    ncg_assert_msg(ctx.ok(), ctx.error_str());
+    ncg_assert(outputs[0]->desc().dtype() == dtype);
+    ncg_assert(max_rel_error(outputs[0], tanh(matmul(value, W))) < 16 * tolerance);
+}
+
+int main() {
+    test_scalar_conversions();
+    test_tensor_ops(DTypeName::Float16, 1.0 / 1024);
+    test_tensor_ops(DTypeName::BFloat16, 1.0 / 128);
+    test_graph(DTypeName::Float16, 1.0 / 1024);
+    test_graph(DTypeName::BFloat16, 1.0 / 128);
+    cerr << "OK" << endl;
+    return 0;
+}
@@ -0,0 +1,210 @@
+/*
+ * main.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "ncg.h"
+
+#include <cmath>
+#include <iostream>
+#include <random>
+
+using namespace ncg;
+using namespace std;
+
+std::vector<double> values(TensorPtr a) {
+    auto fa = cast(a, DTypeName::Float64);
+    std::vector<double> result(fa->desc().numel());
+    for (ssize_t i = 0; i < fa->desc().numel(); ++i) {
+        result[i] = fa->as<DTypeName::Float64>()->elat(i);
+    }
+    return result;
+}
+
+std::vector<int64_t> int_values(TensorPtr a) {
+    auto ia = cast(a, DTypeName::Int64);
+    std::vector<int64_t> result(ia->desc().numel());
+    for (ssize_t i = 0; i < ia->desc().numel(); ++i) {
+        result[i] = ia->as<DTypeName::Int64>()->elat(i);
+    }
+    return result;
+}
+
+// The references sum in double precision.
+bool all_close(const std::vector<double> &a, const std::vector<double> &b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (std::abs(a[i] - b[i]) > 1e-4 * (1 + std::abs(b[i]))) return false;
+    }
+    return true;
+}
+
+// {outer, shape[axis], inner} of a shape.
+void split_shape(const ShapeVec &shape, ssize_t axis, ssize_t &outer, ssize_t &inner) {
+    outer = inner = 1;
+    for (ssize_t i = 0; i < shape.size(); ++i) {
+        if (i < axis) outer *= shape[i];
+        if (i > axis) inner *= shape[i];
+    }
+}
+
+// The element-by-element definitions, as references.
+std::vector<double> ref_index_select(TensorPtr a, ssize_t axis, TensorPtr b) {
+    auto va = values(a);
+    auto idx = int_values(b);
+    ssize_t outer, inner, size = a->desc().shape(axis), n = idx.size();
+    split_shape(a->desc().shape_vec(), axis, outer, inner);
+    std::vector<double> result(outer * n * inner);
+    for (ssize_t p = 0; p < result.size(); ++p) {
+        ssize_t o = p / (n * inner), j = p / inner % n, i = p % inner;
+        result[p] = va[(o * size + idx[j]) * inner + i];
+    }
+    return result;
+}
+
+std::vector<double> ref_index_select_backward(TensorPtr g, ssize_t axis, TensorPtr b, ssize_t size) {
+    auto vg = values(g);
+    auto idx = int_values(b);
+    ssize_t outer, inner, n = idx.size();
+    split_shape(g->desc().shape_vec(), axis, outer, inner);
+    std::vector<double> result(outer * size * inner, 0);
+    for (ssize_t p = 0; p < vg.size(); ++p) {
+        ssize_t o = p / (n * inner), j = p / inner % n, i = p % inner;
+        result[(o * size + idx[j]) * inner + i] += vg[p];
+    }
+    return result;
+}
+
+std::vector<double> ref_gather(TensorPtr a, ssize_t axis, TensorPtr b) {
+    auto va = values(a);
+    auto idx = int_values(b);
+    ssize_t outer, inner, size = a->desc().shape(axis), n = b->desc().shape(axis);
+    split_shape(a->desc().shape_vec(), axis, outer, inner);
+    std::vector<double> result(idx.size());
+    for (ssize_t p = 0; p < result.size(); ++p) {
+        ssize_t o = p / (n * inner), i = p % inner;
+        result[p] = va[(o * size + idx[p]) * inner + i];
+    }
+    return result;
+}
+
+std::vector<double> ref_gather_backward(TensorPtr g, ssize_t axis, TensorPtr b, ssize_t size) {
+    auto vg = values(g);
+    auto idx = int_values(b);
+    ssize_t outer, inner, n = g->desc().shape(axis);
+    split_shape(g->desc().shape_vec(), axis, outer, inner);
+    std::vector<double> result(outer * size * inner, 0);
+    for (ssize_t p = 0; p < vg.size(); ++p) {
+        ssize_t o = p / (n * inner), i = p % inner;
+        result[(o * size + idx[p]) * inner + i] += vg[p];
+    }
+    return result;
+}
+
+TensorPtr random_indices(std::mt19937 &rng, DTypeName dtype, const ShapeVec &shape, int64_t upper) {
+    std::uniform_int_distribution<int64_t> dist(0, upper - 1);
+    ssize_t numel = 1;
+    for (ssize_t i = 0; i < shape.size(); ++i) numel *= shape[i];
+    std::vector<int64_t> data(numel);
+    for (auto &x : data) x = dist(rng);
+    return cast(fromcc(DTypeName::Int64, data).reshape(shape), dtype);
+}
+
+// Small shapes run on a single thread; the large ones are split across the workers.
+const std::vector<ShapeVec> kShapes = {{5, 6, 7}, {13}, {3, 1, 4}, {64, 1024}, {2048, 48}, {8, 300, 40}};
+
+void test_index_select() {
+    std::mt19937 rng(1234);
+    for (auto &shape : kShapes) {
+        for (ssize_t axis = 0; axis < shape.size(); ++axis) {
+            for (auto dtype : {DTypeName::Float32, DTypeName::Float64, DTypeName::Int32}) {
+                auto a = cast(rand_normal(rng, DTypeName::Float64, shape) * fill(DTypeName::Float64, shape, 100), dtype);
+                auto b = random_indices(rng, axis % 2 ? DTypeName::Int32 : DTypeName::Int64, {shape[axis] * 2 + 1}, shape[axis]);
+                ncg_assert(values(index_select(a, axis, b)) == ref_index_select(a, axis, b));
+
+                auto g_shape = shape;
+                g_shape[axis] = b->desc().shape(0);
+                auto g = cast(rand_normal(rng, DTypeName::Float64, g_shape), dtype);
+                ncg_assert(all_close(values(index_select_backward(g, axis, b, shape[axis])), ref_index_select_backward(g, axis, b, shape[axis])));
+            }
+        }
+    }
+
+    // A strided input, and a negative axis.
+    auto a = rand_normal(rng, DTypeName::Float32, {40, 30}).permute({1, 0});
+    auto b = random_indices(rng, DTypeName::Int64, {50}, 40);
+    ncg_assert(values(index_select(a, -1, b)) == ref_index_select(a, 1, b));
+    auto g = rand_normal(rng, DTypeName::Float32, {50, 30}).permute({1, 0});
+    ncg_assert(all_close(values(index_select_backward(g, -1, b, 40)), ref_index_select_backward(g, 1, b, 40)));
+
+    OpIndexSelect op;
+    op.set_desc(OpDescPtr(new OpIndexSelectDesc(0)));
+    OpContext ctx;
+    op.execute(ctx, {a, fromcc(DTypeName::Int64, std::vector<int64_t>{0, 30})});
+    ncg_assert(ctx.is_error());
+}
+
+void test_gather() {
+    std::mt19937 rng(4321);
+    for (auto &shape : kShapes) {
+        for (ssize_t axis = 0; axis < shape.size(); ++axis) {
+            for (auto dtype : {DTypeName::Float32, DTypeName::Float64}) {
+                auto a = cast(rand_normal(rng, DTypeName::Float64, shape), dtype);
+                auto b_shape = shape;
+                b_shape[axis] = std::max<ssize_t>(1, shape[axis] / 2);
+                auto b = random_indices(rng, axis % 2 ? DTypeName::Int64 : DTypeName::Int32, b_shape, shape[axis]);
+                ncg_assert(values(gather(a, axis, b)) == ref_gather(a, axis, b));
+
+                auto g = cast(rand_normal(rng, DTypeName::Float64, b_shape), dtype);
+                ncg_assert(all_close(values(gather_backward(g, axis, b, shape[axis])), ref_gather_backward(g, axis, b, shape[axis])));
+            }
+        }
+    }
+
+    auto a = rand_normal(rng, DTypeName::Float32, {40, 30}).permute({1, 0});
+    auto b = random_indices(rng, DTypeName::Int64, {30, 5}, 40);
+    ncg_assert(values(gather(a, 1, b)) == ref_gather(a, 1, b));
+    auto b_strided = random_indices(rng, DTypeName::Int64, {5, 30}, 40).permute({1, 0});
+    ncg_assert(values(gather(a, 1, b_strided)) == ref_gather(a, 1, b_strided));
+
+    OpGather op;
+    op.set_desc(OpDescPtr(new OpGatherDesc(1)));
+    OpContext ctx;
+    op.execute(ctx, {a, fill(DTypeName::Int64, {30, 5}, -1)});
+    ncg_assert(ctx.is_error());
+}
+
+// The scatter-adds sum every output element on a single thread, in the order of the indices.
+void test_deterministic() {
+    std::mt19937 rng(42);
+    auto g = rand_normal(rng, DTypeName::Float32, {4096, 64});
+    auto b = random_indices(rng, DTypeName::Int64, {4096}, 100);
+    auto gg = rand_normal(rng, DTypeName::Float32, {64, 4096});
+    auto bg = random_indices(rng, DTypeName::Int64, {64, 4096}, 100);
+    auto bg0 = random_indices(rng, DTypeName::Int64, {4096, 64}, 100);
+
+    set_kernel_workers(1);
+    auto r1 = values(index_select_backward(g, 0, b, 100));
+    auto r2 = values(gather_backward(gg, 1, bg, 100));
+    auto r3 = values(gather_backward(g, 0, bg0, 100));
+    set_kernel_workers(4);
+    ncg_assert(values(index_select_backward(g, 0, b, 100)) == r1);
+    ncg_assert(values(gather_backward(gg, 1, bg, 100)) == r2);
+    ncg_assert(values(gather_backward(g, 0, bg0, 100)) == r3);
+    set_kernel_workers(get_hardware_concurrency());
+}
+
+int main() {
+    for (size_t workers : {1, 4}) {
+        set_kernel_workers(workers);
+        test_index_select();
+        test_gather();
+    }
+    set_kernel_workers(get_hardware_concurrency());
+    test_deterministic();
+
+    cout << "OK" << endl;
+    return 0;
+}
@@ -0,0 +1,91 @@
+/*
+ * main.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "ncg.h"
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+
+using namespace ncg;
+using namespace std;
+
+const ssize_t kBatchSize = 100;
+
+int main() {
+    std::mt19937 rng(1234);
+
+    auto image = G::placeholder("image", {kBatchSize, 784}, DTypeName::Float32);
+    auto label = G::placeholder("label", {kBatchSize}, DTypeName::Int64);
+    auto hidden = G::tanh(G::linear("linear1", image, 512, rng));
+    auto logits = G::linear("linear2", hidden, 10, rng);
+    auto loss = G::xent_sparse(G::softmax(logits, -1), label, -1).mean(0);
+
+    auto &graph = get_default_graph();
+    graph.backward(loss);
+    GTensorVec train_ops{loss};
+    for (const auto &name : {"linear1:W", "linear2:W", "linear1:b", "linear2:b"}) {
+        auto W = graph.find_op(name)->outputs()[0];
+        train_ops.push_back(G::assign(W, W - W->grad(loss) * 0.01f));
+    }
+
+    auto images = rand_normal(rng, DTypeName::Float32, {kBatchSize, 784});
+    auto labels = zeros(DTypeName::Int64, {kBatchSize});
+    size_t input_bytes = images->storage()->memsize() + labels->storage()->memsize();
+    ncg_assert(global_memory_account().live_bytes(DTypeName::Float32) >= images->storage()->memsize());
+
+    size_t live_before = global_memory_account().live_bytes();
+    MemoryAccountPtr account;
+    {
+        GraphForwardContext ctx;
+        ctx.enable_memory_tracking("train_step");
+        ctx.feed("image", images);
+        ctx.feed("label", labels);
+        ctx.eval(train_ops);
+        ncg_assert_msg(ctx.ok(), ctx.error_str());
+
+        account = ctx.memory_account();
+        cerr << global_memory_account() << endl;
+        cerr << *account << endl;
+
+        auto ops = ctx.op_memory_accounts();
+        size_t op_allocated = 0;
+        for (const auto &op : ops) op_allocated += op->allocated_bytes();
+        ncg_assert(op_allocated <= account->allocated_bytes());
+        ncg_assert(account->peak_bytes() >= account->live_bytes() && account->live_bytes() > 0);
+
+        sort(ops.begin(), ops.end(), [](const MemoryAccountPtr &a, const MemoryAccountPtr &b) { return a->allocated_bytes() > b->allocated_bytes(); });
+        cerr << "Largest allocating ops:" << endl;
+        for (size_t i = 0; i < min<size_t>(5, ops.size()); ++i) {
+            cerr << "  " << *ops[i] << endl;
+        }
+
+        cerr << "Largest live storages:" << endl;
+        dump_largest_live_storages(cerr, 5);
+        ncg_assert(largest_live_storages(1)[0].nbytes >= 784 * 512 * sizeof(float));
+    }
+
+    // Outside of any scope, storages are only counted; inside a LiveStorageScope they are listed too.
+    {
+        auto unlisted = empty(DTypeName::Float64, {4096, 1024});
+        ncg_assert(largest_live_storages(1)[0].nbytes < unlisted->storage()->memsize());
+
+        LiveStorageScope scope;
+        auto listed = empty(DTypeName::Float64, {4096, 1024});
+        ncg_assert(largest_live_storages(1)[0].nbytes == listed->storage()->memsize());
+        ncg_assert(largest_live_storages(2)[1].nbytes < unlisted->storage()->memsize());
+    }
+
+    // Once the context is gone, only the updated variables (now owned by the session) are left.
+    size_t variable_bytes = (784 * 512 + 512 + 512 * 10 + 10) * sizeof(float);
+    cerr << "After the context is destroyed: " << *account << endl;
+    ncg_assert(account->live_bytes() == variable_bytes);
+    ncg_assert(global_memory_account().live_bytes() >= live_before);
+    ncg_assert(input_bytes > 0);
+
+    return 0;
+}
@@ -0,0 +1,261 @@
+/*
+ * main.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "ncg.h"
+
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <random>
+
+using namespace ncg;
+using namespace std;
+
+const ssize_t kBatchSize = 64;
+const ssize_t kInputDim = 96;
+const ssize_t kNrClasses = 10;
+const char *kParams[] = {"linear1:W", "linear1:b", "linear2:W", "linear2:b"};
+
+struct Model {
+    GTensorPtr logits, loss;
+    GTensorVec train_ops;
+};
+
+// The model code is the same with and without the mixed precision: no casts.
+Model build(Graph &graph, const MixedPrecisionConfig *config, float lr=0.5) {
+    as_default_graph(graph);
+    if (config != nullptr) {
+        graph.enable_mixed_precision(*config);
+    }
+
+    std::mt19937 rng(1234);
+    Model model;
+    auto image = G::placeholder("image", {kBatchSize, kInputDim}, DTypeName::Float32);
+    auto label = G::placeholder("label", {kBatchSize}, DTypeName::Int64);
+    auto hidden = G::tanh(G::linear("linear1", image, 64, rng, 0.1));
+    model.logits = G::linear("linear2", hidden, kNrClasses, rng, 0.1);
+    model.loss = G::xent_sparse(G::softmax(model.logits, -1), label, -1).mean(0);
+
+    graph.backward(model.loss);
+    model.train_ops.push_back(model.loss);
+    for (const auto &name : kParams) {
+        auto W = graph.find_op(name)->outputs()[0];
+        model.train_ops.push_back(G::assign(W, W - W->grad(model.loss) * lr));
+    }
+
+    restore_default_graph();
+    return model;
+}
+
+// Gaussian clusters, one per class.
+TensorVec make_batch(std::mt19937 &rng, const TensorPtr &centers) {
+    auto images = rand_normal(rng, DTypeName::Float32, {kBatchSize, kInputDim});
+    auto labels = empty(DTypeName::Int64, {kBatchSize});
+    std::uniform_int_distribution<int64_t> dist(0, kNrClasses - 1);
+    for (ssize_t i = 0; i < kBatchSize; ++i) {
+        int64_t label = dist(rng);
+        labels->as<DTypeName::Int64>()->mutable_data_ptr()[i] = label;
+        for (ssize_t j = 0; j < kInputDim; ++j) {
+            images->as<DTypeName::Float32>()->mutable_at(i, j) += centers->as<DTypeName::Float32>()->at(label, j);
+        }
+    }
+    return {images, labels};
+}
+
+struct StepResult {
+    float loss;
+    bool overflow;
+};
+
+StepResult train_step(Session &session, const Model &model, const TensorVec &batch) {
+    GraphForwardContext ctx(session);
+    ctx.feed("image", batch[0]);
+    ctx.feed("label", batch[1]);
+    auto outputs = ctx.eval(model.train_ops);
+    ncg_assert_msg(ctx.ok(), ctx.error_str());
+    return {tocc_scalar<float>(outputs[0]), ctx.grad_overflow()};
+}
+
+TensorPtr variable_value(Session &session, const std::string &name) {
+    auto op = session.graph().find_op(name);
+    if (session.is_shared_tensor_initialized(op->outputs()[0])) {
+        return session.shared_tensor(op->outputs()[0]);
+    }
+    return op->desc<GOpVariableDesc>().tensor;
+}
+
+void test_casts() {
+    Graph graph;
+    MixedPrecisionConfig config;
+    auto model = build(graph, &config);
+
+    // The matmuls and the activations run in Float16; the master weights, the softmax and the loss stay in Float32.
+    size_t nr_matmuls = 0, nr_tanhs = 0;
+    for (const auto &op : graph.ops()) {
+        if (graph.is_backward_op(op.get())) continue;
+        if (dynamic_cast<GOpMatMul *>(op.get()) != nullptr) {
+            ++nr_matmuls;
+            ncg_assert(op->inputs()[0]->desc().dtype() == DTypeName::Float16 && op->inputs()[1]->desc().dtype() == DTypeName::Float16);
+            ncg_assert(op->outputs()[0]->desc().dtype() == DTypeName::Float16);
+        } else if (string(op->op_name()) == "GOpTanh") {
+            ++nr_tanhs;
+            ncg_assert(op->outputs()[0]->desc().dtype() == DTypeName::Float16);
+        } else if (string(op->op_name()) == "GOpExp" || string(op->op_name()) == "GOpLog") {
+            ncg_assert(op->outputs()[0]->desc().dtype() == DTypeName::Float32);
+        }
+    }
+    ncg_assert(nr_matmuls == 2 && nr_tanhs == 1);
+    ncg_assert(model.logits->desc().dtype() == DTypeName::Float32 && model.loss->desc().dtype() == DTypeName::Float32);
+
+    for (const auto &name : kParams) {
+        auto W = graph.find_op(name)->outputs()[0];
+        ncg_assert(W->desc().dtype() == DTypeName::Float32);
+        // The gradients of the variables are unscaled, in Float32.
+        auto grad = W->grad(model.loss);
+        ncg_assert(grad->desc().dtype() == DTypeName::Float32 && string(grad->owner_op()->op_name()) == "GOpUnscaleGrads");
+    }
+
+    // Without the mixed precision, everything stays in Float32.
+    Graph graph_fp32;
+    build(graph_fp32, nullptr);
+    for (const auto &op : graph_fp32.ops()) {
+        ncg_assert(string(op->op_name()) != "GOpUnscaleGrads");
+        for (const auto &output : op->outputs()) {
+            ncg_assert(!is_reduced_precision_dtype(output->desc().dtype()));
+        }
+    }
+}
+
+void test_training() {
+    std::mt19937 rng(2345);
+    auto centers = rand_normal(rng, DTypeName::Float32, {kNrClasses, kInputDim}, 0, 0.5);
+
+    Graph graph_fp32, graph_fp16, graph_bf16;
+    auto model_fp32 = build(graph_fp32, nullptr);
+    MixedPrecisionConfig config;
+    auto model_fp16 = build(graph_fp16, &config);
+    config.compute_dtype = DTypeName::BFloat16;
+    auto model_bf16 = build(graph_bf16, &config);
+
+    Session session_fp32(graph_fp32), session_fp16(graph_fp16), session_bf16(graph_bf16);
+    StepResult fp32, fp16, bf16;
+    for (int i = 0; i < 60; ++i) {
+        auto batch = make_batch(rng, centers);
+        fp32 = train_step(session_fp32, model_fp32, batch);
+        fp16 = train_step(session_fp16, model_fp16, batch);
+        bf16 = train_step(session_bf16, model_bf16, batch);
+        ncg_assert(!fp16.overflow && !bf16.overflow);
+        if (i == 0) {
+            ncg_assert(std::fabs(fp16.loss - fp32.loss) < 1e-2 && std::fabs(bf16.loss - fp32.loss) < 5e-2);
+        }
+    }
+    cerr << "final loss: float32 = " << fp32.loss << ", float16 = " << fp16.loss << ", bfloat16 = " << bf16.loss << endl;
+    ncg_assert(fp32.loss < 0.1);
+    ncg_assert(std::fabs(fp16.loss - fp32.loss) < 0.05 && std::fabs(bf16.loss - fp32.loss) < 0.05);
+
+    // The master weights follow the Float32 ones.
+    for (const auto &name : kParams) {
+        auto a = tocc_vector<float>(variable_value(session_fp32, name).reshape({-1}));
+        auto b = tocc_vector<float>(variable_value(session_fp16, name).reshape({-1}));
+        ncg_assert(variable_value(session_fp16, name)->desc().dtype() == DTypeName::Float32);
+        double max_diff = 0, max_abs = 0;
+        for (size_t i = 0; i < a.size(); ++i) {
+            max_diff = std::max(max_diff, (double)std::fabs(a[i] - b[i]));
+            max_abs = std::max(max_abs, (double)std::fabs(a[i]));
+        }
+        ncg_assert(max_diff < 0.05 * max_abs);
+    }
+    // 60 steps without overflow, less than the default growth interval.
+    ncg_assert(get_loss_scale(session_fp16) == 65536);
+}
+
+void test_loss_scaling() {
+    std::mt19937 rng(3456);
+    auto centers = rand_normal(rng, DTypeName::Float32, {kNrClasses, kInputDim}, 0, 0.5);
+
+    MixedPrecisionConfig config;
+    config.init_loss_scale = 1e12;
+    config.growth_interval = 3;
+    Graph graph;
+    auto model = build(graph, &config);
+    Session session(graph);
+    ncg_assert(get_loss_scale(session) == 1e12f);
+
+    // The scaled gradients overflow Float16: the updates are skipped and the scale is halved, until it fits.
+    auto W = tocc_vector<float>(variable_value(session, "linear1:W").reshape({-1}));
+    float scale = get_loss_scale(session);
+    int nr_overflows = 0;
+    for (int i = 0; i < 40; ++i) {
+        auto result = train_step(session, model, make_batch(rng, centers));
+        if (!result.overflow) break;
+        ++nr_overflows;
+        ncg_assert(get_loss_scale(session) == scale * 0.5f);
+        scale = get_loss_scale(session);
+        ncg_assert(tocc_vector<float>(variable_value(session, "linear1:W").reshape({-1})) == W);
+    }
+    cerr << "skipped " << nr_overflows << " steps; loss scale = " << get_loss_scale(session) << endl;
+    ncg_assert(nr_overflows > 0 && nr_overflows < 40);
+    ncg_assert(tocc_vector<float>(variable_value(session, "linear1:W").reshape({-1})) != W);
+
+    // Grows after growth_interval steps in a row without overflow.
+    Graph graph_growth;
+    config.init_loss_scale = 1024;
+    auto model_growth = build(graph_growth, &config);
+    Session session_growth(graph_growth);
+    for (int i = 1; i <= 9; ++i) {
+        ncg_assert(!train_step(session_growth, model_growth, make_batch(rng, centers)).overflow);
+        ncg_assert(get_loss_scale(session_growth) == 1024 << (i / 3));
+    }
+
+    // The state of the loss scaling is saved with the variables.
+    session.save_shared_tensors("test_mixed_precision.bin");
+    Session restored(graph);
+    restored.load_shared_tensors("test_mixed_precision.bin");
+    std::remove("test_mixed_precision.bin");
+    ncg_assert(get_loss_scale(restored) == get_loss_scale(session));
+}
+
+void test_serialize() {
+    std::mt19937 rng(4567);
+    auto centers = rand_normal(rng, DTypeName::Float32, {kNrClasses, kInputDim}, 0, 0.5);
+
+    Graph graph;
+    MixedPrecisionConfig config;
+    auto model = build(graph, &config);
+    save_graph(graph, "test_mixed_precision_graph.bin");
+    Graph loaded;
+    load_graph(loaded, "test_mixed_precision_graph.bin");
+    std::remove("test_mixed_precision_graph.bin");
+
+    Model loaded_model;
+    for (const auto &t : model.train_ops) {
+        for (size_t i = 0; i < graph.ops().size(); ++i) {
+            if (graph.ops()[i].get() == t->owner_op()) {
+                loaded_model.train_ops.push_back(loaded.ops()[i]->outputs()[0]);
+            }
+        }
+    }
+    ncg_assert(loaded_model.train_ops.size() == model.train_ops.size());
+
+    Session session(graph), loaded_session(loaded);
+    for (int i = 0; i < 3; ++i) {
+        auto batch = make_batch(rng, centers);
+        auto a = train_step(session, model, batch);
+        auto b = train_step(loaded_session, loaded_model, batch);
+        ncg_assert(a.loss == b.loss);
+    }
+    ncg_assert(tocc_vector<float>(variable_value(session, "linear2:W").reshape({-1})) == tocc_vector<float>(variable_value(loaded_session, "linear2:W").reshape({-1})));
+}
+
+int main() {
+    test_casts();
+    test_training();
+    test_loss_scaling();
+    test_serialize();
+    cerr << "OK" << endl;
+    return 0;
+}
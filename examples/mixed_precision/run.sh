@@ -0,0 +1 @@
+g++ main.cc ../../src/core/*.cc ../../src/graph/*.cc ../../src/graph/ops/*.cc ../../src/nn/*.cc ../../src/data/*.cc -I ../../src/ -o main -O2 -std=c++17 -pthread && ./main && rm -f main
@@ -5,7 +5,6 @@
  * Distributed under terms of the MIT license.
  */
 
-#include "mnist.hpp"
 #include "ncg.h"
 #include "nn/ops.h"
 
@@ -34,76 +33,20 @@ std::ostream &print_matrix(std::ostream &out, ncg::TensorPtr tensor) {
 
 namespace mnist {
 
-ncg::TensorPtr ncg_read_mnist_image(std::string filename) {
-    auto images = ncg::fromcc(ncg::DTypeName::Float32, mnist::read_mnist_image(filename));
-
-    ncg::OpContext ctx;
-    auto reshape_op = ncg::OpReshape();
-    reshape_op.set_desc(ncg::OpDescPtr(new ncg::OpReshapeDesc({images->desc().shape(0), 1, 28, 28})));
-    auto output_vec = reshape_op.execute(ctx, {images});
-    ncg_assert_msg(!ctx.is_error(), ctx.error_str());
-    return output_vec[0];
-}
-
-ncg::TensorPtr ncg_read_mnist_label(std::string filename) {
-    return ncg::fromcc(ncg::DTypeName::Int32, mnist::read_mnist_label(filename));
-}
-
 void print_data(ncg::TensorPtr raw_images, ncg::TensorPtr raw_labels, ssize_t index) {
-    auto images = raw_images->as<ncg::DTypeName::Float32>();
-    auto labels = raw_labels->as<ncg::DTypeName::Int32>();
+    auto images = raw_images->as<ncg::DTypeName::UInt8>();
+    auto labels = raw_labels->as<ncg::DTypeName::UInt8>();
 
-    std::cerr << "Image #" << index << " (Label: " << labels->at(index) << ")" << std::endl;
+    std::cerr << "Image #" << index << " (Label: " << int(labels->at(index)) << ")" << std::endl;
     for (ssize_t i = 0; i < 28; ++i) {
         for (ssize_t j = 0; j < 28; ++j) {
             if (j != 0) std::cerr << " ";
-            std::cerr << ((images->at(index, ssize_t(0), i, j) > 0) ? 'X' : ' ');
+            std::cerr << ((images->at(index, i, j) >= 128) ? 'X' : ' ');
         }
         std::cerr << std::endl;
     }
 }
 
-class DataLoader {
-public:
-    DataLoader(const ncg::TensorVec &data, ssize_t batch_size, std::mt19937 &rng) : m_data(data), m_batch_size(batch_size), m_shuffle_indices(), m_index(0), m_rng(rng) {}
-
-    ncg::TensorVec next() {
-        if (m_shuffle_indices == nullptr) {
-            m_shuffle_indices = ncg::rand_permutation(m_rng, m_data[0]->desc().shape(0));
-        }
-
-        ssize_t begin = m_index, end = std::min(m_index + m_batch_size, m_data[0]->desc().shape(0));
-        m_index += m_batch_size;
-
-        ncg::TensorVec outputs;
-        outputs.push_back(m_shuffle_indices.narrow(0, begin, end - begin));
-        for (const auto &i : m_data) {
-            outputs.push_back(i.index_select(0, m_shuffle_indices.narrow(0, begin, end - begin)));
-        }
-
-        if (m_index >= m_data[0]->desc().shape(0)) {
-            m_shuffle_indices = nullptr;
-            m_index = 0;
-        }
-
-        return outputs;
-    }
-
-    ssize_t epoch_size() const {
-        ssize_t n = m_data[0]->desc().shape(0);
-        return n / m_batch_size + (n % m_batch_size != 0);
-    }
-
-private:
-    ncg::TensorVec m_data;
-    ssize_t m_batch_size;
-
-    ncg::TensorPtr m_shuffle_indices;
-    ssize_t m_index;
-
-    std::mt19937 &m_rng;
-};
-
 } /* !namespace mnist */
 
 namespace mnist_model {
@@ -153,19 +96,23 @@ int main() {
     std::mt19937 rng{rd()};
 
     std::cerr << "Loading training data..." << std::endl;
-    auto train_images = mnist::ncg_read_mnist_image("./data/train-images-idx3-ubyte");
-    auto train_labels = mnist::ncg_read_mnist_label("./data/train-labels-idx1-ubyte");
+    auto train_images = ncg::read_idx("./data/train-images-idx3-ubyte");
+    auto train_labels = ncg::read_idx("./data/train-labels-idx1-ubyte");
     std::cerr << "Loading test data..." << std::endl;
-    auto test_images = mnist::ncg_read_mnist_image("./data/t10k-images-idx3-ubyte");
-    auto test_labels = mnist::ncg_read_mnist_label("./data/t10k-labels-idx1-ubyte");
+    auto test_images = ncg::read_idx("./data/t10k-images-idx3-ubyte");
+    auto test_labels = ncg::read_idx("./data/t10k-labels-idx1-ubyte");
 
     // for (ssize_t i = 0; i < 10; ++i) {
     //     mnist::print_data(test_images, test_labels, i);
     // }
 
     std::cerr << "Building data loaders..." << std::endl;
-    auto train_loader = std::unique_ptr<mnist::DataLoader>(new mnist::DataLoader({train_images, train_labels}, 100, rng));
-    auto test_loader = std::unique_ptr<mnist::DataLoader>(new mnist::DataLoader({test_images, test_labels}, 100, rng));
+    ncg::DataLoaderOptions loader_options;
+    loader_options.batch_size = 100;
+    // Images are kept as uint8 in the mapped files and normalized to [-0.5, 0.5] per batch.
+    loader_options.transforms[0] = ncg::DataLoaderTransform{ncg::DTypeName::Float32, 1.0 / 255, -0.5};
+    auto train_loader = std::make_unique<ncg::DataLoader>(ncg::TensorVec{train_images, train_labels}, loader_options, rng);
+    auto test_loader = std::make_unique<ncg::DataLoader>(ncg::TensorVec{test_images, test_labels}, loader_options, rng);
 
     std::cerr << "Building the MLP model..." << std::endl;
     auto model = std::make_unique<mnist_model::MLPModel>(rng);
@@ -1 +1 @@
-g++ main.cc ../../src/core/*.cc ../../src/graph/*.cc ../../src/graph/ops/*.cc -I ../../src/ -o main -std=c++17 && ./main < in.txt && rm -f main
+g++ main.cc ../../src/core/*.cc ../../src/graph/*.cc ../../src/graph/ops/*.cc -I ../../src/ -o main -std=c++17 -pthread && ./main < in.txt && rm -f main
@@ -0,0 +1,184 @@
+/*
+ * main.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "core/tensor.h"
+#include "core/tensor_impl.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace ncg;
+using namespace std;
+
+const char *kFilename = "test_pickle.bin";
+
+// Run `func` in a child process and tell whether it aborted (a failed ncg_assert).
+template <typename Func>
+bool aborts(Func func) {
+    cerr.flush();
+    pid_t pid = fork();
+    if (pid == 0) {
+        func();
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT;
+}
+
+string read_file(const char *filename) {
+    ifstream in(filename, ios::binary);
+    return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+void write_file(const char *filename, const string &content) {
+    ofstream out(filename, ios::binary);
+    out.write(content.data(), content.size());
+}
+
+void write_records(NCGPickler &pickler) {
+    pickler.write(static_cast<int64_t>(42));
+    pickler.write(string("records"));
+    arange(DTypeName::Float32, 12).reshape({3, 4})->pickle(pickler);
+}
+
+void check_records(NCGUnpickler &unpickler) {
+    ncg_assert(unpickler.read_int64() == 42);
+    ncg_assert(unpickler.read_string() == "records");
+    auto t = tensor(unpickler);
+    ncg_assert(t->desc().shape_vec() == ShapeVec({3, 4}) && t->as<DTypeName::Float32>()->at(2, 3) == 11);
+}
+
+void test_checksum() {
+    {
+        NCGPickler pickler(kFilename, NCGPickleChecksum);
+        write_records(pickler);
+        pickler.close();
+    }
+    {
+        NCGUnpickler unpickler(kFilename);
+        ncg_assert(unpickler.flags() & NCGPickleChecksum);
+        check_records(unpickler);
+        unpickler.close();
+    }
+
+    // Dropping the unpickler before the end of the records does not verify (nor abort).
+    ncg_assert(!aborts([] {
+        NCGUnpickler unpickler(kFilename);
+        ncg_assert(unpickler.read_int64() == 42);
+    }));
+
+    // A corrupted byte in the records: the values still parse, but close() reports the mismatch.
+    string content = read_file(kFilename);
+    string corrupted = content;
+    corrupted[content.size() - 16] ^= 0x01;
+    write_file(kFilename, corrupted);
+    ncg_assert(aborts([] {
+        NCGUnpickler unpickler(kFilename);
+        ncg_assert(unpickler.read_int64() == 42);
+        ncg_assert(unpickler.read_string() == "records");
+        tensor(unpickler);
+        unpickler.close();
+    }));
+
+    // A truncated trailer.
+    write_file(kFilename, content.substr(0, content.size() - 2));
+    ncg_assert(aborts([] {
+        NCGUnpickler unpickler(kFilename);
+        check_records(unpickler);
+        unpickler.close();
+    }));
+}
+
+void test_version0() {
+    // Files written before the header: the records start right away.
+    ostringstream out;
+    auto put = [&out](const auto &val) { out.write(reinterpret_cast<const char *>(&val), sizeof(val)); };
+    put(static_cast<int32_t>(NCGPickleTypes::Int64));
+    put(static_cast<int64_t>(-7));
+    put(static_cast<int32_t>(NCGPickleTypes::String));
+    put(static_cast<int64_t>(3));
+    out.write("old", 4);
+    write_file(kFilename, out.str());
+
+    NCGUnpickler unpickler(kFilename);
+    ncg_assert(unpickler.version() == 0 && unpickler.flags() == NCGPickleNoFlags);
+    ncg_assert(unpickler.read_int64() == -7);
+    ncg_assert(unpickler.read_string() == "old");
+    unpickler.close();
+}
+
+// A stream buffer that can only be read forward, like a pipe.
+class ForwardOnlyBuf : public std::streambuf {
+public:
+    ForwardOnlyBuf(const string &data) : m_data(data) {
+        setg(&m_data[0], &m_data[0], &m_data[0]);
+    }
+
+protected:
+    // Hand out one byte at a time so that any read-ahead is really consumed from the source.
+    int_type underflow() override {
+        char *end = &m_data[0] + m_data.size();
+        if (egptr() == end) return traits_type::eof();
+        setg(eback(), egptr(), egptr() + 1);
+        return traits_type::to_int_type(*gptr());
+    }
+
+    string m_data;
+};
+
+void test_borrowed_stream() {
+    for (uint32_t flags : {NCGPickleNoFlags, NCGPickleChecksum}) {
+        stringstream buffer;
+        {
+            NCGPickler pickler(buffer, flags);
+            write_records(pickler);
+            pickler.close();
+        }
+        buffer << "tail 123";
+
+        {
+            // Seekable: the read-ahead bytes are given back on close().
+            stringstream in(buffer.str());
+            NCGUnpickler unpickler(in);
+            check_records(unpickler);
+            unpickler.close();
+            string word; int value = 0;
+            in >> word >> value;
+            ncg_assert(word == "tail" && value == 123);
+        }
+
+        {
+            // Not seekable: nothing past the records is read.
+            ForwardOnlyBuf buf(buffer.str());
+            istream in(&buf);
+            {
+                NCGUnpickler unpickler(in);
+                check_records(unpickler);
+                unpickler.close();
+            }
+            string word; int value = 0;
+            in >> word >> value;
+            ncg_assert(word == "tail" && value == 123);
+        }
+    }
+}
+
+int main() {
+    test_checksum();
+    test_version0();
+    test_borrowed_stream();
+    remove(kFilename);
+
+    cout << "OK" << endl;
+    return 0;
+}
@@ -0,0 +1,82 @@
+/*
+ * main.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "core/tensor.h"
+#include "core/tensor_impl.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+using namespace ncg;
+using namespace std;
+
+// Save and load a "model" made of many small tensors, which is dominated by per-record overhead.
+const ssize_t kNrTensors = 5000;
+const int kNrRepeats = 20;
+const char *kFilename = "pickle_benchmark.bin";
+
+double now() {
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main() {
+    vector<TensorPtr> tensors;
+    for (ssize_t i = 0; i < kNrTensors; ++i) {
+        ssize_t n = 1 + i % 64;
+        tensors.emplace_back(arange(DTypeName::Float32, n * 4).reshape({n, 4}));
+    }
+
+    for (uint32_t flags : {NCGPickleNoFlags, NCGPickleChecksum}) {
+        double save_time = 0, load_time = 0, best_save = 1e9, best_load = 1e9;
+        size_t nbytes = 0;
+
+        for (int r = 0; r < kNrRepeats; ++r) {
+            double start = now();
+            {
+                NCGPickler pickler(kFilename, flags);
+                pickler.write(static_cast<int64_t>(tensors.size()));
+                for (const auto &t : tensors) {
+                    t->pickle(pickler);
+                }
+                pickler.close();
+                nbytes = pickler.bytes_written();
+            }
+            save_time += now() - start;
+            best_save = std::min(best_save, now() - start);
+
+            start = now();
+            vector<TensorPtr> loaded;
+            {
+                NCGUnpickler unpickler(kFilename);
+                size_t size = static_cast<size_t>(unpickler.read_int64());
+                for (size_t i = 0; i < size; ++i) {
+                    loaded.emplace_back(tensor(unpickler));
+                }
+                unpickler.close();
+            }
+            load_time += now() - start;
+            best_load = std::min(best_load, now() - start);
+
+            ncg_assert(loaded.size() == tensors.size());
+            ncg_assert(loaded.back()->desc().shape_vec() == tensors.back()->desc().shape_vec());
+        }
+
+        double mb = nbytes / 1024.0 / 1024.0 * kNrRepeats;
+        cerr << fixed << setprecision(2);
+        cerr << "checksum: " << (flags & NCGPickleChecksum ? "on" : "off") << endl;
+        cerr << "  tensors: " << kNrTensors << ", file size: " << nbytes / 1024.0 << " KB" << endl;
+        // The mean is noisy on a shared machine (allocation dominates the load); the best iteration is more stable.
+        cerr << "  save: " << save_time / kNrRepeats * 1000 << " ms/iter (best " << best_save * 1000 << "), " << mb / save_time << " MB/s" << endl;
+        cerr << "  load: " << load_time / kNrRepeats * 1000 << " ms/iter (best " << best_load * 1000 << "), " << mb / load_time << " MB/s" << endl;
+    }
+
+    remove(kFilename);
+    return 0;
+}
@@ -0,0 +1 @@
+g++ main.cc ../../src/core/*.cc -I ../../src/ -o main -O2 -std=c++17 && ./main && rm -f main
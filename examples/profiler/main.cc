@@ -0,0 +1,122 @@
+/*
+ * main.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "ncg.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <random>
+
+using namespace ncg;
+using namespace std;
+
+const ssize_t kBatchSize = 100;
+const ssize_t kNrSteps = 50;
+
+double now() {
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Runs the training ops of a small MLP on synthetic data; returns the time per step in ms.
+double run(const GTensorVec &train_ops, const TensorPtr &images, const TensorPtr &labels, GraphProfiler *profiler) {
+    double start = now();
+    for (ssize_t i = 0; i < kNrSteps; ++i) {
+        GraphForwardContext ctx;
+        ctx.set_profiler(profiler);
+        ctx.feed("image", images);
+        ctx.feed("label", labels);
+        ctx.eval(train_ops);
+        ncg_assert_msg(ctx.ok(), ctx.error_str());
+    }
+    return (now() - start) * 1000 / kNrSteps;
+}
+
+int main() {
+    std::mt19937 rng(1234);
+
+    auto image = G::placeholder("image", {kBatchSize, 784}, DTypeName::Float32);
+    auto label = G::placeholder("label", {kBatchSize}, DTypeName::Int64);
+    auto hidden = G::tanh(G::linear("linear1", image, 512, rng));
+    auto logits = G::linear("linear2", hidden, 10, rng);
+    auto loss = G::xent_sparse(G::softmax(logits, -1), label, -1).mean(0);
+
+    auto &graph = get_default_graph();
+    graph.backward(loss);
+    GTensorVec train_ops{loss};
+    for (const auto &name : {"linear1:W", "linear2:W", "linear1:b", "linear2:b"}) {
+        auto W = graph.find_op(name)->outputs()[0];
+        train_ops.push_back(G::assign(W, W - W->grad(loss) * 0.01f));
+    }
+
+    auto images = rand_normal(rng, DTypeName::Float32, {kBatchSize, 784});
+    auto labels = empty(DTypeName::Int64, {kBatchSize});
+    for (ssize_t i = 0; i < kBatchSize; ++i) {
+        labels->as<DTypeName::Int64>()->mutable_data_ptr()[i] = i % 10;
+    }
+
+    run(train_ops, images, labels, nullptr);
+    double plain_time = run(train_ops, images, labels, nullptr);
+
+    GraphProfiler profiler;
+    double profiled_time = run(train_ops, images, labels, &profiler);
+
+    // Hardware counters are optional: the profiler keeps working (with timings only) without them.
+    GraphProfiler counter_profiler;
+    bool has_counters = counter_profiler.enable_perf_counters();
+    double counter_time = run(train_ops, images, labels, &counter_profiler);
+    ncg_assert(counter_profiler.events().size() == profiler.events().size());
+    if (has_counters) {
+        ncg_assert(counter_profiler.summary_by_op_type()[0].counters.valid != 0);
+    }
+    ncg_assert(profiler.events().size() > 0 && profiler.events().size() % kNrSteps == 0);
+
+    // The kernels which run on worker threads (e.g., conv2d through parallel_for) are counted as well: the
+    // work done, i.e. the number of instructions, does not depend on the number of workers.
+    {
+        auto input = G::placeholder("conv_input", {64, 8, 12, 12});
+        auto conv = G::conv2d(input, G::variable("conv_filter", rand_normal(rng, DTypeName::Float32, {16, 8, 5, 5})));
+        auto conv_images = rand_normal(rng, DTypeName::Float32, {64, 8, 12, 12});
+
+        uint64_t instructions[2] = {0, 0};
+        size_t workers[2] = {1, 4};
+        for (size_t i = 0; i < 2; ++i) {
+            set_kernel_workers(workers[i]);
+            GraphProfiler conv_profiler;
+            conv_profiler.enable_perf_counters();
+            GraphForwardContext ctx;
+            ctx.set_profiler(&conv_profiler);
+            ctx.feed("conv_input", conv_images);
+            ctx.eval({conv});
+            ncg_assert_msg(ctx.ok(), ctx.error_str());
+            for (const auto &summary : conv_profiler.summary_by_op_type()) {
+                if (summary.key == "GOpConv2d") instructions[i] = summary.counters[PerfCounter::Instructions];
+            }
+        }
+        set_kernel_workers(0);
+
+        cerr << "conv2d instructions: " << instructions[0] << " with 1 worker, " << instructions[1] << " with 4 workers" << endl;
+        if (has_counters) {
+            ncg_assert(instructions[1] > instructions[0] / 2);
+        }
+    }
+
+    profiler.dump_chrome_trace("trace.json");
+    ifstream trace("trace.json");
+    string header;
+    getline(trace, header);
+    ncg_assert(header.find("traceEvents") != string::npos);
+
+    cerr << counter_profiler;
+    cerr << fixed << setprecision(3);
+    cerr << "events per step: " << profiler.events().size() / kNrSteps << endl;
+    cerr << "step time: " << plain_time << " ms without profiler, " << profiled_time << " ms with profiler, "
+         << counter_time << " ms with hardware counters" << endl;
+
+    return 0;
+}
@@ -0,0 +1,246 @@
+/*
+ * main.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "ncg.h"
+
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <random>
+
+using namespace ncg;
+using namespace std;
+
+const ssize_t kBatchSize = 64;
+const ssize_t kInputDim = 96;
+const ssize_t kNrClasses = 10;
+
+const float *float_data(const TensorPtr &tensor) {
+    return tensor->as<DTypeName::Float32>()->data_ptr();
+}
+
+void test_quantize() {
+    std::mt19937 rng(1234);
+    auto x = rand_uniform(rng, DTypeName::Float32, {100, 30}, -3.0, 5.0);
+    auto params = QuantizationParams::from_range(-3, 5);
+    auto q = quantize(x, params);
+    ncg_assert(q->desc().dtype() == DTypeName::Int8 && q->is_quantized() && q->quantization() == params);
+
+    // Within half a step, and 0 is exact.
+    auto y = dequantize(q);
+    for (ssize_t i = 0; i < x->desc().numel(); ++i) {
+        ncg_assert(std::fabs(float_data(y)[i] - float_data(x)[i]) <= params.scale * 0.5001f);
+    }
+    ncg_assert(params.dequantize(params.quantize(0)) == 0);
+    // Saturation, including for values out of the int32 range.
+    auto s = quantize(fromcc(DTypeName::Float32, std::vector<float>{-1e3f, 1e3f, 1e30f, -1e30f}), params);
+    ncg_assert((tocc_vector<int>(s.int32()) == std::vector<int>{-128, 127, 127, -128}));
+    // Non-contiguous inputs.
+    auto qt = quantize(x.permute({1, 0}), params);
+    ncg_assert(qt->as<DTypeName::Int8>()->at(3, 7) == q->as<DTypeName::Int8>()->at(7, 3));
+
+    // The params are pickled with the tensor.
+    {
+        NCGPickler pkl("test_quantize.bin");
+        q->pickle(pkl);
+    }
+    {
+        NCGUnpickler unpkl("test_quantize.bin");
+        auto t = tensor(unpkl);
+        ncg_assert(t->is_quantized() && t->quantization() == params);
+    }
+    std::remove("test_quantize.bin");
+
+    // Plain ops do not propagate the params.
+    ncg_assert(!(q + q)->is_quantized());
+
+    cerr << params << endl;
+}
+
+void test_quantized_matmul() {
+    std::mt19937 rng(2345);
+    const ssize_t N = 7, K = 37, M = 19;
+    auto a_float = rand_uniform(rng, DTypeName::Float32, {N, K}, -1.0, 3.0);
+    auto b_float = rand_normal(rng, DTypeName::Float32, {K, M});
+    auto qa = QuantizationParams::from_range(-1, 3), qb = QuantizationParams::from_range(-2.5, 3.5);
+    auto a = quantize(a_float, qa), b = quantize(b_float, qb);
+    ncg_assert(qa.zero_point != 0 && qb.zero_point != 0);
+
+    std::vector<int32_t> bias_values(M);
+    for (ssize_t j = 0; j < M; ++j) bias_values[j] = j * 100 - 900;
+    auto bias = fromcc(DTypeName::Int32, bias_values);
+
+    // The int32 accumulators are exact.
+    auto acc = quantized_matmul(a, b, bias, DTypeName::Int32);
+    ncg_assert(acc->desc().dtype() == DTypeName::Int32 && acc->quantization().scale == qa.scale * qb.scale);
+    for (ssize_t i = 0; i < N; ++i) {
+        for (ssize_t j = 0; j < M; ++j) {
+            int64_t expected = bias_values[j];
+            for (ssize_t k = 0; k < K; ++k) {
+                expected += int64_t(a->as<DTypeName::Int8>()->at(i, k) - qa.zero_point) * (b->as<DTypeName::Int8>()->at(k, j) - qb.zero_point);
+            }
+            ncg_assert(acc->as<DTypeName::Int32>()->at(i, j) == expected);
+        }
+    }
+
+    // Pre-transposed weights give the same result.
+    auto bt = quantize(b_float.permute({1, 0}), qb);
+    ncg_assert(tocc_vector<int>(quantized_matmul(a, bt, bias, DTypeName::Int32, QuantizationParams(), true).reshape({-1})) == tocc_vector<int>(acc.reshape({-1})));
+
+    // Float32 and requantized Int8 outputs, against the float product of the dequantized inputs.
+    auto reference = matmul(dequantize(a), dequantize(b));
+    auto c = quantized_matmul(a, b, nullptr, DTypeName::Float32);
+    double error = 0;
+    for (ssize_t i = 0; i < N * M; ++i) error = std::max(error, (double)std::fabs(float_data(c)[i] - float_data(reference)[i]));
+    ncg_assert(error < 1e-3);
+
+    auto qc = QuantizationParams::from_range(-10, 10);
+    auto c8 = quantized_matmul(a, b, nullptr, DTypeName::Int8, qc);
+    ncg_assert(c8->desc().dtype() == DTypeName::Int8 && c8->quantization() == qc);
+    auto c8_float = dequantize(c8);
+    for (ssize_t i = 0; i < N * M; ++i) {
+        float expected = std::min(std::max(float_data(reference)[i], -10.0f), 10.0f);
+        ncg_assert(std::fabs(float_data(c8_float)[i] - expected) <= qc.scale * 0.5001f + 1e-3f);
+    }
+
+    // Plain matmul does not support 8-bit inputs.
+    OpContext ctx;
+    OpMatMul op;
+    op.set_desc(OpDescPtr(new OpMatMulDesc()));
+    op.execute(ctx, {a, b});
+    ncg_assert(ctx.is_error());
+}
+
+struct MLPModel {
+    MLPModel(std::mt19937 &rng) {
+        image = G::placeholder("image", {kBatchSize, kInputDim}, DTypeName::Float32);
+        label = G::placeholder("label", {kBatchSize}, DTypeName::Int64);
+        hidden = G::tanh(G::linear("linear1", image, 64, rng, 0.1));
+        logits = G::linear("linear2", hidden, kNrClasses, rng, 0.1);
+        loss = G::xent_sparse(G::softmax(logits, -1), label, -1).mean(0);
+    }
+
+    GTensorVec train_ops(float lr) {
+        auto &graph = get_default_graph();
+        graph.backward(loss);
+        GTensorVec ops{loss};
+        for (const auto &name : {"linear1:W", "linear2:W", "linear1:b", "linear2:b"}) {
+            auto W = graph.find_op(name)->outputs()[0];
+            ops.push_back(G::assign(W, W - W->grad(loss) * lr));
+        }
+        return ops;
+    }
+
+    GTensorPtr image, label, hidden, logits, loss;
+};
+
+// Gaussian clusters, one per class.
+TensorVec make_batch(std::mt19937 &rng, const TensorPtr &centers) {
+    auto images = rand_normal(rng, DTypeName::Float32, {kBatchSize, kInputDim});
+    auto labels = empty(DTypeName::Int64, {kBatchSize});
+    std::uniform_int_distribution<int64_t> dist(0, kNrClasses - 1);
+    for (ssize_t i = 0; i < kBatchSize; ++i) {
+        int64_t label = dist(rng);
+        labels->as<DTypeName::Int64>()->mutable_data_ptr()[i] = label;
+        for (ssize_t j = 0; j < kInputDim; ++j) {
+            images->as<DTypeName::Float32>()->mutable_at(i, j) += centers->as<DTypeName::Float32>()->at(label, j);
+        }
+    }
+    return {images, labels};
+}
+
+size_t op_index(const Graph &graph, const GTensorPtr &tensor) {
+    for (size_t i = 0; i < graph.ops().size(); ++i) {
+        if (graph.ops()[i].get() == tensor->owner_op()) return i;
+    }
+    ncg_assert(false);
+    return 0;
+}
+
+void test_calibration() {
+    std::mt19937 rng(3456);
+    auto centers = rand_normal(rng, DTypeName::Float32, {kNrClasses, kInputDim}, 0, 0.5);
+
+    MLPModel model(rng);
+    auto train_ops = model.train_ops(0.5);
+    for (int i = 0; i < 50; ++i) {
+        auto batch = make_batch(rng, centers);
+        GraphForwardContext ctx;
+        ctx.feed("image", batch[0]);
+        ctx.feed("label", batch[1]);
+        ctx.eval(train_ops);
+        ncg_assert_msg(ctx.ok(), ctx.error_str());
+    }
+
+    auto &graph = get_default_graph();
+    Int8Calibrator calibrator(graph, {model.logits});
+    ncg_assert(calibrator.layers().size() == 2);
+    for (int i = 0; i < 8; ++i) {
+        auto batch = make_batch(rng, centers);
+        GraphForwardContext ctx;
+        ctx.feed("image", batch[0]);
+        calibrator.observe(ctx);
+    }
+    auto logits_int8 = calibrator.convert()[0];
+    ncg_assert(logits_int8->desc().dtype() == DTypeName::Float32 && logits_int8->desc().shape_vec() == model.logits->desc().shape_vec());
+
+    // Save the converted graph and reload it.
+    save_graph(graph, "test_quantize_graph.bin");
+    Graph loaded;
+    load_graph(loaded, "test_quantize_graph.bin");
+    std::remove("test_quantize_graph.bin");
+    auto loaded_logits = loaded.ops()[op_index(graph, logits_int8)]->outputs()[0];
+    // The quantized weights are constants, but the (float) biases are still variables.
+    get_default_session().save_shared_tensors("test_quantize_session.bin");
+    Session loaded_session(loaded);
+    loaded_session.load_shared_tensors("test_quantize_session.bin");
+    std::remove("test_quantize_session.bin");
+
+    ssize_t agree = 0, correct_float = 0, correct_int8 = 0, total = 0;
+    double max_error = 0, max_logit = 0;
+    for (int i = 0; i < 10; ++i) {
+        auto batch = make_batch(rng, centers);
+        GraphForwardContext ctx;
+        ctx.feed("image", batch[0]);
+        auto outputs = ctx.eval({model.logits, logits_int8});
+        ncg_assert_msg(ctx.ok(), ctx.error_str());
+
+        GraphForwardContext loaded_ctx(loaded_session);
+        loaded_ctx.feed("image", batch[0]);
+        auto loaded_outputs = loaded_ctx.eval({loaded_logits});
+        ncg_assert_msg(loaded_ctx.ok(), loaded_ctx.error_str());
+        ncg_assert(tocc_vector<float>(loaded_outputs[0].reshape({-1})) == tocc_vector<float>(outputs[1].reshape({-1})));
+
+        auto pred_float = tocc_vector<int64_t>(outputs[0].max(1)[1]);
+        auto pred_int8 = tocc_vector<int64_t>(outputs[1].max(1)[1]);
+        auto labels = tocc_vector<int64_t>(batch[1]);
+        for (ssize_t j = 0; j < kBatchSize; ++j) {
+            agree += pred_float[j] == pred_int8[j];
+            correct_float += pred_float[j] == labels[j];
+            correct_int8 += pred_int8[j] == labels[j];
+        }
+        total += kBatchSize;
+        for (ssize_t j = 0; j < outputs[0]->desc().numel(); ++j) {
+            max_error = std::max(max_error, (double)std::fabs(float_data(outputs[0])[j] - float_data(outputs[1])[j]));
+            max_logit = std::max(max_logit, (double)std::fabs(float_data(outputs[0])[j]));
+        }
+    }
+
+    cerr << "float32 accuracy = " << double(correct_float) / total << ", int8 accuracy = " << double(correct_int8) / total
+        << ", agreement = " << double(agree) / total << ", max |logit error| = " << max_error << " (max |logit| = " << max_logit << ")" << endl;
+    ncg_assert(double(correct_float) / total > 0.9);
+    ncg_assert(double(agree) / total > 0.97);
+    ncg_assert(max_error < 0.05 * max_logit);
+}
+
+int main() {
+    test_quantize();
+    test_quantized_matmul();
+    test_calibration();
+    cerr << "OK" << endl;
+    return 0;
+}
@@ -0,0 +1,136 @@
+/*
+ * main.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "ncg.h"
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <random>
+
+using namespace ncg;
+using namespace std;
+
+const ssize_t kBatchSize = 32;
+const ssize_t kNrSteps = 5;
+const char *kParams[] = {"linear1:W", "linear1:b", "linear2:W", "linear2:b"};
+
+double now() {
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// A training graph: [loss, assign...].
+GTensorVec build(Graph &graph) {
+    std::mt19937 rng(1234);
+    as_default_graph(graph);
+
+    auto image = G::placeholder("image", {kBatchSize, 784}, DTypeName::Float32);
+    auto label = G::placeholder("label", {kBatchSize}, DTypeName::Int64);
+    auto hidden = G::tanh(G::linear("linear1", image, 128, rng));
+    auto logits = G::linear("linear2", hidden, 10, rng);
+    auto loss = G::xent_sparse(G::softmax(logits, -1), label, -1).mean(0);
+
+    graph.backward(loss);
+    GTensorVec train_ops{loss};
+    for (const auto &name : kParams) {
+        auto W = graph.find_op(name)->outputs()[0];
+        train_ops.push_back(G::assign(W, W - W->grad(loss) * 0.1f));
+    }
+
+    restore_default_graph();
+    return train_ops;
+}
+
+vector<float> train(Graph &graph, const GTensorVec &train_ops, const TensorPtr &images, const TensorPtr &labels) {
+    Session session(graph);
+    vector<float> losses;
+    for (ssize_t i = 0; i < kNrSteps; ++i) {
+        GraphForwardContext ctx(session);
+        ctx.feed("image", images);
+        ctx.feed("label", labels);
+        auto outputs = ctx.eval(train_ops);
+        ncg_assert_msg(ctx.ok(), ctx.error_str());
+        losses.push_back(tocc_scalar<float>(outputs[0]));
+    }
+    return losses;
+}
+
+size_t op_index(const Graph &graph, const GTensorPtr &tensor) {
+    for (size_t i = 0; i < graph.ops().size(); ++i) {
+        if (graph.ops()[i].get() == tensor->owner_op()) return i;
+    }
+    ncg_assert(false);
+    return 0;
+}
+
+int main() {
+    std::mt19937 rng(2345);
+    auto images = rand_normal(rng, DTypeName::Float32, {kBatchSize, 784});
+    auto labels = empty(DTypeName::Int64, {kBatchSize});
+    for (ssize_t i = 0; i < kBatchSize; ++i) {
+        labels->as<DTypeName::Int64>()->mutable_data_ptr()[i] = i % 10;
+    }
+
+    Graph graph;
+    double start = now();
+    auto train_ops = build(graph);
+    double build_time = now() - start;
+    save_graph(graph, "graph.ncg");
+
+    Graph loaded;
+    start = now();
+    load_graph(loaded, "graph.ncg");
+    double load_time = now() - start;
+    ncg_assert(loaded.ops().size() == graph.ops().size());
+
+    // The same ops, in the same order, with the same names and shapes.
+    GTensorVec loaded_train_ops;
+    for (const auto &t : train_ops) {
+        const auto &op = loaded.ops()[op_index(graph, t)];
+        ncg_assert(string(op->op_name()) == t->owner_op()->op_name());
+        loaded_train_ops.push_back(op->outputs()[t->owner_op_index()]);
+    }
+    for (size_t i = 0; i < graph.ops().size(); ++i) {
+        const auto &a = graph.ops()[i], &b = loaded.ops()[i];
+        ncg_assert(string(a->op_name()) == b->op_name() && a->has_name() == b->has_name());
+        ncg_assert(!a->has_name() || a->name() == b->name());
+        ncg_assert(graph.is_backward_op(a.get()) == loaded.is_backward_op(b.get()));
+        for (size_t j = 0; j < a->outputs().size(); ++j) {
+            ncg_assert(a->outputs()[j]->desc().shape_vec() == b->outputs()[j]->desc().shape_vec());
+        }
+    }
+
+    // Lookups by name, explicit or automatic.
+    ncg_assert(loaded.find_op("linear2:W")->outputs()[0]->desc().shape_vec() == ShapeVec({128, 10}));
+    ncg_assert(loaded.find_op("linear3:W") == nullptr);
+    auto unnamed = loaded.ops()[op_index(graph, train_ops[0])];
+    auto auto_name = unnamed->name();
+    ncg_assert(!unnamed->has_name() && loaded.find_op(auto_name) == unnamed);
+    unnamed->set_name("loss");
+    ncg_assert(loaded.find_op("loss") == unnamed && loaded.find_op(auto_name) == nullptr);
+
+    // The gradients are restored, and the backward is not computed again.
+    auto loss = loaded_train_ops[0];
+    for (const auto &name : kParams) {
+        ncg_assert(loaded.find_op(name)->outputs()[0]->grad(loss) != nullptr);
+    }
+    loaded.backward(loss);
+    ncg_assert(loaded.ops().size() == graph.ops().size());
+
+    auto expected = train(graph, train_ops, images, labels);
+    auto actual = train(loaded, loaded_train_ops, images, labels);
+    for (ssize_t i = 0; i < kNrSteps; ++i) {
+        ncg_assert(expected[i] == actual[i]);
+    }
+    ncg_assert(expected.back() < expected.front());
+
+    cerr << fixed << setprecision(3);
+    cerr << "ops: " << graph.ops().size() << ", build: " << build_time * 1000 << " ms, load: " << load_time * 1000 << " ms" << endl;
+    cerr << "loss: " << expected.front() << " -> " << expected.back() << endl;
+    remove("graph.ncg");
+    return 0;
+}
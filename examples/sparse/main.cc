@@ -0,0 +1,156 @@
+/*
+ * main.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "ncg.h"
+
+#include <cmath>
+#include <iostream>
+#include <random>
+
+using namespace ncg;
+using namespace std;
+
+std::vector<float> values(TensorPtr a) {
+    auto fa = a.float32();
+    std::vector<float> result(fa->desc().numel());
+    for (ssize_t i = 0; i < fa->desc().numel(); ++i) {
+        result[i] = fa->as<DTypeName::Float32>()->elat(i);
+    }
+    return result;
+}
+
+void assert_close(TensorPtr a, TensorPtr b, float tol = 1e-4) {
+    ncg_assert(a->desc().shape_vec() == b->desc().shape_vec());
+    auto va = values(a), vb = values(b);
+    for (size_t i = 0; i < va.size(); ++i) {
+        ncg_assert_msg(std::abs(va[i] - vb[i]) <= tol * (1 + std::abs(vb[i])), "mismatch at " + std::to_string(i));
+    }
+}
+
+// A random matrix with about density * rows * cols non-zeros, as a dense tensor.
+TensorPtr rand_sparse_dense(std::mt19937 &rng, ssize_t rows, ssize_t cols, double density) {
+    auto dense = rand_normal(rng, DTypeName::Float32, {rows, cols});
+    auto keep = le(rand_uniform(rng, DTypeName::Float32, {rows, cols}), fill(DTypeName::Float32, {rows, cols}, density));
+    return cond(keep, dense, zeros(DTypeName::Float32, {rows, cols}));
+}
+
+void test_formats() {
+    // Unsorted, with a duplicate (summed) and an empty row.
+    auto rows = fromcc(DTypeName::Int32, std::vector<int>{2, 0, 2, 0, 2});
+    auto cols = fromcc(DTypeName::Int32, std::vector<int>{3, 1, 0, 1, 3});
+    auto data = fromcc(DTypeName::Float32, std::vector<float>{1, 2, 3, 4, 5});
+    auto a = SparseTensor::from_coo({4, 5}, rows, cols, data);
+    ncg_assert(a.nnz() == 3 && a.dtype() == DTypeName::Float32);
+    ncg_assert(tocc_vector<int64_t>(a.indptr()) == (std::vector<int64_t>{0, 1, 1, 3, 3}));
+    ncg_assert(tocc_vector<int64_t>(a.indices()) == (std::vector<int64_t>{1, 0, 3}));
+    ncg_assert(values(a.values()) == (std::vector<float>{6, 3, 6}));
+
+    auto dense = a.to_dense();
+    ncg_assert(values(dense) == (std::vector<float>{
+        0, 6, 0, 0, 0,
+        0, 0, 0, 0, 0,
+        3, 0, 0, 6, 0,
+        0, 0, 0, 0, 0
+    }));
+    auto b = SparseTensor::from_dense(dense);
+    ncg_assert(values(b.to_dense()) == values(dense));
+    ncg_assert(values(a.transpose().to_dense()) == values(dense.permute({1, 0})));
+    ncg_assert(a.transpose().shape() == (ShapeVec{5, 4}));
+
+    std::mt19937 rng(1234);
+    auto m = rand_sparse_dense(rng, 37, 53, 0.1);
+    auto sm = SparseTensor::from_dense(m);
+    ncg_assert(sm.density() < 0.2);
+    assert_close(sm.transpose().to_dense(), m.permute({1, 0}), 0);
+}
+
+void test_spmm() {
+    std::mt19937 rng(1234);
+    // 70 columns: a whole block of the kernel and a remainder.
+    auto a_dense = rand_sparse_dense(rng, 300, 500, 0.05);
+    auto a = SparseTensor::from_dense(a_dense);
+    auto b = rand_normal(rng, DTypeName::Float32, {500, 70});
+    auto bt = rand_normal(rng, DTypeName::Float32, {300, 70});
+
+    auto expected = matmul(a_dense, b);
+    auto expected_t = matmul(a_dense, bt, true);
+
+    // The chunked, multi-threaded kernel agrees with the single-threaded one bit for bit.
+    auto nr_workers = get_kernel_workers();
+    set_kernel_workers(1);
+    auto c1 = sparse_matmul(a, b), ct1 = sparse_matmul(a, bt, true);
+    set_kernel_workers(4);
+    auto c4 = sparse_matmul(a, b), ct4 = sparse_matmul(a, bt, true);
+    set_kernel_workers(nr_workers);
+
+    assert_close(c1, expected);
+    assert_close(ct1, expected_t);
+    ncg_assert(values(c1) == values(c4) && values(ct1) == values(ct4));
+
+    // Float64 and a strided dense operand.
+    auto c64 = sparse_matmul(SparseTensor::from_dense(a_dense.float64()), b.float64());
+    assert_close(c64, expected);
+    auto b_strided = rand_normal(rng, DTypeName::Float32, {70, 500}).permute({1, 0});
+    assert_close(sparse_matmul(a, b_strided), matmul(a_dense, b_strided));
+
+    // Invalid inputs are reported, not read out of bounds.
+    OpSparseMatMul op;
+    op.set_desc(OpDescPtr(new OpSparseMatMulDesc(2, 3, false)));
+    OpContext ctx;
+    op.execute(ctx, {
+        fromcc(DTypeName::Int64, std::vector<int64_t>{0, 1, 2}), fromcc(DTypeName::Int64, std::vector<int64_t>{0, 3}),
+        fromcc(DTypeName::Float32, std::vector<float>{1, 1}), ones(DTypeName::Float32, {3, 4})
+    });
+    ncg_assert(ctx.is_error());
+    OpContext shape_ctx;
+    op.execute(shape_ctx, {
+        fromcc(DTypeName::Int64, std::vector<int64_t>{0, 1, 2}), fromcc(DTypeName::Int64, std::vector<int64_t>{0, 2}),
+        fromcc(DTypeName::Float32, std::vector<float>{1, 1}), ones(DTypeName::Float32, {4, 4})
+    });
+    ncg_assert(shape_ctx.is_error());
+}
+
+void test_graph() {
+    std::mt19937 rng(1234);
+    const ssize_t batch = 16, input_dim = 1000, output_dim = 10;
+
+    auto x = G::sparse_placeholder("x", {batch, input_dim});
+    auto x_dense = G::placeholder("x_dense", {batch, input_dim});
+    auto y = G::linear("linear", x, output_dim, rng);
+    auto W = get_default_graph().find_op("linear:W")->outputs()[0];
+    auto y_dense = G::matmul(x_dense, W);
+
+    auto loss = G::reduce_sum(y * y, 1).sum(0);
+    auto loss_dense = G::reduce_sum(y_dense * y_dense, 1).sum(0);
+    auto &graph = get_default_graph();
+    graph.backward(loss);
+    graph.backward(loss_dense);
+    auto grad = W->grad(loss), grad_dense = W->grad(loss_dense);
+    ncg_assert(y->desc().shape_vec() == (ShapeVec{batch, output_dim}));
+
+    // The number of non-zeros changes from feed to feed.
+    for (double density : {0.01, 0.1}) {
+        auto value = rand_sparse_dense(rng, batch, input_dim, density);
+        GraphForwardContext ctx;
+        ctx.feed("x", SparseTensor::from_dense(value));
+        ctx.feed("x_dense", value);
+        auto outputs = ctx.eval({y, y_dense, grad, grad_dense});
+        ncg_assert_msg(ctx.ok(), ctx.error_str());
+
+        // The bias is zero.
+        assert_close(outputs[0], outputs[1]);
+        assert_close(outputs[2], outputs[3]);
+    }
+}
+
+int main() {
+    test_formats();
+    test_spmm();
+    test_graph();
+    cerr << "OK" << endl;
+    return 0;
+}
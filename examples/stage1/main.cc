@@ -98,18 +98,22 @@ public:
         return m_graph.op<GOpVariable>(name, OpDescPtr(new GOpVariableDesc(tensor)));
     }
 
+    // The comparisons output Bool tensors, while every value of the language is a Float32.
+    GTensorPtr to_float32(const GTensorPtr &x) {
+        return m_graph.op<GOpCast>(OpDescPtr(new OpCastDesc(DTypeName::Float32)), x);
+    }
     GTensorPtr arith_binary_op(COp op, const GTensorPtr &x, const GTensorPtr &y) {
         switch (op) {
             case COp::Add: return m_graph.op<GOpAdd>(nullptr, x, y);
             case COp::Sub: return m_graph.op<GOpSub>(nullptr, x, y);
             case COp::Mul: return m_graph.op<GOpMul>(nullptr, x, y);
             case COp::Div: return m_graph.op<GOpDiv>(nullptr, x, y);
-            case COp::Ge: return m_graph.op<GOpGe>(nullptr, x, y);
-            case COp::Le: return m_graph.op<GOpLe>(nullptr, x, y);
-            case COp::Geq: return m_graph.op<GOpGeq>(nullptr, x, y);
-            case COp::Leq: return m_graph.op<GOpLeq>(nullptr, x, y);
-            case COp::Eq: return m_graph.op<GOpEq>(nullptr, x, y);
-            case COp::Neq: return m_graph.op<GOpNeq>(nullptr, x, y);
+            case COp::Ge: return to_float32(m_graph.op<GOpGe>(nullptr, x, y));
+            case COp::Le: return to_float32(m_graph.op<GOpLe>(nullptr, x, y));
+            case COp::Geq: return to_float32(m_graph.op<GOpGeq>(nullptr, x, y));
+            case COp::Leq: return to_float32(m_graph.op<GOpLeq>(nullptr, x, y));
+            case COp::Eq: return to_float32(m_graph.op<GOpEq>(nullptr, x, y));
+            case COp::Neq: return to_float32(m_graph.op<GOpNeq>(nullptr, x, y));
         }
         return nullptr;
     }
@@ -7,13 +7,22 @@
 
 #include "core/common.h"
 #include "core/datatype.h"
+#include "core/memory.h"
 #include "core/tensor.h"
 #include "core/tensor_impl.h"
 #include "core/tensor_extra_ops.h"
+#include "core/compress.h"
+#include "core/mask.h"
+#include "core/quantization.h"
+#include "core/sparse.h"
 #include "core/op.h"
+#include "core/ops/conv.h"
 #include "core/ops/elemwise.h"
+#include "core/ops/embedding.h"
 #include "core/ops/linalg.h"
+#include "core/ops/quantize.h"
 #include "core/ops/reduction.h"
 #include "core/ops/shape.h"
 #include "core/ops/slice.h"
+#include "core/ops/sparse.h"
 
@@ -130,6 +130,31 @@ do { \
 
 // End Assertion }}
 
+// Begin JSON {{
+
+inline void write_json_string(std::ostream &out, const std::string &str) {
+    out << '"';
+    for (char c : str) {
+        switch (c) {
+            case '"': out << "\\\""; break;
+            case '\\': out << "\\\\"; break;
+            case '\n': out << "\\n"; break;
+            case '\t': out << "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", static_cast<int>(c));
+                    out << buf;
+                } else {
+                    out << c;
+                }
+        }
+    }
+    out << '"';
+}
+
+// End JSON }}
+
 class RuntimeContext {
 public:
     RuntimeContext() : m_is_error(false), m_error() {}
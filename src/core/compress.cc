@@ -0,0 +1,322 @@
+/*
+ * compress.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "core/compress.h"
+
+#include <cstring>
+#include <iomanip>
+
+namespace ncg {
+
+namespace {
+
+/* LZ77 in the spirit of LZ4: sequences of (token, literals, 16-bit offset, match length). */
+const size_t LZMinMatch = 4;
+const size_t LZLastLiterals = 5;
+const size_t LZMaxOffset = 65535;
+const int LZHashLog = 16;
+
+inline uint32_t read32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t lz_hash(uint32_t v) {
+    return (v * 2654435761U) >> (32 - LZHashLog);
+}
+
+inline void lz_write_length(std::vector<char> &out, size_t len) {
+    while (len >= 255) {
+        out.push_back(static_cast<char>(255));
+        len -= 255;
+    }
+    out.push_back(static_cast<char>(len));
+}
+
+inline void lz_write_sequence(std::vector<char> &out, const unsigned char *literals, size_t nr_literals, size_t offset, size_t match_len) {
+    size_t ml = match_len >= LZMinMatch ? match_len - LZMinMatch : 0;
+    unsigned char token = static_cast<unsigned char>((std::min<size_t>(nr_literals, 15) << 4) | std::min<size_t>(ml, 15));
+    out.push_back(static_cast<char>(token));
+    if (nr_literals >= 15) lz_write_length(out, nr_literals - 15);
+    out.insert(out.end(), literals, literals + nr_literals);
+
+    if (match_len == 0) return;
+    out.push_back(static_cast<char>(offset & 0xff));
+    out.push_back(static_cast<char>(offset >> 8));
+    if (ml >= 15) lz_write_length(out, ml - 15);
+}
+
+inline size_t lz_read_length(const unsigned char *&ip, const unsigned char *end, size_t len) {
+    if (len != 15) return len;
+    unsigned char b;
+    do {
+        ncg_assert_msg(ip < end, "corrupted LZ stream");
+        b = *ip++;
+        len += b;
+    } while (b == 255);
+    return len;
+}
+
+void shuffle_bytes(const char *in, char *out, size_t size, size_t elem_size) {
+    size_t n = size / elem_size;
+    for (size_t b = 0; b < elem_size; ++b) {
+        char *dst = out + b * n;
+        const char *src = in + b;
+        for (size_t i = 0; i < n; ++i) dst[i] = src[i * elem_size];
+    }
+    memcpy(out + n * elem_size, in + n * elem_size, size - n * elem_size);
+}
+
+void unshuffle_bytes(const char *in, char *out, size_t size, size_t elem_size) {
+    size_t n = size / elem_size;
+    for (size_t b = 0; b < elem_size; ++b) {
+        const char *src = in + b * n;
+        char *dst = out + b;
+        for (size_t i = 0; i < n; ++i) dst[i * elem_size] = src[i];
+    }
+    memcpy(out + n * elem_size, in + n * elem_size, size - n * elem_size);
+}
+
+template <typename T>
+void xor_delta_encode(char *data, size_t n) {
+    T prev = 0;
+    for (size_t i = 0; i < n; ++i) {
+        T cur;
+        memcpy(&cur, data + i * sizeof(T), sizeof(T));
+        T delta = cur ^ prev;
+        memcpy(data + i * sizeof(T), &delta, sizeof(T));
+        prev = cur;
+    }
+}
+
+template <typename T>
+void xor_delta_decode(char *data, size_t n) {
+    T prev = 0;
+    for (size_t i = 0; i < n; ++i) {
+        T cur;
+        memcpy(&cur, data + i * sizeof(T), sizeof(T));
+        prev ^= cur;
+        memcpy(data + i * sizeof(T), &prev, sizeof(T));
+    }
+}
+
+bool xor_delta(char *data, size_t size, size_t elem_size, bool encode) {
+    size_t n = size / elem_size;
+    switch (elem_size) {
+        case 2: encode ? xor_delta_encode<uint16_t>(data, n) : xor_delta_decode<uint16_t>(data, n); return true;
+        case 4: encode ? xor_delta_encode<uint32_t>(data, n) : xor_delta_decode<uint32_t>(data, n); return true;
+        case 8: encode ? xor_delta_encode<uint64_t>(data, n) : xor_delta_decode<uint64_t>(data, n); return true;
+        default: return false;
+    }
+}
+
+} /* !namespace <anonymous> */
+
+const char *get_codec_name(CompressionCodec codec) {
+    switch (codec) {
+        case CompressionCodec::None: return "None";
+        case CompressionCodec::ShuffleLZ: return "ShuffleLZ";
+        case CompressionCodec::FloatDelta: return "FloatDelta";
+    }
+    return "Unknown";
+}
+
+size_t lz_compress(const char *src_, size_t size, std::vector<char> &out) {
+    const unsigned char *src = reinterpret_cast<const unsigned char *>(src_);
+    size_t out_begin = out.size();
+    out.reserve(out_begin + size + size / 255 + 16);
+
+    size_t anchor = 0;
+    if (size > LZMinMatch + LZLastLiterals) {
+        std::vector<int64_t> table(1 << LZHashLog, -1);
+        size_t limit = size - LZLastLiterals - LZMinMatch;
+        size_t i = 0, misses = 0;
+
+        while (i <= limit) {
+            uint32_t v = read32(src + i);
+            uint32_t h = lz_hash(v);
+            int64_t ref = table[h];
+            table[h] = i;
+
+            if (ref >= 0 && i - ref <= LZMaxOffset && read32(src + ref) == v) {
+                size_t len = LZMinMatch;
+                size_t max_len = size - LZLastLiterals - i;
+                while (len < max_len && src[ref + len] == src[i + len]) ++len;
+
+                lz_write_sequence(out, src + anchor, i - anchor, i - ref, len);
+                i += len;
+                anchor = i;
+                misses = 0;
+            } else {
+                // Skip faster through incompressible regions.
+                i += 1 + (misses++ >> 6);
+            }
+        }
+    }
+
+    lz_write_sequence(out, src + anchor, size - anchor, 0, 0);
+    return out.size() - out_begin;
+}
+
+void lz_decompress(const char *src_, size_t size, char *out_, size_t out_size) {
+    const unsigned char *ip = reinterpret_cast<const unsigned char *>(src_);
+    const unsigned char *end = ip + size;
+    unsigned char *op = reinterpret_cast<unsigned char *>(out_);
+    unsigned char *op_begin = op, *op_end = op + out_size;
+
+    while (ip < end) {
+        unsigned char token = *ip++;
+        size_t nr_literals = lz_read_length(ip, end, token >> 4);
+        ncg_assert_msg(nr_literals <= static_cast<size_t>(end - ip) && nr_literals <= static_cast<size_t>(op_end - op), "corrupted LZ stream");
+        memcpy(op, ip, nr_literals);
+        ip += nr_literals;
+        op += nr_literals;
+
+        if (ip == end) break;
+
+        ncg_assert_msg(end - ip >= 2, "corrupted LZ stream");
+        size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+        ip += 2;
+        size_t match_len = lz_read_length(ip, end, token & 15) + LZMinMatch;
+        ncg_assert_msg(offset > 0 && offset <= static_cast<size_t>(op - op_begin) && match_len <= static_cast<size_t>(op_end - op), "corrupted LZ stream");
+
+        const unsigned char *ref = op - offset;
+        if (offset >= match_len) {
+            memcpy(op, ref, match_len);
+        } else {
+            for (size_t i = 0; i < match_len; ++i) op[i] = ref[i];
+        }
+        op += match_len;
+    }
+
+    ncg_assert_msg(op == op_end, "corrupted LZ stream");
+}
+
+NCGCompressedArray compress_bytes(CompressionCodec codec, const char *data, size_t size, size_t elem_size) {
+    NCGCompressedArray arr;
+    arr.codec = static_cast<int32_t>(codec);
+    arr.elem_size = static_cast<int32_t>(elem_size);
+    arr.raw_size = size;
+
+    if (codec == CompressionCodec::None) {
+        arr.data.assign(data, data + size);
+        return arr;
+    }
+
+    std::vector<char> tmp(data, data + size);
+    if (codec == CompressionCodec::FloatDelta && !xor_delta(tmp.data(), size, elem_size, true)) {
+        arr.codec = static_cast<int32_t>(CompressionCodec::ShuffleLZ);
+    }
+    std::vector<char> shuffled(size);
+    shuffle_bytes(tmp.data(), shuffled.data(), size, elem_size);
+    lz_compress(shuffled.data(), size, arr.data);
+
+    return arr;
+}
+
+void decompress_bytes(const NCGCompressedArray &arr, char *out, size_t out_size) {
+    ncg_assert(static_cast<size_t>(arr.raw_size) == out_size);
+    auto codec = static_cast<CompressionCodec>(arr.codec);
+
+    if (codec == CompressionCodec::None) {
+        ncg_assert(arr.data.size() == out_size);
+        memcpy(out, arr.data.data(), out_size);
+        return;
+    }
+
+    ncg_assert_msg(codec == CompressionCodec::ShuffleLZ || codec == CompressionCodec::FloatDelta, "unknown compression codec");
+    std::vector<char> shuffled(out_size);
+    lz_decompress(arr.data.data(), arr.data.size(), shuffled.data(), out_size);
+    unshuffle_bytes(shuffled.data(), out, out_size, arr.elem_size);
+    if (codec == CompressionCodec::FloatDelta) {
+        xor_delta(out, out_size, arr.elem_size, false);
+    }
+}
+
+CompressedTensor::CompressedTensor(const TensorPtr &tensor, CompressionCodec codec) :
+    m_desc(tensor->desc()), m_dtype(tensor->storage()->dtype()), m_data_ptr_offset(tensor->data_ptr_offset()),
+    m_quantization(tensor->quantization()) {
+
+    auto storage = tensor->storage();
+    if (codec == CompressionCodec::None) {
+        m_raw = storage;
+        m_data.raw_size = storage->memsize();
+        return;
+    }
+
+    size_t elem_size = storage->size() > 0 ? storage->memsize() / storage->size() : 1;
+    m_data = compress_bytes(codec, reinterpret_cast<const char *>(storage->raw_data_ptr()), storage->memsize(), elem_size);
+
+    // Incompressible data is stored as-is.
+    if (m_data.data.size() >= storage->memsize()) {
+        m_data = NCGCompressedArray();
+        m_data.raw_size = storage->memsize();
+        m_raw = storage;
+    }
+}
+
+CompressedTensor::CompressedTensor(NCGUnpickler &unpickler) : m_desc(unpickler) {
+    m_dtype = static_cast<DTypeName>(unpickler.read_int64());
+    if (unpickler.peek_type() == NCGPickleTypes::CompressedArray) {
+        m_data = unpickler.read_compressed_array();
+    } else {
+        m_raw = tensor_storage(unpickler, m_dtype);
+        m_data.raw_size = m_raw->memsize();
+    }
+    m_data_ptr_offset = static_cast<ssize_t>(unpickler.read_int64());
+    if (unpickler.version() >= 2) {
+        m_quantization = QuantizationParams(unpickler);
+    }
+}
+
+void CompressedTensor::pickle(NCGPickler &pickler) const {
+    m_desc.pickle(pickler);
+    if (m_raw != nullptr) {
+        m_raw->pickle(pickler);
+    } else {
+        pickler.write(static_cast<int64_t>(m_dtype));
+        pickler.write_compressed_array(m_data);
+    }
+    pickler.write(static_cast<int64_t>(m_data_ptr_offset));
+    m_quantization.pickle(pickler);
+}
+
+TensorPtr CompressedTensor::decompress() const {
+    auto storage = m_raw;
+    if (storage == nullptr) {
+        storage = tensor_storage(m_dtype, m_data.raw_size / std::max<int32_t>(m_data.elem_size, 1));
+        ncg_assert(storage->memsize() == static_cast<size_t>(m_data.raw_size));
+        decompress_bytes(m_data, reinterpret_cast<char *>(storage->mutable_raw_data_ptr()), m_data.raw_size);
+    }
+    auto t = tensor(m_desc, storage, true, m_data_ptr_offset);
+    t->set_quantization(m_quantization);
+    return t;
+}
+
+CompressionCodec CompressedTensor::codec() const {
+    return m_raw != nullptr ? CompressionCodec::None : static_cast<CompressionCodec>(m_data.codec);
+}
+
+size_t CompressedTensor::raw_size() const {
+    return m_data.raw_size;
+}
+
+size_t CompressedTensor::compressed_size() const {
+    return m_raw != nullptr ? m_raw->memsize() : m_data.data.size();
+}
+
+std::ostream &operator << (std::ostream &out, const CompressionStats &stats) {
+    out << std::fixed << std::setprecision(2)
+        << "CompressionStats(raw=" << stats.raw_bytes / 1024.0 / 1024.0 << "MB, compressed=" << stats.compressed_bytes / 1024.0 / 1024.0
+        << "MB, ratio=" << stats.ratio() << ", speed=" << stats.mb_per_second() << "MB/s)";
+    out << std::defaultfloat;
+    return out;
+}
+
+} /* !namespace ncg */
+
@@ -0,0 +1,75 @@
+/*
+ * compress.h
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#pragma once
+
+#include "core/common.h"
+#include "core/datatype.h"
+#include "core/tensor.h"
+#include "core/pickle.h"
+
+#include <vector>
+
+namespace ncg {
+
+enum class CompressionCodec : int32_t {
+    None = 0,
+    // Byte-shuffle (group the i-th byte of every element together), then LZ77.
+    ShuffleLZ = 1,
+    // XOR every element with the previous one (bitwise, hence lossless), then ShuffleLZ.
+    FloatDelta = 2,
+};
+
+const char *get_codec_name(CompressionCodec codec);
+
+/* Raw codecs. elem_size is the width of one element in bytes, used by the shuffle and the delta. */
+NCGCompressedArray compress_bytes(CompressionCodec codec, const char *data, size_t size, size_t elem_size);
+void decompress_bytes(const NCGCompressedArray &arr, char *out, size_t out_size);
+
+size_t lz_compress(const char *src, size_t size, std::vector<char> &out);
+void lz_decompress(const char *src, size_t size, char *out, size_t out_size);
+
+/*
+ * A pickled tensor whose storage is kept compressed. It lets the compression run separately from
+ * the (sequential) pickling, so that callers can compress and decompress many tensors in parallel.
+ * Codec None keeps the storage as-is and is pickled in the plain format.
+ */
+class CompressedTensor {
+public:
+    CompressedTensor() = default;
+    CompressedTensor(const TensorPtr &tensor, CompressionCodec codec);
+    CompressedTensor(NCGUnpickler &unpickler);
+
+    void pickle(NCGPickler &pickler) const;
+    TensorPtr decompress() const;
+
+    CompressionCodec codec() const;
+    size_t raw_size() const;
+    size_t compressed_size() const;
+
+protected:
+    TensorDesc m_desc;
+    DTypeName m_dtype = DTypeName::UInt8;
+    ssize_t m_data_ptr_offset = 0;
+    QuantizationParams m_quantization;
+    NCGCompressedArray m_data;
+    std::shared_ptr<TensorStorage> m_raw;
+};
+
+struct CompressionStats {
+    size_t raw_bytes = 0;
+    size_t compressed_bytes = 0;
+    double seconds = 0;
+
+    double ratio() const { return compressed_bytes > 0 ? double(raw_bytes) / compressed_bytes : 0; }
+    double mb_per_second() const { return seconds > 0 ? raw_bytes / 1024.0 / 1024.0 / seconds : 0; }
+};
+
+std::ostream &operator << (std::ostream &out, const CompressionStats &stats);
+
+} /* !namespace ncg */
+
@@ -8,6 +8,7 @@
 #pragma once
 
 #include "core/common.h"
+#include "core/half.h"
 
 namespace ncg {
 
@@ -20,6 +21,11 @@ enum class DTypeName : int {
     UInt64,
     Float32,
     Float64,
+    // Storage only: computed in float32 (see DType::compute_type).
+    Float16,
+    BFloat16,
+    // One byte per element, 0 or 1; the output of the comparisons.
+    Bool,
 };
 
 template <DTypeName Name>
@@ -33,6 +39,9 @@ struct CCType {
 #define DEF_DTYPE_CCTYPE(identifier_, cctype_) template<> \
 struct DType<DTypeName::identifier_> { \
     using cctype = cctype_; \
+    using compute_type = cctype_; \
+    static constexpr bool is_floating_point = std::is_floating_point<cctype_>::value; \
+    static constexpr bool is_reduced_precision = false; \
     static constexpr char name[] = #identifier_; \
     static constexpr DTypeName identifier = DTypeName::identifier_; \
 }; \
@@ -51,6 +60,23 @@ DEF_DTYPE_CCTYPE(Int64, int64_t);
 DEF_DTYPE_CCTYPE(UInt64, uint64_t);
 DEF_DTYPE_CCTYPE(Float32, float);
 DEF_DTYPE_CCTYPE(Float64, double);
+DEF_DTYPE_CCTYPE(Bool, bool);
+
+/* The 16-bit floating-point types are not arithmetic types, so they have no CCType. */
+#define DEF_DTYPE_HALF(identifier_, cctype_) template<> \
+struct DType<DTypeName::identifier_> { \
+    using cctype = cctype_; \
+    using compute_type = float; \
+    static constexpr bool is_floating_point = true; \
+    static constexpr bool is_reduced_precision = true; \
+    static constexpr char name[] = #identifier_; \
+    static constexpr DTypeName identifier = DTypeName::identifier_; \
+}
+
+DEF_DTYPE_HALF(Float16, float16);
+DEF_DTYPE_HALF(BFloat16, bfloat16);
+
+#undef DEF_DTYPE_HALF
 
 #define NCG_DTYPE_SWITCH(dtype_, MACRO_) case DTypeName::dtype_: MACRO_(dtype_); break;
 
@@ -63,8 +89,12 @@ DEF_DTYPE_CCTYPE(Float64, double);
     NCG_DTYPE_SWITCH(UInt64, MACRO); \
     NCG_DTYPE_SWITCH(Float32, MACRO); \
     NCG_DTYPE_SWITCH(Float64, MACRO); \
+    NCG_DTYPE_SWITCH(Float16, MACRO); \
+    NCG_DTYPE_SWITCH(BFloat16, MACRO); \
+    NCG_DTYPE_SWITCH(Bool, MACRO); \
 }
 
+// Only the native floating-point types.
 #define NCG_DTYPE_SWITCH_FLOAT(dtype_var, MACRO) switch(dtype_var) { \
     NCG_DTYPE_SWITCH(Float32, MACRO); \
     NCG_DTYPE_SWITCH(Float64, MACRO); \
@@ -81,7 +111,10 @@ DEF_DTYPE_CCTYPE(Float64, double);
     NCG_INSTANTIATE_DTYPE(Int64, MACRO); \
     NCG_INSTANTIATE_DTYPE(UInt64, MACRO); \
     NCG_INSTANTIATE_DTYPE(Float32, MACRO); \
-    NCG_INSTANTIATE_DTYPE(Float64, MACRO)
+    NCG_INSTANTIATE_DTYPE(Float64, MACRO); \
+    NCG_INSTANTIATE_DTYPE(Float16, MACRO); \
+    NCG_INSTANTIATE_DTYPE(BFloat16, MACRO); \
+    NCG_INSTANTIATE_DTYPE(Bool, MACRO)
 
 #define NCG_DTYPE_INSTANTIATE_CLASS(dtype_, class_name) template class class_name<DTypeName::dtype_>
 
@@ -93,7 +126,10 @@ DEF_DTYPE_CCTYPE(Float64, double);
     NCG_DTYPE_INSTANTIATE_CLASS(Int64, class_name); \
     NCG_DTYPE_INSTANTIATE_CLASS(UInt64, class_name); \
     NCG_DTYPE_INSTANTIATE_CLASS(Float32, class_name); \
-    NCG_DTYPE_INSTANTIATE_CLASS(Float64, class_name)
+    NCG_DTYPE_INSTANTIATE_CLASS(Float64, class_name); \
+    NCG_DTYPE_INSTANTIATE_CLASS(Float16, class_name); \
+    NCG_DTYPE_INSTANTIATE_CLASS(BFloat16, class_name); \
+    NCG_DTYPE_INSTANTIATE_CLASS(Bool, class_name)
 
 inline const char *get_dtype_name(DTypeName dtype) {
 #define GET_NAME_DTYPE_CASE(dtype_name) return #dtype_name;
@@ -101,6 +137,29 @@ NCG_DTYPE_SWITCH_ALL(dtype, GET_NAME_DTYPE_CASE);
 #undef GET_NAME_DTYPE_CASE
 }
 
+inline size_t get_dtype_size(DTypeName dtype) {
+#define GET_SIZE_DTYPE_CASE(dtype_name) return sizeof(DType<DTypeName::dtype_name>::cctype);
+NCG_DTYPE_SWITCH_ALL(dtype, GET_SIZE_DTYPE_CASE);
+#undef GET_SIZE_DTYPE_CASE
+    return 0;
+}
+
+inline bool is_float_dtype(DTypeName dtype) {
+    return dtype == DTypeName::Float32 || dtype == DTypeName::Float64 || dtype == DTypeName::Float16 || dtype == DTypeName::BFloat16;
+}
+
+inline bool is_int8_dtype(DTypeName dtype) {
+    return dtype == DTypeName::Int8 || dtype == DTypeName::UInt8;
+}
+
+inline bool is_bool_dtype(DTypeName dtype) {
+    return dtype == DTypeName::Bool;
+}
+
+// Float16 and BFloat16 tensors are stored in 16 bits but computed in float32.
+inline bool is_reduced_precision_dtype(DTypeName dtype) {
+    return dtype == DTypeName::Float16 || dtype == DTypeName::BFloat16;
+}
 
 } /* !namespace ncg */
 
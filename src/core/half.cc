@@ -0,0 +1,115 @@
+/*
+ * half.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "core/half.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define NCG_HAS_F16C_DISPATCH 1
+#endif
+
+namespace ncg {
+
+/*
+ * NB: the portable loops work on fixed-size blocks, so that GCC vectorizes them under the "very cheap" cost model
+ * of -O2 (which rejects loops needing a scalar epilogue); the remainder is converted element by element.
+ */
+const size_t HalfConvertBlock = 16;
+
+#ifdef NCG_HAS_F16C_DISPATCH
+
+namespace {
+
+/*
+ * The F16C paths are compiled for the instruction set regardless of the build flags, and selected at run time,
+ * so that a portable build still uses them on the CPUs which have them.
+ */
+const bool HasF16C = __builtin_cpu_supports("f16c") && __builtin_cpu_supports("avx");
+
+__attribute__((target("avx,f16c")))
+size_t convert_float16_to_float32_f16c(const float16 *src, float *dst, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+    }
+    return i;
+}
+
+__attribute__((target("avx,f16c")))
+size_t convert_float32_to_float16_f16c(const float *src, float16 *dst, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), h);
+    }
+    return i;
+}
+
+} /* !namespace <anonymous> */
+
+#endif
+
+void convert_float16_to_float32(const float16 *src, float *dst, size_t n) {
+    size_t i = 0;
+#ifdef NCG_HAS_F16C_DISPATCH
+    if (HasF16C) {
+        i = convert_float16_to_float32_f16c(src, dst, n);
+    }
+#endif
+    for (; i + HalfConvertBlock <= n; i += HalfConvertBlock) {
+        for (size_t j = 0; j < HalfConvertBlock; ++j) {
+            dst[i + j] = float16_bits_to_float(src[i + j].bits);
+        }
+    }
+    for (; i < n; ++i) {
+        dst[i] = float16_bits_to_float(src[i].bits);
+    }
+}
+
+void convert_float32_to_float16(const float *src, float16 *dst, size_t n) {
+    size_t i = 0;
+#ifdef NCG_HAS_F16C_DISPATCH
+    if (HasF16C) {
+        i = convert_float32_to_float16_f16c(src, dst, n);
+    }
+#endif
+    for (; i + HalfConvertBlock <= n; i += HalfConvertBlock) {
+        for (size_t j = 0; j < HalfConvertBlock; ++j) {
+            dst[i + j].bits = float_to_float16_bits(src[i + j]);
+        }
+    }
+    for (; i < n; ++i) {
+        dst[i].bits = float_to_float16_bits(src[i]);
+    }
+}
+
+void convert_bfloat16_to_float32(const bfloat16 *src, float *dst, size_t n) {
+    size_t i = 0;
+    for (; i + HalfConvertBlock <= n; i += HalfConvertBlock) {
+        for (size_t j = 0; j < HalfConvertBlock; ++j) {
+            dst[i + j] = bfloat16_bits_to_float(src[i + j].bits);
+        }
+    }
+    for (; i < n; ++i) {
+        dst[i] = bfloat16_bits_to_float(src[i].bits);
+    }
+}
+
+void convert_float32_to_bfloat16(const float *src, bfloat16 *dst, size_t n) {
+    size_t i = 0;
+    for (; i + HalfConvertBlock <= n; i += HalfConvertBlock) {
+        for (size_t j = 0; j < HalfConvertBlock; ++j) {
+            dst[i + j].bits = float_to_bfloat16_bits(src[i + j]);
+        }
+    }
+    for (; i < n; ++i) {
+        dst[i].bits = float_to_bfloat16_bits(src[i]);
+    }
+}
+
+} /* !namespace ncg */
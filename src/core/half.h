@@ -0,0 +1,154 @@
+/*
+ * half.h
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#pragma once
+
+#include "core/common.h"
+
+#include <cstdint>
+#include <limits>
+
+namespace ncg {
+
+// Begin scalar conversions {{
+
+inline uint32_t float_as_bits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+inline float bits_as_float(uint32_t bits) {
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/* Branch-free `cond ? a : b`, so that the loops of the bulk converters have no control flow and vectorize. */
+inline uint32_t select_bits(bool cond, uint32_t a, uint32_t b) {
+    return b ^ ((a ^ b) & (0u - static_cast<uint32_t>(cond)));
+}
+
+/* IEEE binary16, rounding to the nearest even. */
+inline uint16_t float_to_float16_bits(float value) {
+    uint32_t f = float_as_bits(value);
+    uint32_t sign = f & 0x80000000u;
+    f ^= sign;
+
+    // Overflow to inf; NaN stays a (quiet) NaN.
+    uint32_t inf_nan = select_bits(f > 0x7f800000u, 0x7e00u, 0x7c00u);
+    // Subnormal halves: let the FPU do the rounding by adding a magic number.
+    const uint32_t denorm_magic = ((127 - 15) + (23 - 10) + 1) << 23;
+    uint32_t subnormal = float_as_bits(bits_as_float(f) + bits_as_float(denorm_magic)) - denorm_magic;
+    // Normal halves: rebias the exponent and round the mantissa.
+    uint32_t normal = (f + ((uint32_t)(15 - 127) << 23) + 0xfffu + ((f >> 13) & 1u)) >> 13;
+
+    uint32_t o = select_bits(f >= (143u << 23), inf_nan, select_bits(f < (113u << 23), subnormal, normal));
+    return static_cast<uint16_t>(o | (sign >> 16));
+}
+
+inline float float16_bits_to_float(uint16_t h) {
+    const uint32_t shifted_exp = 0x7c00u << 13;
+    uint32_t o = (h & 0x7fffu) << 13;
+    uint32_t exp = o & shifted_exp;
+    o += (127 - 15) << 23;
+
+    uint32_t inf_nan = o + ((128 - 16) << 23);
+    uint32_t subnormal = float_as_bits(bits_as_float(o + (1 << 23)) - bits_as_float(113u << 23));
+    o = select_bits(exp == shifted_exp, inf_nan, select_bits(exp == 0, subnormal, o));
+    return bits_as_float(o | ((h & 0x8000u) << 16));
+}
+
+/* bfloat16 is the upper half of a float32; rounds to the nearest even. */
+inline uint16_t float_to_bfloat16_bits(float value) {
+    uint32_t f = float_as_bits(value);
+    uint32_t rounded = (f + 0x7fffu + ((f >> 16) & 1u)) >> 16;
+    uint32_t nan = (f >> 16) | 0x40u;
+    return static_cast<uint16_t>(select_bits((f & 0x7fffffffu) > 0x7f800000u, nan, rounded));
+}
+
+inline float bfloat16_bits_to_float(uint16_t h) {
+    return bits_as_float(static_cast<uint32_t>(h) << 16);
+}
+
+// End scalar conversions }}
+
+/*
+ * 16-bit floating-point storage types. They only store; any arithmetic goes through an implicit conversion to
+ * float32, so that the generic kernels compute in float32 (see DType::compute_type).
+ */
+#define NCG_DEF_HALF_TYPE(name, to_bits_func, from_bits_func) \
+struct name { \
+    uint16_t bits; \
+    \
+    name() = default; \
+    template <typename T, typename std::enable_if<std::is_arithmetic<T>::value>::type* = nullptr> \
+    name(T value) : bits(to_bits_func(static_cast<float>(value))) {} \
+    \
+    static name from_bits(uint16_t bits) { name ret; ret.bits = bits; return ret; } \
+    operator float() const { return from_bits_func(bits); } \
+    \
+    name &operator += (float rhs) { return *this = name(float(*this) + rhs); } \
+    name &operator -= (float rhs) { return *this = name(float(*this) - rhs); } \
+    name &operator *= (float rhs) { return *this = name(float(*this) * rhs); } \
+    name &operator /= (float rhs) { return *this = name(float(*this) / rhs); } \
+}
+
+NCG_DEF_HALF_TYPE(float16, float_to_float16_bits, float16_bits_to_float);
+NCG_DEF_HALF_TYPE(bfloat16, float_to_bfloat16_bits, bfloat16_bits_to_float);
+
+#undef NCG_DEF_HALF_TYPE
+
+static_assert(sizeof(float16) == 2 && sizeof(bfloat16) == 2, "16-bit floating-point types must be packed.");
+
+/* Bulk conversions; the float16 ones use the F16C instructions if the CPU has them (checked at run time). */
+void convert_float16_to_float32(const float16 *src, float *dst, size_t n);
+void convert_float32_to_float16(const float *src, float16 *dst, size_t n);
+void convert_bfloat16_to_float32(const bfloat16 *src, float *dst, size_t n);
+void convert_float32_to_bfloat16(const float *src, bfloat16 *dst, size_t n);
+
+/* For the generic kernels: converts with the bulk converters above if there is one for the two types. */
+template <typename SrcT, typename DstT>
+inline bool try_convert_array(const SrcT *, DstT *, size_t) { return false; }
+inline bool try_convert_array(const float16 *src, float *dst, size_t n) { convert_float16_to_float32(src, dst, n); return true; }
+inline bool try_convert_array(const float *src, float16 *dst, size_t n) { convert_float32_to_float16(src, dst, n); return true; }
+inline bool try_convert_array(const bfloat16 *src, float *dst, size_t n) { convert_bfloat16_to_float32(src, dst, n); return true; }
+inline bool try_convert_array(const float *src, bfloat16 *dst, size_t n) { convert_float32_to_bfloat16(src, dst, n); return true; }
+
+} /* !namespace ncg */
+
+namespace std {
+
+template <>
+class numeric_limits<ncg::float16> {
+public:
+    static constexpr bool is_specialized = true;
+    static constexpr bool is_signed = true;
+    static constexpr bool is_integer = false;
+    static constexpr bool has_infinity = true;
+    static ncg::float16 min() { return ncg::float16::from_bits(0x0400); }
+    static ncg::float16 max() { return ncg::float16::from_bits(0x7bff); }
+    static ncg::float16 lowest() { return ncg::float16::from_bits(0xfbff); }
+    static ncg::float16 epsilon() { return ncg::float16::from_bits(0x1400); }
+    static ncg::float16 infinity() { return ncg::float16::from_bits(0x7c00); }
+};
+
+template <>
+class numeric_limits<ncg::bfloat16> {
+public:
+    static constexpr bool is_specialized = true;
+    static constexpr bool is_signed = true;
+    static constexpr bool is_integer = false;
+    static constexpr bool has_infinity = true;
+    static ncg::bfloat16 min() { return ncg::bfloat16::from_bits(0x0080); }
+    static ncg::bfloat16 max() { return ncg::bfloat16::from_bits(0x7f7f); }
+    static ncg::bfloat16 lowest() { return ncg::bfloat16::from_bits(0xff7f); }
+    static ncg::bfloat16 epsilon() { return ncg::bfloat16::from_bits(0x3c00); }
+    static ncg::bfloat16 infinity() { return ncg::bfloat16::from_bits(0x7f80); }
+};
+
+} /* !namespace std */
@@ -0,0 +1,98 @@
+/*
+ * mask.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "core/mask.h"
+#include "core/tensor_impl.h"
+
+#include <cstring>
+
+namespace ncg {
+
+namespace {
+
+/*
+ * Eight bools (bytes holding 0 or 1) <-> the eight low bits of a word, with a multiplication instead of a loop over
+ * the bits. NB: assumes a little-endian machine, as the pickles do.
+ */
+inline uint64_t gather_bits8(const bool *src) {
+    uint64_t bytes;
+    memcpy(&bytes, src, sizeof(bytes));
+    return (bytes * 0x0102040810204080ull) >> 56;
+}
+
+inline void scatter_bits8(uint64_t bits, bool *dst) {
+    uint64_t bytes = (((bits * 0x0101010101010101ull) & 0x8040201008040201ull) + 0x00406070787c7e7full) >> 7;
+    bytes &= 0x0101010101010101ull;
+    memcpy(dst, &bytes, sizeof(bytes));
+}
+
+} /* !namespace <anonymous> */
+
+void pack_bits(const bool *src, uint64_t *dst, size_t n) {
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        uint64_t word = 0;
+        for (size_t j = 0; j < 64; j += 8) {
+            word |= gather_bits8(src + i + j) << j;
+        }
+        dst[i / 64] = word;
+    }
+    if (i < n) {
+        uint64_t word = 0;
+        for (size_t j = 0; i + j < n; ++j) {
+            word |= static_cast<uint64_t>(src[i + j]) << j;
+        }
+        dst[i / 64] = word;
+    }
+}
+
+void unpack_bits(const uint64_t *src, bool *dst, size_t n) {
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        uint64_t word = src[i / 64];
+        for (size_t j = 0; j < 64; j += 8) {
+            scatter_bits8((word >> j) & 0xff, dst + i + j);
+        }
+    }
+    for (; i < n; ++i) {
+        dst[i] = (src[i / 64] >> (i % 64)) & 1;
+    }
+}
+
+size_t count_bits(const uint64_t *src, size_t n) {
+    size_t count = 0;
+    for (size_t i = 0; i < get_packed_words(n); ++i) {
+        count += __builtin_popcountll(src[i]);
+    }
+    return count;
+}
+
+PackedMask::PackedMask(const TensorPtr &mask) : m_shape(mask->desc().shape_vec()), m_numel(mask->desc().numel()) {
+    ncg_assert_msg(mask->desc().dtype() == DTypeName::Bool, "PackedMask only packs Bool tensors.");
+    m_words.resize(get_packed_words(m_numel));
+
+    auto impl = mask->as<DTypeName::Bool>();
+    if (mask->desc().is_contiguous()) {
+        pack_bits(impl->data_ptr(), m_words.data(), m_numel);
+    } else {
+        for (size_t i = 0; i < m_numel; ++i) {
+            m_words[i / 64] |= static_cast<uint64_t>(impl->elat(i)) << (i % 64);
+        }
+    }
+}
+
+TensorPtr PackedMask::unpack() const {
+    auto output = empty(DTypeName::Bool, m_shape);
+    unpack_bits(m_words.data(), output->as<DTypeName::Bool>()->mutable_data_ptr(), m_numel);
+    return output;
+}
+
+size_t PackedMask::count() const {
+    return count_bits(m_words.data(), m_numel);
+}
+
+} /* !namespace ncg */
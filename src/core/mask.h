@@ -0,0 +1,54 @@
+/*
+ * mask.h
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#pragma once
+
+#include "core/common.h"
+#include "core/tensor.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace ncg {
+
+/* Raw bit packing: element i is bit i % 64 of word i / 64; the bits past n in the last word are zero. */
+void pack_bits(const bool *src, uint64_t *dst, size_t n);
+void unpack_bits(const uint64_t *src, bool *dst, size_t n);
+size_t count_bits(const uint64_t *src, size_t n);
+
+inline size_t get_packed_words(size_t n) {
+    return (n + 63) / 64;
+}
+
+/*
+ * A Bool tensor packed to one bit per element, eight times smaller than the tensor; for the large masks which are
+ * kept around, e.g., from the forward pass until the backward pass. The elements are packed in the logical order,
+ * whatever the layout of the tensor.
+ */
+class PackedMask {
+public:
+    PackedMask() = default;
+    explicit PackedMask(const TensorPtr &mask);
+
+    // A contiguous Bool tensor of the original shape.
+    TensorPtr unpack() const;
+
+    const ShapeVec &shape() const { return m_shape; }
+    size_t numel() const { return m_numel; }
+    // The number of true elements.
+    size_t count() const;
+
+    const std::vector<uint64_t> &words() const { return m_words; }
+    size_t memsize() const { return m_words.size() * sizeof(uint64_t); }
+
+protected:
+    ShapeVec m_shape;
+    size_t m_numel = 0;
+    std::vector<uint64_t> m_words;
+};
+
+} /* !namespace ncg */
@@ -0,0 +1,210 @@
+/*
+ * memory.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "core/memory.h"
+#include "core/tensor_storage.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <mutex>
+#include <unordered_set>
+
+namespace ncg {
+
+namespace {
+
+thread_local MemoryAccountPtr current_context_account_;
+thread_local MemoryAccountPtr current_op_account_;
+std::atomic<size_t> nr_live_storage_scopes_(0);
+
+struct StorageRegistry {
+    std::mutex mutex;
+    std::unordered_set<const TensorStorage *> storages;
+};
+
+/* NB: intentionally leaked, so that storages destroyed during the static destruction can still unregister. */
+StorageRegistry &storage_registry() {
+    static auto registry = new StorageRegistry();
+    return *registry;
+}
+
+void update_max(std::atomic<size_t> &target, size_t value) {
+    size_t current = target.load(std::memory_order_relaxed);
+    while (current < value && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+        // Pass
+    }
+}
+
+} /* !namespace <anonymous> */
+
+MemoryAccount::MemoryAccount(const std::string &name) :
+    m_name(name), m_live_bytes(0), m_peak_bytes(0), m_nr_storages(0), m_allocated_bytes(0) {
+    for (auto &bytes : m_live_bytes_by_dtype) {
+        bytes.store(0);
+    }
+}
+
+const std::string &MemoryAccount::name() const {
+    return m_name;
+}
+
+void MemoryAccount::allocate(DTypeName dtype, size_t nbytes) {
+    size_t live = m_live_bytes.fetch_add(nbytes, std::memory_order_relaxed) + nbytes;
+    update_max(m_peak_bytes, live);
+    m_nr_storages.fetch_add(1, std::memory_order_relaxed);
+    m_allocated_bytes.fetch_add(nbytes, std::memory_order_relaxed);
+    m_live_bytes_by_dtype[static_cast<size_t>(dtype)].fetch_add(nbytes, std::memory_order_relaxed);
+}
+
+void MemoryAccount::release(DTypeName dtype, size_t nbytes) {
+    m_live_bytes.fetch_sub(nbytes, std::memory_order_relaxed);
+    m_nr_storages.fetch_sub(1, std::memory_order_relaxed);
+    m_live_bytes_by_dtype[static_cast<size_t>(dtype)].fetch_sub(nbytes, std::memory_order_relaxed);
+}
+
+size_t MemoryAccount::live_bytes() const {
+    return m_live_bytes.load(std::memory_order_relaxed);
+}
+
+size_t MemoryAccount::live_bytes(DTypeName dtype) const {
+    return m_live_bytes_by_dtype[static_cast<size_t>(dtype)].load(std::memory_order_relaxed);
+}
+
+size_t MemoryAccount::peak_bytes() const {
+    return m_peak_bytes.load(std::memory_order_relaxed);
+}
+
+size_t MemoryAccount::nr_storages() const {
+    return m_nr_storages.load(std::memory_order_relaxed);
+}
+
+size_t MemoryAccount::allocated_bytes() const {
+    return m_allocated_bytes.load(std::memory_order_relaxed);
+}
+
+void MemoryAccount::reset_peak() {
+    m_peak_bytes.store(live_bytes(), std::memory_order_relaxed);
+}
+
+std::ostream &operator << (std::ostream &out, const MemoryAccount &account) {
+    out << std::fixed << std::setprecision(2);
+    out << "MemoryAccount(" << (account.name().size() > 0 ? account.name() + ", " : "")
+        << "live=" << account.live_bytes() / 1024.0 << "KB, peak=" << account.peak_bytes() / 1024.0
+        << "KB, storages=" << account.nr_storages() << ", allocated=" << account.allocated_bytes() / 1024.0 << "KB";
+
+#define PRINT_DTYPE_CASE(dtype_name) do { \
+    size_t bytes = account.live_bytes(DTypeName::dtype_name); \
+    if (bytes > 0) out << ", " << #dtype_name << "=" << bytes / 1024.0 << "KB"; \
+} while (0)
+    PRINT_DTYPE_CASE(Int8);
+    PRINT_DTYPE_CASE(UInt8);
+    PRINT_DTYPE_CASE(Int32);
+    PRINT_DTYPE_CASE(UInt32);
+    PRINT_DTYPE_CASE(Int64);
+    PRINT_DTYPE_CASE(UInt64);
+    PRINT_DTYPE_CASE(Float32);
+    PRINT_DTYPE_CASE(Float64);
+    PRINT_DTYPE_CASE(Float16);
+    PRINT_DTYPE_CASE(BFloat16);
+    PRINT_DTYPE_CASE(Bool);
+#undef PRINT_DTYPE_CASE
+
+    out << ")" << std::defaultfloat;
+    return out;
+}
+
+MemoryAccount &global_memory_account() {
+    static auto account = new MemoryAccount("global");
+    return *account;
+}
+
+LiveStorageScope::LiveStorageScope() {
+    nr_live_storage_scopes_.fetch_add(1, std::memory_order_relaxed);
+}
+
+LiveStorageScope::~LiveStorageScope() {
+    nr_live_storage_scopes_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+bool LiveStorageScope::active() {
+    return nr_live_storage_scopes_.load(std::memory_order_relaxed) > 0;
+}
+
+MemoryScope::MemoryScope(const MemoryAccountPtr &context_account, const MemoryAccountPtr &op_account) :
+    m_saved_context_account(current_context_account_), m_saved_op_account(current_op_account_) {
+    if (context_account != nullptr) current_context_account_ = context_account;
+    if (op_account != nullptr) current_op_account_ = op_account;
+}
+
+MemoryScope::~MemoryScope() {
+    current_context_account_ = std::move(m_saved_context_account);
+    current_op_account_ = std::move(m_saved_op_account);
+}
+
+const MemoryAccountPtr &MemoryScope::current_context_account() {
+    return current_context_account_;
+}
+
+const MemoryAccountPtr &MemoryScope::current_op_account() {
+    return current_op_account_;
+}
+
+bool memory_register_storage(const TensorStorage *storage) {
+    if (!LiveStorageScope::active()) {
+        return false;
+    }
+
+    auto &registry = storage_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.storages.insert(storage);
+    return true;
+}
+
+void memory_unregister_storage(const TensorStorage *storage) {
+    auto &registry = storage_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.storages.erase(storage);
+}
+
+std::vector<LiveStorageInfo> largest_live_storages(size_t k) {
+    std::vector<LiveStorageInfo> infos;
+    {
+        auto &registry = storage_registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (const auto storage : registry.storages) {
+            const auto &context = storage->context_memory_account();
+            const auto &op = storage->op_memory_account();
+            infos.emplace_back(LiveStorageInfo{
+                storage->dtype(), storage->size(), storage->memsize(),
+                context != nullptr ? context->name() : "", op != nullptr ? op->name() : ""
+            });
+        }
+    }
+
+    auto cmp = [](const LiveStorageInfo &a, const LiveStorageInfo &b) { return a.nbytes > b.nbytes; };
+    if (infos.size() > k) {
+        std::partial_sort(infos.begin(), infos.begin() + k, infos.end(), cmp);
+        infos.resize(k);
+    } else {
+        std::sort(infos.begin(), infos.end(), cmp);
+    }
+    return infos;
+}
+
+void dump_largest_live_storages(std::ostream &out, size_t k) {
+    out << std::fixed << std::setprecision(2);
+    for (const auto &info : largest_live_storages(k)) {
+        out << std::setw(12) << info.nbytes / 1024.0 << "KB  " << std::left << std::setw(8) << get_dtype_name(info.dtype) << std::right
+            << " size=" << info.size;
+        if (info.context.size() > 0) out << " context=" << info.context;
+        if (info.op.size() > 0) out << " op=" << info.op;
+        out << std::endl;
+    }
+    out << std::defaultfloat;
+}
+
+} /* !namespace ncg */
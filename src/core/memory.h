@@ -0,0 +1,124 @@
+/*
+ * memory.h
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#pragma once
+
+#include "core/common.h"
+#include "core/datatype.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+namespace ncg {
+
+class TensorStorage;
+
+const size_t MemoryMaxDTypes = 16;
+
+/*
+ * Live bytes of tensor storage, per dtype, with the peak. Updated concurrently by all threads which
+ * allocate or free storages charged to the account.
+ */
+class MemoryAccount {
+public:
+    explicit MemoryAccount(const std::string &name = "");
+    virtual ~MemoryAccount() = default;
+
+    MemoryAccount(const MemoryAccount &) = delete;
+    MemoryAccount(MemoryAccount &&) = delete;
+
+    const std::string &name() const;
+
+    void allocate(DTypeName dtype, size_t nbytes);
+    void release(DTypeName dtype, size_t nbytes);
+
+    size_t live_bytes() const;
+    size_t live_bytes(DTypeName dtype) const;
+    size_t peak_bytes() const;
+    size_t nr_storages() const;
+    // Cumulative, including the storages which have been freed since.
+    size_t allocated_bytes() const;
+
+    // Set the peak to the current live bytes.
+    void reset_peak();
+
+    friend std::ostream &operator << (std::ostream &out, const MemoryAccount &account);
+
+protected:
+    std::string m_name;
+    std::atomic<size_t> m_live_bytes;
+    std::atomic<size_t> m_peak_bytes;
+    std::atomic<size_t> m_nr_storages;
+    std::atomic<size_t> m_allocated_bytes;
+    std::atomic<size_t> m_live_bytes_by_dtype[MemoryMaxDTypes];
+};
+
+typedef std::shared_ptr<MemoryAccount> MemoryAccountPtr;
+
+/* All the storages of the process. */
+MemoryAccount &global_memory_account();
+
+/*
+ * While a scope is alive (in any thread), the storages which are allocated are registered, so that
+ * largest_live_storages() can report them until they are freed. Outside of these scopes, allocating
+ * and freeing a storage only updates the atomic counters of its accounts.
+ */
+class LiveStorageScope {
+public:
+    LiveStorageScope();
+    ~LiveStorageScope();
+
+    LiveStorageScope(const LiveStorageScope &) = delete;
+    LiveStorageScope(LiveStorageScope &&) = delete;
+
+    static bool active();
+};
+
+/*
+ * While a scope is alive, the storages allocated by the calling thread are also charged to its accounts
+ * (e.g., those of a GraphForwardContext and of the op being executed). Scopes nest; nullptr accounts
+ * inherit from the enclosing scope. A MemoryScope is also a LiveStorageScope.
+ */
+class MemoryScope {
+public:
+    MemoryScope(const MemoryAccountPtr &context_account, const MemoryAccountPtr &op_account = nullptr);
+    ~MemoryScope();
+
+    MemoryScope(const MemoryScope &) = delete;
+    MemoryScope(MemoryScope &&) = delete;
+
+    static const MemoryAccountPtr &current_context_account();
+    static const MemoryAccountPtr &current_op_account();
+
+protected:
+    LiveStorageScope m_live_storage_scope;
+    MemoryAccountPtr m_saved_context_account;
+    MemoryAccountPtr m_saved_op_account;
+};
+
+struct LiveStorageInfo {
+    DTypeName dtype;
+    size_t size;
+    size_t nbytes;
+    // Names of the accounts the storage was charged to, empty if none.
+    std::string context;
+    std::string op;
+};
+
+/* The k largest storages alive, by decreasing size, among those allocated inside a LiveStorageScope. */
+std::vector<LiveStorageInfo> largest_live_storages(size_t k);
+void dump_largest_live_storages(std::ostream &out, size_t k);
+
+/*
+ * Called by the storages which own their memory; they are registered until destruction. Returns false
+ * (and does nothing) if no LiveStorageScope is active; such storages must not be unregistered.
+ */
+bool memory_register_storage(const TensorStorage *storage);
+void memory_unregister_storage(const TensorStorage *storage);
+
+} /* !namespace ncg */
@@ -16,6 +16,10 @@ class OpContext;
 class OpDesc {
 public:
     virtual ~OpDesc() = default;
+
+    /* Used to save and load graphs; descs without fields can keep the defaults. */
+    virtual void pickle(NCGPickler &pickler) const {}
+    virtual void unpickle(NCGUnpickler &unpickler) {}
 };
 
 typedef std::shared_ptr<OpDesc> OpDescPtr;
@@ -205,10 +209,20 @@ protected:
 
 class OpContext : public RuntimeContext {
 public:
-    OpContext() = default;
+    OpContext() : m_domain_checks(true) {}
     virtual ~OpContext() = default;
 
     std::ostringstream &error(const Op *);
+
+    /*
+     * If disabled, the elementwise kernels skip their domain checks (e.g., log of a non-positive number,
+     * division by zero) and follow the IEEE semantics instead (inf/nan results).
+     */
+    bool domain_checks() const { return m_domain_checks; }
+    void set_domain_checks(bool domain_checks) { m_domain_checks = domain_checks; }
+
+private:
+    bool m_domain_checks;
 };
 
 } /* !namespace ncg */
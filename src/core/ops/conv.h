@@ -0,0 +1,994 @@
+/*
+ * conv.h
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#pragma once
+
+#include "core/op.h"
+#include "core/parallel.h"
+#include "core/ops/slice.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace ncg {
+
+// The images are NCHW ({N, C, H, W}) and the filters OIHW ({O, C, KH, KW}); see Conv2dAlgorithm in core/tensor.h.
+
+namespace conv_impl {
+
+// The rows of a GEMM output are computed in blocks of this many columns, accumulated in a local buffer.
+const ssize_t ColumnBlock = 64;
+// The direct kernels compute this many consecutive outputs of a row, for this many filters, at once.
+const ssize_t DirectBlock = 8;
+const ssize_t DirectFilterBlock = 4;
+/*
+ * Auto uses the direct kernels for the filters with at most this many weights (C * KH * KW; e.g., the first layer
+ * of a network, on a single input channel): the GEMM is too thin to pay for building the im2col matrix. The deeper
+ * layers go through im2col (see the conv benchmarks in benchmarks/kernels.cc).
+ */
+const ssize_t DirectMaxReduction = 64;
+// The gradient of the filter sums the images of a group into a partial sum; the partial sums are added in order.
+const ssize_t FilterGradImageGroup = 4;
+
+struct Conv2dGeometry {
+    ssize_t N, C, H, W;
+    ssize_t O, KH, KW;
+    ssize_t OH, OW;
+    ssize_t stride_h, stride_w, padding_h, padding_w;
+
+    Conv2dGeometry() = default;
+    Conv2dGeometry(ssize_t N, ssize_t C, ssize_t H, ssize_t W, ssize_t O, ssize_t KH, ssize_t KW,
+            ssize_t stride_h, ssize_t stride_w, ssize_t padding_h, ssize_t padding_w) :
+        N(N), C(C), H(H), W(W), O(O), KH(KH), KW(KW),
+        OH(output_size(H, KH, stride_h, padding_h)), OW(output_size(W, KW, stride_w, padding_w)),
+        stride_h(stride_h), stride_w(stride_w), padding_h(padding_h), padding_w(padding_w) {}
+
+    static ssize_t output_size(ssize_t size, ssize_t kernel, ssize_t stride, ssize_t padding) {
+        return size + 2 * padding >= kernel ? (size + 2 * padding - kernel) / stride + 1 : 0;
+    }
+
+    // The rows and the columns of the im2col matrix of an image.
+    ssize_t col_rows() const { return C * KH * KW; }
+    ssize_t col_cols() const { return OH * OW; }
+};
+
+// The output positions [begin, end) reading the input position o * stride - padding + k inside [0, size).
+inline void valid_range(ssize_t k, ssize_t stride, ssize_t padding, ssize_t size, ssize_t out_size, ssize_t &begin, ssize_t &end) {
+    ssize_t lo = padding - k, hi = size - 1 + padding - k;
+    begin = lo > 0 ? (lo + stride - 1) / stride : 0;
+    end = hi >= 0 ? std::min(out_size, hi / stride + 1) : 0;
+    end = std::max(begin, end);
+}
+
+// cols[(c, kh, kw), (oh, ow)] = image[c, oh * stride_h - padding_h + kh, ow * stride_w - padding_w + kw], or 0.
+template <typename T>
+void im2col(const T *image, T *cols, const Conv2dGeometry &g) {
+    for (ssize_t c = 0; c < g.C; ++c) {
+        for (ssize_t kh = 0; kh < g.KH; ++kh) {
+            ssize_t oh_begin, oh_end;
+            valid_range(kh, g.stride_h, g.padding_h, g.H, g.OH, oh_begin, oh_end);
+            for (ssize_t kw = 0; kw < g.KW; ++kw) {
+                ssize_t ow_begin, ow_end;
+                valid_range(kw, g.stride_w, g.padding_w, g.W, g.OW, ow_begin, ow_end);
+
+                T *dst = cols + ((c * g.KH + kh) * g.KW + kw) * g.OH * g.OW;
+                memset(dst, 0, sizeof(T) * g.OH * g.OW);
+                for (ssize_t oh = oh_begin; oh < oh_end; ++oh) {
+                    const T *src = image + (c * g.H + oh * g.stride_h - g.padding_h + kh) * g.W - g.padding_w + kw;
+                    for (ssize_t ow = ow_begin; ow < ow_end; ++ow) {
+                        dst[oh * g.OW + ow] = src[ow * g.stride_w];
+                    }
+                }
+            }
+        }
+    }
+}
+
+// The adjoint of im2col: image[c, ih, iw] += every entry of cols read from there. The image must be zeroed.
+template <typename T>
+void col2im(const T *cols, T *image, const Conv2dGeometry &g) {
+    for (ssize_t c = 0; c < g.C; ++c) {
+        for (ssize_t kh = 0; kh < g.KH; ++kh) {
+            ssize_t oh_begin, oh_end;
+            valid_range(kh, g.stride_h, g.padding_h, g.H, g.OH, oh_begin, oh_end);
+            for (ssize_t kw = 0; kw < g.KW; ++kw) {
+                ssize_t ow_begin, ow_end;
+                valid_range(kw, g.stride_w, g.padding_w, g.W, g.OW, ow_begin, ow_end);
+
+                const T *src = cols + ((c * g.KH + kh) * g.KW + kw) * g.OH * g.OW;
+                for (ssize_t oh = oh_begin; oh < oh_end; ++oh) {
+                    T *dst = image + (c * g.H + oh * g.stride_h - g.padding_h + kh) * g.W - g.padding_w + kw;
+                    for (ssize_t ow = ow_begin; ow < ow_end; ++ow) {
+                        dst[ow * g.stride_w] += src[oh * g.OW + ow];
+                    }
+                }
+            }
+        }
+    }
+}
+
+template <typename T>
+void transpose(const T *src, T *dst, ssize_t rows, ssize_t cols) {
+    for (ssize_t i = 0; i < rows; ++i) {
+        for (ssize_t j = 0; j < cols; ++j) {
+            dst[j * rows + i] = src[i * cols + j];
+        }
+    }
+}
+
+/*
+ * c[M, N] = a[M, K] @ b[K, N] (or +=, if accumulate), all row-major. A block of a row of c stays in a local buffer
+ * while the K rows of b stream through it, so that the inner loop has a constant trip count and vectorizes at -O2.
+ */
+template <typename T>
+void gemm(const T *a, const T *b, T *c, ssize_t M, ssize_t N, ssize_t K, bool accumulate) {
+    for (ssize_t i = 0; i < M; ++i) {
+        const T *a_row = a + i * K;
+        T *c_row = c + i * N;
+        ssize_t j0 = 0;
+        for (; j0 + ColumnBlock <= N; j0 += ColumnBlock) {
+            T acc[ColumnBlock] = {};
+            if (accumulate) {
+                memcpy(acc, c_row + j0, sizeof(acc));
+            }
+            for (ssize_t k = 0; k < K; ++k) {
+                const T *b_row = b + k * N + j0;
+                T a_ik = a_row[k];
+                for (ssize_t j = 0; j < ColumnBlock; ++j) {
+                    acc[j] += a_ik * b_row[j];
+                }
+            }
+            memcpy(c_row + j0, acc, sizeof(acc));
+        }
+        if (j0 < N) {
+            if (!accumulate) {
+                std::fill(c_row + j0, c_row + N, T(0));
+            }
+            for (ssize_t k = 0; k < K; ++k) {
+                const T *b_row = b + k * N;
+                T a_ik = a_row[k];
+                for (ssize_t j = j0; j < N; ++j) {
+                    c_row[j] += a_ik * b_row[j];
+                }
+            }
+        }
+    }
+}
+
+// Copies the {C, H, W} image into the middle of a zeroed {C, H + 2 * padding_h, W + 2 * padding_w} one.
+template <typename T>
+void pad_image(const T *image, T *padded, const Conv2dGeometry &g) {
+    ssize_t PH = g.H + 2 * g.padding_h, PW = g.W + 2 * g.padding_w;
+    std::fill(padded, padded + g.C * PH * PW, T(0));
+    for (ssize_t c = 0; c < g.C; ++c) {
+        for (ssize_t h = 0; h < g.H; ++h) {
+            memcpy(padded + (c * PH + h + g.padding_h) * PW + g.padding_w, image + (c * g.H + h) * g.W, sizeof(T) * g.W);
+        }
+    }
+}
+
+/*
+ * The direct kernel: the output planes {OH, OW} of DirectFilterBlock filters {C, KH, KW} (zero filters past the
+ * last one) on a padded image {C, H + 2 * padding_h, W + 2 * padding_w}. The outputs are computed DirectBlock
+ * consecutive ones of a row at a time, in a local buffer: every input row loaded is used by all the filters, and
+ * the loops have constant trip counts, so that they vectorize. The last block of a row is shifted left to end at
+ * the end of the row (and recomputes a few outputs) instead of going through a scalar loop.
+ */
+template <typename T>
+void conv2d_direct_block(const T *padded, const T *filters, T *output, ssize_t nr_filters, const Conv2dGeometry &g) {
+    const ssize_t B = DirectBlock, F = DirectFilterBlock;
+    ssize_t PH = g.H + 2 * g.padding_h, PW = g.W + 2 * g.padding_w, plane = g.OH * g.OW;
+    for (ssize_t oh = 0; oh < g.OH; ++oh) {
+        for (ssize_t ow0 = 0; ow0 < g.OW; ow0 += B) {
+            // Rows narrower than a block are computed in a single, partial one.
+            ssize_t ow = g.OW >= B ? std::min(ow0, g.OW - B) : 0, width = std::min(B, g.OW);
+            T acc[DirectFilterBlock][DirectBlock] = {};
+            for (ssize_t c = 0; c < g.C; ++c) {
+                for (ssize_t kh = 0; kh < g.KH; ++kh) {
+                    const T *row = padded + (c * PH + oh * g.stride_h + kh) * PW + ow * g.stride_w;
+                    const T *w = filters + (c * g.KH + kh) * g.KW;
+                    for (ssize_t kw = 0; kw < g.KW; ++kw) {
+                        const T *src = row + kw;
+                        if (width < B) {
+                            for (ssize_t f = 0; f < F; ++f) {
+                                for (ssize_t j = 0; j < width; ++j) acc[f][j] += w[f * g.col_rows() + kw] * src[j * g.stride_w];
+                            }
+                        } else if (g.stride_w == 1) {
+                            for (ssize_t f = 0; f < F; ++f) {
+                                T wf = w[f * g.col_rows() + kw];
+                                for (ssize_t j = 0; j < B; ++j) acc[f][j] += wf * src[j];
+                            }
+                        } else {
+                            for (ssize_t f = 0; f < F; ++f) {
+                                T wf = w[f * g.col_rows() + kw];
+                                for (ssize_t j = 0; j < B; ++j) acc[f][j] += wf * src[j * g.stride_w];
+                            }
+                        }
+                    }
+                }
+            }
+            for (ssize_t f = 0; f < nr_filters; ++f) {
+                memcpy(output + f * plane + oh * g.OW + ow, acc[f], sizeof(T) * width);
+            }
+        }
+    }
+}
+
+/*
+ * output {N, O, OH, OW} = the direct convolution of input {N, C, H, W} with filters {O, C, KH, KW}, in parallel
+ * over the (image, group of DirectFilterBlock filters) pairs.
+ */
+template <typename T>
+void conv2d_direct(const T *input, const T *filters, T *output, const Conv2dGeometry &g) {
+    const ssize_t F = DirectFilterBlock;
+    ssize_t nr_groups = (g.O + F - 1) / F, nr_tasks = g.N * nr_groups;
+    // The filters, with zero ones appended up to a multiple of DirectFilterBlock.
+    std::vector<T> padded_filters(nr_groups * F * g.col_rows(), T(0));
+    std::copy(filters, filters + g.O * g.col_rows(), padded_filters.begin());
+
+    ssize_t nr_chunks = slice_impl::nr_chunks(nr_tasks, g.N * g.O * g.OH * g.OW * g.col_rows());
+    parallel_for(nr_chunks, nr_chunks, [&](size_t t) {
+        std::vector<T> padded(g.C * (g.H + 2 * g.padding_h) * (g.W + 2 * g.padding_w));
+        ssize_t last_image = -1;
+        for (ssize_t task = nr_tasks * t / nr_chunks; task < nr_tasks * (t + 1) / nr_chunks; ++task) {
+            ssize_t n = task / nr_groups, o = task % nr_groups * F;
+            if (n != last_image) {
+                pad_image(input + n * g.C * g.H * g.W, padded.data(), g);
+                last_image = n;
+            }
+            conv2d_direct_block(padded.data(), padded_filters.data() + o * g.col_rows(), output + (n * g.O + o) * g.OH * g.OW, std::min(F, g.O - o), g);
+        }
+    });
+}
+
+/*
+ * The direct gradient of one filter {KH, KW} of the input channel c and the output channel o: a sum over the
+ * images and the output positions, in a fixed order (the results do not depend on the number of threads).
+ */
+template <typename T>
+void conv2d_direct_filter_grad(const T *input, const T *output_grad, T *filter_grad, ssize_t o, ssize_t c, const Conv2dGeometry &g) {
+    const ssize_t B = DirectBlock;
+    for (ssize_t kh = 0; kh < g.KH; ++kh) {
+        ssize_t oh_begin, oh_end;
+        valid_range(kh, g.stride_h, g.padding_h, g.H, g.OH, oh_begin, oh_end);
+        for (ssize_t kw = 0; kw < g.KW; ++kw) {
+            ssize_t ow_begin, ow_end;
+            valid_range(kw, g.stride_w, g.padding_w, g.W, g.OW, ow_begin, ow_end);
+
+            T acc[DirectBlock] = {};
+            T tail = 0;
+            for (ssize_t n = 0; n < g.N; ++n) {
+                for (ssize_t oh = oh_begin; oh < oh_end; ++oh) {
+                    const T *grad = output_grad + ((n * g.O + o) * g.OH + oh) * g.OW;
+                    const T *src = input + ((n * g.C + c) * g.H + oh * g.stride_h - g.padding_h + kh) * g.W - g.padding_w + kw;
+                    ssize_t ow = ow_begin;
+                    for (; ow + B <= ow_end; ow += B) {
+                        if (g.stride_w == 1) {
+                            for (ssize_t j = 0; j < B; ++j) acc[j] += grad[ow + j] * src[ow + j];
+                        } else {
+                            for (ssize_t j = 0; j < B; ++j) acc[j] += grad[ow + j] * src[(ow + j) * g.stride_w];
+                        }
+                    }
+                    for (; ow < ow_end; ++ow) {
+                        tail += grad[ow] * src[ow * g.stride_w];
+                    }
+                }
+            }
+            for (ssize_t j = 0; j < B; ++j) tail += acc[j];
+            filter_grad[((o * g.C + c) * g.KH + kh) * g.KW + kw] = tail;
+        }
+    }
+}
+
+inline bool choose_direct(Conv2dAlgorithm algorithm, bool prefer_direct) {
+    if (algorithm != Conv2dAlgorithm::Auto) {
+        return algorithm == Conv2dAlgorithm::Direct;
+    }
+    return prefer_direct;
+}
+
+/*
+ * The gradient of the input is a stride-1 convolution of the output gradient with the flipped filters if the
+ * convolution has stride 1 and a padding smaller than the filter; it always goes through im2col otherwise.
+ */
+inline bool can_flip(const Conv2dGeometry &g) {
+    return g.stride_h == 1 && g.stride_w == 1 && g.padding_h < g.KH && g.padding_w < g.KW;
+}
+
+// For the 16-bit dtypes: runs the op in float32 on casts of the inputs, and casts the output back (as OpMatMul).
+inline bool run_in_float32(OpContext &ctx, Op *op, const TensorVec &inputs, TensorVec &outputs) {
+    auto dtype = inputs[0]->desc().dtype();
+    if (!is_reduced_precision_dtype(dtype)) {
+        return false;
+    }
+    TensorVec float_inputs;
+    for (const auto &input : inputs) {
+        float_inputs.emplace_back(cast(input, DTypeName::Float32));
+    }
+    outputs = op->compute(ctx, float_inputs);
+    for (auto &output : outputs) {
+        output = cast(output, dtype);
+    }
+    return true;
+}
+
+} /* !namespace conv_impl */
+
+class OpConv2dDesc : public OpDesc {
+public:
+    OpConv2dDesc() : stride_h(1), stride_w(1), padding_h(0), padding_w(0), algorithm(Conv2dAlgorithm::Auto) {}
+    OpConv2dDesc(ssize_t stride_h, ssize_t stride_w, ssize_t padding_h, ssize_t padding_w, Conv2dAlgorithm algorithm = Conv2dAlgorithm::Auto) :
+        stride_h(stride_h), stride_w(stride_w), padding_h(padding_h), padding_w(padding_w), algorithm(algorithm) {}
+    virtual ~OpConv2dDesc() = default;
+
+    virtual void pickle(NCGPickler &pickler) const {
+        pickler.write(static_cast<int64_t>(stride_h));
+        pickler.write(static_cast<int64_t>(stride_w));
+        pickler.write(static_cast<int64_t>(padding_h));
+        pickler.write(static_cast<int64_t>(padding_w));
+        pickler.write(static_cast<int64_t>(algorithm));
+    }
+    virtual void unpickle(NCGUnpickler &unpickler) {
+        stride_h = static_cast<ssize_t>(unpickler.read_int64());
+        stride_w = static_cast<ssize_t>(unpickler.read_int64());
+        padding_h = static_cast<ssize_t>(unpickler.read_int64());
+        padding_w = static_cast<ssize_t>(unpickler.read_int64());
+        algorithm = static_cast<Conv2dAlgorithm>(unpickler.read_int64());
+    }
+
+    ssize_t stride_h, stride_w, padding_h, padding_w;
+    Conv2dAlgorithm algorithm;
+};
+
+// Float32 and Float64, and the 16-bit dtypes (computed in float32).
+#define NCG_OP_CHECK_CONV_INPUT_DTYPE(ctx, inputs, idx) do { \
+    auto dtype_value = inputs[idx]->desc().dtype(); \
+    if (dtype_value != DTypeName::Float32 && dtype_value != DTypeName::Float64 && !is_reduced_precision_dtype(dtype_value)) { \
+        ctx.error(this) << this->op_name() << " requires a floating-point input, but got " << get_dtype_name(dtype_value) << "."; \
+        return; \
+    } \
+} while (0)
+
+#define NCG_OP_CHECK_CONV2D_PARAMS(ctx, desc) do { \
+    if (desc.stride_h <= 0 || desc.stride_w <= 0 || desc.padding_h < 0 || desc.padding_w < 0) { \
+        ctx.error(this) << "Invalid strides (" << desc.stride_h << ", " << desc.stride_w << ") or paddings (" << desc.padding_h << ", " << desc.padding_w << ")."; \
+        return; \
+    } \
+} while (0)
+
+/* output[n, o, oh, ow] = sum_{c, kh, kw} filter[o, c, kh, kw] * input[n, c, oh * stride_h - padding_h + kh, ow * stride_w - padding_w + kw]. */
+class OpConv2d : public Op {
+public:
+    NCG_OP_DEF_NAME(OpConv2d);
+
+    virtual void check_inputs(OpContext &ctx, const TensorVec &inputs) {
+        NCG_OP_CHECK_NR_INPUTS(ctx, inputs, 2);
+        NCG_OP_CHECK_COMPATIBLE_DTYPE(ctx, inputs);
+        NCG_OP_CHECK_CONV_INPUT_DTYPE(ctx, inputs, 0);
+        NCG_OP_CHECK_INPUT_DIM(ctx, inputs, 0, 4);
+        NCG_OP_CHECK_INPUT_DIM(ctx, inputs, 1, 4);
+
+        const auto &desc = this->template desc<OpConv2dDesc>();
+        NCG_OP_CHECK_CONV2D_PARAMS(ctx, desc);
+        const auto &input = inputs[0]->desc(), &filter = inputs[1]->desc();
+        if (input.shape(1) != filter.shape(1) || input.shape(2) + 2 * desc.padding_h < filter.shape(2) || input.shape(3) + 2 * desc.padding_w < filter.shape(3)) {
+            ctx.error(this) << "Invalid shape: " << input.shape_vec() << " (input) vs. " << filter.shape_vec() << " (filter).";
+        }
+    }
+
+    virtual TensorVec compute(OpContext &ctx, const TensorVec &inputs) {
+        TensorVec outputs;
+        if (conv_impl::run_in_float32(ctx, this, inputs, outputs)) {
+            return outputs;
+        }
+
+        const auto &desc = this->template desc<OpConv2dDesc>();
+        const auto &input = inputs[0]->desc(), &filter = inputs[1]->desc();
+        conv_impl::Conv2dGeometry g(input.shape(0), input.shape(1), input.shape(2), input.shape(3), filter.shape(0), filter.shape(2), filter.shape(3),
+                                    desc.stride_h, desc.stride_w, desc.padding_h, desc.padding_w);
+
+        auto output = empty(input.dtype(), {g.N, g.O, g.OH, g.OW});
+#define CONV2D_DTYPE_CASE(dtype_name) kernel_<DTypeName::dtype_name>(inputs[0], inputs[1], output->template as<DTypeName::dtype_name>(), g)
+NCG_DTYPE_SWITCH_FLOAT(input.dtype(), CONV2D_DTYPE_CASE);
+#undef CONV2D_DTYPE_CASE
+        return {output};
+    }
+
+private:
+    template <DTypeName DT>
+    void kernel_(const TensorPtr &input_tensor, const TensorPtr &filter_tensor, TensorImpl<DT> *output, const conv_impl::Conv2dGeometry &g) {
+        using cctype = typename DType<DT>::cctype;
+        auto input = input_tensor->template as<DT>();
+        auto filter = filter_tensor->template as<DT>();
+        input->make_contiguous();
+        filter->make_contiguous();
+        const cctype *input_ptr = input->data_ptr(), *filter_ptr = filter->data_ptr();
+        cctype *output_ptr = output->mutable_data_ptr();
+
+        ssize_t plane = g.OH * g.OW, image = g.C * g.H * g.W;
+        if (conv_impl::choose_direct(this->template desc<OpConv2dDesc>().algorithm, g.col_rows() <= conv_impl::DirectMaxReduction)) {
+            conv_impl::conv2d_direct(input_ptr, filter_ptr, output_ptr, g);
+            return;
+        }
+
+        // im2col + GEMM: output[n] {O, OH * OW} = filter {O, C * KH * KW} @ cols {C * KH * KW, OH * OW}.
+        ssize_t nr_chunks = slice_impl::nr_chunks(g.N, g.N * g.O * plane * g.col_rows());
+        parallel_for(nr_chunks, nr_chunks, [&](size_t t) {
+            std::vector<cctype> cols(g.col_rows() * g.col_cols());
+            for (ssize_t n = g.N * t / nr_chunks; n < g.N * (t + 1) / nr_chunks; ++n) {
+                conv_impl::im2col(input_ptr + n * image, cols.data(), g);
+                conv_impl::gemm(filter_ptr, cols.data(), output_ptr + n * g.O * plane, g.O, g.col_cols(), g.col_rows(), false);
+            }
+        });
+    }
+};
+
+class OpConv2dBackwardDataDesc : public OpDesc {
+public:
+    OpConv2dBackwardDataDesc() : stride_h(1), stride_w(1), padding_h(0), padding_w(0), algorithm(Conv2dAlgorithm::Auto), input_h(0), input_w(0) {}
+    OpConv2dBackwardDataDesc(const OpConv2dDesc &conv, ssize_t input_h, ssize_t input_w) :
+        stride_h(conv.stride_h), stride_w(conv.stride_w), padding_h(conv.padding_h), padding_w(conv.padding_w), algorithm(conv.algorithm),
+        input_h(input_h), input_w(input_w) {}
+    virtual ~OpConv2dBackwardDataDesc() = default;
+
+    virtual void pickle(NCGPickler &pickler) const {
+        pickler.write(static_cast<int64_t>(stride_h));
+        pickler.write(static_cast<int64_t>(stride_w));
+        pickler.write(static_cast<int64_t>(padding_h));
+        pickler.write(static_cast<int64_t>(padding_w));
+        pickler.write(static_cast<int64_t>(algorithm));
+        pickler.write(static_cast<int64_t>(input_h));
+        pickler.write(static_cast<int64_t>(input_w));
+    }
+    virtual void unpickle(NCGUnpickler &unpickler) {
+        stride_h = static_cast<ssize_t>(unpickler.read_int64());
+        stride_w = static_cast<ssize_t>(unpickler.read_int64());
+        padding_h = static_cast<ssize_t>(unpickler.read_int64());
+        padding_w = static_cast<ssize_t>(unpickler.read_int64());
+        algorithm = static_cast<Conv2dAlgorithm>(unpickler.read_int64());
+        input_h = static_cast<ssize_t>(unpickler.read_int64());
+        input_w = static_cast<ssize_t>(unpickler.read_int64());
+    }
+
+    ssize_t stride_h, stride_w, padding_h, padding_w;
+    Conv2dAlgorithm algorithm;
+    ssize_t input_h, input_w;
+};
+
+/* The gradient of OpConv2d with respect to its input; the inputs are the filter and the output gradient. */
+class OpConv2dBackwardData : public Op {
+public:
+    NCG_OP_DEF_NAME(OpConv2dBackwardData);
+
+    virtual void check_inputs(OpContext &ctx, const TensorVec &inputs) {
+        NCG_OP_CHECK_NR_INPUTS(ctx, inputs, 2);
+        NCG_OP_CHECK_COMPATIBLE_DTYPE(ctx, inputs);
+        NCG_OP_CHECK_CONV_INPUT_DTYPE(ctx, inputs, 0);
+        NCG_OP_CHECK_INPUT_DIM(ctx, inputs, 0, 4);
+        NCG_OP_CHECK_INPUT_DIM(ctx, inputs, 1, 4);
+
+        const auto &desc = this->template desc<OpConv2dBackwardDataDesc>();
+        NCG_OP_CHECK_CONV2D_PARAMS(ctx, desc);
+        const auto &filter = inputs[0]->desc(), &grad = inputs[1]->desc();
+        if (grad.shape(1) != filter.shape(0) ||
+                grad.shape(2) != conv_impl::Conv2dGeometry::output_size(desc.input_h, filter.shape(2), desc.stride_h, desc.padding_h) ||
+                grad.shape(3) != conv_impl::Conv2dGeometry::output_size(desc.input_w, filter.shape(3), desc.stride_w, desc.padding_w)) {
+            ctx.error(this) << "Invalid shape: " << filter.shape_vec() << " (filter) vs. " << grad.shape_vec() << " (gradient) for an input of "
+                            << desc.input_h << "x" << desc.input_w << ".";
+        }
+    }
+
+    virtual TensorVec compute(OpContext &ctx, const TensorVec &inputs) {
+        TensorVec outputs;
+        if (conv_impl::run_in_float32(ctx, this, inputs, outputs)) {
+            return outputs;
+        }
+
+        const auto &desc = this->template desc<OpConv2dBackwardDataDesc>();
+        const auto &filter = inputs[0]->desc(), &grad = inputs[1]->desc();
+        conv_impl::Conv2dGeometry g(grad.shape(0), filter.shape(1), desc.input_h, desc.input_w, filter.shape(0), filter.shape(2), filter.shape(3),
+                                    desc.stride_h, desc.stride_w, desc.padding_h, desc.padding_w);
+
+        auto output = empty(grad.dtype(), {g.N, g.C, g.H, g.W});
+#define CONV2D_BACKWARD_DATA_DTYPE_CASE(dtype_name) kernel_<DTypeName::dtype_name>(inputs[0], inputs[1], output->template as<DTypeName::dtype_name>(), g)
+NCG_DTYPE_SWITCH_FLOAT(grad.dtype(), CONV2D_BACKWARD_DATA_DTYPE_CASE);
+#undef CONV2D_BACKWARD_DATA_DTYPE_CASE
+        return {output};
+    }
+
+private:
+    template <DTypeName DT>
+    void kernel_(const TensorPtr &filter_tensor, const TensorPtr &grad_tensor, TensorImpl<DT> *output, const conv_impl::Conv2dGeometry &g) {
+        using cctype = typename DType<DT>::cctype;
+        auto filter = filter_tensor->template as<DT>();
+        auto grad = grad_tensor->template as<DT>();
+        filter->make_contiguous();
+        grad->make_contiguous();
+        const cctype *filter_ptr = filter->data_ptr(), *grad_ptr = grad->data_ptr();
+        cctype *output_ptr = output->mutable_data_ptr();
+
+        ssize_t plane = g.OH * g.OW, image = g.C * g.H * g.W;
+        auto algorithm = this->template desc<OpConv2dBackwardDataDesc>().algorithm;
+        // The flipped filters are {C, O, KH, KW}: the direct kernel wastes most of its filter block if C is small.
+        bool prefer_direct = g.C >= conv_impl::DirectFilterBlock && g.O * g.KH * g.KW <= conv_impl::DirectMaxReduction;
+        if (conv_impl::can_flip(g) && conv_impl::choose_direct(algorithm, prefer_direct)) {
+            // A convolution of the gradient {N, O, OH, OW} with the filters flipped to {C, O, KH, KW}.
+            conv_impl::Conv2dGeometry flipped(g.N, g.O, g.OH, g.OW, g.C, g.KH, g.KW, 1, 1, g.KH - 1 - g.padding_h, g.KW - 1 - g.padding_w);
+            std::vector<cctype> flipped_filter(g.C * g.O * g.KH * g.KW);
+            for (ssize_t o = 0; o < g.O; ++o) {
+                for (ssize_t c = 0; c < g.C; ++c) {
+                    for (ssize_t k = 0; k < g.KH * g.KW; ++k) {
+                        flipped_filter[(c * g.O + o) * g.KH * g.KW + (g.KH * g.KW - 1 - k)] = filter_ptr[(o * g.C + c) * g.KH * g.KW + k];
+                    }
+                }
+            }
+
+            conv_impl::conv2d_direct(grad_ptr, flipped_filter.data(), output_ptr, flipped);
+            return;
+        }
+
+        // cols {C * KH * KW, OH * OW} = filter^T {C * KH * KW, O} @ grad[n] {O, OH * OW}, then col2im.
+        std::vector<cctype> filter_t(g.col_rows() * g.O);
+        conv_impl::transpose(filter_ptr, filter_t.data(), g.O, g.col_rows());
+        ssize_t nr_chunks = slice_impl::nr_chunks(g.N, g.N * g.O * plane * g.col_rows());
+        parallel_for(nr_chunks, nr_chunks, [&](size_t t) {
+            std::vector<cctype> cols(g.col_rows() * g.col_cols());
+            for (ssize_t n = g.N * t / nr_chunks; n < g.N * (t + 1) / nr_chunks; ++n) {
+                conv_impl::gemm(filter_t.data(), grad_ptr + n * g.O * plane, cols.data(), g.col_rows(), g.col_cols(), g.O, false);
+                std::fill(output_ptr + n * image, output_ptr + (n + 1) * image, cctype(0));
+                conv_impl::col2im(cols.data(), output_ptr + n * image, g);
+            }
+        });
+    }
+};
+
+class OpConv2dBackwardFilterDesc : public OpDesc {
+public:
+    OpConv2dBackwardFilterDesc() : stride_h(1), stride_w(1), padding_h(0), padding_w(0), algorithm(Conv2dAlgorithm::Auto), kernel_h(0), kernel_w(0) {}
+    OpConv2dBackwardFilterDesc(const OpConv2dDesc &conv, ssize_t kernel_h, ssize_t kernel_w) :
+        stride_h(conv.stride_h), stride_w(conv.stride_w), padding_h(conv.padding_h), padding_w(conv.padding_w), algorithm(conv.algorithm),
+        kernel_h(kernel_h), kernel_w(kernel_w) {}
+    virtual ~OpConv2dBackwardFilterDesc() = default;
+
+    virtual void pickle(NCGPickler &pickler) const {
+        pickler.write(static_cast<int64_t>(stride_h));
+        pickler.write(static_cast<int64_t>(stride_w));
+        pickler.write(static_cast<int64_t>(padding_h));
+        pickler.write(static_cast<int64_t>(padding_w));
+        pickler.write(static_cast<int64_t>(algorithm));
+        pickler.write(static_cast<int64_t>(kernel_h));
+        pickler.write(static_cast<int64_t>(kernel_w));
+    }
+    virtual void unpickle(NCGUnpickler &unpickler) {
+        stride_h = static_cast<ssize_t>(unpickler.read_int64());
+        stride_w = static_cast<ssize_t>(unpickler.read_int64());
+        padding_h = static_cast<ssize_t>(unpickler.read_int64());
+        padding_w = static_cast<ssize_t>(unpickler.read_int64());
+        algorithm = static_cast<Conv2dAlgorithm>(unpickler.read_int64());
+        kernel_h = static_cast<ssize_t>(unpickler.read_int64());
+        kernel_w = static_cast<ssize_t>(unpickler.read_int64());
+    }
+
+    ssize_t stride_h, stride_w, padding_h, padding_w;
+    Conv2dAlgorithm algorithm;
+    ssize_t kernel_h, kernel_w;
+};
+
+/* The gradient of OpConv2d with respect to its filter; the inputs are the input and the output gradient. */
+class OpConv2dBackwardFilter : public Op {
+public:
+    NCG_OP_DEF_NAME(OpConv2dBackwardFilter);
+
+    virtual void check_inputs(OpContext &ctx, const TensorVec &inputs) {
+        NCG_OP_CHECK_NR_INPUTS(ctx, inputs, 2);
+        NCG_OP_CHECK_COMPATIBLE_DTYPE(ctx, inputs);
+        NCG_OP_CHECK_CONV_INPUT_DTYPE(ctx, inputs, 0);
+        NCG_OP_CHECK_INPUT_DIM(ctx, inputs, 0, 4);
+        NCG_OP_CHECK_INPUT_DIM(ctx, inputs, 1, 4);
+
+        const auto &desc = this->template desc<OpConv2dBackwardFilterDesc>();
+        NCG_OP_CHECK_CONV2D_PARAMS(ctx, desc);
+        const auto &input = inputs[0]->desc(), &grad = inputs[1]->desc();
+        if (grad.shape(0) != input.shape(0) ||
+                grad.shape(2) != conv_impl::Conv2dGeometry::output_size(input.shape(2), desc.kernel_h, desc.stride_h, desc.padding_h) ||
+                grad.shape(3) != conv_impl::Conv2dGeometry::output_size(input.shape(3), desc.kernel_w, desc.stride_w, desc.padding_w)) {
+            ctx.error(this) << "Invalid shape: " << input.shape_vec() << " (input) vs. " << grad.shape_vec() << " (gradient) for a filter of "
+                            << desc.kernel_h << "x" << desc.kernel_w << ".";
+        }
+    }
+
+    virtual TensorVec compute(OpContext &ctx, const TensorVec &inputs) {
+        TensorVec outputs;
+        if (conv_impl::run_in_float32(ctx, this, inputs, outputs)) {
+            return outputs;
+        }
+
+        const auto &desc = this->template desc<OpConv2dBackwardFilterDesc>();
+        const auto &input = inputs[0]->desc(), &grad = inputs[1]->desc();
+        conv_impl::Conv2dGeometry g(input.shape(0), input.shape(1), input.shape(2), input.shape(3), grad.shape(1), desc.kernel_h, desc.kernel_w,
+                                    desc.stride_h, desc.stride_w, desc.padding_h, desc.padding_w);
+
+        auto output = empty(input.dtype(), {g.O, g.C, g.KH, g.KW});
+#define CONV2D_BACKWARD_FILTER_DTYPE_CASE(dtype_name) kernel_<DTypeName::dtype_name>(inputs[0], inputs[1], output->template as<DTypeName::dtype_name>(), g)
+NCG_DTYPE_SWITCH_FLOAT(input.dtype(), CONV2D_BACKWARD_FILTER_DTYPE_CASE);
+#undef CONV2D_BACKWARD_FILTER_DTYPE_CASE
+        return {output};
+    }
+
+private:
+    template <DTypeName DT>
+    void kernel_(const TensorPtr &input_tensor, const TensorPtr &grad_tensor, TensorImpl<DT> *output, const conv_impl::Conv2dGeometry &g) {
+        using cctype = typename DType<DT>::cctype;
+        auto input = input_tensor->template as<DT>();
+        auto grad = grad_tensor->template as<DT>();
+        input->make_contiguous();
+        grad->make_contiguous();
+        const cctype *input_ptr = input->data_ptr(), *grad_ptr = grad->data_ptr();
+        cctype *output_ptr = output->mutable_data_ptr();
+
+        ssize_t plane = g.OH * g.OW, image = g.C * g.H * g.W;
+        // The reduction of a filter gradient entry runs over the images and the output positions.
+        if (conv_impl::choose_direct(this->template desc<OpConv2dBackwardFilterDesc>().algorithm, g.col_rows() <= conv_impl::DirectMaxReduction)) {
+            ssize_t nr_pairs = g.O * g.C, nr_chunks = slice_impl::nr_chunks(nr_pairs, g.N * g.O * plane * g.col_rows());
+            parallel_for(nr_chunks, nr_chunks, [&](size_t t) {
+                for (ssize_t p = nr_pairs * t / nr_chunks; p < nr_pairs * (t + 1) / nr_chunks; ++p) {
+                    conv_impl::conv2d_direct_filter_grad(input_ptr, grad_ptr, output_ptr, p / g.C, p % g.C, g);
+                }
+            });
+            return;
+        }
+
+        /*
+         * filter_grad {O, C * KH * KW} += grad[n] {O, OH * OW} @ cols[n]^T {OH * OW, C * KH * KW}, summed over groups
+         * of FilterGradImageGroup images. The groups (not the threads) have their partial sums, which are added in
+         * order: the results do not depend on the number of threads.
+         */
+        ssize_t nr_groups = (g.N + conv_impl::FilterGradImageGroup - 1) / conv_impl::FilterGradImageGroup;
+        ssize_t filter_size = g.O * g.col_rows();
+        std::vector<cctype> partials(nr_groups * filter_size, cctype(0));
+        ssize_t nr_chunks = slice_impl::nr_chunks(nr_groups, g.N * g.O * plane * g.col_rows());
+        parallel_for(nr_chunks, nr_chunks, [&](size_t t) {
+            std::vector<cctype> cols(g.col_rows() * g.col_cols()), cols_t(g.col_rows() * g.col_cols());
+            for (ssize_t group = nr_groups * t / nr_chunks; group < nr_groups * (t + 1) / nr_chunks; ++group) {
+                ssize_t end = std::min(g.N, (group + 1) * conv_impl::FilterGradImageGroup);
+                for (ssize_t n = group * conv_impl::FilterGradImageGroup; n < end; ++n) {
+                    conv_impl::im2col(input_ptr + n * image, cols.data(), g);
+                    conv_impl::transpose(cols.data(), cols_t.data(), g.col_rows(), g.col_cols());
+                    conv_impl::gemm(grad_ptr + n * g.O * plane, cols_t.data(), partials.data() + group * filter_size, g.O, g.col_rows(), g.col_cols(), true);
+                }
+            }
+        });
+        std::copy(partials.begin(), partials.begin() + filter_size, output_ptr);
+        for (ssize_t group = 1; group < nr_groups; ++group) {
+            slice_impl::add_row(output_ptr, partials.data() + group * filter_size, filter_size);
+        }
+    }
+};
+
+class OpPool2dDesc : public OpDesc {
+public:
+    OpPool2dDesc() : kernel_h(1), kernel_w(1), stride_h(1), stride_w(1), padding_h(0), padding_w(0) {}
+    OpPool2dDesc(ssize_t kernel_h, ssize_t kernel_w, ssize_t stride_h, ssize_t stride_w, ssize_t padding_h, ssize_t padding_w) :
+        kernel_h(kernel_h), kernel_w(kernel_w), stride_h(stride_h), stride_w(stride_w), padding_h(padding_h), padding_w(padding_w) {}
+    virtual ~OpPool2dDesc() = default;
+
+    virtual void pickle(NCGPickler &pickler) const {
+        pickler.write(static_cast<int64_t>(kernel_h));
+        pickler.write(static_cast<int64_t>(kernel_w));
+        pickler.write(static_cast<int64_t>(stride_h));
+        pickler.write(static_cast<int64_t>(stride_w));
+        pickler.write(static_cast<int64_t>(padding_h));
+        pickler.write(static_cast<int64_t>(padding_w));
+    }
+    virtual void unpickle(NCGUnpickler &unpickler) {
+        kernel_h = static_cast<ssize_t>(unpickler.read_int64());
+        kernel_w = static_cast<ssize_t>(unpickler.read_int64());
+        stride_h = static_cast<ssize_t>(unpickler.read_int64());
+        stride_w = static_cast<ssize_t>(unpickler.read_int64());
+        padding_h = static_cast<ssize_t>(unpickler.read_int64());
+        padding_w = static_cast<ssize_t>(unpickler.read_int64());
+    }
+
+    // The geometry of a pooling of the {N, C, H, W} input: one filter per channel.
+    conv_impl::Conv2dGeometry geometry(const TensorDesc &input) const {
+        return conv_impl::Conv2dGeometry(input.shape(0), input.shape(1), input.shape(2), input.shape(3), input.shape(1), kernel_h, kernel_w,
+                                         stride_h, stride_w, padding_h, padding_w);
+    }
+
+    ssize_t kernel_h, kernel_w, stride_h, stride_w, padding_h, padding_w;
+};
+
+// Every window must overlap the input: the paddings are at most half of the kernel.
+#define NCG_OP_CHECK_POOL2D_INPUT(ctx, inputs, idx, desc) do { \
+    NCG_OP_CHECK_INPUT_DIM(ctx, inputs, idx, 4); \
+    if (desc.kernel_h <= 0 || desc.kernel_w <= 0 || desc.stride_h <= 0 || desc.stride_w <= 0 || \
+            desc.padding_h < 0 || desc.padding_w < 0 || 2 * desc.padding_h > desc.kernel_h || 2 * desc.padding_w > desc.kernel_w) { \
+        ctx.error(this) << "Invalid pooling: kernel (" << desc.kernel_h << ", " << desc.kernel_w << "), strides (" << desc.stride_h << ", " << desc.stride_w \
+                        << "), paddings (" << desc.padding_h << ", " << desc.padding_w << ")."; \
+        return; \
+    } \
+    if (inputs[idx]->desc().shape(2) + 2 * desc.padding_h < desc.kernel_h || inputs[idx]->desc().shape(3) + 2 * desc.padding_w < desc.kernel_w) { \
+        ctx.error(this) << "The input " << inputs[idx]->desc().shape_vec() << " is smaller than the kernel."; \
+        return; \
+    } \
+} while (0)
+
+namespace conv_impl {
+
+/*
+ * The pooling kernels run over the {H, W} planes, one plane per (n, c), in parallel: the backward ones only write
+ * to the plane they read, so that they need no atomics.
+ */
+template <typename Func>
+void for_each_plane(ssize_t nr_planes, ssize_t work, Func &&func) {
+    ssize_t nr_chunks = slice_impl::nr_chunks(nr_planes, work);
+    parallel_for(nr_chunks, nr_chunks, [&](size_t t) {
+        for (ssize_t p = nr_planes * t / nr_chunks; p < nr_planes * (t + 1) / nr_chunks; ++p) {
+            func(p);
+        }
+    });
+}
+
+// The first position of the maximum of the window at (oh, ow), as kh * KW + kw; NaNs are never the maximum.
+template <typename T>
+ssize_t window_argmax(const T *plane, ssize_t oh, ssize_t ow, const Conv2dGeometry &g) {
+    ssize_t kh_begin = std::max<ssize_t>(0, g.padding_h - oh * g.stride_h), kh_end = std::min(g.KH, g.H + g.padding_h - oh * g.stride_h);
+    ssize_t kw_begin = std::max<ssize_t>(0, g.padding_w - ow * g.stride_w), kw_end = std::min(g.KW, g.W + g.padding_w - ow * g.stride_w);
+    const T *origin = plane + (oh * g.stride_h - g.padding_h) * g.W + ow * g.stride_w - g.padding_w;
+
+    ssize_t best = kh_begin * g.KW + kw_begin;
+    T best_value = origin[kh_begin * g.W + kw_begin];
+    for (ssize_t kh = kh_begin; kh < kh_end; ++kh) {
+        for (ssize_t kw = kw_begin; kw < kw_end; ++kw) {
+            T value = origin[kh * g.W + kw];
+            if (value > best_value) {
+                best_value = value;
+                best = kh * g.KW + kw;
+            }
+        }
+    }
+    return best;
+}
+
+} /* !namespace conv_impl */
+
+class OpMaxPool2d : public Op {
+public:
+    NCG_OP_DEF_NAME(OpMaxPool2d);
+
+    virtual void check_inputs(OpContext &ctx, const TensorVec &inputs) {
+        NCG_OP_CHECK_NR_INPUTS(ctx, inputs, 1);
+        NCG_OP_CHECK_CONV_INPUT_DTYPE(ctx, inputs, 0);
+        const auto &desc = this->template desc<OpPool2dDesc>();
+        NCG_OP_CHECK_POOL2D_INPUT(ctx, inputs, 0, desc);
+    }
+
+    virtual TensorVec compute(OpContext &ctx, const TensorVec &inputs) {
+        TensorVec outputs;
+        if (conv_impl::run_in_float32(ctx, this, inputs, outputs)) {
+            return outputs;
+        }
+
+        auto g = this->template desc<OpPool2dDesc>().geometry(inputs[0]->desc());
+        auto output = empty(inputs[0]->desc().dtype(), {g.N, g.C, g.OH, g.OW});
+#define MAXPOOL2D_DTYPE_CASE(dtype_name) kernel_<DTypeName::dtype_name>(inputs[0]->template as<DTypeName::dtype_name>(), output->template as<DTypeName::dtype_name>(), g)
+NCG_DTYPE_SWITCH_FLOAT(inputs[0]->desc().dtype(), MAXPOOL2D_DTYPE_CASE);
+#undef MAXPOOL2D_DTYPE_CASE
+        return {output};
+    }
+
+private:
+    template <DTypeName DT>
+    void kernel_(TensorImpl<DT> *input, TensorImpl<DT> *output, const conv_impl::Conv2dGeometry &g) {
+        input->make_contiguous();
+        auto input_ptr = input->data_ptr();
+        auto output_ptr = output->mutable_data_ptr();
+        conv_impl::for_each_plane(g.N * g.C, g.N * g.C * g.OH * g.OW * g.KH * g.KW, [&](ssize_t p) {
+            const auto *plane = input_ptr + p * g.H * g.W;
+            for (ssize_t oh = 0; oh < g.OH; ++oh) {
+                for (ssize_t ow = 0; ow < g.OW; ++ow) {
+                    ssize_t k = conv_impl::window_argmax(plane, oh, ow, g);
+                    output_ptr[(p * g.OH + oh) * g.OW + ow] = plane[(oh * g.stride_h - g.padding_h + k / g.KW) * g.W + ow * g.stride_w - g.padding_w + k % g.KW];
+                }
+            }
+        });
+    }
+};
+
+/* The gradient of OpMaxPool2d: each output gradient goes to the (first) maximum of its window; the inputs are the input and the output gradient. */
+class OpMaxPool2dBackward : public Op {
+public:
+    NCG_OP_DEF_NAME(OpMaxPool2dBackward);
+
+    virtual void check_inputs(OpContext &ctx, const TensorVec &inputs) {
+        NCG_OP_CHECK_NR_INPUTS(ctx, inputs, 2);
+        NCG_OP_CHECK_COMPATIBLE_DTYPE(ctx, inputs);
+        NCG_OP_CHECK_CONV_INPUT_DTYPE(ctx, inputs, 0);
+        const auto &desc = this->template desc<OpPool2dDesc>();
+        NCG_OP_CHECK_POOL2D_INPUT(ctx, inputs, 0, desc);
+
+        auto g = desc.geometry(inputs[0]->desc());
+        if (inputs[1]->desc().shape_vec() != ShapeVec{g.N, g.C, g.OH, g.OW}) {
+            ctx.error(this) << "Invalid shape: " << inputs[0]->desc().shape_vec() << " (input) vs. " << inputs[1]->desc().shape_vec() << " (gradient).";
+        }
+    }
+
+    virtual TensorVec compute(OpContext &ctx, const TensorVec &inputs) {
+        TensorVec outputs;
+        if (conv_impl::run_in_float32(ctx, this, inputs, outputs)) {
+            return outputs;
+        }
+
+        auto g = this->template desc<OpPool2dDesc>().geometry(inputs[0]->desc());
+        auto output = empty(inputs[0]->desc().dtype(), {g.N, g.C, g.H, g.W});
+#define MAXPOOL2D_BACKWARD_DTYPE_CASE(dtype_name) kernel_<DTypeName::dtype_name>(inputs[0]->template as<DTypeName::dtype_name>(), inputs[1]->template as<DTypeName::dtype_name>(), output->template as<DTypeName::dtype_name>(), g)
+NCG_DTYPE_SWITCH_FLOAT(inputs[0]->desc().dtype(), MAXPOOL2D_BACKWARD_DTYPE_CASE);
+#undef MAXPOOL2D_BACKWARD_DTYPE_CASE
+        return {output};
+    }
+
+private:
+    template <DTypeName DT>
+    void kernel_(TensorImpl<DT> *input, TensorImpl<DT> *grad, TensorImpl<DT> *output, const conv_impl::Conv2dGeometry &g) {
+        input->make_contiguous();
+        grad->make_contiguous();
+        auto input_ptr = input->data_ptr();
+        auto grad_ptr = grad->data_ptr();
+        auto output_ptr = output->mutable_data_ptr();
+        conv_impl::for_each_plane(g.N * g.C, g.N * g.C * g.OH * g.OW * g.KH * g.KW, [&](ssize_t p) {
+            const auto *plane = input_ptr + p * g.H * g.W;
+            auto *grad_plane = output_ptr + p * g.H * g.W;
+            std::fill(grad_plane, grad_plane + g.H * g.W, 0);
+            for (ssize_t oh = 0; oh < g.OH; ++oh) {
+                for (ssize_t ow = 0; ow < g.OW; ++ow) {
+                    ssize_t k = conv_impl::window_argmax(plane, oh, ow, g);
+                    grad_plane[(oh * g.stride_h - g.padding_h + k / g.KW) * g.W + ow * g.stride_w - g.padding_w + k % g.KW] += grad_ptr[(p * g.OH + oh) * g.OW + ow];
+                }
+            }
+        });
+    }
+};
+
+/* The mean of each window; the padding counts as zeros (the divisor is always kernel_h * kernel_w). */
+class OpAvgPool2d : public Op {
+public:
+    NCG_OP_DEF_NAME(OpAvgPool2d);
+
+    virtual void check_inputs(OpContext &ctx, const TensorVec &inputs) {
+        NCG_OP_CHECK_NR_INPUTS(ctx, inputs, 1);
+        NCG_OP_CHECK_CONV_INPUT_DTYPE(ctx, inputs, 0);
+        const auto &desc = this->template desc<OpPool2dDesc>();
+        NCG_OP_CHECK_POOL2D_INPUT(ctx, inputs, 0, desc);
+    }
+
+    virtual TensorVec compute(OpContext &ctx, const TensorVec &inputs) {
+        TensorVec outputs;
+        if (conv_impl::run_in_float32(ctx, this, inputs, outputs)) {
+            return outputs;
+        }
+
+        auto g = this->template desc<OpPool2dDesc>().geometry(inputs[0]->desc());
+        auto output = empty(inputs[0]->desc().dtype(), {g.N, g.C, g.OH, g.OW});
+#define AVGPOOL2D_DTYPE_CASE(dtype_name) kernel_<DTypeName::dtype_name>(inputs[0]->template as<DTypeName::dtype_name>(), output->template as<DTypeName::dtype_name>(), g)
+NCG_DTYPE_SWITCH_FLOAT(inputs[0]->desc().dtype(), AVGPOOL2D_DTYPE_CASE);
+#undef AVGPOOL2D_DTYPE_CASE
+        return {output};
+    }
+
+private:
+    template <DTypeName DT>
+    void kernel_(TensorImpl<DT> *input, TensorImpl<DT> *output, const conv_impl::Conv2dGeometry &g) {
+        using cctype = typename DType<DT>::cctype;
+        input->make_contiguous();
+        auto input_ptr = input->data_ptr();
+        auto output_ptr = output->mutable_data_ptr();
+        cctype scale = cctype(1) / (g.KH * g.KW);
+        conv_impl::for_each_plane(g.N * g.C, g.N * g.C * g.OH * g.OW * g.KH * g.KW, [&](ssize_t p) {
+            const auto *plane = input_ptr + p * g.H * g.W;
+            for (ssize_t oh = 0; oh < g.OH; ++oh) {
+                ssize_t kh_begin = std::max<ssize_t>(0, g.padding_h - oh * g.stride_h), kh_end = std::min(g.KH, g.H + g.padding_h - oh * g.stride_h);
+                for (ssize_t ow = 0; ow < g.OW; ++ow) {
+                    ssize_t kw_begin = std::max<ssize_t>(0, g.padding_w - ow * g.stride_w), kw_end = std::min(g.KW, g.W + g.padding_w - ow * g.stride_w);
+                    const auto *origin = plane + (oh * g.stride_h - g.padding_h) * g.W + ow * g.stride_w - g.padding_w;
+                    cctype sum = 0;
+                    for (ssize_t kh = kh_begin; kh < kh_end; ++kh) {
+                        for (ssize_t kw = kw_begin; kw < kw_end; ++kw) {
+                            sum += origin[kh * g.W + kw];
+                        }
+                    }
+                    output_ptr[(p * g.OH + oh) * g.OW + ow] = sum * scale;
+                }
+            }
+        });
+    }
+};
+
+class OpAvgPool2dBackwardDesc : public OpDesc {
+public:
+    OpAvgPool2dBackwardDesc() : pool(), input_h(0), input_w(0) {}
+    OpAvgPool2dBackwardDesc(const OpPool2dDesc &pool, ssize_t input_h, ssize_t input_w) : pool(pool), input_h(input_h), input_w(input_w) {}
+    virtual ~OpAvgPool2dBackwardDesc() = default;
+
+    virtual void pickle(NCGPickler &pickler) const {
+        pool.pickle(pickler);
+        pickler.write(static_cast<int64_t>(input_h));
+        pickler.write(static_cast<int64_t>(input_w));
+    }
+    virtual void unpickle(NCGUnpickler &unpickler) {
+        pool.unpickle(unpickler);
+        input_h = static_cast<ssize_t>(unpickler.read_int64());
+        input_w = static_cast<ssize_t>(unpickler.read_int64());
+    }
+
+    OpPool2dDesc pool;
+    ssize_t input_h, input_w;
+};
+
+/* The gradient of OpAvgPool2d; the input is the output gradient. */
+class OpAvgPool2dBackward : public Op {
+public:
+    NCG_OP_DEF_NAME(OpAvgPool2dBackward);
+
+    virtual void check_inputs(OpContext &ctx, const TensorVec &inputs) {
+        NCG_OP_CHECK_NR_INPUTS(ctx, inputs, 1);
+        NCG_OP_CHECK_CONV_INPUT_DTYPE(ctx, inputs, 0);
+        NCG_OP_CHECK_INPUT_DIM(ctx, inputs, 0, 4);
+
+        const auto &desc = this->template desc<OpAvgPool2dBackwardDesc>();
+        const auto &grad = inputs[0]->desc();
+        auto g = desc.pool.geometry(TensorDesc(grad.dtype(), {grad.shape(0), grad.shape(1), desc.input_h, desc.input_w}));
+        if (grad.shape(2) != g.OH || grad.shape(3) != g.OW) {
+            ctx.error(this) << "Invalid shape: " << grad.shape_vec() << " (gradient) for an input of " << desc.input_h << "x" << desc.input_w << ".";
+        }
+    }
+
+    virtual TensorVec compute(OpContext &ctx, const TensorVec &inputs) {
+        TensorVec outputs;
+        if (conv_impl::run_in_float32(ctx, this, inputs, outputs)) {
+            return outputs;
+        }
+
+        const auto &desc = this->template desc<OpAvgPool2dBackwardDesc>();
+        const auto &grad = inputs[0]->desc();
+        auto g = desc.pool.geometry(TensorDesc(grad.dtype(), {grad.shape(0), grad.shape(1), desc.input_h, desc.input_w}));
+        auto output = empty(grad.dtype(), {g.N, g.C, g.H, g.W});
+#define AVGPOOL2D_BACKWARD_DTYPE_CASE(dtype_name) kernel_<DTypeName::dtype_name>(inputs[0]->template as<DTypeName::dtype_name>(), output->template as<DTypeName::dtype_name>(), g)
+NCG_DTYPE_SWITCH_FLOAT(grad.dtype(), AVGPOOL2D_BACKWARD_DTYPE_CASE);
+#undef AVGPOOL2D_BACKWARD_DTYPE_CASE
+        return {output};
+    }
+
+private:
+    template <DTypeName DT>
+    void kernel_(TensorImpl<DT> *grad, TensorImpl<DT> *output, const conv_impl::Conv2dGeometry &g) {
+        using cctype = typename DType<DT>::cctype;
+        grad->make_contiguous();
+        auto grad_ptr = grad->data_ptr();
+        auto output_ptr = output->mutable_data_ptr();
+        cctype scale = cctype(1) / (g.KH * g.KW);
+        conv_impl::for_each_plane(g.N * g.C, g.N * g.C * g.OH * g.OW * g.KH * g.KW, [&](ssize_t p) {
+            auto *plane = output_ptr + p * g.H * g.W;
+            std::fill(plane, plane + g.H * g.W, 0);
+            for (ssize_t oh = 0; oh < g.OH; ++oh) {
+                ssize_t kh_begin = std::max<ssize_t>(0, g.padding_h - oh * g.stride_h), kh_end = std::min(g.KH, g.H + g.padding_h - oh * g.stride_h);
+                for (ssize_t ow = 0; ow < g.OW; ++ow) {
+                    ssize_t kw_begin = std::max<ssize_t>(0, g.padding_w - ow * g.stride_w), kw_end = std::min(g.KW, g.W + g.padding_w - ow * g.stride_w);
+                    auto *origin = plane + (oh * g.stride_h - g.padding_h) * g.W + ow * g.stride_w - g.padding_w;
+                    cctype value = grad_ptr[(p * g.OH + oh) * g.OW + ow] * scale;
+                    for (ssize_t kh = kh_begin; kh < kh_end; ++kh) {
+                        for (ssize_t kw = kw_begin; kw < kw_end; ++kw) {
+                            origin[kh * g.W + kw] += value;
+                        }
+                    }
+                }
+            }
+        });
+    }
+};
+
+} /* !namespace ncg */
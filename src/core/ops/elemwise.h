@@ -27,6 +27,13 @@ public:
     OpCastDesc(DTypeName dtype) : dtype(dtype) {}
     virtual ~OpCastDesc() = default;
 
+    virtual void pickle(NCGPickler &pickler) const {
+        pickler.write(static_cast<int64_t>(dtype));
+    }
+    virtual void unpickle(NCGUnpickler &unpickler) {
+        dtype = static_cast<DTypeName>(unpickler.read_int64());
+    }
+
     DTypeName dtype;
 };
 
@@ -42,7 +49,7 @@ public:
 
     virtual TensorVec compute(OpContext &ctx, const TensorVec &inputs) {
         const auto &desc = this->template desc<OpCastDesc>();
-        TensorPtr output = empty(desc.dtype, inputs[0]->desc().shape_vec());
+        TensorPtr output = empty_like(inputs[0]->desc(), desc.dtype);
 
 #define CAST_DTYPE_CASE(dtype_name) kernel_<DTypeName::dtype_name>(ctx, inputs, output)
 NCG_DTYPE_SWITCH_ALL(inputs[0]->desc().dtype(), CAST_DTYPE_CASE);
@@ -62,6 +69,9 @@ NCG_DTYPE_SWITCH_ALL(desc.dtype, CAST_DTYPE_CASE);
 
     template <DTypeName DT, DTypeName ODT>
     void kernel_inner_(OpContext &ctx, const TensorVec &inputs, TensorPtr &output) {
+        using ictype = typename DType<DT>::compute_type;
+        using octype = typename DType<ODT>::cctype;
+
         size_t n = inputs[0]->desc().numel();
         auto a = inputs[0]->as<DT>();
         auto b = output->as<ODT>();
@@ -71,32 +81,75 @@ NCG_DTYPE_SWITCH_ALL(desc.dtype, CAST_DTYPE_CASE);
         bool a_con = inputs[0]->desc().is_contiguous();
 
         if (a_con) {
+            if (try_convert_array(a_ptr, b_ptr, n)) {
+                return;
+            }
             for (ssize_t i = 0; i < n; ++i) {
-                b_ptr[i] = static_cast<typename DType<DT>::cctype>(a_ptr[i]);
+                b_ptr[i] = static_cast<octype>(static_cast<ictype>(a_ptr[i]));
             }
         } else {
-        	for (ssize_t i = 0; i < n; ++i) {
-            	b_ptr[i] = static_cast<typename DType<DT>::cctype>(a->elat(i));
+            for (ssize_t i = 0; i < n; ++i) {
+                b_ptr[i] = static_cast<octype>(static_cast<ictype>(a->elat(i)));
             }
         }
     }
 };
 
-class OpCond : public OpElemwiseBase {
+/*
+ * Elementwise kernels working on contiguous tensors write blocks of this many elements through a local buffer: the
+ * loop over a block has a constant trip count and cannot alias the output, so that it vectorizes at -O2.
+ */
+const ssize_t ElemwiseBlock = 16;
+
+/* The unsigned integer type with the size of T; OpCond selects on the bits of the values. */
+template <typename T>
+using same_size_bits_t = typename std::conditional<sizeof(T) == 1, uint8_t,
+    typename std::conditional<sizeof(T) == 2, uint16_t,
+    typename std::conditional<sizeof(T) == 4, uint32_t, uint64_t>::type>::type>::type;
+
+/* The conditions of a block as 0 or 1; a Bool tensor already stores them so. */
+template <typename T>
+inline void cond_flags(const T *a, uint8_t *flags) {
+    for (ssize_t j = 0; j < ElemwiseBlock; ++j) {
+        flags[j] = a[j] > 0;
+    }
+}
+inline void cond_flags(const bool *a, uint8_t *flags) {
+    memcpy(flags, a, ElemwiseBlock);
+}
+
+/*
+ * cond(a, b, c) = a > 0 ? b : c. The condition is either a Bool tensor (e.g., the output of a comparison) or a tensor
+ * of the same dtype as the values.
+ */
+class OpCond : public Op {
 public:
     NCG_OP_DEF_NAME(OpCond);
 
     virtual void check_inputs(OpContext &ctx, const TensorVec &inputs) {
-        OpElemwiseBase::check_inputs(ctx, inputs);
+        NCG_OP_CHECK_NONEMPTY_INPUTS(ctx, inputs);
         NCG_OP_CHECK_CTX_CLEAN(ctx);
         NCG_OP_CHECK_NR_INPUTS(ctx, inputs, 3);
+        NCG_OP_CHECK_COMPATIBLE_SHAPE(ctx, inputs);
+
+        DTypeName dtype = inputs[1]->desc().dtype();
+        if (inputs[2]->desc().dtype() != dtype) {
+            ctx.error(this) << "The two values must have the same dtype, got "
+                            << get_dtype_name(dtype) << " and " << get_dtype_name(inputs[2]->desc().dtype()) << ".";
+            return;
+        }
+        DTypeName cond_dtype = inputs[0]->desc().dtype();
+        if (cond_dtype != DTypeName::Bool && cond_dtype != dtype) {
+            ctx.error(this) << "The condition must be a Bool tensor or have the dtype of the values ("
+                            << get_dtype_name(dtype) << "), got " << get_dtype_name(cond_dtype) << ".";
+        }
     }
 
     virtual TensorVec compute(OpContext &ctx, const TensorVec &inputs) {
-        TensorPtr output = empty(inputs[2]->desc().dtype(), inputs[2]->desc().shape_vec());
+        TensorPtr output = empty_like(inputs[2]->desc(), inputs[2]->desc().dtype());
 
 #define COND_COMPUTE_DTYPE(dtype) compute_inner_<DTypeName::dtype>(ctx, inputs, output)
-NCG_DTYPE_SWITCH_ALL(inputs[0]->desc().dtype(), COND_COMPUTE_DTYPE);
+NCG_DTYPE_SWITCH_ALL(inputs[2]->desc().dtype(), COND_COMPUTE_DTYPE);
 #undef COND_COMPUTE_DTYPE
 
         return {output};
@@ -105,17 +158,48 @@ NCG_DTYPE_SWITCH_ALL(inputs[0]->desc().dtype(), COND_COMPUTE_DTYPE);
 private:
     template <DTypeName DT>
     void compute_inner_(OpContext &ctx, const TensorVec &inputs, TensorPtr &output) {
-        size_t n = inputs[0]->desc().numel();
-        auto a = inputs[0]->as<DT>();
+        if (inputs[0]->desc().dtype() == DTypeName::Bool) {
+            select_<DTypeName::Bool, DT>(inputs, output);
+        } else {
+            select_<DT, DT>(inputs, output);
+        }
+    }
+
+    template <DTypeName CDT, DTypeName DT>
+    void select_(const TensorVec &inputs, TensorPtr &output) {
+        using cctype = typename DType<DT>::cctype;
+
+        ssize_t n = inputs[0]->desc().numel();
+        auto a = inputs[0]->as<CDT>();
         auto b = inputs[1]->as<DT>();
         auto c = inputs[2]->as<DT>();
         auto d = output->as<DT>();
 
-        auto a_ptr = a->data_ptr(), b_ptr = b->data_ptr(), c_ptr = c->data_ptr();
+        auto a_ptr = a->data_ptr();
+        auto b_ptr = b->data_ptr(), c_ptr = c->data_ptr();
         auto d_ptr = d->mutable_data_ptr();
         bool a_con = a->desc().is_contiguous(), b_con = b->desc().is_contiguous(), c_con = c->desc().is_contiguous();
 
-        for (ssize_t i = 0; i < n; ++i) {
+        ssize_t i = 0;
+        if (a_con && b_con && c_con) {
+            // A select on the bits (see select_bits): GCC does not vectorize a select whose condition is narrower
+            // than the values, e.g., a Bool mask choosing between floats.
+            using bits_type = same_size_bits_t<cctype>;
+            static_assert(sizeof(bits_type) == sizeof(cctype), "OpCond needs 1, 2, 4 or 8-byte values.");
+            for (; i + ElemwiseBlock <= n; i += ElemwiseBlock) {
+                uint8_t flags[ElemwiseBlock];
+                cond_flags(a_ptr + i, flags);
+                bits_type b_bits[ElemwiseBlock], c_bits[ElemwiseBlock], d_bits[ElemwiseBlock];
+                memcpy(b_bits, b_ptr + i, sizeof(b_bits));
+                memcpy(c_bits, c_ptr + i, sizeof(c_bits));
+                for (ssize_t j = 0; j < ElemwiseBlock; ++j) {
+                    bits_type mask = bits_type(0) - static_cast<bits_type>(flags[j]);
+                    d_bits[j] = c_bits[j] ^ ((b_bits[j] ^ c_bits[j]) & mask);
+                }
+                memcpy(d_ptr + i, d_bits, sizeof(d_bits));
+            }
+        }
+        for (; i < n; ++i) {
             d_ptr[i] = (a_con ? a_ptr[i] : a->elat(i)) > 0 ? (b_con ? b_ptr[i] : b->elat(i)) : (c_con ? c_ptr[i] : c->elat(i));
         }
     }
@@ -133,48 +217,93 @@ enum class UnaryOpKernelType : int {
     Reciprocal,
 };
 
+/*
+ * Float16 and BFloat16 kernels on contiguous inputs convert blocks of this many elements to float32 with the bulk
+ * converters (see half.h), run the Float32 kernel, and convert the results back. Other layouts convert per element.
+ * NB: the Float32 kernel always runs on whole blocks (the tail of the last one holds stale values, which are not
+ * written back), so that its loop has a constant trip count and vectorizes at -O2.
+ */
+const ssize_t ReducedPrecisionBlock = 256;
+
+/*
+ * Elementwise kernels. compute() is a pure function of the elements; nothing is checked inside the loop:
+ *   - `supported` tells at compile time whether the kernel is implemented for the dtype;
+ *   - kernels with `has_domain_check` reject some input values (e.g., log of a non-positive number). The op
+ *     checks them with in_domain() in a separate pass before computing, unless the context disables the
+ *     domain checks (see OpContext::set_domain_checks), in which case the IEEE semantics apply.
+ */
 template <UnaryOpKernelType OpType, DTypeName DT>
 struct UnaryOpKernel {
-    UnaryOpKernel(Op *self, OpContext &ctx) {
-        if (OpType != UnaryOpKernelType::Neg) {
-            if (DT != DTypeName::Float32 && DT != DTypeName::Float64) {
-                ctx.error(self) << "Unary Op not implemented for non-float tensors.";
-            }
-        }
+    using cctype = typename DType<DT>::cctype;
+
+    static constexpr bool supported = (OpType == UnaryOpKernelType::Neg && DT != DTypeName::Bool) || DType<DT>::is_floating_point;
+    static constexpr bool has_domain_check = OpType == UnaryOpKernelType::Log || OpType == UnaryOpKernelType::Reciprocal;
+
+    static const char *unsupported_error() {
+        return DT == DTypeName::Bool ? "Arithmetic on Bool tensors is not supported; cast them first." : "Unary Op not implemented for non-float tensors.";
+    }
+    static const char *domain_error() {
+        return OpType == UnaryOpKernelType::Log ? "LOG operator's input must be positive" : "Division by zero";
     }
 
-    void compute(
-        OpContext &ctx,
-        Op *op,
-        const typename DType<DT>::cctype &a,
-        typename DType<DT>::cctype &b
-    ) {
+    static bool in_domain(const cctype &a) {
         switch (OpType) {
-            case UnaryOpKernelType::Neg: b = -a; break;
-            case UnaryOpKernelType::Sin: b = std::sin(a); break;
-            case UnaryOpKernelType::Cos: b = std::cos(a); break;
-            case UnaryOpKernelType::Tan: b = std::tan(a); break;
-            case UnaryOpKernelType::Log:
-                if (a <= 0) {
-                    ctx.error(op) << "LOG operator's input must be positive";
-                } else {
-                    b = std::log(a);
-                }
-                break;
-            case UnaryOpKernelType::Exp: b = std::exp(a); break;
-            case UnaryOpKernelType::Tanh: b = std::tanh(a); break;
-            case UnaryOpKernelType::Sigmoid: b = 1 / (1 + std::exp(-a)); break;
-            case UnaryOpKernelType::Reciprocal:
-                if (a == 0) {
-                    ctx.error(op) << "Division by zero";
-                    break;
-                }
-                b = 1 / a;
-                break;
+            case UnaryOpKernelType::Log: return a > 0;
+            case UnaryOpKernelType::Reciprocal: return a != 0;
+            default: return true;
+        }
+    }
+
+    // Unsupported kernels are never called (see kernel_), so their bodies are not instantiated.
+    static void compute(const cctype &a, cctype &b) {
+        if constexpr (supported) {
+            switch (OpType) {
+                case UnaryOpKernelType::Neg: b = -a; break;
+                case UnaryOpKernelType::Sin: b = std::sin(a); break;
+                case UnaryOpKernelType::Cos: b = std::cos(a); break;
+                case UnaryOpKernelType::Tan: b = std::tan(a); break;
+                case UnaryOpKernelType::Log: b = std::log(a); break;
+                case UnaryOpKernelType::Exp: b = std::exp(a); break;
+                case UnaryOpKernelType::Tanh: b = std::tanh(a); break;
+                case UnaryOpKernelType::Sigmoid: b = 1 / (1 + std::exp(-a)); break;
+                case UnaryOpKernelType::Reciprocal: b = 1 / a; break;
+            }
         }
     }
 };
 
+/*
+ * Whether in_domain() fails for any element of the tensor. Contiguous tensors are scanned in fixed-size blocks
+ * without branches inside a block, so that the compiler can vectorize the scan even at -O2.
+ */
+template <typename Kernel, DTypeName DT>
+bool any_out_of_domain(const TensorImpl<DT> *a) {
+    const ssize_t block_size = 64;
+    ssize_t n = a->desc().numel();
+
+    if (a->desc().is_scalar_broadcasted()) {
+        return n > 0 && !Kernel::in_domain(a->data_ptr()[0]);
+    } else if (a->desc().is_contiguous()) {
+        auto a_ptr = a->data_ptr();
+        ssize_t i = 0;
+        for (; i + block_size <= n; i += block_size) {
+            int bad = 0;
+            for (ssize_t j = 0; j < block_size; ++j) {
+                bad |= !Kernel::in_domain(a_ptr[i + j]);
+            }
+            if (bad) return true;
+        }
+        for (; i < n; ++i) {
+            if (!Kernel::in_domain(a_ptr[i])) return true;
+        }
+    } else {
+        for (ssize_t i = 0; i < n; ++i) {
+            if (!Kernel::in_domain(a->elat(i))) return true;
+        }
+    }
+    return false;
+}
+
 template <UnaryOpKernelType OpKernelType>
 class OpUnaryElemwiseBase : public OpElemwiseBase {
 public:
@@ -185,7 +314,7 @@ public:
     }
 
     virtual TensorVec compute(OpContext &ctx, const TensorVec &inputs) {
-        TensorPtr output = empty(inputs[0]->desc().dtype(), inputs[0]->desc().shape_vec());
+        TensorPtr output = empty_like(inputs[0]->desc(), inputs[0]->desc().dtype());
 
 #define UNARY_COMPUTE_DTYPE(dtype) kernel_<DTypeName::dtype>(ctx, inputs, output)
 NCG_DTYPE_SWITCH_ALL(inputs[0]->desc().dtype(), UNARY_COMPUTE_DTYPE);
@@ -197,22 +326,45 @@ NCG_DTYPE_SWITCH_ALL(inputs[0]->desc().dtype(), UNARY_COMPUTE_DTYPE);
 private:
     template <DTypeName DT>
     void kernel_(OpContext &ctx, const TensorVec &inputs, TensorPtr &output) {
+        using Kernel = UnaryOpKernel<OpKernelType, DT>;
+        if (!Kernel::supported) {
+            ctx.error(this) << Kernel::unsupported_error();
+            return;
+        }
+
         size_t n = inputs[0]->desc().numel();
-        auto kernel = UnaryOpKernel<OpKernelType, DT>(this, ctx);
         auto a = inputs[0]->as<DT>();
         auto b = output->as<DT>();
 
+        if (Kernel::has_domain_check && ctx.domain_checks()) {
+            if (any_out_of_domain<Kernel>(a)) {
+                ctx.error(this) << Kernel::domain_error();
+                return;
+            }
+        }
+
         auto a_ptr = a->data_ptr();
         auto b_ptr = b->mutable_data_ptr();
         bool a_con = a->desc().is_contiguous();
 
-        if (a_con) {
+        if (DType<DT>::is_reduced_precision && a_con) {
+            using FloatKernel = UnaryOpKernel<OpKernelType, DTypeName::Float32>;
+            float a_buf[ReducedPrecisionBlock] = {}, b_buf[ReducedPrecisionBlock];
+            for (ssize_t i = 0; i < n; i += ReducedPrecisionBlock) {
+                ssize_t m = std::min<ssize_t>(ReducedPrecisionBlock, n - i);
+                try_convert_array(a_ptr + i, a_buf, m);
+                for (ssize_t j = 0; j < ReducedPrecisionBlock; ++j) {
+                    FloatKernel::compute(a_buf[j], b_buf[j]);
+                }
+                try_convert_array(b_buf, b_ptr + i, m);
+            }
+        } else if (a_con) {
             for (ssize_t i = 0; i < n; ++i) {
-                kernel.compute(ctx, this, a_ptr[i], b_ptr[i]);
+                Kernel::compute(a_ptr[i], b_ptr[i]);
             }
         } else {
             for (ssize_t i = 0; i < n; ++i) {
-                kernel.compute(ctx, this, a->elat(i), b_ptr[i]);
+                Kernel::compute(a->elat(i), b_ptr[i]);
             }
         }
     }
@@ -234,45 +386,60 @@ enum class BinaryOpKernelType : int {
     Max
 };
 
+/*
+ * See UnaryOpKernel; the domain checks of the binary kernels only depend on the second operand. The comparisons
+ * output Bool tensors; on Bool inputs, only the comparisons, Min (logical and) and Max (logical or) are supported.
+ */
 template <BinaryOpKernelType OpType, DTypeName DT>
 struct BinaryOpKernel {
-    BinaryOpKernel(Op *self, OpContext &ctx) {}
-
-    void compute(
-        OpContext &ctx,
-        Op *op,
-        const typename DType<DT>::cctype &a,
-        const typename DType<DT>::cctype &b,
-        typename DType<DT>::cctype &c
-    ) {
-        switch (OpType) {
-            case BinaryOpKernelType::Add: c = a + b; break;
-            case BinaryOpKernelType::Sub: c = a - b; break;
-            case BinaryOpKernelType::Mul: c = a * b; break;
-            case BinaryOpKernelType::Div:
-                if (DT != DTypeName::Float32 && DT != DTypeName::Float64) {
-                    ctx.error(op) << "Division for integer not implemented";
-                    break;
-                }
-                if (b == 0) {
-                    ctx.error(op) << "Division by zero";
-                    break;
-                }
-                c = a / b;
-                break;
-            case BinaryOpKernelType::Ge: c = a > b; break;
-            case BinaryOpKernelType::Le: c = a < b; break;
-            case BinaryOpKernelType::Geq: c = a >= b; break;
-            case BinaryOpKernelType::Leq: c = a <= b; break;
-            case BinaryOpKernelType::Eq: c = a == b; break;
-            case BinaryOpKernelType::Neq: c = a != b; break;
-            case BinaryOpKernelType::Pow: c = std::pow(a, b); break;
-            case BinaryOpKernelType::Min: c = std::min(a, b); break;
-            case BinaryOpKernelType::Max: c = std::max(a, b); break;
-        }
+    using cctype = typename DType<DT>::cctype;
+
+    static constexpr bool is_comparison = OpType == BinaryOpKernelType::Ge || OpType == BinaryOpKernelType::Le ||
+        OpType == BinaryOpKernelType::Geq || OpType == BinaryOpKernelType::Leq ||
+        OpType == BinaryOpKernelType::Eq || OpType == BinaryOpKernelType::Neq;
+    static constexpr DTypeName output_dtype = is_comparison ? DTypeName::Bool : DT;
+    using output_type = typename DType<output_dtype>::cctype;
+
+    static constexpr bool is_logical = is_comparison || OpType == BinaryOpKernelType::Min || OpType == BinaryOpKernelType::Max;
+    static constexpr bool supported = (OpType != BinaryOpKernelType::Div || DType<DT>::is_floating_point) &&
+        (DT != DTypeName::Bool || is_logical);
+    static constexpr bool has_domain_check = OpType == BinaryOpKernelType::Div;
+
+    static const char *unsupported_error() {
+        return DT == DTypeName::Bool ? "Arithmetic on Bool tensors is not supported; cast them first." : "Division for integer not implemented";
+    }
+    static const char *domain_error() { return "Division by zero"; }
+
+    static bool in_domain(const cctype &b) {
+        return OpType == BinaryOpKernelType::Div ? b != 0 : true;
+    }
+
+    // Only the case of OpType is instantiated (see UnaryOpKernel::compute), e.g. never the arithmetic on Bool, nor
+    // a product whose result would be stored in the Bool output of a comparison.
+    static void compute(const cctype &a, const cctype &b, output_type &c) {
+        if constexpr (!supported) return;
+        else if constexpr (OpType == BinaryOpKernelType::Add) c = a + b;
+        else if constexpr (OpType == BinaryOpKernelType::Sub) c = a - b;
+        else if constexpr (OpType == BinaryOpKernelType::Mul) c = a * b;
+        else if constexpr (OpType == BinaryOpKernelType::Div) c = a / b;
+        else if constexpr (OpType == BinaryOpKernelType::Ge) c = a > b;
+        else if constexpr (OpType == BinaryOpKernelType::Le) c = a < b;
+        else if constexpr (OpType == BinaryOpKernelType::Geq) c = a >= b;
+        else if constexpr (OpType == BinaryOpKernelType::Leq) c = a <= b;
+        else if constexpr (OpType == BinaryOpKernelType::Eq) c = a == b;
+        else if constexpr (OpType == BinaryOpKernelType::Neq) c = a != b;
+        else if constexpr (OpType == BinaryOpKernelType::Pow) c = std::pow(a, b);
+        else if constexpr (OpType == BinaryOpKernelType::Min) c = std::min(a, b);
+        else if constexpr (OpType == BinaryOpKernelType::Max) c = std::max(a, b);
     }
 };
 
+/* Copies the output block of a reduced-precision kernel back: Bool outputs are copied, floats are converted. */
+template <typename T>
+inline void store_block(const T *src, T *dst, size_t n) { memcpy(dst, src, n * sizeof(T)); }
+template <typename SrcT, typename DstT>
+inline void store_block(const SrcT *src, DstT *dst, size_t n) { try_convert_array(src, dst, n); }
+
 template <BinaryOpKernelType OpKernelType>
 class OpBinaryElemwiseBase : public OpElemwiseBase {
 public:
@@ -283,8 +450,8 @@ public:
     }
 
     virtual TensorVec compute(OpContext &ctx, const TensorVec &inputs) {
-        size_t n = inputs[0]->desc().numel();
-        TensorPtr output = empty(inputs[0]->desc().dtype(), inputs[0]->desc().shape_vec());
+        DTypeName dtype = inputs[0]->desc().dtype();
+        TensorPtr output = empty_like(inputs[0]->desc(), output_dtype(dtype));
 
 #define BINARY_COMPUTE_DTYPE(dtype) kernel_<DTypeName::dtype>(ctx, inputs, output)
 NCG_DTYPE_SWITCH_ALL(inputs[0]->desc().dtype(), BINARY_COMPUTE_DTYPE);
@@ -293,14 +460,30 @@ NCG_DTYPE_SWITCH_ALL(inputs[0]->desc().dtype(), BINARY_COMPUTE_DTYPE);
         return {output};
     }
 
+    static DTypeName output_dtype(DTypeName dtype) {
+        return BinaryOpKernel<OpKernelType, DTypeName::Float32>::is_comparison ? DTypeName::Bool : dtype;
+    }
+
 private:
     template <DTypeName DT>
     void kernel_(OpContext &ctx, const TensorVec &inputs, TensorPtr &output) {
+        using Kernel = BinaryOpKernel<OpKernelType, DT>;
+        if (!Kernel::supported) {
+            ctx.error(this) << Kernel::unsupported_error();
+            return;
+        }
+
         size_t n = inputs[0]->desc().numel();
-        auto kernel = BinaryOpKernel<OpKernelType, DT>(this, ctx);
         auto a = inputs[0]->as<DT>();
         auto b = inputs[1]->as<DT>();
-        auto c = output->as<DT>();
+        auto c = output->as<Kernel::output_dtype>();
+
+        if (Kernel::has_domain_check && ctx.domain_checks()) {
+            if (any_out_of_domain<Kernel>(b)) {
+                ctx.error(this) << Kernel::domain_error();
+                return;
+            }
+        }
 
         auto a_ptr = a->data_ptr(), b_ptr = b->data_ptr();
         auto c_ptr = c->mutable_data_ptr();
@@ -309,11 +492,28 @@ private:
 
 #define BINARY_KERNEL_CASE(a_condition, b_condition, a_index, b_index) else if (a_condition && b_condition) { \
     for (ssize_t i = 0; i < n; ++i) { \
-        kernel.compute(ctx, this, a_index, b_index, c_ptr[i]); \
+        Kernel::compute(a_index, b_index, c_ptr[i]); \
     } \
 }
 
-        if (false) {}
+        if (DType<DT>::is_reduced_precision && a_con && b_con) {
+            using FloatKernel = BinaryOpKernel<OpKernelType, DTypeName::Float32>;
+            float a_buf[ReducedPrecisionBlock] = {}, b_buf[ReducedPrecisionBlock] = {};
+            typename FloatKernel::output_type c_buf[ReducedPrecisionBlock];
+            for (ssize_t i = 0; i < n; i += ReducedPrecisionBlock) {
+                ssize_t m = std::min<ssize_t>(ReducedPrecisionBlock, n - i);
+                try_convert_array(a_ptr + i, a_buf, m);
+                try_convert_array(b_ptr + i, b_buf, m);
+                for (ssize_t j = 0; j < ReducedPrecisionBlock; ++j) {
+                    FloatKernel::compute(a_buf[j], b_buf[j], c_buf[j]);
+                }
+                store_block(c_buf, c_ptr + i, m);
+            }
+        } else if (Kernel::is_comparison && a_con && b_con) {
+            compare_blocked_<Kernel, false>(a_ptr, b_ptr, c_ptr, n);
+        } else if (Kernel::is_comparison && a_con && b_sca) {
+            compare_blocked_<Kernel, true>(a_ptr, b_ptr, c_ptr, n);
+        }
         BINARY_KERNEL_CASE(a_con, b_con, a_ptr[i], b_ptr[i])
         BINARY_KERNEL_CASE(a_con, b_sca, a_ptr[i], b_ptr[0])
         BINARY_KERNEL_CASE(a_sca, b_con, a_ptr[0], b_ptr[i])
@@ -324,8 +524,24 @@ private:
         BINARY_KERNEL_CASE(a_sca, true,  a_ptr[0], b->elat(i))
         else {
             for (ssize_t i = 0; i < n; ++i) {
-                kernel.compute(ctx, this, a->elat(i), b->elat(i), c_ptr[i]);
+                Kernel::compute(a->elat(i), b->elat(i), c_ptr[i]);
+            }
+        }
+    }
+
+    // The comparisons write their 1-byte outputs through a local block (see ElemwiseBlock), so that they vectorize.
+    template <typename Kernel, bool BScalar>
+    static void compare_blocked_(const typename Kernel::cctype *a_ptr, const typename Kernel::cctype *b_ptr, typename Kernel::output_type *c_ptr, ssize_t n) {
+        ssize_t i = 0;
+        for (; i + ElemwiseBlock <= n; i += ElemwiseBlock) {
+            typename Kernel::output_type block[ElemwiseBlock];
+            for (ssize_t j = 0; j < ElemwiseBlock; ++j) {
+                Kernel::compute(a_ptr[i + j], b_ptr[BScalar ? 0 : i + j], block[j]);
             }
+            memcpy(c_ptr + i, block, sizeof(block));
+        }
+        for (; i < n; ++i) {
+            Kernel::compute(a_ptr[i], b_ptr[BScalar ? 0 : i], c_ptr[i]);
         }
     }
 };
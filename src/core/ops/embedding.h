@@ -0,0 +1,313 @@
+/*
+ * embedding.h
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#pragma once
+
+#include "core/op.h"
+#include "core/parallel.h"
+#include "core/ops/slice.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace ncg {
+
+namespace embedding_impl {
+
+// Shared with the index kernels of slice.h.
+using slice_impl::ColumnBlock;
+using slice_impl::flat_indices;
+using slice_impl::any_out_of_range;
+using slice_impl::nr_chunks;
+
+} /* !namespace embedding_impl */
+
+/*
+ * output[i..., :] = table[indices[i...], :], for a 2-D table and Int32 or Int64 indices of any shape. Unlike
+ * OpIndexSelect, the indices are checked, and the rows are copied whole.
+ */
+class OpEmbedding : public Op {
+public:
+    NCG_OP_DEF_NAME(OpEmbedding);
+
+    virtual void check_inputs(OpContext &ctx, const TensorVec &inputs) {
+        NCG_OP_CHECK_NR_INPUTS(ctx, inputs, 2);
+        NCG_OP_CHECK_INPUT_DIM(ctx, inputs, 0, 2);
+        NCG_OP_CHECK_INPUT_DTYPE_INT(ctx, inputs, 1);
+        if (inputs[1]->desc().dim() + 1 > TensorMaxDim) {
+            ctx.error(this) << "Too many dimensions in the indices of " << this->op_name() << ".";
+        }
+    }
+
+    virtual TensorVec compute(OpContext &ctx, const TensorVec &inputs) {
+        auto indices = embedding_impl::flat_indices(inputs[1]);
+        if (embedding_impl::any_out_of_range(indices, inputs[0]->desc().shape(0))) {
+            ctx.error(this) << "Embedding index out of range [0, " << inputs[0]->desc().shape(0) << ").";
+            return {};
+        }
+
+        auto shape = inputs[1]->desc().shape_vec();
+        shape.push_back(inputs[0]->desc().shape(1));
+        auto output = empty(inputs[0]->desc().dtype(), shape);
+
+#define EMBEDDING_DTYPE_CASE(dtype_name) kernel_<DTypeName::dtype_name>(inputs[0]->template as<DTypeName::dtype_name>(), indices, output->template as<DTypeName::dtype_name>())
+NCG_DTYPE_SWITCH_ALL(inputs[0]->desc().dtype(), EMBEDDING_DTYPE_CASE);
+#undef EMBEDDING_DTYPE_CASE
+
+        return {output};
+    }
+
+private:
+    template <DTypeName DT>
+    void kernel_(const TensorImpl<DT> *table, const std::vector<int64_t> &indices, TensorImpl<DT> *output) {
+        using cctype = typename DType<DT>::cctype;
+        ssize_t n = indices.size(), D = table->desc().shape(1);
+        auto output_ptr = output->mutable_data_ptr();
+
+        if (!table->desc().is_contiguous()) {
+            for (ssize_t i = 0; i < n; ++i) {
+                for (ssize_t j = 0; j < D; ++j) {
+                    output_ptr[i * D + j] = table->elat(indices[i] * D + j);
+                }
+            }
+            return;
+        }
+
+        auto table_ptr = table->data_ptr();
+        ssize_t nr_chunks = embedding_impl::nr_chunks(n, n * D);
+        parallel_for(nr_chunks, nr_chunks, [&](size_t t) {
+            for (ssize_t i = n * t / nr_chunks; i < n * (t + 1) / nr_chunks; ++i) {
+                memcpy(output_ptr + i * D, table_ptr + indices[i] * D, sizeof(cctype) * D);
+            }
+        });
+    }
+};
+
+/*
+ * The gradient of OpEmbedding with respect to the table, as a row-sparse tensor: the inputs are the output
+ * gradient {..., D} and the indices {...}; the outputs are the sorted distinct indices {U} (Int64) and the sums
+ * of the gradient rows of each of them {U, D} (a segment sum over the indices sorted with their positions).
+ * The sums are in the order of the positions, so that the results do not depend on the number of threads.
+ */
+class OpEmbeddingGrad : public Op {
+public:
+    NCG_OP_DEF_NAME(OpEmbeddingGrad);
+
+    virtual void check_inputs(OpContext &ctx, const TensorVec &inputs) {
+        NCG_OP_CHECK_NR_INPUTS(ctx, inputs, 2);
+        NCG_OP_CHECK_INPUT_DTYPE_INT(ctx, inputs, 1);
+
+        const auto &grad = inputs[0]->desc(), &indices = inputs[1]->desc();
+        bool valid = grad.dim() == indices.dim() + 1;
+        for (ssize_t i = 0; valid && i < indices.dim(); ++i) {
+            valid = grad.shape(i) == indices.shape(i);
+        }
+        if (!valid) {
+            ctx.error(this) << "Invalid shape: " << grad.shape_vec() << " (gradient) vs. " << indices.shape_vec() << " (indices).";
+        }
+    }
+
+    virtual TensorVec compute(OpContext &ctx, const TensorVec &inputs) {
+        auto indices = embedding_impl::flat_indices(inputs[1]);
+        ssize_t n = indices.size();
+
+        std::vector<std::pair<int64_t, int64_t>> order(n);
+        for (ssize_t i = 0; i < n; ++i) {
+            order[i] = {indices[i], i};
+        }
+        std::sort(order.begin(), order.end());
+
+        // The start of each run of equal indices in the sorted order.
+        std::vector<int64_t> segments;
+        for (ssize_t i = 0; i < n; ++i) {
+            if (i == 0 || order[i].first != order[i - 1].first) {
+                segments.push_back(i);
+            }
+        }
+        ssize_t nr_segments = segments.size();
+        segments.push_back(n);
+
+        auto unique = empty(DTypeName::Int64, {nr_segments});
+        auto unique_ptr = unique->template as<DTypeName::Int64>()->mutable_data_ptr();
+        for (ssize_t u = 0; u < nr_segments; ++u) {
+            unique_ptr[u] = order[segments[u]].first;
+        }
+
+        ssize_t D = inputs[0]->desc().shape(inputs[0]->desc().dim() - 1);
+        auto rows = empty(inputs[0]->desc().dtype(), {nr_segments, D});
+
+#define EMBEDDING_GRAD_DTYPE_CASE(dtype_name) kernel_<DTypeName::dtype_name>(inputs[0], order, segments, rows)
+NCG_DTYPE_SWITCH_ALL(inputs[0]->desc().dtype(), EMBEDDING_GRAD_DTYPE_CASE);
+#undef EMBEDDING_GRAD_DTYPE_CASE
+
+        return {unique, rows};
+    }
+
+private:
+    template <DTypeName DT>
+    void kernel_(const TensorPtr &grad_tensor, const std::vector<std::pair<int64_t, int64_t>> &order, const std::vector<int64_t> &segments, TensorPtr &rows) {
+        using cctype = typename DType<DT>::cctype;
+        using compute_type = typename DType<DT>::compute_type;
+        using embedding_impl::ColumnBlock;
+
+        auto grad = grad_tensor->template as<DT>();
+        grad->make_contiguous();
+        const cctype *grad_ptr = grad->data_ptr();
+        cctype *rows_ptr = rows->template as<DT>()->mutable_data_ptr();
+        ssize_t nr_segments = segments.size() - 1, D = rows->desc().shape(1);
+
+        // Each chunk of segments writes its own output rows: no atomics and no locks.
+        ssize_t nr_chunks = embedding_impl::nr_chunks(nr_segments, order.size() * D);
+        parallel_for(nr_chunks, nr_chunks, [&](size_t t) {
+            for (ssize_t u = nr_segments * t / nr_chunks; u < nr_segments * (t + 1) / nr_chunks; ++u) {
+                for (ssize_t j0 = 0; j0 < D; j0 += ColumnBlock) {
+                    ssize_t width = std::min(ColumnBlock, D - j0);
+                    compute_type acc[ColumnBlock] = {};
+                    for (int64_t p = segments[u]; p < segments[u + 1]; ++p) {
+                        const cctype *src = grad_ptr + order[p].second * D + j0;
+                        if (width == ColumnBlock) {
+                            // A constant trip count, so that the sum vectorizes at -O2.
+                            for (ssize_t j = 0; j < ColumnBlock; ++j) acc[j] += src[j];
+                        } else {
+                            for (ssize_t j = 0; j < width; ++j) acc[j] += src[j];
+                        }
+                    }
+                    for (ssize_t j = 0; j < width; ++j) {
+                        rows_ptr[u * D + j0 + j] = acc[j];
+                    }
+                }
+            }
+        });
+    }
+};
+
+class OpSparseRowsToDenseDesc : public OpDesc {
+public:
+    OpSparseRowsToDenseDesc() : nr_rows(0) {}
+    OpSparseRowsToDenseDesc(ssize_t nr_rows) : nr_rows(nr_rows) {}
+    virtual ~OpSparseRowsToDenseDesc() = default;
+
+    virtual void pickle(NCGPickler &pickler) const {
+        pickler.write(static_cast<int64_t>(nr_rows));
+    }
+    virtual void unpickle(NCGUnpickler &unpickler) {
+        nr_rows = static_cast<ssize_t>(unpickler.read_int64());
+    }
+
+    ssize_t nr_rows;
+};
+
+/* Scatters the (indices {U}, rows {U, D}) of OpEmbeddingGrad into a dense {nr_rows, D} tensor of zeros. */
+class OpSparseRowsToDense : public Op {
+public:
+    NCG_OP_DEF_NAME(OpSparseRowsToDense);
+
+    virtual void check_inputs(OpContext &ctx, const TensorVec &inputs) {
+        NCG_OP_CHECK_NR_INPUTS(ctx, inputs, 2);
+        NCG_OP_CHECK_INPUT_DTYPE_INT(ctx, inputs, 0);
+        NCG_OP_CHECK_INPUT_DIM(ctx, inputs, 0, 1);
+        NCG_OP_CHECK_INPUT_DIM(ctx, inputs, 1, 2);
+        if (inputs[0]->desc().shape(0) != inputs[1]->desc().shape(0)) {
+            ctx.error(this) << "Invalid shape: " << inputs[0]->desc().shape_vec() << " (indices) vs. " << inputs[1]->desc().shape_vec() << " (rows).";
+        }
+    }
+
+    virtual TensorVec compute(OpContext &ctx, const TensorVec &inputs) {
+        ssize_t nr_rows = this->template desc<OpSparseRowsToDenseDesc>().nr_rows;
+        auto indices = embedding_impl::flat_indices(inputs[0]);
+        if (embedding_impl::any_out_of_range(indices, nr_rows)) {
+            ctx.error(this) << "Row index out of range [0, " << nr_rows << ").";
+            return {};
+        }
+
+        auto output = zeros(inputs[1]->desc().dtype(), {nr_rows, inputs[1]->desc().shape(1)});
+#define SPARSE_ROWS_TO_DENSE_DTYPE_CASE(dtype_name) kernel_<DTypeName::dtype_name>(inputs[1]->template as<DTypeName::dtype_name>(), indices, output->template as<DTypeName::dtype_name>())
+NCG_DTYPE_SWITCH_ALL(inputs[1]->desc().dtype(), SPARSE_ROWS_TO_DENSE_DTYPE_CASE);
+#undef SPARSE_ROWS_TO_DENSE_DTYPE_CASE
+        return {output};
+    }
+
+private:
+    template <DTypeName DT>
+    void kernel_(const TensorImpl<DT> *rows, const std::vector<int64_t> &indices, TensorImpl<DT> *output) {
+        ssize_t D = rows->desc().shape(1);
+        auto output_ptr = output->mutable_data_ptr();
+        // Repeated indices are summed.
+        for (ssize_t u = 0; u < indices.size(); ++u) {
+            for (ssize_t j = 0; j < D; ++j) {
+                output_ptr[indices[u] * D + j] += rows->elat(u * D + j);
+            }
+        }
+    }
+};
+
+namespace embedding_impl {
+
+template <DTypeName DT>
+void add_rows_inplace_(TensorImpl<DT> *table, const std::vector<int64_t> &indices, TensorImpl<DT> *rows, double alpha) {
+    using cctype = typename DType<DT>::cctype;
+    using compute_type = typename DType<DT>::compute_type;
+
+    rows->make_contiguous();
+    const cctype *rows_ptr = rows->data_ptr();
+    cctype *table_ptr = table->mutable_data_ptr();
+    ssize_t D = table->desc().shape(1);
+    compute_type scale = static_cast<compute_type>(alpha);
+
+    // Distinct indices (as from OpEmbeddingGrad) write distinct rows, so that the chunks do not race.
+    ssize_t n = indices.size(), nr_chunks = embedding_impl::nr_chunks(n, n * D);
+    parallel_for(nr_chunks, nr_chunks, [&](size_t t) {
+        for (ssize_t u = n * t / nr_chunks; u < n * (t + 1) / nr_chunks; ++u) {
+            cctype *dst = table_ptr + indices[u] * D;
+            const cctype *src = rows_ptr + u * D;
+            ssize_t j = 0;
+            // Whole blocks through a local buffer, so that the update vectorizes at -O2 (no alias check).
+            for (; j + ColumnBlock <= D; j += ColumnBlock) {
+                cctype out[ColumnBlock];
+                for (ssize_t k = 0; k < ColumnBlock; ++k) {
+                    out[k] = static_cast<compute_type>(dst[j + k]) + scale * static_cast<compute_type>(src[j + k]);
+                }
+                memcpy(dst + j, out, sizeof(out));
+            }
+            for (; j < D; ++j) {
+                dst[j] = static_cast<compute_type>(dst[j]) + scale * static_cast<compute_type>(src[j]);
+            }
+        }
+    });
+}
+
+} /* !namespace embedding_impl */
+
+/*
+ * table[indices[u], :] += alpha * rows[u, :] for a floating-point table, in place; the only kernel writing to an existing tensor. It is for the
+ * row-sparse optimizer updates of the Session variables (see GOpAssignAddRows), which make sure that nothing else
+ * reads the table. The indices must be distinct (e.g., the ones of OpEmbeddingGrad); returns false, without
+ * touching the table, on invalid inputs.
+ */
+inline bool add_rows_inplace(TensorPtr &table, const TensorPtr &indices, const TensorPtr &rows, double alpha) {
+    if (!is_float_dtype(table->desc().dtype()) || table->desc().dim() != 2 || rows->desc().dim() != 2 || indices->desc().dim() != 1 ||
+            table->desc().dtype() != rows->desc().dtype() || table->desc().shape(1) != rows->desc().shape(1) ||
+            indices->desc().shape(0) != rows->desc().shape(0) ||
+            (indices->desc().dtype() != DTypeName::Int32 && indices->desc().dtype() != DTypeName::Int64)) {
+        return false;
+    }
+    auto flat = embedding_impl::flat_indices(indices);
+    if (embedding_impl::any_out_of_range(flat, table->desc().shape(0))) {
+        return false;
+    }
+
+    table->make_contiguous();
+#define ADD_ROWS_DTYPE_CASE(dtype_name) embedding_impl::add_rows_inplace_<DTypeName::dtype_name>(table->template as<DTypeName::dtype_name>(), flat, rows->template as<DTypeName::dtype_name>(), alpha)
+NCG_DTYPE_SWITCH_ALL(table->desc().dtype(), ADD_ROWS_DTYPE_CASE);
+#undef ADD_ROWS_DTYPE_CASE
+    table->storage()->mark_modified();
+    return true;
+}
+
+} /* !namespace ncg */
@@ -17,6 +17,15 @@ public:
     OpMatMulDesc(bool transpose_a, bool transpose_b) : transpose_a(transpose_a), transpose_b(transpose_b) {}
     virtual ~OpMatMulDesc() = default;
 
+    virtual void pickle(NCGPickler &pickler) const {
+        pickler.write(static_cast<int64_t>(transpose_a));
+        pickler.write(static_cast<int64_t>(transpose_b));
+    }
+    virtual void unpickle(NCGUnpickler &unpickler) {
+        transpose_a = unpickler.read_int64() != 0;
+        transpose_b = unpickler.read_int64() != 0;
+    }
+
     bool transpose_a, transpose_b;
 };
 
@@ -29,6 +38,10 @@ public:
         NCG_OP_CHECK_COMPATIBLE_DTYPE(ctx, inputs);
         NCG_OP_CHECK_INPUT_DIM(ctx, inputs, 0, 2);
         NCG_OP_CHECK_INPUT_DIM(ctx, inputs, 1, 2);
+        if (is_int8_dtype(inputs[0]->desc().dtype())) {
+            ctx.error(this) << "OpMatMul does not support 8-bit inputs (the products overflow the output dtype); use quantized_matmul instead.";
+            return;
+        }
 
         const auto &desc = this->template desc<OpMatMulDesc>();
         ssize_t k1 = !desc.transpose_a ? inputs[0]->desc().shape(1) : inputs[0]->desc().shape(0);
@@ -44,7 +57,16 @@ public:
         ssize_t N = !desc.transpose_a ? a->desc().shape(0) : a->desc().shape(1);
         ssize_t M = !desc.transpose_b ? b->desc().shape(1) : b->desc().shape(0);
 
-        auto output = zeros(inputs[0]->desc().dtype(), {N, M});
+        auto dtype = inputs[0]->desc().dtype();
+        if (is_reduced_precision_dtype(dtype)) {
+            // Multiply and accumulate in float32, store the result in 16 bits.
+            auto a_float = cast(a, DTypeName::Float32), b_float = cast(b, DTypeName::Float32);
+            auto output_float = zeros(DTypeName::Float32, {N, M});
+            kernel_(ctx, a_float->template as<DTypeName::Float32>(), b_float->template as<DTypeName::Float32>(), output_float->template as<DTypeName::Float32>());
+            return {cast(output_float, dtype)};
+        }
+
+        auto output = zeros(dtype, {N, M});
 #define MATMUL_DTYPE_CASE(dtype_name) kernel_(ctx, inputs[0]->template as<DTypeName::dtype_name>(), inputs[1]->template as<DTypeName::dtype_name>(), output->template as<DTypeName::dtype_name>());
 NCG_DTYPE_SWITCH_ALL(inputs[0]->desc().dtype(), MATMUL_DTYPE_CASE);
 #undef MATMUL_DTYPE_CASE
@@ -0,0 +1,314 @@
+/*
+ * quantize.h
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#pragma once
+
+#include "core/op.h"
+#include "core/quantization.h"
+
+namespace ncg {
+
+/*
+ * The quantized kernels work on fixed-size blocks, so that GCC vectorizes them at -O2 (see half.cc); the remainders
+ * are processed element by element.
+ */
+const ssize_t QuantizeBlock = 16;
+
+/* dst = saturate_int8(src * multiplier + zero_point); quantizes (multiplier = 1 / scale) and requantizes. */
+template <typename T>
+inline void quantize_array(const T *src, int8_t *dst, ssize_t n, float multiplier, float zero_point) {
+    ssize_t i = 0;
+    for (; i + QuantizeBlock <= n; i += QuantizeBlock) {
+        // NB: the int8 stores may alias src; converting into a local block keeps the loop vectorizable.
+        int8_t block[QuantizeBlock];
+        for (ssize_t j = 0; j < QuantizeBlock; ++j) {
+            block[j] = saturate_int8(static_cast<float>(src[i + j]) * multiplier + zero_point);
+        }
+        memcpy(dst + i, block, sizeof(block));
+    }
+    for (; i < n; ++i) {
+        dst[i] = saturate_int8(static_cast<float>(src[i]) * multiplier + zero_point);
+    }
+}
+
+/* dst = (src - zero_point) * scale. */
+template <typename T>
+inline void dequantize_array(const T *src, float *dst, ssize_t n, float scale, float zero_point) {
+    ssize_t i = 0;
+    for (; i + QuantizeBlock <= n; i += QuantizeBlock) {
+        for (ssize_t j = 0; j < QuantizeBlock; ++j) {
+            dst[i + j] = (static_cast<float>(src[i + j]) - zero_point) * scale;
+        }
+    }
+    for (; i < n; ++i) {
+        dst[i] = (static_cast<float>(src[i]) - zero_point) * scale;
+    }
+}
+
+class OpQuantizeDesc : public OpDesc {
+public:
+    OpQuantizeDesc() : params() {}
+    OpQuantizeDesc(const QuantizationParams &params) : params(params) {}
+    virtual ~OpQuantizeDesc() = default;
+
+    virtual void pickle(NCGPickler &pickler) const {
+        params.pickle(pickler);
+    }
+    virtual void unpickle(NCGUnpickler &unpickler) {
+        params = QuantizationParams(unpickler);
+    }
+
+    QuantizationParams params;
+};
+
+/* Float tensor -> quantized Int8 tensor; the values out of the range of the params saturate. */
+class OpQuantize : public Op {
+public:
+    NCG_OP_DEF_NAME(OpQuantize);
+
+    virtual void check_inputs(OpContext &ctx, const TensorVec &inputs) {
+        NCG_OP_CHECK_NR_INPUTS(ctx, inputs, 1);
+        if (!is_float_dtype(inputs[0]->desc().dtype())) {
+            ctx.error(this) << "OpQuantize requires a floating-point input, but got " << get_dtype_name(inputs[0]->desc().dtype()) << ".";
+            return;
+        }
+        if (!this->template desc<OpQuantizeDesc>().params.valid()) {
+            ctx.error(this) << "Invalid quantization params: " << this->template desc<OpQuantizeDesc>().params << ".";
+        }
+    }
+
+    virtual TensorVec compute(OpContext &ctx, const TensorVec &inputs) {
+        const auto &params = this->template desc<OpQuantizeDesc>().params;
+        auto input = inputs[0];
+        if (input->desc().dtype() != DTypeName::Float32 || !input->desc().is_contiguous()) {
+            input = cast(input, DTypeName::Float32);
+        }
+        auto output = empty_like(input->desc(), DTypeName::Int8);
+
+        quantize_array(
+            input->template as<DTypeName::Float32>()->data_ptr(), output->template as<DTypeName::Int8>()->mutable_data_ptr(),
+            input->desc().numel(), 1.0f / params.scale, params.zero_point
+        );
+
+        output->set_quantization(params);
+        return {output};
+    }
+};
+
+/* Quantized Int8 or Int32 tensor -> Float32 tensor. */
+class OpDequantize : public Op {
+public:
+    NCG_OP_DEF_NAME(OpDequantize);
+
+    virtual void check_inputs(OpContext &ctx, const TensorVec &inputs) {
+        NCG_OP_CHECK_NR_INPUTS(ctx, inputs, 1);
+        auto dtype = inputs[0]->desc().dtype();
+        if (dtype != DTypeName::Int8 && dtype != DTypeName::Int32) {
+            ctx.error(this) << "OpDequantize requires an Int8 or Int32 input, but got " << get_dtype_name(dtype) << ".";
+            return;
+        }
+        if (!inputs[0]->is_quantized()) {
+            ctx.error(this) << "OpDequantize requires a quantized input.";
+        }
+    }
+
+    virtual TensorVec compute(OpContext &ctx, const TensorVec &inputs) {
+        auto output = empty_like(inputs[0]->desc(), DTypeName::Float32);
+        if (inputs[0]->desc().dtype() == DTypeName::Int8) {
+            kernel_(inputs[0]->template as<DTypeName::Int8>(), output->template as<DTypeName::Float32>());
+        } else {
+            kernel_(inputs[0]->template as<DTypeName::Int32>(), output->template as<DTypeName::Float32>());
+        }
+        return {output};
+    }
+
+private:
+    template <DTypeName DT>
+    void kernel_(const TensorImpl<DT> *a, TensorImpl<DTypeName::Float32> *b) {
+        const auto params = a->quantization();
+        ssize_t n = a->desc().numel();
+        float *dst = b->mutable_data_ptr();
+
+        if (a->desc().is_contiguous()) {
+            dequantize_array(a->data_ptr(), dst, n, params.scale, params.zero_point);
+        } else {
+            for (ssize_t i = 0; i < n; ++i) {
+                dst[i] = (static_cast<float>(a->elat(i)) - params.zero_point) * params.scale;
+            }
+        }
+    }
+};
+
+class OpQuantizedMatMulDesc : public OpDesc {
+public:
+    OpQuantizedMatMulDesc() : dtype(DTypeName::Float32), output(), transpose_b(false) {}
+    OpQuantizedMatMulDesc(DTypeName dtype, const QuantizationParams &output = QuantizationParams(), bool transpose_b = false) :
+        dtype(dtype), output(output), transpose_b(transpose_b) {}
+    virtual ~OpQuantizedMatMulDesc() = default;
+
+    virtual void pickle(NCGPickler &pickler) const {
+        pickler.write(static_cast<int64_t>(dtype));
+        output.pickle(pickler);
+        pickler.write(static_cast<int64_t>(transpose_b));
+    }
+    virtual void unpickle(NCGUnpickler &unpickler) {
+        dtype = static_cast<DTypeName>(unpickler.read_int64());
+        output = QuantizationParams(unpickler);
+        transpose_b = unpickler.read_int64() != 0;
+    }
+
+    // Int32: the raw accumulators; Float32: the dequantized products; Int8: requantized with the output params.
+    DTypeName dtype;
+    QuantizationParams output;
+    // If set, b is [M, K], which is the layout the kernel reads (otherwise b is transposed first).
+    bool transpose_b;
+};
+
+/*
+ * a (Int8, [N, K]) x b (Int8, [K, M]), both quantized, with an optional Int32 bias ([M]) expressed in units of
+ * a.scale * b.scale. The products are accumulated in int32; the zero points are folded in afterwards with the row
+ * sums of a and the column sums of b.
+ */
+class OpQuantizedMatMul : public Op {
+public:
+    NCG_OP_DEF_NAME(OpQuantizedMatMul);
+
+    virtual void check_inputs(OpContext &ctx, const TensorVec &inputs) {
+        NCG_OP_CHECK_NR_INPUTS2(ctx, inputs, 2, 3);
+        NCG_OP_CHECK_INPUT_DTYPE(ctx, inputs, 0, Int8);
+        NCG_OP_CHECK_INPUT_DTYPE(ctx, inputs, 1, Int8);
+        NCG_OP_CHECK_INPUT_DIM(ctx, inputs, 0, 2);
+        NCG_OP_CHECK_INPUT_DIM(ctx, inputs, 1, 2);
+
+        const auto &desc = this->template desc<OpQuantizedMatMulDesc>();
+        if (desc.dtype != DTypeName::Int8 && desc.dtype != DTypeName::Int32 && desc.dtype != DTypeName::Float32) {
+            ctx.error(this) << "OpQuantizedMatMul outputs Int8, Int32 or Float32, but got " << get_dtype_name(desc.dtype) << ".";
+            return;
+        }
+        if (desc.dtype == DTypeName::Int8 && !desc.output.valid()) {
+            ctx.error(this) << "OpQuantizedMatMul requires the output quantization params for an Int8 output.";
+            return;
+        }
+        if (!inputs[0]->is_quantized() || !inputs[1]->is_quantized()) {
+            ctx.error(this) << "OpQuantizedMatMul requires quantized inputs.";
+            return;
+        }
+
+        ssize_t k2 = !desc.transpose_b ? inputs[1]->desc().shape(0) : inputs[1]->desc().shape(1);
+        ssize_t M = !desc.transpose_b ? inputs[1]->desc().shape(1) : inputs[1]->desc().shape(0);
+        if (inputs[0]->desc().shape(1) != k2) {
+            ctx.error(this) << "Invalid shape: " << inputs[0]->desc().shape_vec() << " vs. " << inputs[1]->desc().shape_vec() << ".";
+            return;
+        }
+        if (inputs.size() == 3) {
+            NCG_OP_CHECK_INPUT_DTYPE(ctx, inputs, 2, Int32);
+            NCG_OP_CHECK_INPUT_VECTOR(ctx, inputs, 2);
+            if (inputs[2]->desc().shape(0) != M) {
+                ctx.error(this) << "Invalid bias shape: " << inputs[2]->desc().shape_vec() << " for " << M << " output columns.";
+            }
+        }
+    }
+
+    virtual TensorVec compute(OpContext &ctx, const TensorVec &inputs) {
+        const auto &desc = this->template desc<OpQuantizedMatMulDesc>();
+        auto a = inputs[0]->template as<DTypeName::Int8>(), b = inputs[1]->template as<DTypeName::Int8>();
+        ssize_t N = a->desc().shape(0), K = a->desc().shape(1);
+        ssize_t M = !desc.transpose_b ? b->desc().shape(1) : b->desc().shape(0);
+
+        const auto qa = a->quantization(), qb = b->quantization();
+        a->make_contiguous();
+        b->make_contiguous();
+
+        // The kernel takes b as [M, K], so that both operands of the dot products are contiguous.
+        std::vector<int8_t> bt_buf;
+        const int8_t *bt = b->data_ptr();
+        if (!desc.transpose_b) {
+            bt_buf.resize(M * K);
+            for (ssize_t k = 0; k < K; ++k) {
+                for (ssize_t j = 0; j < M; ++j) {
+                    bt_buf[j * K + k] = bt[k * M + j];
+                }
+            }
+            bt = bt_buf.data();
+        }
+
+        auto acc = empty(DTypeName::Int32, {N, M});
+        int32_t *acc_ptr = acc->template as<DTypeName::Int32>()->mutable_data_ptr();
+        gemm_(a->data_ptr(), bt, acc_ptr, N, M, K);
+
+        // sum_k (a - za) (b - zb) = sum_k a b - za sum_k b - zb sum_k a + K za zb.
+        std::vector<int32_t> col_offset(M, K * qa.zero_point * qb.zero_point);
+        for (ssize_t j = 0; j < M; ++j) {
+            col_offset[j] -= qa.zero_point * row_sum_(bt + j * K, K);
+        }
+        if (inputs.size() == 3) {
+            auto bias = inputs[2]->template as<DTypeName::Int32>();
+            for (ssize_t j = 0; j < M; ++j) {
+                col_offset[j] += bias->elat(j);
+            }
+        }
+        for (ssize_t i = 0; i < N; ++i) {
+            int32_t row_offset = qb.zero_point * row_sum_(a->data_ptr() + i * K, K);
+            for (ssize_t j = 0; j < M; ++j) {
+                acc_ptr[i * M + j] += col_offset[j] - row_offset;
+            }
+        }
+
+        QuantizationParams acc_params(qa.scale * qb.scale, 0);
+        if (desc.dtype == DTypeName::Int32) {
+            acc->set_quantization(acc_params);
+            return {acc};
+        }
+
+        auto output = empty(desc.dtype, {N, M});
+        if (desc.dtype == DTypeName::Float32) {
+            dequantize_array(acc_ptr, output->template as<DTypeName::Float32>()->mutable_data_ptr(), N * M, acc_params.scale, 0);
+        } else {
+            // Requantize with a float multiplier.
+            quantize_array(
+                acc_ptr, output->template as<DTypeName::Int8>()->mutable_data_ptr(),
+                N * M, acc_params.scale / desc.output.scale, desc.output.zero_point
+            );
+            output->set_quantization(desc.output);
+        }
+        return {output};
+    }
+
+private:
+    static int32_t row_sum_(const int8_t *a, ssize_t K) {
+        int32_t sum = 0;
+        for (ssize_t k = 0; k < K; ++k) {
+            sum += a[k];
+        }
+        return sum;
+    }
+
+    /* c = a x bt^T: a is [N, K], bt is [M, K]. */
+    static void gemm_(const int8_t *a, const int8_t *bt, int32_t *c, ssize_t N, ssize_t M, ssize_t K) {
+        for (ssize_t i = 0; i < N; ++i) {
+            const int8_t *a_row = a + i * K;
+            for (ssize_t j = 0; j < M; ++j) {
+                const int8_t *b_row = bt + j * K;
+                int32_t sum = 0;
+                ssize_t k = 0;
+                for (; k + QuantizeBlock <= K; k += QuantizeBlock) {
+                    int32_t block_sum = 0;
+                    for (ssize_t kk = 0; kk < QuantizeBlock; ++kk) {
+                        block_sum += static_cast<int32_t>(a_row[k + kk]) * static_cast<int32_t>(b_row[k + kk]);
+                    }
+                    sum += block_sum;
+                }
+                for (; k < K; ++k) {
+                    sum += static_cast<int32_t>(a_row[k]) * static_cast<int32_t>(b_row[k]);
+                }
+                c[i * M + j] = sum;
+            }
+        }
+    }
+};
+
+} /* !namespace ncg */
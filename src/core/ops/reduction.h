@@ -27,6 +27,15 @@ public:
     OpReduceDesc(ssize_t axis = 0, bool keepdims = false) : axis(axis), keepdims(keepdims) {}
     virtual ~OpReduceDesc() = default;
 
+    virtual void pickle(NCGPickler &pickler) const {
+        pickler.write(static_cast<int64_t>(axis));
+        pickler.write(static_cast<int64_t>(keepdims));
+    }
+    virtual void unpickle(NCGUnpickler &unpickler) {
+        axis = static_cast<ssize_t>(unpickler.read_int64());
+        keepdims = unpickler.read_int64() != 0;
+    }
+
     ssize_t axis;
     bool keepdims;
 };
@@ -73,9 +82,9 @@ private:
 
         TensorPtr output_ptr, indices_ptr;
         if (ReduceType == ReduceType1::Min) {
-            output_ptr = fill(DT, output_shape, std::numeric_limits<typename DType<DT>::cctype>::max());
+            output_ptr = fill(DT, output_shape, static_cast<typename DType<DT>::compute_type>(std::numeric_limits<typename DType<DT>::cctype>::max()));
         } else {
-            output_ptr = fill(DT, output_shape, std::numeric_limits<typename DType<DT>::cctype>::lowest());
+            output_ptr = fill(DT, output_shape, static_cast<typename DType<DT>::compute_type>(std::numeric_limits<typename DType<DT>::cctype>::lowest()));
         }
         indices_ptr = empty(DTypeName::Int64, output_shape);
 
@@ -87,8 +96,10 @@ private:
         auto output_data_ptr = output->mutable_data_ptr();
         auto indices_data_ptr = indices->mutable_data_ptr();
 
-        const auto &input_default_stride = input->desc().get_default_stride();
-        const auto &output_default_stride = output->desc().get_default_stride();
+        ssize_t input_default_stride[TensorMaxDim];
+        input->desc().get_default_stride(input_default_stride);
+        ssize_t output_default_stride[TensorMaxDim];
+        output->desc().get_default_stride(output_default_stride);
         for (ssize_t i = 0; i < input->desc().numel(); ++i) {
             ssize_t j1, j2, j3;
             if (axis != 0) {
@@ -147,6 +158,14 @@ public:
 
         TensorVec outputs;
 
+        if (is_reduced_precision_dtype(input->desc().dtype())) {
+            // Accumulate in float32, store the result in 16 bits.
+            auto input_float = cast(input, DTypeName::Float32);
+            outputs = kernel_(ctx, input_float->template as<DTypeName::Float32>(), axis, desc.keepdims);
+            outputs[0] = cast(outputs[0], input->desc().dtype());
+            return outputs;
+        }
+
 #define REDUCE_DTYPE_CASE(dtype_name) outputs = kernel_(ctx, input->template as<DTypeName::dtype_name>(), axis, desc.keepdims)
 NCG_DTYPE_SWITCH_ALL(input->desc().dtype(), REDUCE_DTYPE_CASE);
 #undef REDUCE_DTYPE_CASE
@@ -177,8 +196,10 @@ private:
         bool input_con = input->desc().is_contiguous();
         auto output_data_ptr = output->mutable_data_ptr();
 
-        const auto &input_default_stride = input->desc().get_default_stride();
-        const auto &output_default_stride = output->desc().get_default_stride();
+        ssize_t input_default_stride[TensorMaxDim];
+        input->desc().get_default_stride(input_default_stride);
+        ssize_t output_default_stride[TensorMaxDim];
+        output->desc().get_default_stride(output_default_stride);
         for (ssize_t i = 0; i < input->desc().numel(); ++i) {
             ssize_t j1, j2, j3;
             if (axis != 0) {
@@ -199,11 +220,11 @@ private:
             }
 
             const auto input_val = input_con ? input_data_ptr[i] : input->elat(i);
-            if (ReduceType == ReduceType2::Sum) {
+            if constexpr (ReduceType == ReduceType2::Sum) {
                 output_data_ptr[j] += input_val;
-            } else if (ReduceType == ReduceType2::Mean) {
+            } else if constexpr (ReduceType == ReduceType2::Mean) {
                 output_data_ptr[j] += input_val / axis_size;
-            } else if (ReduceType == ReduceType2::Prod) {
+            } else if constexpr (ReduceType == ReduceType2::Prod) {
                 output_data_ptr[j] *= input_val;
             }
         }
@@ -19,6 +19,13 @@ public:
     OpReshapeDesc(const ShapeVec &shape) : shape(shape) {}
     virtual ~OpReshapeDesc() = default;
 
+    virtual void pickle(NCGPickler &pickler) const {
+        shape.pickle(pickler);
+    }
+    virtual void unpickle(NCGUnpickler &unpickler) {
+        shape = ShapeVec(unpickler);
+    }
+
     ShapeVec shape;
 };
 
@@ -73,7 +80,7 @@ public:
         int nr_total = 1;
         for (ssize_t i = 0; i < shape.size(); ++i) {
             if (shape[i] == -1) {
-                negative_idx = 0;
+                negative_idx = i;
             } else if (shape[i] == NewAxis) {
                 shape[i] = 1;
             } else if (shape[i] > 0) {
@@ -87,7 +94,7 @@ public:
 
         inputs[0]->make_contiguous();
         TensorDesc desc(input->desc().dtype(), shape);
-        TensorPtr output = tensor(desc, input->storage(), false);
+        TensorPtr output = tensor(desc, input->storage(), false, input->data_ptr_offset());
 
         return {output};
     }
@@ -99,6 +106,13 @@ public:
     OpPermuteDesc(const ShapeVec &axes) : axes(axes) {}
     virtual ~OpPermuteDesc() = default;
 
+    virtual void pickle(NCGPickler &pickler) const {
+        axes.pickle(pickler);
+    }
+    virtual void unpickle(NCGUnpickler &unpickler) {
+        axes = ShapeVec(unpickler);
+    }
+
     ShapeVec axes;
 };
 
@@ -128,10 +142,9 @@ public:
         auto output = tensor(input->desc(), input->storage(), false);
         auto &axes = this->template desc<OpPermuteDesc>().axes;
 
-        auto stride = input->desc().stride();
         for (ssize_t i = 0; i < input->desc().dim(); ++i) {
-            output->desc().stride(i) = input->desc().stride(axes[i]);
-            output->desc().shape(i) = input->desc().shape(axes[i]);
+            output->desc().set_stride(i, input->desc().stride(axes[i]));
+            output->desc().set_shape(i, input->desc().shape(axes[i]));
         }
 
         return {output};
@@ -144,6 +157,13 @@ public:
     OpExpandDesc(const ShapeVec &shape) : shape(shape) {}
     virtual ~OpExpandDesc() = default;
 
+    virtual void pickle(NCGPickler &pickler) const {
+        shape.pickle(pickler);
+    }
+    virtual void unpickle(NCGUnpickler &unpickler) {
+        shape = ShapeVec(unpickler);
+    }
+
     ShapeVec shape;
 };
 
@@ -176,8 +196,8 @@ public:
 
         for (ssize_t i = 0; i < input->desc().dim(); ++i) {
             if (shape[i] != input->desc().shape(i)) {
-                output->desc().shape(i) = shape[i];
-                output->desc().stride(i) = 0;
+                output->desc().set_shape(i, shape[i]);
+                output->desc().set_stride(i, 0);
             }
         }
 
@@ -191,6 +211,13 @@ public:
     OpSqueezeDesc(ssize_t axis) : axis(axis) {}
     virtual ~OpSqueezeDesc() = default;
 
+    virtual void pickle(NCGPickler &pickler) const {
+        pickler.write(static_cast<int64_t>(axis));
+    }
+    virtual void unpickle(NCGUnpickler &unpickler) {
+        axis = static_cast<ssize_t>(unpickler.read_int64());
+    }
+
     ssize_t axis;
 };
 
@@ -234,6 +261,13 @@ public:
     OpUnsqueezeDesc(ssize_t axis) : axis(axis) {}
     virtual ~OpUnsqueezeDesc() = default;
 
+    virtual void pickle(NCGPickler &pickler) const {
+        pickler.write(static_cast<int64_t>(axis));
+    }
+    virtual void unpickle(NCGUnpickler &unpickler) {
+        axis = static_cast<ssize_t>(unpickler.read_int64());
+    }
+
     ssize_t axis;
 };
 
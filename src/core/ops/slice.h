@@ -8,15 +8,101 @@
 #pragma once
 
 #include "core/op.h"
+#include "core/parallel.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
 
 namespace ncg {
 
+namespace slice_impl {
+
+// Below this many copied or summed elements, the kernels run on a single thread.
+const ssize_t ParallelMinWork = 1 << 16;
+// The rows are summed in blocks of this many columns, through a local buffer.
+const ssize_t ColumnBlock = 64;
+
+template <DTypeName IndexDT>
+std::vector<int64_t> flat_indices(const TensorImpl<IndexDT> *indices) {
+    std::vector<int64_t> result(indices->desc().numel());
+    if (indices->desc().is_contiguous()) {
+        auto indices_ptr = indices->data_ptr();
+        for (ssize_t i = 0; i < result.size(); ++i) {
+            result[i] = indices_ptr[i];
+        }
+    } else {
+        for (ssize_t i = 0; i < result.size(); ++i) {
+            result[i] = indices->elat(i);
+        }
+    }
+    return result;
+}
+
+inline std::vector<int64_t> flat_indices(const TensorPtr &indices) {
+    if (indices->desc().dtype() == DTypeName::Int32) {
+        return flat_indices(indices->template as<DTypeName::Int32>());
+    }
+    return flat_indices(indices->template as<DTypeName::Int64>());
+}
+
+inline bool any_out_of_range(const std::vector<int64_t> &indices, int64_t upper) {
+    // Branch-free, as in any_out_of_domain.
+    int bad = 0;
+    for (ssize_t i = 0; i < indices.size(); ++i) {
+        bad |= indices[i] < 0 || indices[i] >= upper;
+    }
+    return bad != 0;
+}
+
+// Splits [0, n) into chunks for parallel_for: one chunk per worker if there is enough work, else a single one.
+inline ssize_t nr_chunks(ssize_t n, ssize_t work) {
+    return work >= ParallelMinWork ? std::max<ssize_t>(1, std::min<ssize_t>(n, get_kernel_workers())) : 1;
+}
+
+// A shape seen as {outer, shape[axis], inner}, so that the kernels index with products instead of divisions.
+struct AxisSplit {
+    ssize_t outer, size, inner;
+};
+
+inline AxisSplit split_axis(const TensorDesc &desc, ssize_t axis) {
+    AxisSplit split{1, desc.shape(axis), 1};
+    for (ssize_t i = 0; i < axis; ++i) split.outer *= desc.shape(i);
+    for (ssize_t i = axis + 1; i < desc.dim(); ++i) split.inner *= desc.shape(i);
+    return split;
+}
+
+// dst[0:n] += src[0:n]; whole blocks go through a local buffer, so that the sum vectorizes at -O2 (no alias check).
+template <typename T>
+inline void add_row(T *dst, const T *src, ssize_t n) {
+    ssize_t j = 0;
+    for (; j + ColumnBlock <= n; j += ColumnBlock) {
+        T out[ColumnBlock];
+        for (ssize_t k = 0; k < ColumnBlock; ++k) {
+            out[k] = dst[j + k] + src[j + k];
+        }
+        memcpy(dst + j, out, sizeof(out));
+    }
+    for (; j < n; ++j) {
+        dst[j] += src[j];
+    }
+}
+
+} /* !namespace slice_impl */
+
 class OpConcatDesc : public OpDesc {
 public:
     OpConcatDesc() : axis(0) {}
     OpConcatDesc(ssize_t axis) : axis(axis) {}
     virtual ~OpConcatDesc() = default;
 
+    virtual void pickle(NCGPickler &pickler) const {
+        pickler.write(static_cast<int64_t>(axis));
+    }
+    virtual void unpickle(NCGUnpickler &unpickler) {
+        axis = static_cast<ssize_t>(unpickler.read_int64());
+    }
+
     ssize_t axis;
 };
 
@@ -55,9 +141,14 @@ public:
             shape[axis] += inputs[i]->desc().shape(axis);
         }
 
+        auto view = adjacent_view_(inputs, axis, shape);
+        if (view != nullptr) {
+            return {view};
+        }
+
         auto output = empty(inputs[0]->desc().dtype(), shape);
 
-#define CONCAT_DTYPE_CASE(dtype) kernel_<DTypeName::dtype>(inputs, output);
+#define CONCAT_DTYPE_CASE(dtype) kernel_<DTypeName::dtype>(inputs, output->template as<DTypeName::dtype>(), axis);
 NCG_DTYPE_SWITCH_ALL(inputs[0]->desc().dtype(), CONCAT_DTYPE_CASE);
 #undef CONCAT_DTYPE_CASE
 
@@ -65,36 +156,96 @@ NCG_DTYPE_SWITCH_ALL(inputs[0]->desc().dtype(), CONCAT_DTYPE_CASE);
     }
 
 private:
-    template <DTypeName DT>
-    void kernel_(const TensorVec &inputs, TensorPtr output) {
-        std::vector<const TensorImpl<DT> *> inputs_dtype;
-        for (auto i : inputs) {
-            inputs_dtype.emplace_back(i->as<DT>());
+    /*
+     * The zero-copy mode: if the inputs are consecutive views of one storage along the axis, with the same strides
+     * (e.g., the outputs of OpSplit, or the rows of OpNarrow), the result is a view of that storage as well.
+     */
+    TensorPtr adjacent_view_(const TensorVec &inputs, ssize_t axis, const ShapeVec &shape) {
+        auto storage = inputs[0]->storage();
+        if (storage == nullptr) {
+            return nullptr;
         }
-        auto output_dtype = output->as<DT>();
-
-        auto axis = this->template desc<OpConcatDesc>().axis;
-        if (axis < 0) axis += inputs[0]->desc().dim();
 
-        ssize_t index = 0;
+        const auto &first = inputs[0]->desc();
+        ssize_t next_offset = inputs[0]->data_ptr_offset();
         for (ssize_t i = 0; i < inputs.size(); ++i) {
-            auto i_ptr = inputs_dtype[i]->data_ptr();
-            bool i_con = inputs_dtype[i]->desc().is_contiguous();
-            auto n = inputs[i]->desc().numel();
-
-            if (i_con) {
-                for (ssize_t j = 0; j < n; ++j) {
-                    ssize_t k = output->elindex(j) + index * output->desc().stride(axis);
-                    output_dtype->mutable_data_ptr()[k] = i_ptr[j];
+            const auto &desc = inputs[i]->desc();
+            if (inputs[i]->storage() != storage || inputs[i]->data_ptr_offset() != next_offset) {
+                return nullptr;
+            }
+            for (ssize_t j = 0; j < first.dim(); ++j) {
+                if (desc.stride(j) != first.stride(j)) {
+                    return nullptr;
                 }
+            }
+            next_offset += desc.shape(axis) * desc.stride(axis);
+        }
+
+        TensorDesc desc = first;
+        desc.set_shape(axis, shape[axis]);
+        return tensor(desc, storage, false, inputs[0]->data_ptr_offset());
+    }
+
+    /*
+     * Seen as {outer, shape[axis], inner}, the output is outer rows, each the concatenation of one contiguous slab
+     * of shape[axis] * inner elements per input. The slabs are copied with memcpy; if there are fewer rows than
+     * chunks, the slabs are split at equal byte offsets instead, so that large copies still use all the threads.
+     */
+    template <DTypeName DT>
+    void kernel_(const TensorVec &inputs, TensorImpl<DT> *output, ssize_t axis) {
+        using cctype = typename DType<DT>::cctype;
+        auto split = slice_impl::split_axis(output->desc(), axis);
+        ssize_t outer = split.outer, inner = split.inner, row = split.size * inner;
+        auto output_ptr = output->mutable_data_ptr();
+
+        std::vector<const cctype *> input_ptrs;
+        std::vector<ssize_t> slabs, offsets;
+        ssize_t offset = 0;
+        for (ssize_t i = 0; i < inputs.size(); ++i) {
+            auto input = inputs[i]->template as<DT>();
+            ssize_t slab = input->desc().shape(axis) * inner;
+            if (input->desc().is_contiguous()) {
+                input_ptrs.emplace_back(input->data_ptr());
             } else {
-                for (ssize_t j = 0; j < n; ++j) {
-                    ssize_t k = output->elindex(j) + index * output->desc().stride(axis);
-                    output_dtype->mutable_data_ptr()[k] = inputs_dtype[i]->elat(j);
+                // Strided inputs are copied element by element; they get no entry in the bulk copy below.
+                for (ssize_t o = 0; o < outer; ++o) {
+                    for (ssize_t j = 0; j < slab; ++j) {
+                        output_ptr[o * row + offset + j] = input->elat(o * slab + j);
+                    }
                 }
+                input_ptrs.emplace_back(nullptr);
             }
-            index += inputs[i]->desc().shape(axis);
+            slabs.emplace_back(slab);
+            offsets.emplace_back(offset);
+            offset += slab;
+        }
+
+        ssize_t nr_chunks = slice_impl::nr_chunks(std::max(outer, row), outer * row);
+        if (outer >= nr_chunks) {
+            parallel_for(nr_chunks, nr_chunks, [&](size_t t) {
+                for (ssize_t o = outer * t / nr_chunks; o < outer * (t + 1) / nr_chunks; ++o) {
+                    for (ssize_t i = 0; i < inputs.size(); ++i) {
+                        if (input_ptrs[i] != nullptr) {
+                            memcpy(output_ptr + o * row + offsets[i], input_ptrs[i] + o * slabs[i], sizeof(cctype) * slabs[i]);
+                        }
+                    }
+                }
+            });
+            return;
         }
+
+        // Each chunk copies the elements [row * t / nr_chunks, row * (t + 1) / nr_chunks) of every output row.
+        parallel_for(nr_chunks, nr_chunks, [&](size_t t) {
+            ssize_t begin = row * t / nr_chunks, end = row * (t + 1) / nr_chunks;
+            for (ssize_t o = 0; o < outer; ++o) {
+                for (ssize_t i = 0; i < inputs.size(); ++i) {
+                    ssize_t lo = std::max(begin, offsets[i]), hi = std::min(end, offsets[i] + slabs[i]);
+                    if (input_ptrs[i] != nullptr && lo < hi) {
+                        memcpy(output_ptr + o * row + lo, input_ptrs[i] + o * slabs[i] + (lo - offsets[i]), sizeof(cctype) * (hi - lo));
+                    }
+                }
+            }
+        });
     }
 };
 
@@ -104,6 +255,15 @@ public:
     OpSplitDesc(ssize_t axis, const ShapeVec &splits) : axis(axis), splits(splits) {}
     virtual ~OpSplitDesc() = default;
 
+    virtual void pickle(NCGPickler &pickler) const {
+        pickler.write(static_cast<int64_t>(axis));
+        splits.pickle(pickler);
+    }
+    virtual void unpickle(NCGUnpickler &unpickler) {
+        axis = static_cast<ssize_t>(unpickler.read_int64());
+        splits = ShapeVec(unpickler);
+    }
+
     ssize_t axis;
     ShapeVec splits;
 };
@@ -140,8 +300,8 @@ public:
 
         ssize_t index = 0;
         for (ssize_t i = 0; i < splits.size(); ++i) {
-            TensorDesc desc(input->desc().dtype(), input->desc().shape_vec(), input->desc().stride_vec());
-            desc.shape(axis) = splits[i];
+            TensorDesc desc = input->desc();
+            desc.set_shape(axis, splits[i]);
             ssize_t offset = index * desc.stride(axis);
             outputs[i] = tensor(desc, input->storage(), false, offset);
             index += splits[i];
@@ -157,6 +317,17 @@ public:
     OpNarrowDesc(ssize_t axis, ssize_t start, ssize_t length) : axis(axis), start(start), length(length) {}
     virtual ~OpNarrowDesc() = default;
 
+    virtual void pickle(NCGPickler &pickler) const {
+        pickler.write(static_cast<int64_t>(axis));
+        pickler.write(static_cast<int64_t>(start));
+        pickler.write(static_cast<int64_t>(length));
+    }
+    virtual void unpickle(NCGUnpickler &unpickler) {
+        axis = static_cast<ssize_t>(unpickler.read_int64());
+        start = static_cast<ssize_t>(unpickler.read_int64());
+        length = static_cast<ssize_t>(unpickler.read_int64());
+    }
+
     ssize_t axis, start, length;
 };
 
@@ -186,7 +357,7 @@ public:
         input->make_contiguous();
 
         auto output_desc = input->desc();
-        output_desc.shape(axis) = desc.length;
+        output_desc.set_shape(axis, desc.length);
         ssize_t output_data_ptr_offset = input->data_ptr_offset() + output_desc.stride(axis) * desc.start;
         TensorPtr output = tensor(output_desc, input->storage(), false, output_data_ptr_offset);
 
@@ -200,6 +371,17 @@ public:
     OpNarrowBackwardDesc(ssize_t axis, ssize_t start, ssize_t input_size) : axis(axis), start(start), input_size(input_size) {}
     virtual ~OpNarrowBackwardDesc() = default;
 
+    virtual void pickle(NCGPickler &pickler) const {
+        pickler.write(static_cast<int64_t>(axis));
+        pickler.write(static_cast<int64_t>(start));
+        pickler.write(static_cast<int64_t>(input_size));
+    }
+    virtual void unpickle(NCGUnpickler &unpickler) {
+        axis = static_cast<ssize_t>(unpickler.read_int64());
+        start = static_cast<ssize_t>(unpickler.read_int64());
+        input_size = static_cast<ssize_t>(unpickler.read_int64());
+    }
+
     ssize_t axis, start, input_size;
 };
 
@@ -230,8 +412,10 @@ NCG_DTYPE_SWITCH_ALL(inputs[0]->desc().dtype(), NARROWBACKWARD_DTYPE_CASE);
 private:
     template <DTypeName DT>
     void kernel_(const TensorImpl<DT> *input, TensorImpl<DT> *output, ssize_t axis, ssize_t start) {
-        auto input_default_stride = input->desc().get_default_stride();
-        auto output_default_stride = output->desc().get_default_stride();
+        ssize_t input_default_stride[TensorMaxDim];
+        input->desc().get_default_stride(input_default_stride);
+        ssize_t output_default_stride[TensorMaxDim];
+        output->desc().get_default_stride(output_default_stride);
 
         auto input_data_ptr = input->data_ptr();
         bool input_con = input->desc().is_contiguous();
@@ -262,6 +446,13 @@ public:
     OpIndexSelectDesc(ssize_t axis) : axis(axis) {}
     virtual ~OpIndexSelectDesc() = default;
 
+    virtual void pickle(NCGPickler &pickler) const {
+        pickler.write(static_cast<int64_t>(axis));
+    }
+    virtual void unpickle(NCGUnpickler &unpickler) {
+        axis = static_cast<ssize_t>(unpickler.read_int64());
+    }
+
     ssize_t axis;
 };
 
@@ -288,56 +479,61 @@ public:
         auto axis = this->template desc<OpIndexSelectDesc>().axis;
         if (axis < 0) axis += inputs[0]->desc().dim();
 
+        auto indices = slice_impl::flat_indices(inputs[1]);
+        if (slice_impl::any_out_of_range(indices, inputs[0]->desc().shape(axis))) {
+            ctx.error(this) << "Index out of range [0, " << inputs[0]->desc().shape(axis) << ").";
+            return {};
+        }
+
         auto shape = inputs[0]->desc().shape_vec();
         shape[axis] = inputs[1]->desc().shape(0);
         auto output = empty(inputs[0]->desc().dtype(), shape);
 
-        if (inputs[1]->desc().dtype() == DTypeName::Int32) {
-#define INDEXSELECT32_DTYPE_CASE(dtype_name) kernel_<DTypeName::dtype_name>(inputs[0]->template as<DTypeName::dtype_name>(), inputs[1]->template as<DTypeName::Int32>(), output->template as<DTypeName::dtype_name>());
-NCG_DTYPE_SWITCH_ALL(inputs[0]->desc().dtype(), INDEXSELECT32_DTYPE_CASE);
-#undef INDEXSELECT32_DTYPE_CASE
-        } else if (inputs[1]->desc().dtype() == DTypeName::Int64) {
-#define INDEXSELECT64_DTYPE_CASE(dtype_name) kernel_<DTypeName::dtype_name>(inputs[0]->template as<DTypeName::dtype_name>(), inputs[1]->template as<DTypeName::Int64>(), output->template as<DTypeName::dtype_name>());
-NCG_DTYPE_SWITCH_ALL(inputs[0]->desc().dtype(), INDEXSELECT64_DTYPE_CASE);
-#undef INDEXSELECT64_DTYPE_CASE
-        }
+#define INDEXSELECT_DTYPE_CASE(dtype_name) kernel_<DTypeName::dtype_name>(inputs[0]->template as<DTypeName::dtype_name>(), indices, output->template as<DTypeName::dtype_name>(), axis);
+NCG_DTYPE_SWITCH_ALL(inputs[0]->desc().dtype(), INDEXSELECT_DTYPE_CASE);
+#undef INDEXSELECT_DTYPE_CASE
 
         return {output};
     }
 
 private:
-    template <DTypeName DT, DTypeName IndexDT>
-    void kernel_(const TensorImpl<DT> *input, const TensorImpl<IndexDT> *index, TensorImpl<DT> *output) {
-        auto axis = this->template desc<OpIndexSelectDesc>().axis;
-        if (axis < 0) axis += input->desc().dim();
-
-        auto input_default_stride = input->desc().get_default_stride();
-        auto output_default_stride = output->desc().get_default_stride();
-
-        auto input_data_ptr = input->data_ptr();
-        bool input_con = input->desc().is_contiguous();
-        auto output_data_ptr = output->mutable_data_ptr();
-
-        for (ssize_t i = 0; i < output->desc().numel(); ++i) {
-            ssize_t j1, j2, j3;
-
-            if (axis != 0) {
-                j1 = i / output_default_stride[axis - 1];
-                j2 = (i % output_default_stride[axis - 1]) / output_default_stride[axis];
-                j3 = i % output_default_stride[axis];
-            } else {
-                j1 = 0;
-                j2 = i / output_default_stride[axis];
-                j3 = i % output_default_stride[axis];
+    template <DTypeName DT>
+    void kernel_(const TensorImpl<DT> *input, const std::vector<int64_t> &indices, TensorImpl<DT> *output, ssize_t axis) {
+        using cctype = typename DType<DT>::cctype;
+        auto split = slice_impl::split_axis(input->desc(), axis);
+        ssize_t outer = split.outer, size = split.size, inner = split.inner, n = indices.size();
+        const int64_t *index_ptr = indices.data();
+        auto output_ptr = output->mutable_data_ptr();
+
+        if (!input->desc().is_contiguous()) {
+            for (ssize_t o = 0; o < outer; ++o) {
+                for (ssize_t j = 0; j < n; ++j) {
+                    for (ssize_t i = 0; i < inner; ++i) {
+                        output_ptr[(o * n + j) * inner + i] = input->elat((o * size + index_ptr[j]) * inner + i);
+                    }
+                }
             }
-
-            ssize_t k = static_cast<ssize_t>(index->at(j2));
-            ssize_t ii = j1 * ((axis == 0) ? 0 : input_default_stride[axis - 1]) + k * input_default_stride[axis] + j3;
-
-            output_data_ptr[i] = input_con ? input_data_ptr[ii] : input->elat(ii);
+            return;
         }
-    }
 
+        // The output is a sequence of outer * n rows of inner elements, each a copy of an input row.
+        auto input_ptr = input->data_ptr();
+        ssize_t nr_rows = outer * n, nr_chunks = slice_impl::nr_chunks(nr_rows, nr_rows * inner);
+        parallel_for(nr_chunks, nr_chunks, [&](size_t t) {
+            ssize_t begin = nr_rows * t / nr_chunks, end = nr_rows * (t + 1) / nr_chunks;
+            for (ssize_t r = begin; r < end; ) {
+                ssize_t o = r / n, j0 = r % n, j1 = std::min(n, j0 + (end - r));
+                const cctype *src = input_ptr + o * size * inner;
+                cctype *dst = output_ptr + r * inner - j0 * inner;
+                if (inner == 1) {
+                    for (ssize_t j = j0; j < j1; ++j) dst[j] = src[index_ptr[j]];
+                } else {
+                    for (ssize_t j = j0; j < j1; ++j) memcpy(dst + j * inner, src + index_ptr[j] * inner, sizeof(cctype) * inner);
+                }
+                r += j1 - j0;
+            }
+        });
+    }
 };
 
 class OpIndexSelectBackwardDesc : public OpDesc {
@@ -346,6 +542,15 @@ public:
     OpIndexSelectBackwardDesc(ssize_t axis, ssize_t input_size) : axis(axis), input_size(input_size) {}
     virtual ~OpIndexSelectBackwardDesc() = default;
 
+    virtual void pickle(NCGPickler &pickler) const {
+        pickler.write(static_cast<int64_t>(axis));
+        pickler.write(static_cast<int64_t>(input_size));
+    }
+    virtual void unpickle(NCGUnpickler &unpickler) {
+        axis = static_cast<ssize_t>(unpickler.read_int64());
+        input_size = static_cast<ssize_t>(unpickler.read_int64());
+    }
+
     ssize_t axis, input_size;
 };
 
@@ -366,6 +571,10 @@ public:
             ctx.error(this) << "Invalid axis.";
             return;
         }
+        if (inputs[0]->desc().shape(axis) != inputs[1]->desc().shape(0)) {
+            ctx.error(this) << "Invalid shape: " << inputs[0]->desc().shape_vec() << " (gradient) vs. " << inputs[1]->desc().shape_vec() << " (indices).";
+            return;
+        }
     }
 
     virtual TensorVec compute(OpContext &ctx, const TensorVec &inputs) {
@@ -373,54 +582,70 @@ public:
         auto axis = desc.axis;
         if (axis < 0) axis += inputs[0]->desc().dim();
 
+        auto indices = slice_impl::flat_indices(inputs[1]);
+        if (slice_impl::any_out_of_range(indices, desc.input_size)) {
+            ctx.error(this) << "Index out of range [0, " << desc.input_size << ").";
+            return {};
+        }
+
         auto shape = inputs[0]->desc().shape_vec();
         shape[axis] = desc.input_size;
         auto output = zeros(inputs[0]->desc().dtype(), shape);
 
-        if (inputs[1]->desc().dtype() == DTypeName::Int32) {
-#define INDEXSELECTBACKWARD32_DTYPE_CASE(dtype_name) kernel_<DTypeName::dtype_name>(inputs[0]->template as<DTypeName::dtype_name>(), inputs[1]->template as<DTypeName::Int32>(), output->template as<DTypeName::dtype_name>());
-NCG_DTYPE_SWITCH_ALL(inputs[0]->desc().dtype(), INDEXSELECTBACKWARD32_DTYPE_CASE);
-#undef INDEXSELECTBACKWARD32_DTYPE_CASE
-        } else if (inputs[1]->desc().dtype() == DTypeName::Int64) {
-#define INDEXSELECTBACKWARD64_DTYPE_CASE(dtype_name) kernel_<DTypeName::dtype_name>(inputs[0]->template as<DTypeName::dtype_name>(), inputs[1]->template as<DTypeName::Int64>(), output->template as<DTypeName::dtype_name>());
-NCG_DTYPE_SWITCH_ALL(inputs[0]->desc().dtype(), INDEXSELECTBACKWARD64_DTYPE_CASE);
-#undef INDEXSELECTBACKWARD64_DTYPE_CASE
-        }
+#define INDEXSELECTBACKWARD_DTYPE_CASE(dtype_name) kernel_<DTypeName::dtype_name>(inputs[0]->template as<DTypeName::dtype_name>(), indices, output->template as<DTypeName::dtype_name>(), axis);
+NCG_DTYPE_SWITCH_ALL(inputs[0]->desc().dtype(), INDEXSELECTBACKWARD_DTYPE_CASE);
+#undef INDEXSELECTBACKWARD_DTYPE_CASE
 
         return {output};
     }
 
 private:
-    template <DTypeName DT, DTypeName IndexDT>
-    void kernel_(const TensorImpl<DT> *input, const TensorImpl<IndexDT> *index, TensorImpl<DT> *output) {
-        auto axis = this->template desc<OpIndexSelectBackwardDesc>().axis;
-        if (axis < 0) axis += input->desc().dim();
-
-        auto input_default_stride = input->desc().get_default_stride();
-        auto output_default_stride = output->desc().get_default_stride();
-
-        auto input_data_ptr = input->data_ptr();
-        bool input_con = input->desc().is_contiguous();
-        auto output_data_ptr = output->mutable_data_ptr();
-
-        for (ssize_t i = 0; i < input->desc().numel(); ++i) {
-            ssize_t j1, j2, j3;
+    template <DTypeName DT>
+    void kernel_(const TensorImpl<DT> *input, const std::vector<int64_t> &indices, TensorImpl<DT> *output, ssize_t axis) {
+        using cctype = typename DType<DT>::cctype;
+        auto split = slice_impl::split_axis(output->desc(), axis);
+        ssize_t outer = split.outer, size = split.size, inner = split.inner, n = indices.size();
+        const int64_t *index_ptr = indices.data();
+        auto output_ptr = output->mutable_data_ptr();
+
+        if (!input->desc().is_contiguous()) {
+            for (ssize_t o = 0; o < outer; ++o) {
+                for (ssize_t j = 0; j < n; ++j) {
+                    for (ssize_t i = 0; i < inner; ++i) {
+                        output_ptr[(o * size + index_ptr[j]) * inner + i] += input->elat((o * n + j) * inner + i);
+                    }
+                }
+            }
+            return;
+        }
 
-            if (axis != 0) {
-                j1 = i / input_default_stride[axis - 1];
-                j2 = (i % input_default_stride[axis - 1]) / input_default_stride[axis];
-                j3 = i % input_default_stride[axis];
+        /*
+         * Atomic-free: each chunk owns either a range of the outer slices or, if there are fewer slices than chunks,
+         * a range of the output rows along the axis (and skips the indices out of it). Either way, every output
+         * element is summed by a single thread, in the order of the indices; the results do not depend on the
+         * number of threads.
+         */
+        auto input_ptr = input->data_ptr();
+        ssize_t nr_chunks = slice_impl::nr_chunks(std::max(outer, size), outer * n * inner);
+        bool by_outer = outer >= nr_chunks;
+        parallel_for(nr_chunks, nr_chunks, [&](size_t t) {
+            ssize_t o_begin = 0, o_end = outer, k_begin = 0, k_end = size;
+            if (by_outer) {
+                o_begin = outer * t / nr_chunks, o_end = outer * (t + 1) / nr_chunks;
             } else {
-                j1 = 0;
-                j2 = i / input_default_stride[axis];
-                j3 = i % input_default_stride[axis];
+                k_begin = size * t / nr_chunks, k_end = size * (t + 1) / nr_chunks;
             }
-
-            ssize_t k = static_cast<ssize_t>(index->at(j2));
-            ssize_t ii = j1 * ((axis == 0) ? 0 : output_default_stride[axis - 1]) + k * output_default_stride[axis] + j3;
-
-            output_data_ptr[ii] += input_con ? input_data_ptr[i] : input->elat(i);
-        }
+            for (ssize_t o = o_begin; o < o_end; ++o) {
+                cctype *dst = output_ptr + o * size * inner;
+                const cctype *src = input_ptr + o * n * inner;
+                for (ssize_t j = 0; j < n; ++j) {
+                    ssize_t k = index_ptr[j];
+                    if (k_begin <= k && k < k_end) {
+                        slice_impl::add_row(dst + k * inner, src + j * inner, inner);
+                    }
+                }
+            }
+        });
     }
 };
 
@@ -430,6 +655,13 @@ public:
     OpGatherDesc(ssize_t axis) : axis(axis) {}
     virtual ~OpGatherDesc() = default;
 
+    virtual void pickle(NCGPickler &pickler) const {
+        pickler.write(static_cast<int64_t>(axis));
+    }
+    virtual void unpickle(NCGUnpickler &unpickler) {
+        axis = static_cast<ssize_t>(unpickler.read_int64());
+    }
+
     ssize_t axis;
 };
 
@@ -464,52 +696,63 @@ public:
         auto axis = this->template desc<OpGatherDesc>().axis;
         if (axis < 0) axis += inputs[0]->desc().dim();
 
-        auto output = empty(inputs[0]->desc().dtype(), inputs[1]->desc().shape_vec());
-
-        if (inputs[1]->desc().dtype() == DTypeName::Int32) {
-#define GATHER32_DTYPE_CASE(dtype_name) kernel_<DTypeName::dtype_name>(inputs[0]->template as<DTypeName::dtype_name>(), inputs[1]->template as<DTypeName::Int32>(), output->template as<DTypeName::dtype_name>());
-NCG_DTYPE_SWITCH_ALL(inputs[0]->desc().dtype(), GATHER32_DTYPE_CASE);
-#undef GATHER32_DTYPE_CASE
-        } else if (inputs[1]->desc().dtype() == DTypeName::Int64) {
-#define GATHER64_DTYPE_CASE(dtype_name) kernel_<DTypeName::dtype_name>(inputs[0]->template as<DTypeName::dtype_name>(), inputs[1]->template as<DTypeName::Int64>(), output->template as<DTypeName::dtype_name>());
-NCG_DTYPE_SWITCH_ALL(inputs[0]->desc().dtype(), GATHER64_DTYPE_CASE);
-#undef GATHER64_DTYPE_CASE
+        auto indices = slice_impl::flat_indices(inputs[1]);
+        if (slice_impl::any_out_of_range(indices, inputs[0]->desc().shape(axis))) {
+            ctx.error(this) << "Index out of range [0, " << inputs[0]->desc().shape(axis) << ").";
+            return {};
         }
 
+        auto output = empty_like(inputs[1]->desc(), inputs[0]->desc().dtype());
+
+#define GATHER_DTYPE_CASE(dtype_name) kernel_<DTypeName::dtype_name>(inputs[0]->template as<DTypeName::dtype_name>(), indices, output->template as<DTypeName::dtype_name>(), axis);
+NCG_DTYPE_SWITCH_ALL(inputs[0]->desc().dtype(), GATHER_DTYPE_CASE);
+#undef GATHER_DTYPE_CASE
+
         return {output};
     }
 
 private:
-    template <DTypeName DT, DTypeName IndexDT>
-    void kernel_(const TensorImpl<DT> *input, const TensorImpl<IndexDT> *index, TensorImpl<DT> *output) {
-        auto axis = this->template desc<OpGatherDesc>().axis;
-        if (axis < 0) axis += input->desc().dim();
-
-        auto input_default_stride = input->desc().get_default_stride();
-        auto output_default_stride = output->desc().get_default_stride();
-
-        auto input_data_ptr = input->data_ptr();
-        bool input_con = input->desc().is_contiguous();
-        auto output_data_ptr = output->mutable_data_ptr();
-
-        for (ssize_t i = 0; i < output->desc().numel(); ++i) {
-            ssize_t j1, j2, j3;
-
-            if (axis != 0) {
-                j1 = i / output_default_stride[axis - 1];
-                j2 = (i % output_default_stride[axis - 1]) / output_default_stride[axis];
-                j3 = i % output_default_stride[axis];
-            } else {
-                j1 = 0;
-                j2 = i / output_default_stride[axis];
-                j3 = i % output_default_stride[axis];
+    template <DTypeName DT>
+    void kernel_(const TensorImpl<DT> *input, const std::vector<int64_t> &indices, TensorImpl<DT> *output, ssize_t axis) {
+        using cctype = typename DType<DT>::cctype;
+        auto split = slice_impl::split_axis(input->desc(), axis);
+        ssize_t outer = split.outer, size = split.size, inner = split.inner, n = output->desc().shape(axis);
+        const int64_t *index_ptr = indices.data();
+        auto output_ptr = output->mutable_data_ptr();
+
+        if (!input->desc().is_contiguous()) {
+            for (ssize_t o = 0; o < outer; ++o) {
+                for (ssize_t j = 0; j < n; ++j) {
+                    for (ssize_t i = 0; i < inner; ++i) {
+                        ssize_t p = (o * n + j) * inner + i;
+                        output_ptr[p] = input->elat((o * size + index_ptr[p]) * inner + i);
+                    }
+                }
             }
-
-            ssize_t k = static_cast<ssize_t>(index->elat(i));
-            ssize_t ii = j1 * ((axis == 0) ? 0 : input_default_stride[axis - 1]) + k * input_default_stride[axis] + j3;
-
-            output_data_ptr[i] = input_con ? input_data_ptr[ii] : input->elat(ii);
+            return;
         }
+
+        // The output and the indices are outer * n rows of inner elements; row (o, j) reads the outer slice o.
+        auto input_ptr = input->data_ptr();
+        ssize_t nr_rows = outer * n, nr_chunks = slice_impl::nr_chunks(nr_rows, nr_rows * inner);
+        parallel_for(nr_chunks, nr_chunks, [&](size_t t) {
+            ssize_t begin = nr_rows * t / nr_chunks, end = nr_rows * (t + 1) / nr_chunks;
+            for (ssize_t r = begin; r < end; ) {
+                ssize_t o = r / n, j0 = r % n, j1 = std::min(n, j0 + (end - r));
+                const cctype *src = input_ptr + o * size * inner;
+                cctype *dst = output_ptr + r * inner;
+                const int64_t *idx = index_ptr + r * inner;
+                ssize_t m = (j1 - j0) * inner;
+                if (inner == 1) {
+                    for (ssize_t p = 0; p < m; ++p) dst[p] = src[idx[p]];
+                } else {
+                    for (ssize_t p = 0; p < m; p += inner) {
+                        for (ssize_t i = 0; i < inner; ++i) dst[p + i] = src[idx[p + i] * inner + i];
+                    }
+                }
+                r += j1 - j0;
+            }
+        });
     }
 };
 
@@ -519,6 +762,15 @@ public:
     OpGatherBackwardDesc(ssize_t axis, ssize_t input_size) : axis(axis), input_size(input_size) {}
     virtual ~OpGatherBackwardDesc() = default;
 
+    virtual void pickle(NCGPickler &pickler) const {
+        pickler.write(static_cast<int64_t>(axis));
+        pickler.write(static_cast<int64_t>(input_size));
+    }
+    virtual void unpickle(NCGUnpickler &unpickler) {
+        axis = static_cast<ssize_t>(unpickler.read_int64());
+        input_size = static_cast<ssize_t>(unpickler.read_int64());
+    }
+
     ssize_t axis, input_size;
 };
 
@@ -529,7 +781,16 @@ public:
     virtual void check_inputs(OpContext &ctx, const TensorVec &inputs) {
         NCG_OP_CHECK_NR_INPUTS(ctx, inputs, 2);
         NCG_OP_CHECK_INPUT_DTYPE_INT(ctx, inputs, 1);
-        NCG_OP_CHECK_COMPATIBLE_DIM(ctx, inputs);
+        NCG_OP_CHECK_COMPATIBLE_SHAPE(ctx, inputs);
+
+        const auto &desc = this->template desc<OpGatherBackwardDesc>();
+        auto axis = desc.axis;
+        if (axis < 0) axis += inputs[0]->desc().dim();
+
+        if (!(0 <= axis && axis < inputs[0]->desc().dim())) {
+            ctx.error(this) << "Invalid axis.";
+            return;
+        }
     }
 
     virtual TensorVec compute(OpContext &ctx, const TensorVec &inputs) {
@@ -537,56 +798,70 @@ public:
         auto axis = desc.axis;
         if (axis < 0) axis += inputs[0]->desc().dim();
 
+        auto indices = slice_impl::flat_indices(inputs[1]);
+        if (slice_impl::any_out_of_range(indices, desc.input_size)) {
+            ctx.error(this) << "Index out of range [0, " << desc.input_size << ").";
+            return {};
+        }
+
         auto shape = inputs[0]->desc().shape_vec();
         shape[axis] = desc.input_size;
         auto output = zeros(inputs[0]->desc().dtype(), shape);
 
-        if (inputs[1]->desc().dtype() == DTypeName::Int32) {
-#define GATHERBACKWARD32_DTYPE_CASE(dtype_name) kernel_<DTypeName::dtype_name>(inputs[0]->template as<DTypeName::dtype_name>(), inputs[1]->template as<DTypeName::Int32>(), output->template as<DTypeName::dtype_name>());
-NCG_DTYPE_SWITCH_ALL(inputs[0]->desc().dtype(), GATHERBACKWARD32_DTYPE_CASE);
-#undef GATHERBACKWARD32_DTYPE_CASE
-        } else if (inputs[1]->desc().dtype() == DTypeName::Int64) {
-#define GATHERBACKWARD64_DTYPE_CASE(dtype_name) kernel_<DTypeName::dtype_name>(inputs[0]->template as<DTypeName::dtype_name>(), inputs[1]->template as<DTypeName::Int64>(), output->template as<DTypeName::dtype_name>());
-NCG_DTYPE_SWITCH_ALL(inputs[0]->desc().dtype(), GATHERBACKWARD64_DTYPE_CASE);
-#undef GATHERBACKWARD64_DTYPE_CASE
-        }
+#define GATHERBACKWARD_DTYPE_CASE(dtype_name) kernel_<DTypeName::dtype_name>(inputs[0]->template as<DTypeName::dtype_name>(), indices, output->template as<DTypeName::dtype_name>(), axis);
+NCG_DTYPE_SWITCH_ALL(inputs[0]->desc().dtype(), GATHERBACKWARD_DTYPE_CASE);
+#undef GATHERBACKWARD_DTYPE_CASE
 
         return {output};
     }
 
 private:
-    template <DTypeName DT, DTypeName IndexDT>
-    void kernel_(const TensorImpl<DT> *input, const TensorImpl<IndexDT> *index, TensorImpl<DT> *output) {
-        auto axis = this->template desc<OpGatherBackwardDesc>().axis;
-        if (axis < 0) axis += input->desc().dim();
-
-        auto input_default_stride = input->desc().get_default_stride();
-        auto output_default_stride = output->desc().get_default_stride();
-
-        auto input_data_ptr = input->data_ptr();
-        bool input_con = input->desc().is_contiguous();
-        auto output_data_ptr = output->mutable_data_ptr();
-
-        for (ssize_t i = 0; i < input->desc().numel(); ++i) {
-            ssize_t j1, j2, j3;
+    template <DTypeName DT>
+    void kernel_(const TensorImpl<DT> *input, const std::vector<int64_t> &indices, TensorImpl<DT> *output, ssize_t axis) {
+        using cctype = typename DType<DT>::cctype;
+        auto split = slice_impl::split_axis(output->desc(), axis);
+        ssize_t outer = split.outer, size = split.size, inner = split.inner, n = input->desc().shape(axis);
+        const int64_t *index_ptr = indices.data();
+        auto output_ptr = output->mutable_data_ptr();
+
+        if (!input->desc().is_contiguous()) {
+            for (ssize_t o = 0; o < outer; ++o) {
+                for (ssize_t j = 0; j < n; ++j) {
+                    for (ssize_t i = 0; i < inner; ++i) {
+                        ssize_t p = (o * n + j) * inner + i;
+                        output_ptr[(o * size + index_ptr[p]) * inner + i] += input->elat(p);
+                    }
+                }
+            }
+            return;
+        }
 
-            if (axis != 0) {
-                j1 = i / input_default_stride[axis - 1];
-                j2 = (i % input_default_stride[axis - 1]) / input_default_stride[axis];
-                j3 = i % input_default_stride[axis];
+        // Partitioned as in OpIndexSelectBackward: by outer slices, or by output rows along the axis.
+        auto input_ptr = input->data_ptr();
+        ssize_t nr_chunks = slice_impl::nr_chunks(std::max(outer, size), outer * n * inner);
+        bool by_outer = outer >= nr_chunks;
+        parallel_for(nr_chunks, nr_chunks, [&](size_t t) {
+            ssize_t o_begin = 0, o_end = outer, k_begin = 0, k_end = size;
+            if (by_outer) {
+                o_begin = outer * t / nr_chunks, o_end = outer * (t + 1) / nr_chunks;
             } else {
-                j1 = 0;
-                j2 = i / input_default_stride[axis];
-                j3 = i % input_default_stride[axis];
+                k_begin = size * t / nr_chunks, k_end = size * (t + 1) / nr_chunks;
             }
-
-            ssize_t k = static_cast<ssize_t>(index->elat(i));
-            ssize_t ii = j1 * ((axis == 0) ? 0 : output_default_stride[axis - 1]) + k * output_default_stride[axis] + j3;
-
-            output_data_ptr[ii] += input_con ? input_data_ptr[i] : input->elat(i);
-        }
+            for (ssize_t o = o_begin; o < o_end; ++o) {
+                cctype *dst = output_ptr + o * size * inner;
+                const cctype *src = input_ptr + o * n * inner;
+                const int64_t *idx = index_ptr + o * n * inner;
+                for (ssize_t p = 0; p < n * inner; p += inner) {
+                    for (ssize_t i = 0; i < inner; ++i) {
+                        ssize_t k = idx[p + i];
+                        if (k_begin <= k && k < k_end) {
+                            dst[k * inner + i] += src[p + i];
+                        }
+                    }
+                }
+            }
+        });
     }
 };
 
 } /* !namespace ncg */
-
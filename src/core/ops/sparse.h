@@ -0,0 +1,157 @@
+/*
+ * sparse.h
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#pragma once
+
+#include "core/op.h"
+#include "core/parallel.h"
+#include "core/sparse.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace ncg {
+
+class OpSparseMatMulDesc : public OpDesc {
+public:
+    OpSparseMatMulDesc() : rows(0), cols(0), transpose_a(false) {}
+    OpSparseMatMulDesc(ssize_t rows, ssize_t cols, bool transpose_a) : rows(rows), cols(cols), transpose_a(transpose_a) {}
+    virtual ~OpSparseMatMulDesc() = default;
+
+    virtual void pickle(NCGPickler &pickler) const {
+        pickler.write(static_cast<int64_t>(rows));
+        pickler.write(static_cast<int64_t>(cols));
+        pickler.write(static_cast<int64_t>(transpose_a));
+    }
+    virtual void unpickle(NCGUnpickler &unpickler) {
+        rows = unpickler.read_int64();
+        cols = unpickler.read_int64();
+        transpose_a = unpickler.read_int64() != 0;
+    }
+
+    // The shape of the sparse operand.
+    ssize_t rows, cols;
+    bool transpose_a;
+};
+
+// Returns an empty string if (indptr, indices, values) is a valid CSR matrix of the shape; see SparseTensor.
+std::string check_csr(const ShapeVec &shape, const TensorPtr &indptr, const TensorPtr &indices, const TensorPtr &values);
+
+/*
+ * A product of a sparse and a dense matrix (SpMM). The inputs are the three arrays of a CSR matrix a (see
+ * SparseTensor) and a dense 2-D b; the output is the dense a @ b, or a^T @ b with transpose_a.
+ */
+class OpSparseMatMul : public Op {
+public:
+    NCG_OP_DEF_NAME(OpSparseMatMul);
+
+    virtual void check_inputs(OpContext &ctx, const TensorVec &inputs) {
+        NCG_OP_CHECK_NR_INPUTS(ctx, inputs, 4);
+        NCG_OP_CHECK_INPUT_DIM(ctx, inputs, 3, 2);
+
+        const auto &desc = this->template desc<OpSparseMatMulDesc>();
+        auto error = check_csr({desc.rows, desc.cols}, inputs[0], inputs[1], inputs[2]);
+        if (!error.empty()) {
+            ctx.error(this) << error;
+            return;
+        }
+        if (inputs[2]->desc().dtype() != inputs[3]->desc().dtype()) {
+            ctx.error(this) << "The sparse values and the dense operand must have the same dtype, got "
+                            << get_dtype_name(inputs[2]->desc().dtype()) << " and " << get_dtype_name(inputs[3]->desc().dtype()) << ".";
+            return;
+        }
+        ssize_t k = !desc.transpose_a ? desc.cols : desc.rows;
+        if (inputs[3]->desc().shape(0) != k) {
+            ctx.error(this) << "Invalid shape: " << ShapeVec{desc.rows, desc.cols} << " (sparse) vs. " << inputs[3]->desc().shape_vec() << ".";
+        }
+    }
+
+    virtual TensorVec compute(OpContext &ctx, const TensorVec &inputs) {
+        const auto &desc = this->template desc<OpSparseMatMulDesc>();
+        SparseTensor a({desc.rows, desc.cols}, inputs[0], inputs[1], inputs[2]);
+        if (desc.transpose_a) {
+            a = a.transpose();
+        }
+
+        TensorPtr output = empty(inputs[3]->desc().dtype(), {a.rows(), inputs[3]->desc().shape(1)});
+#define SPMM_DTYPE_CASE(dtype_name) kernel_<DTypeName::dtype_name>(a, inputs[3], output)
+NCG_DTYPE_SWITCH_FLOAT(inputs[3]->desc().dtype(), SPMM_DTYPE_CASE);
+#undef SPMM_DTYPE_CASE
+        return {output};
+    }
+
+private:
+    // The output rows are computed in blocks of this many columns, accumulated in a local buffer.
+    static const ssize_t ColumnBlock = 64;
+    // Below this many multiply-adds, the kernel runs on a single thread.
+    static const ssize_t ParallelMinWork = 1 << 16;
+
+    template <DTypeName DT>
+    void kernel_(const SparseTensor &a, const TensorPtr &b_tensor, TensorPtr &output) {
+        using cctype = typename DType<DT>::cctype;
+
+        auto b = b_tensor->template as<DT>();
+        b->make_contiguous();
+
+        const int64_t *indptr = a.indptr()->template as<DTypeName::Int64>()->data_ptr();
+        const int64_t *indices = a.indices()->template as<DTypeName::Int64>()->data_ptr();
+        const cctype *values = a.values()->template as<DT>()->data_ptr();
+        const cctype *b_ptr = b->data_ptr();
+        cctype *c_ptr = output->template as<DT>()->mutable_data_ptr();
+        ssize_t N = a.rows(), M = b->desc().shape(1);
+
+        // Split the rows into chunks of about the same number of non-zeros (each row counts as one more, so that
+        // the empty rows are split too).
+        ssize_t nr_workers = a.nnz() * M >= ParallelMinWork ? get_kernel_workers() : 1;
+        ssize_t nr_chunks = std::min<ssize_t>(N, nr_workers > 1 ? 4 * nr_workers : 1);
+        std::vector<ssize_t> bounds(nr_chunks + 1, N);
+        bounds[0] = 0;
+        for (ssize_t t = 1; t < nr_chunks; ++t) {
+            ssize_t target = (a.nnz() + N) * t / nr_chunks;
+            ssize_t lo = bounds[t - 1], hi = N;
+            while (lo < hi) {
+                ssize_t mid = (lo + hi) / 2;
+                if (indptr[mid] + mid < target) lo = mid + 1; else hi = mid;
+            }
+            bounds[t] = lo;
+        }
+
+        parallel_for(nr_chunks, nr_workers, [&](size_t t) {
+            spmm_rows_(indptr, indices, values, b_ptr, c_ptr, bounds[t], bounds[t + 1], M);
+        });
+    }
+
+    template <typename T>
+    static void spmm_rows_(const int64_t *indptr, const int64_t *indices, const T *values, const T *b, T *c, ssize_t row_begin, ssize_t row_end, ssize_t M) {
+        for (ssize_t i = row_begin; i < row_end; ++i) {
+            ssize_t j0 = 0;
+            // Whole blocks have a constant trip count, so that the multiply-adds vectorize at -O2.
+            for (; j0 + ColumnBlock <= M; j0 += ColumnBlock) {
+                T acc[ColumnBlock] = {};
+                for (int64_t p = indptr[i]; p < indptr[i + 1]; ++p) {
+                    const T v = values[p], *b_row = b + indices[p] * M + j0;
+                    for (ssize_t j = 0; j < ColumnBlock; ++j) {
+                        acc[j] += v * b_row[j];
+                    }
+                }
+                memcpy(c + i * M + j0, acc, sizeof(acc));
+            }
+            if (j0 < M) {
+                T acc[ColumnBlock] = {};
+                for (int64_t p = indptr[i]; p < indptr[i + 1]; ++p) {
+                    const T v = values[p], *b_row = b + indices[p] * M + j0;
+                    for (ssize_t j = 0; j < M - j0; ++j) {
+                        acc[j] += v * b_row[j];
+                    }
+                }
+                memcpy(c + i * M + j0, acc, (M - j0) * sizeof(T));
+            }
+        }
+    }
+};
+
+} /* !namespace ncg */
@@ -0,0 +1,53 @@
+/*
+ * parallel.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "core/parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace ncg {
+
+namespace {
+
+std::atomic<size_t> kernel_workers(0);
+
+} /* !namespace <anonymous> */
+
+void parallel_for(size_t n, size_t nr_workers, const std::function<void(size_t)> &func) {
+    nr_workers = std::min(nr_workers, n);
+    if (nr_workers <= 1) {
+        for (size_t i = 0; i < n; ++i) func(i);
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    for (size_t w = 0; w < nr_workers; ++w) {
+        workers.emplace_back([&]() {
+            for (size_t i = next++; i < n; i = next++) func(i);
+        });
+    }
+    for (auto &worker : workers) worker.join();
+}
+
+size_t get_hardware_concurrency() {
+    return std::max<size_t>(1, std::thread::hardware_concurrency());
+}
+
+size_t get_kernel_workers() {
+    size_t nr_workers = kernel_workers.load();
+    return nr_workers > 0 ? nr_workers : get_hardware_concurrency();
+}
+
+void set_kernel_workers(size_t nr_workers) {
+    kernel_workers.store(nr_workers);
+}
+
+} /* !namespace ncg */
@@ -0,0 +1,32 @@
+/*
+ * parallel.h
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#pragma once
+
+#include "core/common.h"
+
+#include <functional>
+
+namespace ncg {
+
+/*
+ * Runs func(i) for every i in [0, n) on up to nr_workers threads, which take the indices in turn. Runs on the
+ * calling thread if nr_workers <= 1.
+ */
+void parallel_for(size_t n, size_t nr_workers, const std::function<void(size_t)> &func);
+
+// std::thread::hardware_concurrency(), at least 1.
+size_t get_hardware_concurrency();
+
+/*
+ * The number of threads of the multi-threaded kernels (by default, get_hardware_concurrency()). The kernels only
+ * split the work which is large enough to pay for starting the threads.
+ */
+size_t get_kernel_workers();
+void set_kernel_workers(size_t nr_workers);
+
+} /* !namespace ncg */
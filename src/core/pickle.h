@@ -14,6 +14,8 @@
 #include <fstream>
 #include <memory>
 #include <utility>
+#include <algorithm>
+#include <vector>
 
 namespace ncg {
 
@@ -21,7 +23,59 @@ enum class NCGPickleTypes : int32_t {
     Int64 = 0x0001,
     String = 0x0002,
     Int64Array = 0x0003,
-    CharArray = 0x0004
+    CharArray = 0x0004,
+    CompressedArray = 0x0005
+};
+
+struct NCGCompressedArray {
+    int32_t codec = 0;
+    int32_t elem_size = 1;
+    int64_t raw_size = 0;
+    std::vector<char> data;
+};
+
+enum NCGPickleFlags : uint32_t {
+    NCGPickleNoFlags = 0x0000,
+    NCGPickleChecksum = 0x0001
+};
+
+/*
+ * File layout: a 12-byte header (magic, version, flags), the records, and an optional
+ * 8-byte trailer (magic, Adler-32 of all record bytes) when NCGPickleChecksum is set.
+ * Files written before the header was introduced start directly with a record type tag;
+ * the unpickler detects them and reads them as version 0.
+ * Version 2 adds the quantization parameters after each tensor (see Tensor::pickle).
+ */
+constexpr char NCGPickleMagic[4] = {'N', 'C', 'G', 'P'};
+constexpr char NCGPickleTrailerMagic[4] = {'N', 'C', 'G', 'E'};
+constexpr uint32_t NCGPickleVersion = 2;
+constexpr size_t NCGPickleBufferSize = 1 << 20;
+
+class NCGAdler32 {
+public:
+    NCGAdler32() : m_a(1), m_b(0) {}
+
+    void update(const char *data, size_t size) {
+        const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+        while (size > 0) {
+            // 5552 is the largest block for which m_b cannot overflow 32 bits before the modulo.
+            size_t block = size < 5552 ? size : 5552;
+            size -= block;
+            for (size_t i = 0; i < block; ++i) {
+                m_a += p[i];
+                m_b += m_a;
+            }
+            p += block;
+            m_a %= kMod;
+            m_b %= kMod;
+        }
+    }
+
+    uint32_t value() const { return (m_b << 16) | m_a; }
+
+private:
+    static constexpr uint32_t kMod = 65521;
+    uint32_t m_a, m_b;
 };
 
 #define WP(x) reinterpret_cast<const char *>(x)
@@ -29,13 +83,36 @@ enum class NCGPickleTypes : int32_t {
 
 class NCGPickler {
 public:
-    NCGPickler(std::ostream &out) : m_out(out), m_own_stream(false) { ncg_assert(bool(m_out)); }
-    NCGPickler(std::string fname) : m_own_out(fname, std::ios::out | std::ios::binary), m_own_stream(true), m_out(m_own_out) { ncg_assert(bool(m_out)); }
+    NCGPickler(std::ostream &out, uint32_t flags = NCGPickleNoFlags) : m_out(out), m_own_out(), m_own_stream(false), m_flags(flags) {
+        ncg_assert(bool(m_out));
+        write_header_();
+    }
+    NCGPickler(std::string fname, uint32_t flags = NCGPickleNoFlags) : m_out(m_own_out), m_own_out(fname, std::ios::out | std::ios::binary), m_own_stream(true), m_flags(flags) {
+        ncg_assert(bool(m_out));
+        write_header_();
+    }
 
     NCGPickler(const NCGPickler &) = delete;
     NCGPickler(NCGPickler &&) = delete;
 
+    void flush() {
+        if (m_buffer.size() > 0) {
+            m_out.write(m_buffer.data(), m_buffer.size());
+            m_buffer.clear();
+        }
+        m_out.flush();
+    }
+
     void close() {
+        if (m_closed) return;
+        m_closed = true;
+
+        if (m_flags & NCGPickleChecksum) {
+            uint32_t checksum = m_checksum.value();
+            write_raw_(NCGPickleTrailerMagic, sizeof(NCGPickleTrailerMagic), false);
+            write_raw_(WP(&checksum), sizeof(checksum), false);
+        }
+        flush();
         if (m_own_stream) {
             m_own_out.close();
             m_own_stream = false;
@@ -44,126 +121,303 @@ public:
 
     virtual ~NCGPickler() { close(); }
 
+    uint32_t flags() const { return m_flags; }
+    size_t bytes_written() const { return m_bytes_written; }
+
     void write(const int64_t &val) {
-        int32_t type_val = static_cast<int32_t>(NCGPickleTypes::Int64);
-        m_out.write(WP(&type_val), sizeof(type_val));
-        m_out.write(WP(&val), sizeof(val));
+        write_type_(NCGPickleTypes::Int64);
+        write_raw_(WP(&val), sizeof(val));
     }
 
     void write(const std::string &val) {
-        int32_t type_val = static_cast<int32_t>(NCGPickleTypes::String);
-        m_out.write(WP(&type_val), sizeof(type_val));
+        write_type_(NCGPickleTypes::String);
         int64_t size_val = val.size();
-        m_out.write(WP(&size_val), sizeof(size_val));
+        write_raw_(WP(&size_val), sizeof(size_val));
         const char *cstr_val = val.c_str();
-        m_out.write(WP(cstr_val), sizeof(char) * (size_val + 1));
+        write_raw_(WP(cstr_val), sizeof(char) * (size_val + 1));
     }
 
     void write_ssize_array(const ssize_t *arr_val, int64_t size_val) {
-        int32_t type_val = static_cast<int32_t>(NCGPickleTypes::Int64Array);
-        m_out.write(WP(&type_val), sizeof(type_val));
-        m_out.write(WP(&size_val), sizeof(size_val));
-
-        for (ssize_t i = 0; i < size_val; ++i) {
-            int64_t val = static_cast<int64_t>(arr_val[i]);
-            m_out.write(WP(&val), sizeof(val));
+        write_type_(NCGPickleTypes::Int64Array);
+        write_raw_(WP(&size_val), sizeof(size_val));
+
+        if (sizeof(ssize_t) == sizeof(int64_t)) {
+            write_raw_(WP(arr_val), sizeof(int64_t) * size_val);
+        } else {
+            std::vector<int64_t> i64_val(arr_val, arr_val + size_val);
+            write_raw_(WP(i64_val.data()), sizeof(int64_t) * size_val);
         }
     }
 
     template <typename T = char>
     void write_char_array(const T *arr_val, int64_t size_val) {
-        int32_t type_val = static_cast<int32_t>(NCGPickleTypes::CharArray);
-        m_out.write(WP(&type_val), sizeof(type_val));
-        m_out.write(WP(&size_val), sizeof(size_val));
-        m_out.write(WP(arr_val), sizeof(T) * size_val);
+        write_type_(NCGPickleTypes::CharArray);
+        write_raw_(WP(&size_val), sizeof(size_val));
+        write_raw_(WP(arr_val), sizeof(T) * size_val);
+    }
+
+    void write_compressed_array(const NCGCompressedArray &arr) {
+        write_type_(NCGPickleTypes::CompressedArray);
+        write_raw_(WP(&arr.codec), sizeof(arr.codec));
+        write_raw_(WP(&arr.elem_size), sizeof(arr.elem_size));
+        write_raw_(WP(&arr.raw_size), sizeof(arr.raw_size));
+        int64_t size_val = arr.data.size();
+        write_raw_(WP(&size_val), sizeof(size_val));
+        write_raw_(arr.data.data(), size_val);
     }
 
 protected:
+    void write_header_() {
+        m_buffer.reserve(NCGPickleBufferSize);
+        write_raw_(NCGPickleMagic, sizeof(NCGPickleMagic), false);
+        write_raw_(WP(&NCGPickleVersion), sizeof(NCGPickleVersion), false);
+        write_raw_(WP(&m_flags), sizeof(m_flags), false);
+    }
+
+    void write_type_(NCGPickleTypes type) {
+        int32_t type_val = static_cast<int32_t>(type);
+        write_raw_(WP(&type_val), sizeof(type_val));
+    }
+
+    void write_raw_(const char *data, size_t size, bool checksum = true) {
+        ncg_assert(!m_closed || !checksum);
+        if (checksum && (m_flags & NCGPickleChecksum)) {
+            m_checksum.update(data, size);
+        }
+        m_bytes_written += size;
+
+        if (m_buffer.size() + size > NCGPickleBufferSize) {
+            m_out.write(m_buffer.data(), m_buffer.size());
+            m_buffer.clear();
+        }
+        // Large payloads (tensor storages) bypass the buffer to save a copy.
+        if (size >= NCGPickleBufferSize) {
+            m_out.write(data, size);
+        } else {
+            m_buffer.insert(m_buffer.end(), data, data + size);
+        }
+    }
+
     std::ostream &m_out;
 
     std::ofstream m_own_out;
     bool m_own_stream;
+
+    uint32_t m_flags;
+    bool m_closed = false;
+    size_t m_bytes_written = 0;
+    std::vector<char> m_buffer;
+    NCGAdler32 m_checksum;
 };
 
 class NCGUnpickler {
 public:
-    NCGUnpickler(std::istream &in) : m_in(in) { ncg_assert(bool(m_in)); }
-    NCGUnpickler(std::string fname) : m_own_in(fname, std::ios::in | std::ios::binary), m_own_stream(true), m_in(m_own_in) { ncg_assert(bool(m_in)); }
+    NCGUnpickler(std::istream &in) : m_in(in), m_own_in(), m_own_stream(false) {
+        ncg_assert(bool(m_in));
+        // Pipes and other non-seekable streams cannot take read-ahead bytes back: read only what each record needs.
+        m_read_ahead = m_in.tellg() != std::streampos(-1);
+        m_in.clear();
+        read_header_();
+    }
+    NCGUnpickler(std::string fname) : m_in(m_own_in), m_own_in(fname, std::ios::in | std::ios::binary), m_own_stream(true) {
+        ncg_assert(bool(m_in));
+        read_header_();
+    }
 
     NCGUnpickler(const NCGUnpickler &) = delete;
     NCGUnpickler(NCGUnpickler &&) = delete;
 
+    /*
+     * Verifies the checksum trailer (if any) and releases the stream. It must be called after all
+     * records have been read. For a borrowed stream, bytes that were read ahead into the buffer
+     * are given back so that the caller can keep reading after the pickled records.
+     */
     void close() {
-        if (m_own_stream) {
-            m_own_in.close();
-            m_own_stream = false;
+        if (m_closed) return;
+
+        if (m_flags & NCGPickleChecksum) {
+            uint32_t expected = m_checksum.value();
+            char magic[sizeof(NCGPickleTrailerMagic)];
+            uint32_t checksum = 0;
+            read_raw_(magic, sizeof(magic), false);
+            read_raw_(RP(&checksum), sizeof(checksum), false);
+            ncg_assert_msg(memcmp(magic, NCGPickleTrailerMagic, sizeof(magic)) == 0, "missing pickle trailer");
+            ncg_assert_msg(checksum == expected, "pickle checksum mismatch");
         }
+
+        release_();
     }
 
-    virtual ~NCGUnpickler() { close(); }
+    // Dropping an unpickler before the end of the records is fine: the checksum is only verified by close().
+    virtual ~NCGUnpickler() { release_(); }
+
+    uint32_t version() const { return m_version; }
+    uint32_t flags() const { return m_flags; }
 
     int64_t read_int64() {
-        int32_t type_val = 0;
-        m_in.read(RP(&type_val), sizeof(type_val));
-        ncg_assert(type_val == static_cast<int32_t>(NCGPickleTypes::Int64));
+        read_type_(NCGPickleTypes::Int64);
 
         int64_t val = 0;
-        m_in.read(RP(&val), sizeof(val));
+        read_raw_(RP(&val), sizeof(val));
         return val;
     }
 
     std::string read_string() {
-        int32_t type_val = 0;
-        m_in.read(RP(&type_val), sizeof(type_val));
-        ncg_assert(type_val == static_cast<int32_t>(NCGPickleTypes::String));
+        read_type_(NCGPickleTypes::String);
 
         int64_t size_val = 0;
-        m_in.read(RP(&size_val), sizeof(size_val));
-        char *cstr_val = new char[size_val + 1];
-        m_in.read(RP(cstr_val), sizeof(char) * (size_val + 1));
-        std::string val(cstr_val, size_val);
-        delete []cstr_val;
+        read_raw_(RP(&size_val), sizeof(size_val));
+        std::string val(size_val + 1, '\0');
+        read_raw_(RP(&val[0]), sizeof(char) * (size_val + 1));
+        val.resize(size_val);
 
         return val;
     }
 
-    std::pair<std::unique_ptr<ssize_t>, size_t> read_ssize_array() {
-        int32_t type_val = 0;
-        m_in.read(RP(&type_val), sizeof(type_val));
-        ncg_assert(type_val == static_cast<int32_t>(NCGPickleTypes::Int64Array));
+    std::pair<std::unique_ptr<ssize_t[]>, size_t> read_ssize_array() {
+        read_type_(NCGPickleTypes::Int64Array);
 
         int64_t size_val = 0;
-        m_in.read(RP(&size_val), sizeof(size_val));
-        int64_t *i64_val = new int64_t[size_val];
-        m_in.read(RP(i64_val), sizeof(int64_t) * size_val);
+        read_raw_(RP(&size_val), sizeof(size_val));
         ssize_t *arr_val = new ssize_t[size_val];
-        for (int64_t i = 0; i < size_val; ++i) {
-            arr_val[i] = i64_val[i];
+        if (sizeof(ssize_t) == sizeof(int64_t)) {
+            read_raw_(RP(arr_val), sizeof(int64_t) * size_val);
+        } else {
+            std::vector<int64_t> i64_val(size_val);
+            read_raw_(RP(i64_val.data()), sizeof(int64_t) * size_val);
+            for (int64_t i = 0; i < size_val; ++i) {
+                arr_val[i] = i64_val[i];
+            }
         }
-        delete []i64_val;
 
-        return std::make_pair(std::unique_ptr<ssize_t>(arr_val), static_cast<size_t>(size_val));
+        return std::make_pair(std::unique_ptr<ssize_t[]>(arr_val), static_cast<size_t>(size_val));
     }
 
     template <typename T = char>
     std::pair<std::unique_ptr<T>, size_t> read_char_array() {
-        int32_t type_val = 0;
-        m_in.read(RP(&type_val), sizeof(type_val));
-        ncg_assert(type_val == static_cast<int32_t>(NCGPickleTypes::CharArray));
+        read_type_(NCGPickleTypes::CharArray);
 
         int64_t size_val = 0;
-        m_in.read(RP(&size_val), sizeof(size_val));
+        read_raw_(RP(&size_val), sizeof(size_val));
         char *arr_val = new char[size_val * sizeof(T)];
-        m_in.read(RP(arr_val), sizeof(T) * size_val);
+        read_raw_(RP(arr_val), sizeof(T) * size_val);
 
         return std::make_pair(std::unique_ptr<T>(reinterpret_cast<T *>(arr_val)), static_cast<size_t>(size_val));
     }
 
+    NCGCompressedArray read_compressed_array() {
+        read_type_(NCGPickleTypes::CompressedArray);
+
+        NCGCompressedArray arr;
+        read_raw_(RP(&arr.codec), sizeof(arr.codec));
+        read_raw_(RP(&arr.elem_size), sizeof(arr.elem_size));
+        read_raw_(RP(&arr.raw_size), sizeof(arr.raw_size));
+        int64_t size_val = 0;
+        read_raw_(RP(&size_val), sizeof(size_val));
+        arr.data.resize(size_val);
+        read_raw_(arr.data.data(), size_val);
+
+        return arr;
+    }
+
+    // Return the type of the next record without consuming it.
+    NCGPickleTypes peek_type() {
+        int32_t type_val = 0;
+        fill_(sizeof(type_val));
+        ncg_assert_msg(m_buffer.size() - m_buffer_pos >= sizeof(type_val), "unexpected end of pickle");
+        memcpy(&type_val, m_buffer.data() + m_buffer_pos, sizeof(type_val));
+        return static_cast<NCGPickleTypes>(type_val);
+    }
+
 protected:
+    void release_() {
+        if (m_closed) return;
+        m_closed = true;
+
+        if (m_own_stream) {
+            m_own_in.close();
+            m_own_stream = false;
+        } else if (m_buffer_pos < m_buffer.size()) {
+            m_in.clear();
+            m_in.seekg(-static_cast<std::streamoff>(m_buffer.size() - m_buffer_pos), std::ios::cur);
+        }
+        m_buffer.clear();
+        m_buffer_pos = 0;
+    }
+
+    void read_header_() {
+        m_buffer.reserve(NCGPickleBufferSize);
+
+        char magic[sizeof(NCGPickleMagic)];
+        fill_(sizeof(magic));
+        if (m_buffer.size() - m_buffer_pos >= sizeof(magic) && memcmp(m_buffer.data() + m_buffer_pos, NCGPickleMagic, sizeof(magic)) == 0) {
+            read_raw_(magic, sizeof(magic), false);
+            read_raw_(RP(&m_version), sizeof(m_version), false);
+            read_raw_(RP(&m_flags), sizeof(m_flags), false);
+            ncg_assert_msg(m_version <= NCGPickleVersion, "unsupported pickle version");
+        } else {
+            m_version = 0;
+            m_flags = NCGPickleNoFlags;
+        }
+    }
+
+    void read_type_(NCGPickleTypes type) {
+        int32_t type_val = 0;
+        read_raw_(RP(&type_val), sizeof(type_val));
+        ncg_assert(type_val == static_cast<int32_t>(type));
+    }
+
+    // Make sure that at least `size` bytes are buffered, unless the stream ends first.
+    void fill_(size_t size) {
+        size_t avail = m_buffer.size() - m_buffer_pos;
+        if (avail >= size) return;
+
+        std::copy(m_buffer.begin() + m_buffer_pos, m_buffer.end(), m_buffer.begin());
+        m_buffer.resize(NCGPickleBufferSize);
+        m_buffer_pos = 0;
+        size_t target = m_read_ahead ? NCGPickleBufferSize : size;
+        while (avail < size && m_in) {
+            m_in.read(m_buffer.data() + avail, target - avail);
+            avail += m_in.gcount();
+        }
+        m_buffer.resize(avail);
+    }
+
+    void read_raw_(char *data, size_t size, bool checksum = true) {
+        char *begin = data;
+        size_t avail = m_buffer.size() - m_buffer_pos;
+
+        if (size <= avail || size < NCGPickleBufferSize) {
+            fill_(size);
+            ncg_assert_msg(m_buffer.size() - m_buffer_pos >= size, "unexpected end of pickle");
+            memcpy(data, m_buffer.data() + m_buffer_pos, size);
+            m_buffer_pos += size;
+        } else {
+            // Large payloads are read straight into the destination.
+            memcpy(data, m_buffer.data() + m_buffer_pos, avail);
+            m_buffer.clear();
+            m_buffer_pos = 0;
+            m_in.read(data + avail, size - avail);
+            ncg_assert_msg(static_cast<size_t>(m_in.gcount()) == size - avail, "unexpected end of pickle");
+        }
+
+        if (checksum && (m_flags & NCGPickleChecksum)) {
+            m_checksum.update(begin, size);
+        }
+    }
+
     std::istream &m_in;
 
     std::ifstream m_own_in;
     bool m_own_stream;
+    bool m_read_ahead = true;
+
+    uint32_t m_version = 0;
+    uint32_t m_flags = NCGPickleNoFlags;
+    bool m_closed = false;
+    std::vector<char> m_buffer;
+    size_t m_buffer_pos = 0;
+    NCGAdler32 m_checksum;
 };
 
 #undef RP
@@ -171,4 +425,3 @@ protected:
 
 
 } /* !namespace ncg */
-
@@ -0,0 +1,87 @@
+/*
+ * quantization.h
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#pragma once
+
+#include "core/common.h"
+#include "core/half.h"
+#include "core/pickle.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace ncg {
+
+const int32_t QuantizedInt8Min = -128;
+const int32_t QuantizedInt8Max = 127;
+
+/* round(value), halves away from zero; branch-free, so that the loops using it vectorize. */
+inline int32_t round_to_int32(float value) {
+    return static_cast<int32_t>(value + std::copysign(0.5f, value));
+}
+
+/* min(max(value, low), high) without control flow (std::min and std::max on floats keep the loops from vectorizing). */
+inline float clamp_float(float value, float low, float high) {
+    uint32_t bits = select_bits(value < low, float_as_bits(low), float_as_bits(value));
+    return bits_as_float(select_bits(bits_as_float(bits) > high, float_as_bits(high), bits));
+}
+
+inline int8_t saturate_int8(float value) {
+    return static_cast<int8_t>(round_to_int32(clamp_float(value, QuantizedInt8Min, QuantizedInt8Max)));
+}
+
+/*
+ * Affine quantization: real_value = scale * (quantized_value - zero_point), with a scale and a zero point per tensor
+ * (see Tensor::quantization). A zero scale means "not quantized".
+ */
+struct QuantizationParams {
+    float scale = 0;
+    int32_t zero_point = 0;
+
+    QuantizationParams() = default;
+    QuantizationParams(float scale, int32_t zero_point) : scale(scale), zero_point(zero_point) {}
+    QuantizationParams(NCGUnpickler &unpickler) {
+        scale = bits_as_float(static_cast<uint32_t>(unpickler.read_int64()));
+        zero_point = static_cast<int32_t>(unpickler.read_int64());
+    }
+
+    void pickle(NCGPickler &pickler) const {
+        pickler.write(static_cast<int64_t>(float_as_bits(scale)));
+        pickler.write(static_cast<int64_t>(zero_point));
+    }
+
+    bool valid() const { return scale > 0; }
+    bool operator == (const QuantizationParams &rhs) const { return scale == rhs.scale && zero_point == rhs.zero_point; }
+    bool operator != (const QuantizationParams &rhs) const { return !(*this == rhs); }
+
+    int8_t quantize(float value) const { return saturate_int8(value * (1.0f / scale) + zero_point); }
+    float dequantize(int32_t value) const { return scale * (value - zero_point); }
+
+    /* Maps [min, max] (extended to contain 0, so that 0 is exact) to the int8 range; for the activations. */
+    static QuantizationParams from_range(float min, float max) {
+        min = std::min(min, 0.0f);
+        max = std::max(max, 0.0f);
+        if (max - min < 1e-8f) {
+            return QuantizationParams(1.0f, 0);
+        }
+        float scale = (max - min) / (QuantizedInt8Max - QuantizedInt8Min);
+        int32_t zero_point = round_to_int32(QuantizedInt8Min - min / scale);
+        return QuantizationParams(scale, std::min(std::max(zero_point, QuantizedInt8Min), QuantizedInt8Max));
+    }
+
+    /* Maps [-absmax, absmax] to [-127, 127] with a zero zero point; for the weights. */
+    static QuantizationParams symmetric(float absmax) {
+        return QuantizationParams(absmax > 1e-8f ? absmax / QuantizedInt8Max : 1.0f, 0);
+    }
+
+    friend std::ostream &operator << (std::ostream &out, const QuantizationParams &params) {
+        return out << "QuantizationParams(scale=" << params.scale << ", zero_point=" << params.zero_point << ")";
+    }
+};
+
+} /* !namespace ncg */
@@ -0,0 +1,243 @@
+/*
+ * sparse.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "core/sparse.h"
+#include "core/tensor_impl.h"
+#include "core/ops/sparse.h"
+
+#include <algorithm>
+#include <numeric>
+#include <sstream>
+#include <vector>
+
+namespace ncg {
+
+namespace {
+
+const int64_t *int64_ptr(const TensorPtr &tensor) {
+    return tensor->as<DTypeName::Int64>()->data_ptr();
+}
+
+template <DTypeName DT>
+SparseTensor from_coo_(const ShapeVec &shape, const int64_t *rows, const int64_t *cols, TensorPtr values_tensor) {
+    using cctype = typename DType<DT>::cctype;
+    auto values = values_tensor->as<DT>();
+    ssize_t n = values->desc().numel(), nr_rows = shape[0];
+
+    // Bucket the entries by row, then sort each row by column and sum the duplicates.
+    std::vector<int64_t> row_start(nr_rows + 1, 0);
+    for (ssize_t i = 0; i < n; ++i) row_start[rows[i] + 1]++;
+    std::partial_sum(row_start.begin(), row_start.end(), row_start.begin());
+
+    std::vector<std::pair<int64_t, cctype>> entries(n);
+    std::vector<int64_t> fill(row_start.begin(), row_start.end() - 1);
+    for (ssize_t i = 0; i < n; ++i) {
+        entries[fill[rows[i]]++] = {cols[i], values->elat(i)};
+    }
+
+    std::vector<int64_t> indptr(nr_rows + 1, 0), indices;
+    std::vector<cctype> data;
+    indices.reserve(n);
+    data.reserve(n);
+    for (ssize_t r = 0; r < nr_rows; ++r) {
+        auto begin = entries.begin() + row_start[r], end = entries.begin() + row_start[r + 1];
+        std::sort(begin, end, [](const std::pair<int64_t, cctype> &x, const std::pair<int64_t, cctype> &y) { return x.first < y.first; });
+        for (auto it = begin; it != end; ++it) {
+            if (static_cast<ssize_t>(indices.size()) > indptr[r] && indices.back() == it->first) {
+                data.back() += it->second;
+            } else {
+                indices.push_back(it->first);
+                data.push_back(it->second);
+            }
+        }
+        indptr[r + 1] = indices.size();
+    }
+
+    return SparseTensor(
+        shape, fromcc(DTypeName::Int64, indptr), fromcc(DTypeName::Int64, indices),
+        data.empty() ? empty(DT, {0}) : fromcc(DT, data)
+    );
+}
+
+template <DTypeName DT>
+SparseTensor from_dense_(TensorPtr dense) {
+    using cctype = typename DType<DT>::cctype;
+    auto a = dense->as<DT>();
+    ssize_t nr_rows = a->desc().shape(0), nr_cols = a->desc().shape(1);
+
+    std::vector<int64_t> indptr(nr_rows + 1, 0), indices;
+    std::vector<cctype> data;
+    for (ssize_t r = 0; r < nr_rows; ++r) {
+        for (ssize_t c = 0; c < nr_cols; ++c) {
+            cctype v = a->elat(r * nr_cols + c);
+            if (v != 0) {
+                indices.push_back(c);
+                data.push_back(v);
+            }
+        }
+        indptr[r + 1] = indices.size();
+    }
+
+    return SparseTensor(
+        a->desc().shape_vec(), fromcc(DTypeName::Int64, indptr), fromcc(DTypeName::Int64, indices),
+        data.empty() ? empty(DT, {0}) : fromcc(DT, data)
+    );
+}
+
+template <DTypeName DT>
+void to_dense_(const SparseTensor &a, TensorPtr &output) {
+    auto values = a.values()->as<DT>()->data_ptr();
+    auto out = output->as<DT>()->mutable_data_ptr();
+    const int64_t *indptr = int64_ptr(a.indptr()), *indices = int64_ptr(a.indices());
+    for (ssize_t r = 0; r < a.rows(); ++r) {
+        for (int64_t p = indptr[r]; p < indptr[r + 1]; ++p) {
+            out[r * a.cols() + indices[p]] += values[p];
+        }
+    }
+}
+
+template <DTypeName DT>
+SparseTensor transpose_(const SparseTensor &a) {
+    auto values = a.values()->as<DT>()->data_ptr();
+    const int64_t *indptr = int64_ptr(a.indptr()), *indices = int64_ptr(a.indices());
+
+    auto t_indptr = zeros(DTypeName::Int64, {a.cols() + 1});
+    auto t_indices = empty(DTypeName::Int64, {a.nnz()});
+    auto t_values = empty(DT, {a.nnz()});
+    int64_t *t_indptr_ptr = t_indptr->as<DTypeName::Int64>()->mutable_data_ptr();
+    int64_t *t_indices_ptr = t_indices->as<DTypeName::Int64>()->mutable_data_ptr();
+    auto t_values_ptr = t_values->as<DT>()->mutable_data_ptr();
+
+    // Counting sort by column; the rows are visited in order, so that each transposed row stays sorted.
+    for (ssize_t p = 0; p < a.nnz(); ++p) t_indptr_ptr[indices[p] + 1]++;
+    std::partial_sum(t_indptr_ptr, t_indptr_ptr + a.cols() + 1, t_indptr_ptr);
+    std::vector<int64_t> fill(t_indptr_ptr, t_indptr_ptr + a.cols());
+    for (ssize_t r = 0; r < a.rows(); ++r) {
+        for (int64_t p = indptr[r]; p < indptr[r + 1]; ++p) {
+            int64_t q = fill[indices[p]]++;
+            t_indices_ptr[q] = r;
+            t_values_ptr[q] = values[p];
+        }
+    }
+
+    return SparseTensor({a.cols(), a.rows()}, t_indptr, t_indices, t_values);
+}
+
+} /* !namespace <anonymous> */
+
+std::string check_csr(const ShapeVec &shape, const TensorPtr &indptr, const TensorPtr &indices, const TensorPtr &values) {
+    std::ostringstream error;
+    if (shape.size() != 2 || shape[0] < 0 || shape[1] < 0) {
+        error << "A sparse tensor must be 2-D, got the shape " << shape << ".";
+    } else if (indptr->desc().dtype() != DTypeName::Int64 || indices->desc().dtype() != DTypeName::Int64) {
+        error << "The indptr and the indices of a sparse tensor must be Int64, got "
+              << get_dtype_name(indptr->desc().dtype()) << " and " << get_dtype_name(indices->desc().dtype()) << ".";
+    } else if (values->desc().dtype() != DTypeName::Float32 && values->desc().dtype() != DTypeName::Float64) {
+        error << "The values of a sparse tensor must be Float32 or Float64, got " << get_dtype_name(values->desc().dtype()) << ".";
+    } else if (indptr->desc().dim() != 1 || indices->desc().dim() != 1 || values->desc().dim() != 1 ||
+            !indptr->desc().is_contiguous() || !indices->desc().is_contiguous() || !values->desc().is_contiguous()) {
+        error << "The indptr, the indices and the values of a sparse tensor must be contiguous vectors.";
+    } else if (indptr->desc().shape(0) != shape[0] + 1 || indices->desc().shape(0) != values->desc().shape(0)) {
+        error << "Invalid sparse tensor: " << shape[0] + 1 << " row pointers and " << values->desc().shape(0)
+              << " values expected, got " << indptr->desc().shape(0) << " and " << indices->desc().shape(0) << ".";
+    } else {
+        const int64_t *indptr_ptr = int64_ptr(indptr), *indices_ptr = int64_ptr(indices);
+        ssize_t nnz = indices->desc().shape(0);
+        bool valid = indptr_ptr[0] == 0 && indptr_ptr[shape[0]] == nnz;
+        for (ssize_t r = 0; r < shape[0] && valid; ++r) {
+            valid = indptr_ptr[r] <= indptr_ptr[r + 1];
+        }
+        // Branch-free, as in any_out_of_domain.
+        int bad = 0;
+        for (ssize_t p = 0; p < nnz; ++p) {
+            bad |= indices_ptr[p] < 0 || indices_ptr[p] >= shape[1];
+        }
+        if (!valid) {
+            error << "Invalid sparse tensor: the row pointers must grow from 0 to the number of values.";
+        } else if (bad) {
+            error << "Invalid sparse tensor: column index out of range [0, " << shape[1] << ").";
+        }
+    }
+    return error.str();
+}
+
+SparseTensor::SparseTensor(const ShapeVec &shape, TensorPtr indptr, TensorPtr indices, TensorPtr values)
+    : m_shape(shape), m_indptr(indptr), m_indices(indices), m_values(values) {
+    auto error = check_csr(shape, indptr, indices, values);
+    ncg_assert_msg(error.empty(), error);
+}
+
+SparseTensor SparseTensor::from_coo(const ShapeVec &shape, TensorPtr rows, TensorPtr cols, TensorPtr values) {
+    ncg_assert_msg(shape.size() == 2, "A sparse tensor must be 2-D.");
+    ncg_assert_msg(rows->desc().numel() == values->desc().numel() && cols->desc().numel() == values->desc().numel(),
+        "The COO rows, columns and values must have the same size.");
+
+    auto rows64 = cast(rows, DTypeName::Int64), cols64 = cast(cols, DTypeName::Int64);
+    rows64->make_contiguous();
+    cols64->make_contiguous();
+    const int64_t *rows_ptr = int64_ptr(rows64), *cols_ptr = int64_ptr(cols64);
+    for (ssize_t i = 0; i < values->desc().numel(); ++i) {
+        ncg_assert_msg(rows_ptr[i] >= 0 && rows_ptr[i] < shape[0] && cols_ptr[i] >= 0 && cols_ptr[i] < shape[1],
+            "COO index out of range.");
+    }
+
+#define FROM_COO_DTYPE_CASE(dtype_name) return from_coo_<DTypeName::dtype_name>(shape, rows_ptr, cols_ptr, values)
+NCG_DTYPE_SWITCH_FLOAT(values->desc().dtype(), FROM_COO_DTYPE_CASE);
+#undef FROM_COO_DTYPE_CASE
+
+    ncg_assert_msg(false, "The values of a sparse tensor must be Float32 or Float64.");
+    return SparseTensor();
+}
+
+SparseTensor SparseTensor::from_dense(TensorPtr dense) {
+    ncg_assert_msg(dense->desc().dim() == 2, "A sparse tensor must be 2-D.");
+
+#define FROM_DENSE_DTYPE_CASE(dtype_name) return from_dense_<DTypeName::dtype_name>(dense)
+NCG_DTYPE_SWITCH_FLOAT(dense->desc().dtype(), FROM_DENSE_DTYPE_CASE);
+#undef FROM_DENSE_DTYPE_CASE
+
+    ncg_assert_msg(false, "The values of a sparse tensor must be Float32 or Float64.");
+    return SparseTensor();
+}
+
+TensorPtr SparseTensor::to_dense() const {
+    auto output = zeros(dtype(), m_shape);
+
+#define TO_DENSE_DTYPE_CASE(dtype_name) to_dense_<DTypeName::dtype_name>(*this, output)
+NCG_DTYPE_SWITCH_FLOAT(dtype(), TO_DENSE_DTYPE_CASE);
+#undef TO_DENSE_DTYPE_CASE
+
+    return output;
+}
+
+SparseTensor SparseTensor::transpose() const {
+#define TRANSPOSE_DTYPE_CASE(dtype_name) return transpose_<DTypeName::dtype_name>(*this)
+NCG_DTYPE_SWITCH_FLOAT(dtype(), TRANSPOSE_DTYPE_CASE);
+#undef TRANSPOSE_DTYPE_CASE
+
+    return SparseTensor();
+}
+
+double SparseTensor::density() const {
+    return rows() * cols() > 0 ? double(nnz()) / (rows() * cols()) : 0;
+}
+
+std::ostream &operator << (std::ostream &out, const SparseTensor &tensor) {
+    return out << "SparseTensor(shape=" << tensor.shape() << ", dtype=" << get_dtype_name(tensor.dtype())
+               << ", nnz=" << tensor.nnz() << ")";
+}
+
+TensorPtr sparse_matmul(const SparseTensor &a, TensorPtr b, bool transpose_a) {
+    OpContext ctx;
+    auto op = OpSparseMatMul();
+    op.set_desc(OpDescPtr(new OpSparseMatMulDesc(a.rows(), a.cols(), transpose_a)));
+    auto output_vec = op.execute(ctx, {a.indptr(), a.indices(), a.values(), b});
+    ncg_assert_msg(ctx.ok(), ctx.error_str());
+    return ctx.ok() ? output_vec[0] : nullptr;
+}
+
+} /* !namespace ncg */
@@ -0,0 +1,56 @@
+/*
+ * sparse.h
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#pragma once
+
+#include "core/common.h"
+#include "core/tensor.h"
+
+namespace ncg {
+
+/*
+ * A 2-D sparse matrix in the CSR format: the column indices and the values of the row i are at
+ * [indptr[i], indptr[i + 1]) of indices and values, sorted by column. The three arrays are ordinary contiguous
+ * vectors (Int64, Int64, and a Float32 or Float64 values), so that they are fed, passed between the ops and
+ * pickled like any other tensor (see G::sparse_placeholder).
+ */
+class SparseTensor {
+public:
+    SparseTensor() = default;
+    SparseTensor(const ShapeVec &shape, TensorPtr indptr, TensorPtr indices, TensorPtr values);
+
+    // From the COO format (the row, column and value of each non-zero, in any order); duplicates are summed.
+    static SparseTensor from_coo(const ShapeVec &shape, TensorPtr rows, TensorPtr cols, TensorPtr values);
+    // Keeps the non-zero elements of a 2-D tensor.
+    static SparseTensor from_dense(TensorPtr dense);
+
+    TensorPtr to_dense() const;
+    // The CSR of the transposed matrix (i.e., the CSC of this one), by a counting sort of the columns.
+    SparseTensor transpose() const;
+
+    const ShapeVec &shape() const { return m_shape; }
+    ssize_t rows() const { return m_shape[0]; }
+    ssize_t cols() const { return m_shape[1]; }
+    ssize_t nnz() const { return m_indices->desc().numel(); }
+    double density() const;
+    DTypeName dtype() const { return m_values->desc().dtype(); }
+
+    const TensorPtr &indptr() const { return m_indptr; }
+    const TensorPtr &indices() const { return m_indices; }
+    const TensorPtr &values() const { return m_values; }
+
+    friend std::ostream &operator << (std::ostream &out, const SparseTensor &tensor);
+
+protected:
+    ShapeVec m_shape;
+    TensorPtr m_indptr, m_indices, m_values;
+};
+
+// a @ b, or a^T @ b, for a sparse a and a dense 2-D b (see OpSparseMatMul).
+TensorPtr sparse_matmul(const SparseTensor &a, TensorPtr b, bool transpose_a=false);
+
+} /* !namespace ncg */
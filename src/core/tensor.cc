@@ -8,8 +8,11 @@
 #include "core/tensor.h"
 #include "core/tensor_impl.h"
 #include "core/op.h"
+#include "ops/conv.h"
 #include "ops/elemwise.h"
+#include "ops/embedding.h"
 #include "ops/linalg.h"
+#include "ops/quantize.h"
 #include "ops/reduction.h"
 #include "ops/shape.h"
 #include "ops/slice.h"
@@ -18,13 +21,14 @@
 
 namespace ncg {
 
-Tensor::Tensor() : m_desc(), m_storage(), m_own_data(false), m_data_ptr_offset(0) {}
-Tensor::Tensor(const TensorDesc &desc, std::shared_ptr<TensorStorage> storage, bool own_data, ssize_t data_ptr_offset) : m_desc(desc), m_storage(storage), m_own_data(own_data), m_data_ptr_offset(data_ptr_offset) {}
+Tensor::Tensor() : m_desc(), m_storage(), m_own_data(false), m_data_ptr_offset(0), m_quantization() {}
+Tensor::Tensor(const TensorDesc &desc, std::shared_ptr<TensorStorage> storage, bool own_data, ssize_t data_ptr_offset) : m_desc(desc), m_storage(storage), m_own_data(own_data), m_data_ptr_offset(data_ptr_offset), m_quantization() {}
 
 void Tensor::pickle(NCGPickler &pickler) const {
     m_desc.pickle(pickler);
     m_storage->pickle(pickler);
     pickler.write(static_cast<int64_t>(m_data_ptr_offset));
+    m_quantization.pickle(pickler);
 }
 
 TensorDesc &Tensor::desc() {
@@ -43,6 +47,10 @@ std::shared_ptr<const TensorStorage> Tensor::storage() const {
     return m_storage;
 }
 
+long Tensor::storage_use_count() const {
+    return m_storage.use_count();
+}
+
 const ssize_t Tensor::elindex(ssize_t elindex) const {
     ssize_t ret = 0;
     for (ssize_t i = m_desc.dim() - 1; i >= 0; --i) {
@@ -61,8 +69,24 @@ ssize_t Tensor::data_ptr_offset() const {
     return  m_data_ptr_offset;
 }
 
+bool Tensor::is_quantized() const {
+    return m_quantization.valid();
+}
+
+const QuantizationParams &Tensor::quantization() const {
+    return m_quantization;
+}
+
+void Tensor::set_quantization(const QuantizationParams &params) {
+    m_quantization = params;
+}
+
 std::ostream &operator << (std::ostream &out, const Tensor &tensor) {
-    out << "Tensor(desc=" << tensor.desc() << ", storage=" << *tensor.storage() << ")";
+    out << "Tensor(desc=" << tensor.desc() << ", storage=" << *tensor.storage();
+    if (tensor.is_quantized()) {
+        out << ", quantization=" << tensor.quantization();
+    }
+    out << ")";
     return out;
 }
 
@@ -70,7 +94,11 @@ TensorPtr tensor(NCGUnpickler &unpickler) {
     auto desc = TensorDesc(unpickler);
     auto storage = tensor_storage(unpickler);
     ssize_t m_data_ptr_offset = static_cast<ssize_t>(unpickler.read_int64());
-    return tensor(desc, storage, true, m_data_ptr_offset);
+    auto t = tensor(desc, storage, true, m_data_ptr_offset);
+    if (unpickler.version() >= 2) {
+        t->set_quantization(QuantizationParams(unpickler));
+    }
+    return t;
 }
 
 TensorPtr tensor(const TensorDesc &desc, std::shared_ptr<TensorStorage> storage, bool own_data, ssize_t data_ptr_offset) {
@@ -85,7 +113,11 @@ NCG_DTYPE_SWITCH_ALL(desc.dtype(), TENSOR_DTYPE_CASE)
 }
 
 TensorPtr empty(DTypeName dtype, const ShapeVec &shape) {
-    TensorDesc desc(dtype, shape);
+    return empty_like(TensorDesc(dtype, shape), dtype);
+}
+
+TensorPtr empty_like(const TensorDesc &like, DTypeName dtype) {
+    auto desc = like.as_contiguous(dtype);
 
 #define EMPTY_DTYPE_CASE(dtype_name) return TensorPtr( \
         static_cast<Tensor *>(new TensorImpl<DTypeName::dtype_name>(\
@@ -190,6 +222,32 @@ TensorPtr matmul(TensorPtr a, TensorPtr b, bool transpose_a, bool transpose_b) {
     return ctx.ok() ? output_vec[0] : nullptr;
 }
 
+TensorPtr quantize(TensorPtr a, const QuantizationParams &params) {
+    OpContext ctx;
+    auto op = OpQuantize();
+    op.set_desc(OpDescPtr(new OpQuantizeDesc(params)));
+    auto output_vec = op.execute(ctx, {a});
+    ncg_assert_msg(ctx.ok(), ctx.error_str());
+    return ctx.ok() ? output_vec[0] : nullptr;
+}
+
+TensorPtr dequantize(TensorPtr a) {
+    OpContext ctx;
+    auto op = OpDequantize();
+    auto output_vec = op.execute(ctx, {a});
+    ncg_assert_msg(ctx.ok(), ctx.error_str());
+    return ctx.ok() ? output_vec[0] : nullptr;
+}
+
+TensorPtr quantized_matmul(TensorPtr a, TensorPtr b, TensorPtr bias, DTypeName dtype, const QuantizationParams &output, bool transpose_b) {
+    OpContext ctx;
+    auto op = OpQuantizedMatMul();
+    op.set_desc(OpDescPtr(new OpQuantizedMatMulDesc(dtype, output, transpose_b)));
+    auto output_vec = bias != nullptr ? op.execute(ctx, {a, b, bias}) : op.execute(ctx, {a, b});
+    ncg_assert_msg(ctx.ok(), ctx.error_str());
+    return ctx.ok() ? output_vec[0] : nullptr;
+}
+
 #define NCG_OP_DEF_REDUCE_TYPE1_FUNC(func_name, op_name) TensorVec func_name(TensorPtr a, ssize_t axis, bool keepdims) { \
     OpContext ctx; \
     auto op = Op##op_name(); \
@@ -311,6 +369,85 @@ TensorPtr gather_backward(TensorPtr a, ssize_t axis, TensorPtr b, ssize_t input_
     return ctx.ok() ? output_vec[0] : nullptr;
 }
 
+TensorPtr embedding(TensorPtr table, TensorPtr indices) {
+    OpContext ctx;
+    auto op = OpEmbedding();
+    auto output_vec = op.execute(ctx, {table, indices});
+    ncg_assert_msg(ctx.ok(), ctx.error_str());
+    return ctx.ok() ? output_vec[0] : nullptr;
+}
+
+TensorVec embedding_grad(TensorPtr output_grad, TensorPtr indices) {
+    OpContext ctx;
+    auto op = OpEmbeddingGrad();
+    auto output_vec = op.execute(ctx, {output_grad, indices});
+    ncg_assert_msg(ctx.ok(), ctx.error_str());
+    return output_vec;
+}
+
+TensorPtr conv2d(TensorPtr input, TensorPtr filter, ssize_t stride, ssize_t padding, Conv2dAlgorithm algorithm) {
+    OpContext ctx;
+    auto op = OpConv2d();
+    op.set_desc(OpDescPtr(new OpConv2dDesc(stride, stride, padding, padding, algorithm)));
+    auto output_vec = op.execute(ctx, {input, filter});
+    ncg_assert_msg(ctx.ok(), ctx.error_str());
+    return ctx.ok() ? output_vec[0] : nullptr;
+}
+
+TensorPtr conv2d_backward_data(TensorPtr filter, TensorPtr output_grad, ssize_t input_h, ssize_t input_w, ssize_t stride, ssize_t padding, Conv2dAlgorithm algorithm) {
+    OpContext ctx;
+    auto op = OpConv2dBackwardData();
+    op.set_desc(OpDescPtr(new OpConv2dBackwardDataDesc(OpConv2dDesc(stride, stride, padding, padding, algorithm), input_h, input_w)));
+    auto output_vec = op.execute(ctx, {filter, output_grad});
+    ncg_assert_msg(ctx.ok(), ctx.error_str());
+    return ctx.ok() ? output_vec[0] : nullptr;
+}
+
+TensorPtr conv2d_backward_filter(TensorPtr input, TensorPtr output_grad, ssize_t kernel_h, ssize_t kernel_w, ssize_t stride, ssize_t padding, Conv2dAlgorithm algorithm) {
+    OpContext ctx;
+    auto op = OpConv2dBackwardFilter();
+    op.set_desc(OpDescPtr(new OpConv2dBackwardFilterDesc(OpConv2dDesc(stride, stride, padding, padding, algorithm), kernel_h, kernel_w)));
+    auto output_vec = op.execute(ctx, {input, output_grad});
+    ncg_assert_msg(ctx.ok(), ctx.error_str());
+    return ctx.ok() ? output_vec[0] : nullptr;
+}
+
+TensorPtr max_pool2d(TensorPtr input, ssize_t kernel, ssize_t stride, ssize_t padding) {
+    OpContext ctx;
+    auto op = OpMaxPool2d();
+    op.set_desc(OpDescPtr(new OpPool2dDesc(kernel, kernel, stride, stride, padding, padding)));
+    auto output_vec = op.execute(ctx, {input});
+    ncg_assert_msg(ctx.ok(), ctx.error_str());
+    return ctx.ok() ? output_vec[0] : nullptr;
+}
+
+TensorPtr max_pool2d_backward(TensorPtr input, TensorPtr output_grad, ssize_t kernel, ssize_t stride, ssize_t padding) {
+    OpContext ctx;
+    auto op = OpMaxPool2dBackward();
+    op.set_desc(OpDescPtr(new OpPool2dDesc(kernel, kernel, stride, stride, padding, padding)));
+    auto output_vec = op.execute(ctx, {input, output_grad});
+    ncg_assert_msg(ctx.ok(), ctx.error_str());
+    return ctx.ok() ? output_vec[0] : nullptr;
+}
+
+TensorPtr avg_pool2d(TensorPtr input, ssize_t kernel, ssize_t stride, ssize_t padding) {
+    OpContext ctx;
+    auto op = OpAvgPool2d();
+    op.set_desc(OpDescPtr(new OpPool2dDesc(kernel, kernel, stride, stride, padding, padding)));
+    auto output_vec = op.execute(ctx, {input});
+    ncg_assert_msg(ctx.ok(), ctx.error_str());
+    return ctx.ok() ? output_vec[0] : nullptr;
+}
+
+TensorPtr avg_pool2d_backward(TensorPtr output_grad, ssize_t input_h, ssize_t input_w, ssize_t kernel, ssize_t stride, ssize_t padding) {
+    OpContext ctx;
+    auto op = OpAvgPool2dBackward();
+    op.set_desc(OpDescPtr(new OpAvgPool2dBackwardDesc(OpPool2dDesc(kernel, kernel, stride, stride, padding, padding), input_h, input_w)));
+    auto output_vec = op.execute(ctx, {output_grad});
+    ncg_assert_msg(ctx.ok(), ctx.error_str());
+    return ctx.ok() ? output_vec[0] : nullptr;
+}
+
 #define NCG_OP_DEF_OPERATOR_FUNC(op_symbol, op_func) TensorPtr operator op_symbol (const TensorPtr &a, const TensorPtr &b) { \
     return op_func(a, b); \
 }
@@ -340,6 +477,9 @@ NCG_OP_DEF_OPERATOR_CAST_FUNC(int64, Int64);
 NCG_OP_DEF_OPERATOR_CAST_FUNC(uint64, UInt64);
 NCG_OP_DEF_OPERATOR_CAST_FUNC(float32, Float32);
 NCG_OP_DEF_OPERATOR_CAST_FUNC(float64, Float64);
+NCG_OP_DEF_OPERATOR_CAST_FUNC(float16, Float16);
+NCG_OP_DEF_OPERATOR_CAST_FUNC(bfloat16, BFloat16);
+NCG_OP_DEF_OPERATOR_CAST_FUNC(boolean, Bool);
 
 TensorPtr TensorPtr::eq(const TensorPtr &rhs) const {
     return ::ncg::eq(*this, rhs);
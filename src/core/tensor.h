@@ -12,6 +12,7 @@
 #include "core/tensor_desc.h"
 #include "core/tensor_storage.h"
 #include "core/pickle.h"
+#include "core/quantization.h"
 
 #include <algorithm>
 #include <limits>
@@ -45,6 +46,8 @@ public:
 
     std::shared_ptr<TensorStorage> storage();
     std::shared_ptr<const TensorStorage> storage() const;
+    // The number of owners of the storage (tensors sharing it, ...); unlike storage().use_count(), without the returned copy.
+    long storage_use_count() const;
 
     template <typename ...Ints>
     const ssize_t index(Ints... args) const;
@@ -52,6 +55,15 @@ public:
 
     bool own_data() const;
     ssize_t data_ptr_offset() const;
+
+    /*
+     * The affine quantization parameters of the values. They are set by the quantized ops (see core/ops/quantize.h)
+     * and pickled with the tensor; the other ops produce tensors which are not quantized.
+     */
+    bool is_quantized() const;
+    const QuantizationParams &quantization() const;
+    void set_quantization(const QuantizationParams &params);
+
     virtual void make_own_data() = 0;
     virtual void make_contiguous() = 0;
 
@@ -62,6 +74,7 @@ protected:
     std::shared_ptr<TensorStorage> m_storage;
     bool m_own_data;
     ssize_t m_data_ptr_offset;
+    QuantizationParams m_quantization;
 };
 
 class TensorPtr : public std::shared_ptr<Tensor> {
@@ -94,6 +107,9 @@ public:
     TensorPtr uint64() const;
     TensorPtr float32() const;
     TensorPtr float64() const;
+    TensorPtr float16() const;
+    TensorPtr bfloat16() const;
+    TensorPtr boolean() const;
 
     std::vector<TensorPtr> min(ssize_t axis, bool keepdims=false) const;
     std::vector<TensorPtr> max(ssize_t axis, bool keepdims=false) const;
@@ -141,11 +157,17 @@ public:
 protected:
     const TensorStorageImpl<DT> *storage_impl_() const;
     TensorStorageImpl<DT> *storage_impl_();
+    void update_data_ptr_();
+
+    // storage_impl_()->data_ptr() + m_data_ptr_offset, refreshed whenever the storage changes.
+    cctype *m_data_ptr;
 };
 
 TensorPtr tensor(NCGUnpickler &unpickler);
 TensorPtr tensor(const TensorDesc &desc, std::shared_ptr<TensorStorage> storage, bool own_data=true, ssize_t data_ptr_offset=0);
 TensorPtr empty(DTypeName dtype, const ShapeVec &shape);
+// A contiguous tensor with the shape of desc; does not build an intermediate ShapeVec.
+TensorPtr empty_like(const TensorDesc &desc, DTypeName dtype);
 
 template <typename ValueT = double>
 typename std::enable_if<std::is_arithmetic<ValueT>::value, TensorPtr>::type
@@ -211,6 +233,12 @@ TensorPtr max(TensorPtr a, TensorPtr b);
 // linalg
 TensorPtr matmul(TensorPtr a, TensorPtr b, bool transpose_a=false, bool transpose_b=false);
 
+// quantize
+TensorPtr quantize(TensorPtr a, const QuantizationParams &params);
+TensorPtr dequantize(TensorPtr a);
+// bias can be nullptr; see OpQuantizedMatMul.
+TensorPtr quantized_matmul(TensorPtr a, TensorPtr b, TensorPtr bias, DTypeName dtype, const QuantizationParams &output=QuantizationParams(), bool transpose_b=false);
+
 // reduce
 TensorVec reduce_min(TensorPtr a, ssize_t axis, bool keepdims=false);
 TensorVec reduce_max(TensorPtr a, ssize_t axis, bool keepdims=false);
@@ -235,6 +263,28 @@ TensorPtr narrow_backward(TensorPtr a, ssize_t axis, ssize_t start, ssize_t inpu
 TensorPtr index_select_backward(TensorPtr a, ssize_t axis, TensorPtr b, ssize_t input_size);
 TensorPtr gather_backward(TensorPtr a, ssize_t axis, TensorPtr b, ssize_t input_size);
 
+// embedding
+TensorPtr embedding(TensorPtr table, TensorPtr indices);
+// Returns the row-sparse gradient of the table: {distinct indices, summed rows}; see OpEmbeddingGrad.
+TensorVec embedding_grad(TensorPtr output_grad, TensorPtr indices);
+
+// conv
+// The kernels of conv2d and of its gradients: Auto picks one from the shapes (see conv_impl::choose_direct).
+enum class Conv2dAlgorithm : int {
+    Auto = 0,
+    Im2col = 1,
+    Direct = 2,
+};
+
+// input {N, C, H, W}, filter {O, C, KH, KW}; the stride and the padding apply to both spatial axes.
+TensorPtr conv2d(TensorPtr input, TensorPtr filter, ssize_t stride=1, ssize_t padding=0, Conv2dAlgorithm algorithm=Conv2dAlgorithm::Auto);
+TensorPtr conv2d_backward_data(TensorPtr filter, TensorPtr output_grad, ssize_t input_h, ssize_t input_w, ssize_t stride=1, ssize_t padding=0, Conv2dAlgorithm algorithm=Conv2dAlgorithm::Auto);
+TensorPtr conv2d_backward_filter(TensorPtr input, TensorPtr output_grad, ssize_t kernel_h, ssize_t kernel_w, ssize_t stride=1, ssize_t padding=0, Conv2dAlgorithm algorithm=Conv2dAlgorithm::Auto);
+TensorPtr max_pool2d(TensorPtr input, ssize_t kernel, ssize_t stride, ssize_t padding=0);
+TensorPtr max_pool2d_backward(TensorPtr input, TensorPtr output_grad, ssize_t kernel, ssize_t stride, ssize_t padding=0);
+TensorPtr avg_pool2d(TensorPtr input, ssize_t kernel, ssize_t stride, ssize_t padding=0);
+TensorPtr avg_pool2d_backward(TensorPtr output_grad, ssize_t input_h, ssize_t input_w, ssize_t kernel, ssize_t stride, ssize_t padding=0);
+
 TensorPtr operator + (const TensorPtr &a, const TensorPtr &b);
 TensorPtr operator - (const TensorPtr &a, const TensorPtr &b);
 TensorPtr operator * (const TensorPtr &a, const TensorPtr &b);
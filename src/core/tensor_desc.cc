@@ -8,6 +8,7 @@
 #include "core/tensor_desc.h"
 
 #include <cstring>
+#include <algorithm>
 
 namespace ncg {
 
@@ -21,16 +22,30 @@ std::ostream &operator << (std::ostream &out, const ShapeVec &shape) {
     return out;
 }
 
-TensorDesc::TensorDesc() {
-    m_dtype = DTypeName::UInt8;
-    memset(m_shape, 0, sizeof(m_shape));
-    memset(m_stride, 0, sizeof(m_stride));
+ShapeVec::ShapeVec(NCGUnpickler &unpickler) {
+    auto arr = unpickler.read_ssize_array();
+    assign(arr.first.get(), arr.first.get() + arr.second);
 }
 
-TensorDesc::TensorDesc(DTypeName dtype, const ShapeVec &shape, const ShapeVec &stride) : m_dtype(dtype) {
-    memset(m_shape, 0, sizeof(m_shape));
-    memset(m_stride, 0, sizeof(m_stride));
+void ShapeVec::pickle(NCGPickler &pickler) const {
+    pickler.write_ssize_array(data(), size());
+}
+
+std::ostream &operator << (std::ostream &out, const ShapeView &shape) {
+    out << "[";
+    for (size_t i = 0; i < shape.size(); ++i) {
+        if (i != 0) out << ", ";
+        out << shape[i];
+    }
+    out << "]";
+    return out;
+}
+
+TensorDesc::TensorDesc() : m_dtype(DTypeName::UInt8), m_dim(0) {
+    update_cache_();
+}
 
+TensorDesc::TensorDesc(DTypeName dtype, const ShapeVec &shape, const ShapeVec &stride) : m_dtype(dtype), m_dim(0) {
     ncg_assert(shape.size() <= TensorMaxDim);
     ncg_assert(stride.size() <= TensorMaxDim);
 
@@ -43,46 +58,69 @@ TensorDesc::TensorDesc(DTypeName dtype, const ShapeVec &shape, const ShapeVec &s
     }
 }
 
-TensorDesc::TensorDesc(NCGUnpickler &unpickler) {
+/* NB: only copy the entries in use; most tensors have far fewer than TensorMaxDim dimensions. */
+TensorDesc::TensorDesc(const TensorDesc &rhs) :
+    m_dtype(rhs.m_dtype), m_dim(rhs.m_dim), m_numel(rhs.m_numel),
+    m_is_contiguous(rhs.m_is_contiguous), m_is_scalar_broadcasted(rhs.m_is_scalar_broadcasted) {
+    memcpy(m_shape, rhs.m_shape, sizeof(ssize_t) * m_dim);
+    memcpy(m_stride, rhs.m_stride, sizeof(ssize_t) * m_dim);
+}
+
+TensorDesc &TensorDesc::operator = (const TensorDesc &rhs) {
+    if (this != &rhs) {
+        m_dtype = rhs.m_dtype;
+        m_dim = rhs.m_dim;
+        m_numel = rhs.m_numel;
+        m_is_contiguous = rhs.m_is_contiguous;
+        m_is_scalar_broadcasted = rhs.m_is_scalar_broadcasted;
+        memcpy(m_shape, rhs.m_shape, sizeof(ssize_t) * m_dim);
+        memcpy(m_stride, rhs.m_stride, sizeof(ssize_t) * m_dim);
+    }
+    return *this;
+}
+
+TensorDesc::TensorDesc(NCGUnpickler &unpickler) : m_dim(0) {
     m_dtype = static_cast<DTypeName>(unpickler.read_int64());
+
+    // Both arrays are terminated by a TensorShape0 entry. Older files store all TensorMaxDim + 1 entries; newer ones
+    // only store up to the terminator.
     auto shape = unpickler.read_ssize_array();
-    ncg_assert(shape.second == TensorMaxDim + 1);
-    memcpy(m_shape, shape.first.get(), sizeof(m_shape));
+    ncg_assert(shape.second >= 1 && shape.second <= TensorMaxDim + 1);
+    while (m_dim < shape.second && shape.first[m_dim] != TensorShape0) ++m_dim;
+    ncg_assert(m_dim < shape.second);
+    memcpy(m_shape, shape.first.get(), sizeof(ssize_t) * m_dim);
     auto stride = unpickler.read_ssize_array();
-    ncg_assert(stride.second == TensorMaxDim + 1);
-    memcpy(m_stride, stride.first.get(), sizeof(m_stride));
+    ncg_assert(stride.second == shape.second);
+    memcpy(m_stride, stride.first.get(), sizeof(ssize_t) * m_dim);
+    update_cache_();
 }
 
 void TensorDesc::pickle(NCGPickler &pickler) const {
-    pickler.write(static_cast<int64_t>(m_dtype));
-    pickler.write_ssize_array(m_shape, TensorMaxDim + 1);
-    pickler.write_ssize_array(m_stride, TensorMaxDim + 1);
-}
+    ssize_t shape[TensorMaxDim + 1], stride[TensorMaxDim + 1];
+    memcpy(shape, m_shape, sizeof(ssize_t) * m_dim);
+    memcpy(stride, m_stride, sizeof(ssize_t) * m_dim);
+    shape[m_dim] = stride[m_dim] = TensorShape0;
 
-DTypeName TensorDesc::dtype() const {
-    return m_dtype;
+    pickler.write(static_cast<int64_t>(m_dtype));
+    pickler.write_ssize_array(shape, m_dim + 1);
+    pickler.write_ssize_array(stride, m_dim + 1);
 }
 
-size_t TensorDesc::dim() const {
-    size_t i;
-    for (i = 0; i <= TensorMaxDim; ++i)
-        if (m_shape[i] == TensorShape0) break;
-    return i;
+ShapeVec TensorDesc::shape_vec() const {
+    return ShapeVec(m_shape, m_shape + m_dim);
 }
 
-ShapeVec TensorDesc::shape_vec() const {
-    return ShapeVec(m_shape, m_shape + dim());
+ShapeView TensorDesc::shape_view() const {
+    return ShapeView(m_shape, m_dim);
 }
 
 void TensorDesc::set_shape_vec(const ShapeVec &shape) {
     ncg_assert(shape.size() <= TensorMaxDim);
-    size_t i = 0;
-    for (auto it = shape.begin(); it != shape.end(); ++it) m_shape[i++] = *it;
-    m_shape[i++] = TensorShape0;
-}
-
-ssize_t *TensorDesc::shape() {
-    return m_shape;
+    /* NB: the strides of the new dimensions are left to the caller. */
+    for (size_t i = m_dim; i < shape.size(); ++i) m_stride[i] = 0;
+    m_dim = shape.size();
+    std::copy(shape.begin(), shape.end(), m_shape);
+    update_cache_();
 }
 
 const ssize_t *TensorDesc::shape() const {
@@ -90,104 +128,71 @@ const ssize_t *TensorDesc::shape() const {
 }
 
 ShapeVec TensorDesc::stride_vec() const {
-    return ShapeVec(m_stride, m_stride + dim());
+    return ShapeVec(m_stride, m_stride + m_dim);
 }
 
-void TensorDesc::set_stride_vec(const ShapeVec &stride) {
-    ncg_assert(stride.size() <= TensorMaxDim);
-    size_t i = 0;
-    for (auto it = stride.begin(); it != stride.end(); ++it) m_stride[i++] = *it;
-    m_stride[i++] = TensorShape0;
+ShapeView TensorDesc::stride_view() const {
+    return ShapeView(m_stride, m_dim);
 }
 
-ssize_t *TensorDesc::stride() {
-    return m_stride;
+void TensorDesc::set_stride_vec(const ShapeVec &stride) {
+    ncg_assert(stride.size() == m_dim);
+    std::copy(stride.begin(), stride.end(), m_stride);
+    update_cache_();
 }
 
 const ssize_t *TensorDesc::stride() const {
     return m_stride;
 }
 
-ssize_t &TensorDesc::shape(ssize_t i) {
-    return m_shape[i];
-}
-
-ssize_t TensorDesc::shape(ssize_t i) const {
-    return m_shape[i];
+void TensorDesc::set_shape(ssize_t i, ssize_t value) {
+    ncg_dassert(i >= 0 && i < m_dim);
+    m_shape[i] = value;
+    update_cache_();
 }
 
-ssize_t &TensorDesc::stride(ssize_t i) {
-    return m_stride[i];
+void TensorDesc::set_stride(ssize_t i, ssize_t value) {
+    ncg_dassert(i >= 0 && i < m_dim);
+    m_stride[i] = value;
+    update_cache_();
 }
 
-ssize_t TensorDesc::stride(ssize_t i) const {
-    return m_stride[i];
-}
-
-ShapeVec TensorDesc::get_default_stride() const {
-    size_t d = dim();
-    ShapeVec stride_vec(d);
-
-    if (d == 0) {
-        // pass
-    } else {
-        stride_vec[d - 1] = 1;
-        for (ssize_t i = d - 2; i >= 0; --i) {
-            stride_vec[i] = stride_vec[i + 1] * m_shape[i + 1];
-        }
+void TensorDesc::get_default_stride(ssize_t *stride) const {
+    if (m_dim == 0) {
+        return;
     }
-
-    return stride_vec;
-}
-
-void TensorDesc::set_default_stride() {
-    size_t d = dim();
-
-    memset(m_stride, 0, sizeof(m_stride));
-    if (d == 0) {
-        // pass
-    } else {
-        m_stride[d - 1] = 1;
-        for (ssize_t i = d - 2; i >= 0; --i) {
-            m_stride[i] = m_stride[i + 1] * m_shape[i + 1];
-        }
+    stride[m_dim - 1] = 1;
+    for (ssize_t i = m_dim - 2; i >= 0; --i) {
+        stride[i] = stride[i + 1] * m_shape[i + 1];
     }
 }
 
-bool TensorDesc::is_contiguous() const {
-    size_t d = dim();
-    if (d == 0) {
-        return true;
-    }
-    if (m_stride[d - 1] != 1) return false;
-    for (ssize_t i = d - 2; i >= 0; --i) {
-        if (m_stride[i] != m_stride[i + 1] * m_shape[i + 1])
-            return false;
-    }
-    return true;
-}
-
- bool TensorDesc::is_scalar_broadcasted() const {
-    size_t d = dim();
-    if (d == 0) {
-        return true;
-    }
-    for (ssize_t i = 0; i < d; ++i) {
-        if (m_shape[i] > 1 && m_stride[i] != 0) {
-            return false;
-        }
-    }
-    return true;
- }
-
-
-size_t TensorDesc::numel() const {
-    size_t n = 1;
-    for (ssize_t i = 0; i < TensorMaxDim; ++i) {
-        if (m_shape[i] == TensorShape0) break;
-        n *= m_shape[i];
+void TensorDesc::set_default_stride() {
+    get_default_stride(m_stride);
+    update_cache_();
+}
+
+TensorDesc TensorDesc::as_contiguous(DTypeName dtype) const {
+    TensorDesc desc;
+    desc.m_dtype = dtype;
+    desc.m_dim = m_dim;
+    memcpy(desc.m_shape, m_shape, sizeof(ssize_t) * m_dim);
+    desc.set_default_stride();
+    return desc;
+}
+
+void TensorDesc::update_cache_() {
+    m_numel = 1;
+    m_is_contiguous = true;
+    m_is_scalar_broadcasted = true;
+
+    ssize_t expected_stride = 1;
+    for (ssize_t i = m_dim - 1; i >= 0; --i) {
+        m_numel *= m_shape[i];
+        if (m_stride[i] != expected_stride) m_is_contiguous = false;
+        if (m_shape[i] > 1 && m_stride[i] != 0) m_is_scalar_broadcasted = false;
+        expected_stride *= m_shape[i];
     }
-    return n;
 }
 
 bool TensorDesc::is_compatible(const TensorDesc &rhs, bool allow_broadcast) const {
@@ -207,11 +212,8 @@ bool TensorDesc::is_compatible(const TensorDesc &rhs, bool allow_broadcast) cons
 
 std::ostream &operator << (std::ostream &out, const TensorDesc &desc) {
     size_t d = desc.dim();
-    out << "TensorDesc(dtype=" << get_dtype_name(desc.m_dtype) << ", dim=" << d << ", shape=[";
-    for (ssize_t i = 0; i < d; ++i) out << desc.m_shape[i] << (i == d - 1 ? "" : ", ");
-    out << "], stride=[";
-    for (ssize_t i = 0; i < d; ++i) out << desc.m_stride[i] << (i == d - 1 ? "" : ", ");
-    out << "])";
+    out << "TensorDesc(dtype=" << get_dtype_name(desc.m_dtype) << ", dim=" << d << ", shape=" << desc.shape_view()
+        << ", stride=" << desc.stride_view() << ")";
     return out;
 }
 
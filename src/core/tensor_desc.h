@@ -24,51 +24,85 @@ const ssize_t NewAxis = std::numeric_limits<ssize_t>::max();
 class ShapeVec : public std::vector<ssize_t> {
 public:
     using std::vector<ssize_t>::vector;
-    virtual ~ShapeVec() = default;
+    ShapeVec(NCGUnpickler &unpickler);
+
+    void pickle(NCGPickler &pickler) const;
     friend std::ostream &operator << (std::ostream &out, const ShapeVec &shape);
 };
 
+/* A non-owning view of the shape or the stride of a TensorDesc; valid while the desc is alive and unchanged. */
+class ShapeView {
+public:
+    ShapeView(const ssize_t *data, size_t size) : m_data(data), m_size(size) {}
+
+    size_t size() const { return m_size; }
+    const ssize_t *begin() const { return m_data; }
+    const ssize_t *end() const { return m_data + m_size; }
+    ssize_t operator [] (size_t i) const { return m_data[i]; }
+
+    ShapeVec vec() const { return ShapeVec(begin(), end()); }
+    friend std::ostream &operator << (std::ostream &out, const ShapeView &shape);
+
+private:
+    const ssize_t *m_data;
+    size_t m_size;
+};
+
+/*
+ * The rank is stored explicitly, and the number of elements and the layout flags are cached; they are updated by all
+ * the setters. Only the first dim() entries of the shape and the stride are meaningful (and copied).
+ */
 class TensorDesc {
 public:
     TensorDesc();
     TensorDesc(DTypeName dtype, const ShapeVec &shape, const ShapeVec &stride = {});
-    virtual ~TensorDesc() = default;
+    TensorDesc(const TensorDesc &rhs);
+    TensorDesc &operator = (const TensorDesc &rhs);
 
     TensorDesc(NCGUnpickler &unpickler);
     void pickle(NCGPickler &pickler) const;
 
-    DTypeName dtype() const;
+    DTypeName dtype() const { return m_dtype; }
 
-    size_t dim() const;
+    size_t dim() const { return m_dim; }
 
     ShapeVec shape_vec() const;
+    ShapeView shape_view() const;
     void set_shape_vec(const ShapeVec &);
-    ssize_t *shape();
     const ssize_t *shape() const;
     ShapeVec stride_vec() const;
+    ShapeView stride_view() const;
     void set_stride_vec(const ShapeVec &);
-    ssize_t *stride();
     const ssize_t *stride() const;
 
-    ssize_t &shape(ssize_t i);
-    ssize_t shape(ssize_t i) const;
-    ssize_t &stride(ssize_t i);
-    ssize_t stride(ssize_t i) const;
+    ssize_t shape(ssize_t i) const { return m_shape[i]; }
+    void set_shape(ssize_t i, ssize_t value);
+    ssize_t stride(ssize_t i) const { return m_stride[i]; }
+    void set_stride(ssize_t i, ssize_t value);
 
-    ShapeVec get_default_stride() const;
+    // Writes dim() entries.
+    void get_default_stride(ssize_t *stride) const;
     void set_default_stride();
+    // A contiguous desc with the same shape.
+    TensorDesc as_contiguous(DTypeName dtype) const;
 
-    bool is_contiguous() const;
-    bool is_scalar_broadcasted() const;
-    size_t numel() const;
+    bool is_contiguous() const { return m_is_contiguous; }
+    bool is_scalar_broadcasted() const { return m_is_scalar_broadcasted; }
+    size_t numel() const { return m_numel; }
     bool is_compatible(const TensorDesc &rhs, bool allow_broadcast=false) const;
 
     friend std::ostream &operator << (std::ostream &out, const TensorDesc &desc);
 
 protected:
+    void update_cache_();
+
     DTypeName m_dtype;
-    ssize_t m_shape[TensorMaxDim + 1];
-    ssize_t m_stride[TensorMaxDim + 1];
+    size_t m_dim;
+    size_t m_numel;
+    bool m_is_contiguous;
+    bool m_is_scalar_broadcasted;
+    ssize_t m_shape[TensorMaxDim];
+    ssize_t m_stride[TensorMaxDim];
 };
 
 class TensorDescVec : public std::vector<TensorDesc> {
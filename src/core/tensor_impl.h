@@ -11,9 +11,14 @@
 
 namespace ncg {
 
+/*
+ * NB: every TensorImpl<DT> is created with a desc of dtype DT (see the TensorImpl constructors), so the dtype
+ * is enough to check the downcast; this avoids an RTTI lookup per call.
+ */
 template <DTypeName DT>
 TensorImpl<DT> *Tensor::as() {
-    return (dynamic_cast<TensorImpl<DT> *>(this));
+    ncg_dassert_msg(m_desc.dtype() == DT, "Invalid tensor dtype.");
+    return static_cast<TensorImpl<DT> *>(this);
 }
 
 #define INSTANTIATE_FUNC(dtype_name) TensorImpl<DTypeName::dtype_name> *Tensor::as()
@@ -22,7 +27,8 @@ NCG_DTYPE_INSTANTIATE_ALL(INSTANTIATE_FUNC);
 
 template <DTypeName DT>
 const TensorImpl<DT> *Tensor::as() const {
-    return (dynamic_cast<const TensorImpl<DT> *>(this));
+    ncg_dassert_msg(m_desc.dtype() == DT, "Invalid tensor dtype.");
+    return static_cast<const TensorImpl<DT> *>(this);
 }
 
 #define INSTANTIATE_FUNC(dtype_name) const TensorImpl<DTypeName::dtype_name> *Tensor::as() const
@@ -39,23 +45,27 @@ const ssize_t Tensor::index(Ints... args) const {
 }
 
 template <DTypeName DT>
-TensorImpl<DT>::TensorImpl() {}
+TensorImpl<DT>::TensorImpl() : m_data_ptr(nullptr) {}
 
 template <DTypeName DT>
 TensorImpl<DT>::TensorImpl(const TensorDesc &desc, std::shared_ptr<TensorStorage> storage, bool own_data, ssize_t data_ptr_offset) : Tensor(desc, storage, own_data, data_ptr_offset) {
-    ncg_assert(storage->dtype() == desc.dtype());
+    ncg_assert(desc.dtype() == DT && storage->dtype() == DT);
+    update_data_ptr_();
 }
 
 template <DTypeName DT>
 TensorImpl<DT>::TensorImpl(const TensorDesc &desc, TensorStorage *storage, bool own_data, ssize_t data_ptr_offset) : Tensor(desc, nullptr, own_data, data_ptr_offset) {
-    ncg_assert(storage->dtype() == desc.dtype());
+    ncg_assert(desc.dtype() == DT && storage->dtype() == DT);
     m_storage = std::shared_ptr<TensorStorage>(storage);
+    update_data_ptr_();
 }
 
 template <DTypeName DT>
 TensorImpl<DT>::TensorImpl(const TensorDesc &desc, typename TensorImpl<DT>::cctype *data_ptr, bool own_data, ssize_t data_ptr_offset) : Tensor(desc, nullptr, own_data, data_ptr_offset) {
+    ncg_assert(desc.dtype() == DT);
     auto storage = new TensorStorageImpl<DT>(data_ptr);
     m_storage = std::shared_ptr<TensorStorage>(storage);
+    update_data_ptr_();
 }
 
 template <DTypeName DT>
@@ -65,6 +75,7 @@ void TensorImpl<DT>::make_own_data() {
             m_storage = std::shared_ptr<TensorStorage>(m_storage->clone(m_data_ptr_offset, m_desc.numel()));
             m_own_data = true;
             m_data_ptr_offset = 0;
+            update_data_ptr_();
         } else {
             make_contiguous();
         }
@@ -77,14 +88,25 @@ void TensorImpl<DT>::make_contiguous() {
         return;
     } else {
         auto storage = new TensorStorageImpl<DT>(m_desc.numel());
-        for (ssize_t i = 0; i < m_desc.numel(); ++i) {
-            storage->mutable_data_ptr()[i] = elat(i);
+        auto dst = storage->mutable_data_ptr();
+        ssize_t last = m_desc.dim() - 1;
+        if (last >= 0 && m_desc.stride(last) == 1) {
+            // Contiguous rows (e.g., the outputs of split or narrow): copy them whole.
+            ssize_t width = m_desc.shape(last);
+            for (ssize_t i = 0; i < m_desc.numel(); i += width) {
+                memcpy(dst + i, data_ptr() + elindex(i), sizeof(cctype) * width);
+            }
+        } else {
+            for (ssize_t i = 0; i < m_desc.numel(); ++i) {
+                dst[i] = elat(i);
+            }
         }
 
         m_desc.set_default_stride();
         m_storage = std::shared_ptr<TensorStorage>(static_cast<TensorStorage *>(storage));
         m_own_data = true;
         m_data_ptr_offset = 0;
+        update_data_ptr_();
     }
 }
 
@@ -112,23 +134,33 @@ typename TensorImpl<DT>::cctype &TensorImpl<DT>::mutable_elat(ssize_t i) {
 
 template <DTypeName DT>
 const typename TensorImpl<DT>::cctype *TensorImpl<DT>::data_ptr() const {
-    return storage_impl_()->data_ptr() + m_data_ptr_offset;
+    return m_data_ptr;
 }
 
 template <DTypeName DT>
 typename TensorImpl<DT>::cctype *TensorImpl<DT>::mutable_data_ptr() {
-    make_own_data();
-    return storage_impl_()->mutable_data_ptr() + m_data_ptr_offset;
+    if (!m_own_data) {
+        make_own_data();
+    }
+    return m_data_ptr;
 }
 
 template <DTypeName DT>
 const TensorStorageImpl<DT> *TensorImpl<DT>::storage_impl_() const {
-    return dynamic_cast<const TensorStorageImpl<DT> *>(m_storage.get());
+    ncg_dassert_msg(m_storage->dtype() == DT, "Invalid storage dtype.");
+    return static_cast<const TensorStorageImpl<DT> *>(m_storage.get());
 }
 
 template <DTypeName DT>
 TensorStorageImpl<DT> *TensorImpl<DT>::storage_impl_() {
-    return dynamic_cast<TensorStorageImpl<DT> *>(m_storage.get());
+    ncg_dassert_msg(m_storage->dtype() == DT, "Invalid storage dtype.");
+    return static_cast<TensorStorageImpl<DT> *>(m_storage.get());
+}
+
+/* NB: the data pointer of a storage never changes, so the cache only has to follow m_storage and m_data_ptr_offset. */
+template <DTypeName DT>
+void TensorImpl<DT>::update_data_ptr_() {
+    m_data_ptr = m_storage != nullptr ? storage_impl_()->mutable_data_ptr() + m_data_ptr_offset : nullptr;
 }
 
 template <typename T>
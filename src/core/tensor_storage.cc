@@ -7,13 +7,70 @@
 
 #include "core/datatype.h"
 #include "core/tensor_storage.h"
+#include "core/compress.h"
+
+#include <algorithm>
 
 namespace ncg {
 
-TensorStorage::TensorStorage(DTypeName dtype) : m_dtype(dtype) {
+namespace {
+
+thread_local size_t allocated_bytes = 0;
+
+} /* !namespace <anonymous> */
+
+size_t tensor_storage_allocated_bytes() {
+    return allocated_bytes;
+}
+
+TensorStorage::TensorStorage(DTypeName dtype) : m_dtype(dtype), m_accounted_bytes(0), m_registered(false), m_version(0) {
 
 }
 
+TensorStorage::~TensorStorage() {
+    if (m_accounted_bytes == 0) {
+        return;
+    }
+
+    if (m_registered) memory_unregister_storage(this);
+    global_memory_account().release(m_dtype, m_accounted_bytes);
+    if (m_context_memory_account != nullptr) m_context_memory_account->release(m_dtype, m_accounted_bytes);
+    if (m_op_memory_account != nullptr) m_op_memory_account->release(m_dtype, m_accounted_bytes);
+}
+
+uint64_t TensorStorage::version() const {
+    return m_version.load(std::memory_order_relaxed);
+}
+
+void TensorStorage::mark_modified() {
+    m_version.fetch_add(1, std::memory_order_relaxed);
+}
+
+const MemoryAccountPtr &TensorStorage::context_memory_account() const {
+    return m_context_memory_account;
+}
+
+const MemoryAccountPtr &TensorStorage::op_memory_account() const {
+    return m_op_memory_account;
+}
+
+void TensorStorage::account_memory_(size_t nbytes) {
+    ncg_assert(m_accounted_bytes == 0);
+    if (nbytes == 0) {
+        return;
+    }
+
+    allocated_bytes += nbytes;
+    m_accounted_bytes = nbytes;
+    m_context_memory_account = MemoryScope::current_context_account();
+    m_op_memory_account = MemoryScope::current_op_account();
+
+    global_memory_account().allocate(m_dtype, nbytes);
+    if (m_context_memory_account != nullptr) m_context_memory_account->allocate(m_dtype, nbytes);
+    if (m_op_memory_account != nullptr) m_op_memory_account->allocate(m_dtype, nbytes);
+    m_registered = memory_register_storage(this);
+}
+
 DTypeName TensorStorage::dtype() const {
     return m_dtype;
 }
@@ -27,12 +84,18 @@ NCG_DTYPE_SWITCH_ALL(storage.dtype(), COUT_STORAGE_DTYPE_CASE)
 }
 
 template <DTypeName DT>
-TensorStorageImpl<DT>::TensorStorageImpl() : TensorStorage(DT) {
+TensorStorageImpl<DT>::TensorStorageImpl() : TensorStorage(DT), m_data_ptr(nullptr), m_size(0) {
 
 }
 
 template <DTypeName DT>
 TensorStorageImpl<DT>::TensorStorageImpl(cctype *data_ptr, size_t size) : TensorStorage(DT), m_data_ptr(data_ptr), m_size(size) {
+    account_memory_(size * sizeof(cctype));
+
+}
+
+template <DTypeName DT>
+TensorStorageImpl<DT>::TensorStorageImpl(cctype *data_ptr, size_t size, std::shared_ptr<void> owner) : TensorStorage(DT), m_data_ptr(data_ptr), m_size(size), m_owner(owner) {
 
 }
 
@@ -40,14 +103,15 @@ template <DTypeName DT>
 TensorStorageImpl<DT>::TensorStorageImpl(size_t size) : TensorStorage(DT), m_size(size) {
     /* TODO: use aligned allocation. */
     m_data_ptr = new cctype[size];
+    account_memory_(size * sizeof(cctype));
 }
 
 template <DTypeName DT>
 TensorStorageImpl<DT>::~TensorStorageImpl() {
-    if (m_data_ptr != nullptr) {
+    if (m_data_ptr != nullptr && m_owner == nullptr) {
         delete []m_data_ptr;
-        m_data_ptr = nullptr;
     }
+    m_data_ptr = nullptr;
 }
 
 template <DTypeName DT>
@@ -61,8 +125,9 @@ TensorStorage *TensorStorageImpl<DT>::clone(ssize_t start, ssize_t length) const
     if (m_data_ptr != nullptr) {
         ret->m_data_ptr = new cctype[length];
         ret->m_size = length;
+        ret->account_memory_(length * sizeof(cctype));
 
-        memcpy(ret->m_data_ptr, m_data_ptr + start, m_size * sizeof(cctype));
+        memcpy(ret->m_data_ptr, m_data_ptr + start, length * sizeof(cctype));
     }
     return static_cast<TensorStorage *>(ret);
 }
@@ -83,6 +148,16 @@ size_t TensorStorageImpl<DT>::memsize() const {
     return m_size * sizeof(cctype);
 }
 
+template <DTypeName DT>
+const void *TensorStorageImpl<DT>::raw_data_ptr() const {
+    return m_data_ptr;
+}
+
+template <DTypeName DT>
+void *TensorStorageImpl<DT>::mutable_raw_data_ptr() {
+    return m_data_ptr;
+}
+
 template <DTypeName DT>
 const typename TensorStorageImpl<DT>::cctype *TensorStorageImpl<DT>::data_ptr() const {
     return m_data_ptr;
@@ -112,8 +187,25 @@ NCG_DTYPE_INSTANTIATE_CLASS_ALL(TensorStorageImpl);
 NCG_DTYPE_INSTANTIATE_ALL(INSTANTIATE_FUNC);
 #undef INSTANTIATE_FUNC
 
+std::shared_ptr<TensorStorage> tensor_storage(DTypeName dtype, size_t size) {
+#define TS_EMPTY_DTYPE_CASE(dtype_name) return std::shared_ptr<TensorStorage>(new TensorStorageImpl<DTypeName::dtype_name>(size));
+NCG_DTYPE_SWITCH_ALL(dtype, TS_EMPTY_DTYPE_CASE);
+#undef TS_EMPTY_DTYPE_CASE
+    return nullptr;
+}
+
 std::shared_ptr<TensorStorage> tensor_storage(NCGUnpickler &unpickler) {
     auto dtype = static_cast<DTypeName>(unpickler.read_int64());
+    return tensor_storage(unpickler, dtype);
+}
+
+std::shared_ptr<TensorStorage> tensor_storage(NCGUnpickler &unpickler, DTypeName dtype) {
+    if (unpickler.peek_type() == NCGPickleTypes::CompressedArray) {
+        auto arr = unpickler.read_compressed_array();
+        auto storage = tensor_storage(dtype, arr.raw_size / std::max<int32_t>(arr.elem_size, 1));
+        decompress_bytes(arr, reinterpret_cast<char *>(storage->mutable_raw_data_ptr()), storage->memsize());
+        return storage;
+    }
 
 #define TS_UNPICKLE_DTYPE_CASE(dtype_name) do { \
     auto data = unpickler.read_char_array<typename DType<DTypeName::dtype_name>::cctype>(); \
@@ -123,6 +215,7 @@ std::shared_ptr<TensorStorage> tensor_storage(NCGUnpickler &unpickler) {
 } while (0)
 NCG_DTYPE_SWITCH_ALL(dtype, TS_UNPICKLE_DTYPE_CASE);
 #undef TS_UNPICKLE_DTYPE_CASE
+    return nullptr;
 }
 
 } /* !namespace ncg */
@@ -10,7 +10,9 @@
 #include "core/common.h"
 #include "core/datatype.h"
 #include "core/pickle.h"
+#include "core/memory.h"
 
+#include <atomic>
 #include <limits>
 
 namespace ncg {
@@ -20,19 +22,40 @@ const size_t TensorValueMaxPrint = 16;
 class TensorStorage {
 public:
     TensorStorage(DTypeName dtype);
-    virtual ~TensorStorage() = default;
+    virtual ~TensorStorage();
 
     DTypeName dtype() const;
     virtual size_t size() const = 0;
     virtual size_t memsize() const = 0;
+    virtual const void *raw_data_ptr() const = 0;
+    virtual void *mutable_raw_data_ptr() = 0;
 
     virtual TensorStorage *clone(ssize_t start = 0, ssize_t length = std::numeric_limits<ssize_t>::max()) const = 0;
     virtual void pickle(NCGPickler &pickler) const = 0;
 
+    /*
+     * Incremented by the kernels which modify existing data in place (add_rows_inplace), so that a change can be
+     * told apart even though the storage stays the same object (see Checkpointer).
+     */
+    uint64_t version() const;
+    void mark_modified();
+
+    // The accounts (see core/memory.h) of the scope in which the storage was allocated.
+    const MemoryAccountPtr &context_memory_account() const;
+    const MemoryAccountPtr &op_memory_account() const;
+
     friend std::ostream &operator << (std::ostream &out, const TensorStorage &storage);
 
 protected:
+    /* NB: called by the subclasses once they own nbytes of memory; released by the destructor. */
+    void account_memory_(size_t nbytes);
+
     DTypeName m_dtype;
+    size_t m_accounted_bytes;
+    bool m_registered;
+    std::atomic<uint64_t> m_version;
+    MemoryAccountPtr m_context_memory_account;
+    MemoryAccountPtr m_op_memory_account;
 };
 
 template <DTypeName DT> class TensorStorageImpl;
@@ -45,6 +68,8 @@ public:
 
     TensorStorageImpl();
     explicit TensorStorageImpl(cctype *data_ptr, size_t size);
+    /* NB: borrow the data, which is kept alive by the owner (e.g., a memory-mapped file). */
+    explicit TensorStorageImpl(cctype *data_ptr, size_t size, std::shared_ptr<void> owner);
     explicit TensorStorageImpl(size_t size);
 
     /* NB: delete the copy-constructor and move-constructor */
@@ -55,6 +80,8 @@ public:
 
     virtual size_t size() const;
     virtual size_t memsize() const;
+    virtual const void *raw_data_ptr() const;
+    virtual void *mutable_raw_data_ptr();
 
     const cctype *data_ptr() const;
     cctype *mutable_data_ptr();
@@ -67,9 +94,15 @@ public:
 protected:
     cctype *m_data_ptr;
     size_t m_size;
+    std::shared_ptr<void> m_owner;
 };
 
+/* Total number of bytes of storage allocated (and owned) by the tensor storages created on the calling thread. */
+size_t tensor_storage_allocated_bytes();
+
+std::shared_ptr<TensorStorage> tensor_storage(DTypeName dtype, size_t size);
 std::shared_ptr<TensorStorage> tensor_storage(NCGUnpickler &unpickler);
+std::shared_ptr<TensorStorage> tensor_storage(NCGUnpickler &unpickler, DTypeName dtype);
 
 } /* !namespace ncg */
 
@@ -0,0 +1,10 @@
+/*
+ * data.h
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "data/data_loader.h"
+#include "data/idx.h"
+
@@ -0,0 +1,221 @@
+/*
+ * data_loader.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "data/data_loader.h"
+#include "core/tensor_impl.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace ncg {
+
+DataLoader::DataLoader(const TensorVec &data, const DataLoaderOptions &options, URBG &rng) :
+    m_data(), m_options(options), m_rng(rng()) {
+
+    ncg_assert(data.size() > 0);
+    ncg_assert(m_options.batch_size > 0);
+    for (const auto &it : m_options.transforms) {
+        ncg_assert_msg(it.first < data.size(), "transform for a non-existing input");
+        ncg_assert_msg(it.second.dtype == DTypeName::Float32 || it.second.dtype == DTypeName::Float64, "transforms only produce floating-point outputs");
+    }
+    for (const auto &t : data) {
+        ncg_assert(t->desc().dim() > 0 && t->desc().shape(0) == data[0]->desc().shape(0));
+
+        // Work on a shallow copy so that making it contiguous does not touch the caller's tensor.
+        auto copy = tensor(t->desc(), t->storage(), false, t->data_ptr_offset());
+        copy->make_contiguous();
+        m_data.emplace_back(copy);
+    }
+
+    m_slots.resize(std::max<size_t>(m_options.prefetch, 1) + 1);
+    for (auto &slot : m_slots) {
+        alloc_slot_(slot);
+    }
+
+    for (size_t i = 0; i < std::max<size_t>(m_options.nr_workers, 1); ++i) {
+        m_workers.emplace_back(&DataLoader::worker_, this);
+    }
+}
+
+DataLoader::~DataLoader() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv_free.notify_all();
+    for (auto &worker : m_workers) {
+        worker.join();
+    }
+}
+
+ssize_t DataLoader::size() const {
+    return m_data[0]->desc().shape(0);
+}
+
+ssize_t DataLoader::batch_size() const {
+    return m_options.batch_size;
+}
+
+ssize_t DataLoader::epoch_size() const {
+    ssize_t n = size();
+    return n / m_options.batch_size + (n % m_options.batch_size != 0);
+}
+
+TensorVec DataLoader::next() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    if (m_held_slot >= 0) {
+        m_slots[m_held_slot].state = SlotState::Free;
+        m_held_slot = -1;
+        m_cv_free.notify_all();
+    }
+
+    ssize_t batch_id = m_next_consume++;
+    Slot &slot = m_slots[batch_id % m_slots.size()];
+    m_cv_ready.wait(lock, [&]() { return slot.state == SlotState::Ready && slot.batch_id == batch_id; });
+    m_held_slot = batch_id % m_slots.size();
+
+    TensorVec outputs;
+    if (slot.size == m_options.batch_size) {
+        outputs.push_back(slot.indices);
+        for (const auto &buffer : slot.buffers) outputs.push_back(buffer);
+    } else {
+        outputs.push_back(slot.indices.narrow(0, 0, slot.size));
+        for (const auto &buffer : slot.buffers) outputs.push_back(buffer.narrow(0, 0, slot.size));
+    }
+    return outputs;
+}
+
+void DataLoader::worker_() {
+    std::vector<int64_t> indices(m_options.batch_size);
+
+    while (true) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv_free.wait(lock, [&]() { return m_stop || m_slots[m_next_produce % m_slots.size()].state == SlotState::Free; });
+        if (m_stop) return;
+
+        // Batches are claimed in order, so the permutation of an epoch is only replaced after
+        // every batch of that epoch has copied its indices.
+        ssize_t batch_id = m_next_produce++;
+        Slot &slot = m_slots[batch_id % m_slots.size()];
+        slot.state = SlotState::Filling;
+
+        ssize_t epoch = batch_id / epoch_size();
+        ssize_t begin = (batch_id % epoch_size()) * m_options.batch_size;
+        ssize_t size = std::min(m_options.batch_size, this->size() - begin);
+
+        if (m_permutation_epoch != epoch) {
+            if (m_options.shuffle) {
+                m_permutation = rand_permutation(m_rng, this->size());
+            } else {
+                m_permutation = arange(DTypeName::Int64, this->size());
+            }
+            m_permutation_epoch = epoch;
+        }
+        const int64_t *perm = m_permutation->as<DTypeName::Int64>()->data_ptr();
+        std::copy(perm + begin, perm + begin + size, indices.begin());
+        lock.unlock();
+
+        if (is_slot_shared_(slot)) {
+            alloc_slot_(slot);
+        }
+        fill_slot_(slot, indices.data(), size);
+
+        lock.lock();
+        slot.batch_id = batch_id;
+        slot.size = size;
+        slot.state = SlotState::Ready;
+        m_cv_ready.notify_all();
+    }
+}
+
+void DataLoader::fill_slot_(Slot &slot, const int64_t *indices, ssize_t size) {
+    memcpy(slot.indices->as<DTypeName::Int64>()->mutable_data_ptr(), indices, sizeof(int64_t) * size);
+
+    for (size_t i = 0; i < m_data.size(); ++i) {
+        gather_rows_(i, slot.buffers[i], indices, size);
+    }
+}
+
+namespace {
+
+template <typename SrcT, typename DstT>
+void transform_row(const SrcT *src, DstT *dst, ssize_t n, DstT scale, DstT bias) {
+    for (ssize_t i = 0; i < n; ++i) {
+        dst[i] = static_cast<DstT>(src[i]) * scale + bias;
+    }
+}
+
+template <typename DstT>
+void gather_transformed_rows(DTypeName src_dtype, const char *src_ptr, DstT *dst_rows, const int64_t *indices, ssize_t size, ssize_t row_numel, const DataLoaderTransform &transform) {
+    DstT scale = static_cast<DstT>(transform.scale), bias = static_cast<DstT>(transform.bias);
+
+#define TRANSFORM_SRC_DTYPE_CASE(src_dtype_name) do { \
+    auto src_rows = reinterpret_cast<const DType<DTypeName::src_dtype_name>::cctype *>(src_ptr); \
+    for (ssize_t j = 0; j < size; ++j) { \
+        transform_row(src_rows + indices[j] * row_numel, dst_rows + j * row_numel, row_numel, scale, bias); \
+    } \
+} while (0)
+
+    NCG_DTYPE_SWITCH_ALL(src_dtype, TRANSFORM_SRC_DTYPE_CASE);
+
+#undef TRANSFORM_SRC_DTYPE_CASE
+}
+
+} /* !namespace <anonymous> */
+
+void DataLoader::gather_rows_(size_t input, const TensorPtr &dst, const int64_t *indices, ssize_t size) {
+    const auto &src = m_data[input];
+    DTypeName src_dtype = src->desc().dtype();
+    ssize_t row_numel = 1;
+    for (size_t d = 1; d < src->desc().dim(); ++d) row_numel *= src->desc().shape(d);
+
+    const char *src_ptr = reinterpret_cast<const char *>(src->storage()->raw_data_ptr()) + src->data_ptr_offset() * get_dtype_size(src_dtype);
+    char *dst_ptr = reinterpret_cast<char *>(dst->storage()->mutable_raw_data_ptr());
+
+    auto it = m_options.transforms.find(input);
+    if (it == m_options.transforms.end()) {
+        size_t row_bytes = row_numel * get_dtype_size(src_dtype);
+        for (ssize_t j = 0; j < size; ++j) {
+            memcpy(dst_ptr + j * row_bytes, src_ptr + indices[j] * row_bytes, row_bytes);
+        }
+        return;
+    }
+
+#define TRANSFORM_DST_DTYPE_CASE(dst_dtype_name) gather_transformed_rows( \
+    src_dtype, src_ptr, reinterpret_cast<DType<DTypeName::dst_dtype_name>::cctype *>(dst_ptr), indices, size, row_numel, it->second \
+)
+
+    NCG_DTYPE_SWITCH_FLOAT(it->second.dtype, TRANSFORM_DST_DTYPE_CASE);
+
+#undef TRANSFORM_DST_DTYPE_CASE
+}
+
+void DataLoader::alloc_slot_(Slot &slot) {
+    slot.indices = empty(DTypeName::Int64, {m_options.batch_size});
+    slot.buffers.clear();
+    for (const auto &t : m_data) {
+        auto shape = t->desc().shape_vec();
+        shape[0] = m_options.batch_size;
+        auto it = m_options.transforms.find(slot.buffers.size());
+        auto dtype = it == m_options.transforms.end() ? t->desc().dtype() : it->second.dtype;
+        slot.buffers.emplace_back(empty(dtype, shape));
+    }
+}
+
+bool DataLoader::is_slot_shared_(const Slot &slot) const {
+    // One reference is held by the slot itself, another one by the temporary returned by storage().
+    auto shared = [](const TensorPtr &t) { return t.use_count() > 1 || t->storage().use_count() > 2; };
+    if (shared(slot.indices)) return true;
+    for (const auto &buffer : slot.buffers) {
+        if (shared(buffer)) return true;
+    }
+    return false;
+}
+
+} /* !namespace ncg */
+
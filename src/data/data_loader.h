@@ -0,0 +1,108 @@
+/*
+ * data_loader.h
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#pragma once
+
+#include "core/common.h"
+#include "core/tensor.h"
+#include "core/tensor_extra_ops.h"
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ncg {
+
+/*
+ * An element-wise conversion fused into the batch gathering: dst = scale * src + bias, cast to dtype.
+ * E.g. {Float32, 1 / 255.0, -0.5} normalizes uint8 images without materializing a float copy of
+ * the whole dataset.
+ */
+struct DataLoaderTransform {
+    DTypeName dtype = DTypeName::Float32;
+    double scale = 1.0;
+    double bias = 0.0;
+};
+
+struct DataLoaderOptions {
+    ssize_t batch_size = 32;
+    bool shuffle = true;
+    // Number of worker threads gathering batches.
+    size_t nr_workers = 1;
+    // Number of batches prepared ahead of the one being consumed.
+    size_t prefetch = 2;
+    // Optional transforms, keyed by the index of the input tensor.
+    std::map<size_t, DataLoaderTransform> transforms;
+};
+
+/*
+ * Iterates over mini-batches of a set of tensors sharing their first dimension. Batches are shuffled
+ * and gathered by worker threads into a ring of preallocated batch tensors, so that data preparation
+ * overlaps with the training step.
+ *
+ * next() returns {indices, batch of data[0], batch of data[1], ...}. The returned tensors live in a ring
+ * slot which is recycled by the following call to next(); if the caller still holds a reference to them
+ * by then, the slot gets fresh buffers instead of overwriting the data.
+ */
+class DataLoader {
+public:
+    DataLoader(const TensorVec &data, const DataLoaderOptions &options, URBG &rng);
+    virtual ~DataLoader();
+
+    DataLoader(const DataLoader &) = delete;
+    DataLoader(DataLoader &&) = delete;
+
+    TensorVec next();
+
+    ssize_t size() const;
+    ssize_t batch_size() const;
+    ssize_t epoch_size() const;
+
+protected:
+    enum class SlotState : int {
+        Free,
+        Filling,
+        Ready
+    };
+
+    struct Slot {
+        SlotState state = SlotState::Free;
+        ssize_t batch_id = -1;
+        ssize_t size = 0;
+        TensorPtr indices;
+        TensorVec buffers;
+    };
+
+    void worker_();
+    void fill_slot_(Slot &slot, const int64_t *indices, ssize_t size);
+    void gather_rows_(size_t input, const TensorPtr &dst, const int64_t *indices, ssize_t size);
+    void alloc_slot_(Slot &slot);
+    bool is_slot_shared_(const Slot &slot) const;
+
+    TensorVec m_data;
+    DataLoaderOptions m_options;
+    URBG m_rng;
+
+    std::vector<Slot> m_slots;
+    ssize_t m_next_produce = 0;
+    ssize_t m_next_consume = 0;
+    ssize_t m_held_slot = -1;
+
+    ssize_t m_permutation_epoch = -1;
+    TensorPtr m_permutation;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv_ready;
+    std::condition_variable m_cv_free;
+    bool m_stop = false;
+    std::vector<std::thread> m_workers;
+};
+
+} /* !namespace ncg */
+
@@ -0,0 +1,144 @@
+/*
+ * idx.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "data/idx.h"
+#include "core/tensor_impl.h"
+
+#include <fstream>
+
+#if defined(_WIN32) || defined(__WIN32__)
+    #define NCG_NO_MMAP
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace ncg {
+
+MappedFile::MappedFile(const std::string &filename) : m_data(nullptr), m_size(0), m_mapped(false) {
+#ifndef NCG_NO_MMAP
+    int fd = open(filename.c_str(), O_RDONLY);
+    ncg_assert_msg(fd >= 0, "cannot open " + filename);
+    struct stat st;
+    ncg_assert(fstat(fd, &st) == 0);
+    m_size = static_cast<size_t>(st.st_size);
+    if (m_size > 0) {
+        void *ptr = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ncg_assert_msg(ptr != MAP_FAILED, "cannot mmap " + filename);
+        madvise(ptr, m_size, MADV_WILLNEED);
+        m_data = static_cast<char *>(ptr);
+        m_mapped = true;
+    }
+    close(fd);
+#else
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    ncg_assert_msg(bool(file), "cannot open " + filename);
+    m_size = static_cast<size_t>(file.tellg());
+    m_data = new char[m_size];
+    file.seekg(0);
+    file.read(m_data, m_size);
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifndef NCG_NO_MMAP
+    if (m_mapped) munmap(m_data, m_size);
+#else
+    delete []m_data;
+#endif
+    m_data = nullptr;
+}
+
+const char *MappedFile::data() const {
+    return m_data;
+}
+
+size_t MappedFile::size() const {
+    return m_size;
+}
+
+namespace {
+
+inline uint32_t read_be32(const unsigned char *p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+template <typename T, typename U>
+void copy_be(const unsigned char *src, T *dst, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        U v = 0;
+        for (size_t b = 0; b < sizeof(U); ++b) v = (v << 8) | static_cast<U>(src[i * sizeof(U) + b]);
+        T out;
+        if (sizeof(T) == sizeof(U)) {
+            memcpy(&out, &v, sizeof(T));
+        } else {
+            out = static_cast<T>(static_cast<typename std::make_signed<U>::type>(v));
+        }
+        dst[i] = out;
+    }
+}
+
+} /* !namespace <anonymous> */
+
+TensorPtr read_idx(const std::string &filename) {
+    auto file = std::make_shared<MappedFile>(filename);
+    const unsigned char *data = reinterpret_cast<const unsigned char *>(file->data());
+    ncg_assert_msg(file->size() >= 4 && data[0] == 0 && data[1] == 0, "invalid IDX file " + filename);
+
+    unsigned char type = data[2];
+    size_t dim = data[3];
+    ncg_assert_msg(dim <= TensorMaxDim && file->size() >= 4 + 4 * dim, "invalid IDX file " + filename);
+
+    ShapeVec shape;
+    size_t numel = 1;
+    for (size_t i = 0; i < dim; ++i) {
+        shape.push_back(read_be32(data + 4 + 4 * i));
+        numel *= shape.back();
+    }
+
+    const unsigned char *payload = data + 4 + 4 * dim;
+    size_t payload_size = file->size() - 4 - 4 * dim;
+
+    DTypeName dtype;
+    size_t elem_size;
+    switch (type) {
+        case 0x08: dtype = DTypeName::UInt8; elem_size = 1; break;
+        case 0x09: dtype = DTypeName::Int8; elem_size = 1; break;
+        case 0x0B: dtype = DTypeName::Int32; elem_size = 2; break;
+        case 0x0C: dtype = DTypeName::Int32; elem_size = 4; break;
+        case 0x0D: dtype = DTypeName::Float32; elem_size = 4; break;
+        case 0x0E: dtype = DTypeName::Float64; elem_size = 8; break;
+        default: ncg_assert_msg(false, "unsupported IDX data type in " + filename); return nullptr;
+    }
+    ncg_assert_msg(payload_size >= numel * elem_size, "truncated IDX file " + filename);
+
+    TensorDesc desc(dtype, shape);
+    if (dtype == DTypeName::UInt8) {
+        auto ptr = const_cast<uint8_t *>(reinterpret_cast<const uint8_t *>(payload));
+        std::shared_ptr<TensorStorage> storage(new TensorStorageImpl<DTypeName::UInt8>(ptr, numel, file));
+        return tensor(desc, storage, false);
+    }
+    if (dtype == DTypeName::Int8) {
+        auto ptr = const_cast<int8_t *>(reinterpret_cast<const int8_t *>(payload));
+        std::shared_ptr<TensorStorage> storage(new TensorStorageImpl<DTypeName::Int8>(ptr, numel, file));
+        return tensor(desc, storage, false);
+    }
+
+    auto output = empty(dtype, shape);
+    switch (type) {
+        case 0x0B: copy_be<int32_t, uint16_t>(payload, output->as<DTypeName::Int32>()->mutable_data_ptr(), numel); break;
+        case 0x0C: copy_be<int32_t, uint32_t>(payload, output->as<DTypeName::Int32>()->mutable_data_ptr(), numel); break;
+        case 0x0D: copy_be<float, uint32_t>(payload, output->as<DTypeName::Float32>()->mutable_data_ptr(), numel); break;
+        case 0x0E: copy_be<double, uint64_t>(payload, output->as<DTypeName::Float64>()->mutable_data_ptr(), numel); break;
+    }
+    return output;
+}
+
+} /* !namespace ncg */
+
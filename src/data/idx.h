@@ -0,0 +1,46 @@
+/*
+ * idx.h
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#pragma once
+
+#include "core/common.h"
+#include "core/tensor.h"
+
+#include <string>
+
+namespace ncg {
+
+/*
+ * A read-only memory mapping of a whole file. Falls back to reading the file into memory on
+ * platforms without mmap.
+ */
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &filename);
+    virtual ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile(MappedFile &&) = delete;
+
+    const char *data() const;
+    size_t size() const;
+
+protected:
+    char *m_data;
+    size_t m_size;
+    bool m_mapped;
+};
+
+/*
+ * Read a file in the IDX format (used by MNIST). The file is memory-mapped; single-byte data
+ * (UInt8/Int8) is exposed as a tensor view into the mapping without any copy. Multi-byte data is
+ * stored big-endian and is converted into a fresh tensor (Int16 is widened to Int32).
+ */
+TensorPtr read_idx(const std::string &filename);
+
+} /* !namespace ncg */
+
@@ -6,13 +6,25 @@
  */
 
 #include "graph/graph.h"
+#include "graph/checkpoint.h"
+#include "graph/cost_model.h"
+#include "graph/export.h"
+#include "graph/mixed_precision.h"
 #include "graph/op.h"
+#include "graph/perf_counters.h"
+#include "graph/profiler.h"
+#include "graph/serialize.h"
+#include "graph/ops/conv.h"
 #include "graph/ops/elemwise.h"
+#include "graph/ops/embedding.h"
 #include "graph/ops/grad.h"
 #include "graph/ops/linalg.h"
+#include "graph/ops/mixed_precision.h"
 #include "graph/ops/netsrc.h"
+#include "graph/ops/quantize.h"
 #include "graph/ops/reduction.h"
 #include "graph/ops/shape.h"
 #include "graph/ops/slice.h"
+#include "graph/ops/sparse.h"
 #include "graph/ops/update.h"
 
@@ -0,0 +1,345 @@
+/*
+ * checkpoint.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "graph/checkpoint.h"
+#include "core/parallel.h"
+#include "graph/op.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+
+namespace ncg {
+
+namespace {
+
+const int64_t CheckpointManifestVersion = 1;
+
+std::string join_path(const std::string &dirname, const std::string &filename) {
+    return (std::filesystem::path(dirname) / filename).string();
+}
+
+std::string shard_filename(size_t index) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "shard-%05zu.ncg", index);
+    return buf;
+}
+
+} /* !namespace <anonymous> */
+
+uint64_t tensor_content_hash(const TensorPtr &tensor) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    auto mix = [&h](uint64_t v) {
+        h = (h ^ v) * 0x9e3779b97f4a7c15ULL;
+        h ^= h >> 32;
+    };
+
+    const auto &desc = tensor->desc();
+    mix(static_cast<uint64_t>(desc.dtype()));
+    for (size_t i = 0; i < desc.dim(); ++i) {
+        mix(static_cast<uint64_t>(desc.shape(i)));
+        mix(static_cast<uint64_t>(desc.stride(i)));
+    }
+    mix(static_cast<uint64_t>(tensor->data_ptr_offset()));
+
+    auto storage = tensor->storage();
+    const char *data = reinterpret_cast<const char *>(storage->raw_data_ptr());
+    size_t size = storage->memsize();
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t v;
+        memcpy(&v, data + i, sizeof(v));
+        mix(v);
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, data + i, size - i);
+    mix(tail ^ size);
+
+    return h;
+}
+
+Checkpointer::Checkpointer(Session &session, const std::string &dirname, const CheckpointOptions &options) :
+    m_session(session), m_dirname(dirname), m_options(options) {
+    // pass
+}
+
+const std::string &Checkpointer::dirname() const {
+    return m_dirname;
+}
+
+const CheckpointOptions &Checkpointer::options() const {
+    return m_options;
+}
+
+const std::vector<CheckpointShard> &Checkpointer::shards() const {
+    return m_shards;
+}
+
+const CompressionStats &Checkpointer::compression_stats() const {
+    return m_compression_stats;
+}
+
+const CompressionStats &Checkpointer::decompression_stats() const {
+    return m_decompression_stats;
+}
+
+std::string Checkpointer::manifest_filename(const std::string &dirname) {
+    return join_path(dirname, "manifest.ncg");
+}
+
+size_t Checkpointer::save() {
+    std::filesystem::create_directories(m_dirname);
+
+    // A fresh checkpointer can still skip unchanged shards if the hashes on disk are usable.
+    if (m_options.delta && m_options.content_hash && m_shards.empty()) {
+        read_manifest_();
+    }
+
+    auto entries = collect_entries_();
+    auto shards = plan_shards_(entries);
+
+    std::unordered_map<std::string, const Entry *> entry_by_name;
+    for (const auto &entry : entries) entry_by_name[entry.name] = &entry;
+
+    bool same_layout = m_options.delta && shards.size() == m_shards.size();
+    for (size_t i = 0; same_layout && i < shards.size(); ++i) {
+        same_layout = shards[i].filename == m_shards[i].filename && shards[i].names == m_shards[i].names;
+    }
+
+    std::vector<size_t> dirty;
+    std::vector<std::vector<const Entry *>> shard_entries(shards.size());
+    for (size_t i = 0; i < shards.size(); ++i) {
+        bool changed = !same_layout;
+        for (const auto &name : shards[i].names) {
+            const Entry *entry = entry_by_name[name];
+            shard_entries[i].push_back(entry);
+            changed = changed || is_changed_(*entry);
+        }
+        if (changed) dirty.push_back(i);
+    }
+
+    // Compress across all tensors first, so that a shard with a single large tensor does not
+    // serialize the whole save, then write the shards.
+    std::vector<const Entry *> to_compress;
+    for (size_t i : dirty) to_compress.insert(to_compress.end(), shard_entries[i].begin(), shard_entries[i].end());
+
+    std::vector<CompressedTensor> compressed(to_compress.size());
+    auto start = std::chrono::steady_clock::now();
+    parallel_for(to_compress.size(), nr_workers_(), [&](size_t i) {
+        compressed[i] = CompressedTensor(to_compress[i]->tensor, m_options.codec);
+    });
+    m_compression_stats = CompressionStats();
+    m_compression_stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (const auto &t : compressed) {
+        m_compression_stats.raw_bytes += t.raw_size();
+        m_compression_stats.compressed_bytes += t.compressed_size();
+    }
+
+    std::vector<std::vector<const CompressedTensor *>> shard_tensors(dirty.size());
+    for (size_t i = 0, k = 0; i < dirty.size(); ++i) {
+        for (size_t j = 0; j < shard_entries[dirty[i]].size(); ++j) shard_tensors[i].push_back(&compressed[k++]);
+    }
+    parallel_for(dirty.size(), nr_workers_(), [&](size_t i) {
+        write_shard_(shards[dirty[i]], shard_tensors[i]);
+    });
+
+    // Remove the shards of a previous (larger) layout only once the new manifest is in place:
+    // a crash in between leaves unused files, never a manifest pointing at deleted shards.
+    auto old_shards = std::move(m_shards);
+    m_shards = std::move(shards);
+    write_manifest_();
+
+    for (const auto &old_shard : old_shards) {
+        bool alive = false;
+        for (const auto &shard : m_shards) alive = alive || shard.filename == old_shard.filename;
+        if (!alive) std::remove(join_path(m_dirname, old_shard.filename).c_str());
+    }
+
+    for (const auto &entry : entries) {
+        remember_(entry.name, entry.tensor, entry.hash);
+    }
+    return dirty.size();
+}
+
+void Checkpointer::load() {
+    ncg_assert_msg(read_manifest_(), "missing checkpoint manifest in " + m_dirname);
+
+    std::vector<std::vector<CompressedTensor>> loaded(m_shards.size());
+    parallel_for(m_shards.size(), nr_workers_(), [&](size_t i) {
+        const auto &shard = m_shards[i];
+        NCGUnpickler unpickler(join_path(m_dirname, shard.filename));
+
+        size_t size = static_cast<size_t>(unpickler.read_int64());
+        ncg_assert(size == shard.names.size());
+        for (size_t j = 0; j < size; ++j) {
+            ncg_assert(unpickler.read_string() == shard.names[j]);
+            loaded[i].emplace_back(unpickler);
+        }
+
+        unpickler.close();
+    });
+
+    std::vector<std::pair<size_t, size_t>> index;
+    for (size_t i = 0; i < loaded.size(); ++i) {
+        for (size_t j = 0; j < loaded[i].size(); ++j) index.emplace_back(i, j);
+    }
+
+    std::vector<TensorPtr> tensors(index.size());
+    auto start = std::chrono::steady_clock::now();
+    parallel_for(index.size(), nr_workers_(), [&](size_t k) {
+        tensors[k] = loaded[index[k].first][index[k].second].decompress();
+    });
+    m_decompression_stats = CompressionStats();
+    m_decompression_stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    auto &graph = m_session.graph();
+    for (size_t k = 0; k < index.size(); ++k) {
+        size_t i = index[k].first, j = index[k].second;
+        m_decompression_stats.raw_bytes += loaded[i][j].raw_size();
+        m_decompression_stats.compressed_bytes += loaded[i][j].compressed_size();
+
+        const auto &name = m_shards[i].names[j];
+        auto op = graph.find_op(name);
+        if (op != nullptr) {
+            m_session.set_shared_tensor(op->outputs()[0], tensors[k]);
+            remember_(name, tensors[k], m_shards[i].hashes[j]);
+        }
+    }
+}
+
+std::vector<Checkpointer::Entry> Checkpointer::collect_entries_() const {
+    std::vector<Entry> entries;
+    for (const auto &it : m_session.shared_tensors()) {
+        auto gtensor = reinterpret_cast<GraphTensor *>(it.first);
+        const auto &tensor = it.second;
+        size_t nbytes = tensor->storage()->memsize() + 2 * sizeof(int64_t) * (TensorMaxDim + 1);
+        entries.push_back(Entry{gtensor->owner_op()->name(), tensor, nbytes, 0});
+    }
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) { return a.name < b.name; });
+
+    if (m_options.content_hash) {
+        parallel_for(entries.size(), nr_workers_(), [&](size_t i) {
+            entries[i].hash = tensor_content_hash(entries[i].tensor);
+        });
+    }
+    return entries;
+}
+
+std::vector<CheckpointShard> Checkpointer::plan_shards_(const std::vector<Entry> &entries) const {
+    // Greedy packing in name order: deterministic, and stable as long as the variables and
+    // their sizes do not change, which is what makes delta checkpoints effective.
+    std::vector<CheckpointShard> shards;
+    for (const auto &entry : entries) {
+        if (shards.empty() || (shards.back().nbytes > 0 && shards.back().nbytes + entry.nbytes > m_options.shard_size)) {
+            shards.emplace_back();
+            shards.back().filename = shard_filename(shards.size() - 1);
+        }
+        shards.back().names.push_back(entry.name);
+        shards.back().hashes.push_back(entry.hash);
+        shards.back().nbytes += entry.nbytes;
+    }
+    return shards;
+}
+
+bool Checkpointer::is_changed_(const Entry &entry) const {
+    if (m_options.content_hash) {
+        auto it = m_saved_hashes.find(entry.name);
+        return it == m_saved_hashes.end() || it->second != entry.hash;
+    }
+
+    // A live weak_ptr pointing at the same object guarantees that the address was not reused.
+    auto it = m_saved_tensors.find(entry.name);
+    auto jt = m_saved_storages.find(entry.name);
+    if (it == m_saved_tensors.end() || jt == m_saved_storages.end()) return true;
+    auto tensor = it->second.lock();
+    auto storage = jt->second.lock();
+    if (tensor == nullptr || storage == nullptr || tensor.get() != entry.tensor.get() || storage.get() != entry.tensor->storage().get()) return true;
+    // The same storage, updated in place (e.g., the rows of an embedding table, see GOpAssignAddRows).
+    return storage->version() != m_saved_versions.at(entry.name);
+}
+
+void Checkpointer::remember_(const std::string &name, const TensorPtr &tensor, uint64_t hash) {
+    m_saved_tensors[name] = tensor;
+    m_saved_storages[name] = std::shared_ptr<const TensorStorage>(tensor->storage());
+    m_saved_versions[name] = tensor->storage()->version();
+    m_saved_hashes[name] = hash;
+}
+
+void Checkpointer::write_shard_(const CheckpointShard &shard, const std::vector<const CompressedTensor *> &tensors) const {
+    std::string filename = join_path(m_dirname, shard.filename);
+    std::string tmp_filename = filename + ".tmp";
+
+    {
+        NCGPickler pickler(tmp_filename, m_options.pickle_flags);
+        pickler.write(static_cast<int64_t>(tensors.size()));
+        for (size_t i = 0; i < tensors.size(); ++i) {
+            pickler.write(shard.names[i]);
+            tensors[i]->pickle(pickler);
+        }
+        pickler.close();
+    }
+
+    std::filesystem::rename(tmp_filename, filename);
+}
+
+void Checkpointer::write_manifest_() const {
+    std::string filename = manifest_filename(m_dirname);
+    std::string tmp_filename = filename + ".tmp";
+
+    {
+        NCGPickler pickler(tmp_filename, NCGPickleChecksum);
+        pickler.write(CheckpointManifestVersion);
+        pickler.write(static_cast<int64_t>(m_shards.size()));
+        for (const auto &shard : m_shards) {
+            pickler.write(shard.filename);
+            pickler.write(static_cast<int64_t>(shard.nbytes));
+            pickler.write(static_cast<int64_t>(shard.names.size()));
+            for (size_t i = 0; i < shard.names.size(); ++i) {
+                pickler.write(shard.names[i]);
+                pickler.write(static_cast<int64_t>(shard.hashes[i]));
+            }
+        }
+        pickler.close();
+    }
+
+    std::filesystem::rename(tmp_filename, filename);
+}
+
+bool Checkpointer::read_manifest_() {
+    std::string filename = manifest_filename(m_dirname);
+    if (!std::filesystem::exists(filename)) {
+        return false;
+    }
+
+    NCGUnpickler unpickler(filename);
+    int64_t version = unpickler.read_int64();
+    ncg_assert_msg(version <= CheckpointManifestVersion, "unsupported checkpoint manifest version");
+
+    m_shards.clear();
+    m_shards.resize(static_cast<size_t>(unpickler.read_int64()));
+    for (auto &shard : m_shards) {
+        shard.filename = unpickler.read_string();
+        shard.nbytes = static_cast<size_t>(unpickler.read_int64());
+        size_t size = static_cast<size_t>(unpickler.read_int64());
+        for (size_t i = 0; i < size; ++i) {
+            shard.names.push_back(unpickler.read_string());
+            shard.hashes.push_back(static_cast<uint64_t>(unpickler.read_int64()));
+            m_saved_hashes[shard.names.back()] = shard.hashes.back();
+        }
+    }
+    unpickler.close();
+    return true;
+}
+
+size_t Checkpointer::nr_workers_() const {
+    if (m_options.nr_workers > 0) return m_options.nr_workers;
+    return get_hardware_concurrency();
+}
+
+} /* !namespace ncg */
+
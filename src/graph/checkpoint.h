@@ -0,0 +1,100 @@
+/*
+ * checkpoint.h
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#pragma once
+
+#include "core/tensor.h"
+#include "core/compress.h"
+#include "graph/graph.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace ncg {
+
+struct CheckpointOptions {
+    // Tensors are packed (sorted by name) into shards of roughly this many bytes.
+    size_t shard_size = 64 * 1024 * 1024;
+    // Number of writer/reader threads; 0 means one per hardware thread.
+    size_t nr_workers = 0;
+    // Only rewrite the shards whose tensors changed since the last save.
+    bool delta = true;
+    // Detect changes by hashing the tensor contents instead of by storage identity (and version, see TensorStorage).
+    bool content_hash = false;
+    uint32_t pickle_flags = NCGPickleChecksum;
+    // Per-tensor compression; tensors are compressed and decompressed in parallel.
+    CompressionCodec codec = CompressionCodec::None;
+};
+
+struct CheckpointShard {
+    std::string filename;
+    std::vector<std::string> names;
+    std::vector<uint64_t> hashes;
+    size_t nbytes = 0;
+};
+
+/*
+ * A checkpoint is a directory holding a manifest and a set of shards. Each shard is an
+ * ordinary pickle file with the same record layout as Session::save_shared_tensors.
+ */
+class Checkpointer {
+public:
+    Checkpointer(Session &session, const std::string &dirname, const CheckpointOptions &options = CheckpointOptions());
+    virtual ~Checkpointer() = default;
+
+    // Returns the number of shards that were (re)written.
+    size_t save();
+    void load();
+
+    const std::string &dirname() const;
+    const CheckpointOptions &options() const;
+    const std::vector<CheckpointShard> &shards() const;
+    // Statistics of the last save() and load() respectively.
+    const CompressionStats &compression_stats() const;
+    const CompressionStats &decompression_stats() const;
+
+    static std::string manifest_filename(const std::string &dirname);
+
+protected:
+    struct Entry {
+        std::string name;
+        TensorPtr tensor;
+        size_t nbytes;
+        uint64_t hash;
+    };
+
+    std::vector<Entry> collect_entries_() const;
+    std::vector<CheckpointShard> plan_shards_(const std::vector<Entry> &entries) const;
+    bool is_changed_(const Entry &entry) const;
+    void remember_(const std::string &name, const TensorPtr &tensor, uint64_t hash);
+
+    void write_shard_(const CheckpointShard &shard, const std::vector<const CompressedTensor *> &tensors) const;
+    void write_manifest_() const;
+    bool read_manifest_();
+
+    size_t nr_workers_() const;
+
+    Session &m_session;
+    std::string m_dirname;
+    CheckpointOptions m_options;
+
+    std::vector<CheckpointShard> m_shards;
+    std::unordered_map<std::string, std::weak_ptr<Tensor>> m_saved_tensors;
+    std::unordered_map<std::string, std::weak_ptr<const TensorStorage>> m_saved_storages;
+    std::unordered_map<std::string, uint64_t> m_saved_versions;
+    std::unordered_map<std::string, uint64_t> m_saved_hashes;
+
+    CompressionStats m_compression_stats;
+    CompressionStats m_decompression_stats;
+};
+
+uint64_t tensor_content_hash(const TensorPtr &tensor);
+
+} /* !namespace ncg */
+
@@ -0,0 +1,196 @@
+/*
+ * cost_model.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "graph/cost_model.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+
+namespace ncg {
+
+namespace {
+
+const size_t PeakFMALanes = 64;
+const size_t PeakFMAIterations = 1 << 16;
+const size_t PeakCopyBytes = 64 << 20;
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/* Independent accumulators, so that the loop is bound by the throughput (not the latency) of the FPU. */
+double measure_gflops(double min_seconds) {
+    float acc[PeakFMALanes];
+    for (size_t i = 0; i < PeakFMALanes; ++i) acc[i] = static_cast<float>(i);
+    volatile float a_ = 0.999f, b_ = 0.001f;
+    float a = a_, b = b_;
+
+    double best = 0;
+    auto begin = std::chrono::steady_clock::now();
+    do {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t j = 0; j < PeakFMAIterations; ++j) {
+            for (size_t i = 0; i < PeakFMALanes; ++i) acc[i] = acc[i] * a + b;
+        }
+        double seconds = seconds_since(start);
+        best = std::max(best, 2.0 * PeakFMALanes * PeakFMAIterations / seconds / 1e9);
+    } while (seconds_since(begin) < min_seconds);
+
+    volatile float sink = 0;
+    for (size_t i = 0; i < PeakFMALanes; ++i) sink = sink + acc[i];
+    return best;
+}
+
+double measure_gbytes_per_second(double min_seconds) {
+    std::vector<char> src(PeakCopyBytes, 1), dst(PeakCopyBytes, 0);
+
+    double best = 0;
+    auto begin = std::chrono::steady_clock::now();
+    do {
+        auto start = std::chrono::steady_clock::now();
+        memcpy(dst.data(), src.data(), PeakCopyBytes);
+        double seconds = seconds_since(start);
+        // Both the read and the write traffic.
+        best = std::max(best, 2.0 * PeakCopyBytes / seconds / 1e9);
+        std::swap(src, dst);
+    } while (seconds_since(begin) < min_seconds);
+
+    volatile char sink = dst[PeakCopyBytes / 2];
+    (void)sink;
+    return best;
+}
+
+} /* !namespace <anonymous> */
+
+double MachinePeak::ridge() const {
+    return gbytes_per_second > 0 ? gflops / gbytes_per_second : 0;
+}
+
+double MachinePeak::attainable_gflops(double intensity) const {
+    return std::min(gflops, intensity * gbytes_per_second);
+}
+
+double MachinePeak::roof_time(const OpCost &cost) const {
+    double compute = gflops > 0 ? cost.flops / (gflops * 1e3) : 0;
+    double memory = gbytes_per_second > 0 ? cost.bytes() / (gbytes_per_second * 1e3) : 0;
+    return std::max(compute, memory);
+}
+
+std::ostream &operator << (std::ostream &out, const MachinePeak &peak) {
+    out << std::fixed << std::setprecision(2);
+    out << "MachinePeak(" << peak.gflops << " GFLOP/s, " << peak.gbytes_per_second << " GB/s, ridge=" << peak.ridge() << " FLOP/B)";
+    out << std::defaultfloat;
+    return out;
+}
+
+MachinePeak measure_machine_peak(double min_seconds) {
+    MachinePeak peak;
+    peak.gflops = measure_gflops(min_seconds);
+    peak.gbytes_per_second = measure_gbytes_per_second(min_seconds);
+    return peak;
+}
+
+RooflineReport::RooflineReport(const GraphProfiler &profiler, const MachinePeak &peak) : m_peak(peak) {
+    m_by_op_type = make_rows_(profiler.summary_by_op_type());
+    m_by_name = make_rows_(profiler.summary_by_name());
+
+    GraphProfileSummary total;
+    total.key = "total";
+    for (const auto &event : profiler.events()) {
+        total.count += 1;
+        total.total += event.duration;
+        total.cost += event.cost;
+    }
+    m_total = make_row_(total);
+}
+
+const MachinePeak &RooflineReport::peak() const {
+    return m_peak;
+}
+
+const std::vector<RooflineRow> &RooflineReport::by_op_type() const {
+    return m_by_op_type;
+}
+
+const std::vector<RooflineRow> &RooflineReport::by_name() const {
+    return m_by_name;
+}
+
+const RooflineRow &RooflineReport::total() const {
+    return m_total;
+}
+
+RooflineRow RooflineReport::make_row_(const GraphProfileSummary &summary) const {
+    RooflineRow row;
+    row.key = summary.key;
+    row.count = summary.count;
+    row.total = summary.total;
+    row.cost = summary.cost;
+    row.gflops = summary.gflops();
+    row.gbytes_per_second = summary.gbytes_per_second();
+    row.memory_bound = row.cost.intensity() < m_peak.ridge();
+
+    double roof_time = m_peak.roof_time(row.cost);
+    row.efficiency = row.total > 0 ? std::min(roof_time / row.total, 1.0) : 0;
+    row.headroom = std::max(row.total - roof_time, 0.0);
+    return row;
+}
+
+std::vector<RooflineRow> RooflineReport::make_rows_(const std::vector<GraphProfileSummary> &summaries) const {
+    std::vector<RooflineRow> rows;
+    for (const auto &summary : summaries) {
+        rows.emplace_back(make_row_(summary));
+    }
+    std::stable_sort(rows.begin(), rows.end(), [](const RooflineRow &a, const RooflineRow &b) {
+        return a.headroom > b.headroom;
+    });
+    return rows;
+}
+
+namespace {
+
+const size_t RooflineMaxPrint = 20;
+
+void print_row(std::ostream &out, const RooflineRow &row) {
+    out << "  " << std::left << std::setw(40) << row.key << std::right
+        << std::setw(8) << row.count << std::setw(12) << row.total / 1000
+        << std::setw(10) << row.cost.flops / 1e6 << std::setw(10) << row.cost.bytes() / 1e6
+        << std::setw(10) << row.cost.intensity() << std::setw(10) << row.gflops << std::setw(10) << row.gbytes_per_second
+        << std::setw(9) << (row.memory_bound ? "memory" : "compute")
+        << std::setw(9) << row.efficiency * 100 << std::setw(14) << row.headroom / 1000 << std::endl;
+}
+
+void print_rows(std::ostream &out, const std::string &title, const std::vector<RooflineRow> &rows) {
+    out << title << ":" << std::endl;
+    out << "  " << std::left << std::setw(40) << "key" << std::right
+        << std::setw(8) << "count" << std::setw(12) << "total(ms)"
+        << std::setw(10) << "MFLOP" << std::setw(10) << "MB" << std::setw(10) << "FLOP/B"
+        << std::setw(10) << "GFLOP/s" << std::setw(10) << "GB/s"
+        << std::setw(9) << "bound" << std::setw(9) << "%roof" << std::setw(14) << "headroom(ms)" << std::endl;
+    for (size_t i = 0; i < std::min(rows.size(), RooflineMaxPrint); ++i) {
+        print_row(out, rows[i]);
+    }
+    if (rows.size() > RooflineMaxPrint) {
+        out << "  ... (" << rows.size() - RooflineMaxPrint << " more)" << std::endl;
+    }
+}
+
+} /* !namespace <anonymous> */
+
+std::ostream &operator << (std::ostream &out, const RooflineReport &report) {
+    out << report.peak() << std::endl;
+    out << std::fixed << std::setprecision(2);
+    print_rows(out, "Roofline per op type", report.by_op_type());
+    print_rows(out, "Roofline per op", report.by_name());
+    print_row(out, report.total());
+    out << std::defaultfloat;
+    return out;
+}
+
+} /* !namespace ncg */
@@ -0,0 +1,82 @@
+/*
+ * cost_model.h
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#pragma once
+
+#include "graph/op.h"
+#include "graph/profiler.h"
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ncg {
+
+/* Single-thread roofs of the machine. */
+struct MachinePeak {
+    double gflops = 0;
+    double gbytes_per_second = 0;
+
+    // The arithmetic intensity (FLOPs per byte) at which the op becomes compute bound.
+    double ridge() const;
+    double attainable_gflops(double intensity) const;
+    // The minimum time (in microseconds) for the given amount of work.
+    double roof_time(const OpCost &cost) const;
+
+    friend std::ostream &operator << (std::ostream &out, const MachinePeak &peak);
+};
+
+/*
+ * Measure the roofs with a multiply-add loop and a large memcpy. NB: this is the peak of the code as
+ * compiled by this build (same flags as the kernels), which can be far below the datasheet peak of the CPU.
+ */
+MachinePeak measure_machine_peak(double min_seconds = 0.05);
+
+struct RooflineRow {
+    std::string key;
+    size_t count = 0;
+    // In microseconds.
+    double total = 0;
+    OpCost cost;
+
+    double gflops = 0;
+    double gbytes_per_second = 0;
+    bool memory_bound = false;
+    // Time at the roof divided by the measured time.
+    double efficiency = 0;
+    // Time (in microseconds) that would be saved by running at the roof.
+    double headroom = 0;
+};
+
+/*
+ * Combine the static costs (GraphOp::cost) with the times measured by a profiler. The rows are sorted by
+ * decreasing headroom, i.e., the ops to optimize first come first.
+ */
+class RooflineReport {
+public:
+    RooflineReport(const GraphProfiler &profiler, const MachinePeak &peak);
+    virtual ~RooflineReport() = default;
+
+    const MachinePeak &peak() const;
+    const std::vector<RooflineRow> &by_op_type() const;
+    const std::vector<RooflineRow> &by_name() const;
+    // Totals over all the ops.
+    const RooflineRow &total() const;
+
+    friend std::ostream &operator << (std::ostream &out, const RooflineReport &report);
+
+protected:
+    RooflineRow make_row_(const GraphProfileSummary &summary) const;
+    std::vector<RooflineRow> make_rows_(const std::vector<GraphProfileSummary> &summaries) const;
+
+    MachinePeak m_peak;
+    std::vector<RooflineRow> m_by_op_type;
+    std::vector<RooflineRow> m_by_name;
+    RooflineRow m_total;
+};
+
+} /* !namespace ncg */
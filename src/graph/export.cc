@@ -0,0 +1,209 @@
+/*
+ * export.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "graph/export.h"
+
+#include <fstream>
+#include <iomanip>
+
+namespace ncg {
+
+namespace {
+
+bool is_static_desc(const TensorDesc &desc) {
+    for (ssize_t i = 0; i < desc.dim(); ++i) {
+        if (desc.shape(i) < 0) return false;
+    }
+    return true;
+}
+
+void write_dot_string(std::ostream &out, const std::string &str) {
+    out << '"';
+    for (char c : str) {
+        if (c == '\n') {
+            out << "\\n";
+            continue;
+        }
+        if (c == '"' || c == '\\') out << '\\';
+        out << c;
+    }
+    out << '"';
+}
+
+std::string format_desc(const TensorDesc &desc) {
+    std::ostringstream ss;
+    ss << get_dtype_name(desc.dtype()) << desc.shape_vec();
+    return ss.str();
+}
+
+} /* !namespace <anonymous> */
+
+GraphExporter::GraphExporter(Graph &graph) : m_graph(graph) {
+    for (const auto &op : graph.ops()) {
+        m_ids.emplace(op.get(), m_ops.size());
+        m_ops.emplace_back(op.get());
+    }
+}
+
+void GraphExporter::set_targets(const GTensorVec &targets) {
+    GraphTopoSorter sorter(m_graph);
+    sorter.sort(targets);
+    m_ops.assign(sorter.sorted().begin(), sorter.sorted().end());
+}
+
+void GraphExporter::set_profiler(const GraphProfiler *profiler) {
+    m_profiler = profiler;
+    m_profile.clear();
+    m_profile_index.clear();
+    m_profile_total = 0;
+    if (profiler == nullptr) {
+        return;
+    }
+
+    m_profile = profiler->summary_by_name();
+    for (size_t i = 0; i < m_profile.size(); ++i) {
+        m_profile_index.emplace(m_profile[i].key, i);
+        m_profile_total += m_profile[i].total;
+    }
+}
+
+std::vector<GraphExporter::Node> GraphExporter::nodes_() const {
+    std::vector<Node> nodes;
+    for (const auto op : m_ops) {
+        Node node{node_id_(op), op, m_graph.is_backward_op(op), OpCost(), nullptr};
+
+        auto it = m_profile_index.find(op->name());
+        if (it != m_profile_index.end()) {
+            node.profile = &m_profile[it->second];
+            node.cost = node.profile->cost;
+            node.cost.flops /= node.profile->count;
+            node.cost.bytes_read /= node.profile->count;
+            node.cost.bytes_written /= node.profile->count;
+        } else {
+            TensorDescVec inputs, outputs;
+            bool is_static = true;
+            for (const auto &t : op->inputs()) {
+                inputs.emplace_back(t->desc());
+                is_static &= is_static_desc(t->desc());
+            }
+            for (const auto &t : op->outputs()) {
+                outputs.emplace_back(t->desc());
+                is_static &= is_static_desc(t->desc());
+            }
+            if (is_static) node.cost = op->cost(inputs, outputs);
+        }
+        nodes.emplace_back(node);
+    }
+    return nodes;
+}
+
+size_t GraphExporter::node_id_(const GraphOp *op) const {
+    auto it = m_ids.find(op);
+    ncg_assert(it != m_ids.end());
+    return it->second;
+}
+
+void GraphExporter::dump_dot(std::ostream &out) const {
+    auto nodes = nodes_();
+
+    out << "digraph ncg {" << std::endl;
+    out << "  rankdir=TB;" << std::endl;
+    out << "  node [shape=box, style=filled, fillcolor=white, fontname=\"Helvetica\", fontsize=10];" << std::endl;
+    out << "  edge [fontname=\"Helvetica\", fontsize=8];" << std::endl;
+    out << std::fixed << std::setprecision(3);
+
+    for (int group = 0; group < 2; ++group) {
+        out << "  subgraph cluster_" << (group == 0 ? "forward" : "backward") << " {" << std::endl;
+        out << "    label=\"" << (group == 0 ? "forward" : "backward") << "\";" << std::endl;
+        for (const auto &node : nodes) {
+            if (node.backward != (group == 1)) continue;
+
+            std::ostringstream label;
+            label << std::fixed << std::setprecision(3);
+            label << node.op->name() << "\n" << node.op->op_name();
+            for (const auto &t : node.op->outputs()) {
+                label << "\n" << format_desc(t->desc());
+            }
+            if (node.cost.flops > 0) label << "\n" << node.cost.flops / 1e6 << " MFLOP";
+            if (node.profile != nullptr) {
+                label << "\n" << node.profile->mean() / 1000 << " ms x " << node.profile->count
+                      << ", " << node.profile->allocated_bytes / node.profile->count / 1024.0 << " KB";
+            }
+
+            out << "    op" << node.id << " [label=";
+            write_dot_string(out, label.str());
+            // The hotter the op, the redder the node.
+            if (node.profile != nullptr && m_profile_total > 0) {
+                out << ", fillcolor=\"0.000 " << node.profile->total / m_profile_total << " 1.000\"";
+            }
+            out << "];" << std::endl;
+        }
+        out << "  }" << std::endl;
+    }
+
+    for (const auto &node : nodes) {
+        for (const auto &t : node.op->inputs()) {
+            out << "  op" << node_id_(t->owner_op()) << " -> op" << node.id << " [label=";
+            write_dot_string(out, format_desc(t->desc()));
+            out << "];" << std::endl;
+        }
+    }
+    out << "}" << std::endl;
+    out << std::defaultfloat;
+}
+
+void GraphExporter::dump_dot(const std::string &filename) const {
+    std::ofstream out(filename);
+    ncg_assert_msg(out.good(), "cannot open " + filename);
+    dump_dot(out);
+}
+
+void GraphExporter::dump_json(std::ostream &out) const {
+    auto nodes = nodes_();
+
+    out << std::setprecision(15);
+    out << "{\"nodes\": [";
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        const auto &node = nodes[i];
+        out << (i == 0 ? "\n" : ",\n");
+        out << "{\"id\": " << node.id << ", \"name\": "; write_json_string(out, node.op->name());
+        out << ", \"op\": "; write_json_string(out, node.op->op_name());
+        out << ", \"group\": \"" << (node.backward ? "backward" : "forward") << "\"";
+
+        out << ", \"inputs\": [";
+        for (size_t j = 0; j < node.op->inputs().size(); ++j) {
+            const auto &t = node.op->inputs()[j];
+            out << (j == 0 ? "" : ", ") << "{\"op\": " << node_id_(t->owner_op()) << ", \"index\": " << t->owner_op_index() << "}";
+        }
+        out << "], \"outputs\": [";
+        for (size_t j = 0; j < node.op->outputs().size(); ++j) {
+            const auto &desc = node.op->outputs()[j]->desc();
+            out << (j == 0 ? "" : ", ") << "{\"dtype\": \"" << get_dtype_name(desc.dtype()) << "\", \"shape\": " << desc.shape_vec() << "}";
+        }
+        out << "]";
+
+        out << ", \"cost\": {\"flops\": " << node.cost.flops << ", \"bytes_read\": " << node.cost.bytes_read
+            << ", \"bytes_written\": " << node.cost.bytes_written << "}";
+        if (node.profile != nullptr) {
+            out << std::fixed << std::setprecision(3);
+            out << ", \"profile\": {\"count\": " << node.profile->count << ", \"total_us\": " << node.profile->total
+                << ", \"mean_us\": " << node.profile->mean() << ", \"allocated_bytes\": " << node.profile->allocated_bytes << "}";
+            out << std::defaultfloat << std::setprecision(15);
+        }
+        out << "}";
+    }
+    out << "\n]}" << std::endl;
+    out << std::defaultfloat;
+}
+
+void GraphExporter::dump_json(const std::string &filename) const {
+    std::ofstream out(filename);
+    ncg_assert_msg(out.good(), "cannot open " + filename);
+    dump_json(out);
+}
+
+} /* !namespace ncg */
@@ -0,0 +1,64 @@
+/*
+ * export.h
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#pragma once
+
+#include "graph/graph.h"
+#include "graph/op.h"
+#include "graph/profiler.h"
+
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ncg {
+
+/*
+ * Write a graph as GraphViz DOT (e.g., `dot -Tsvg graph.dot -o graph.svg`) or as JSON. The nodes are the
+ * ops, grouped into forward and backward (see Graph::is_backward_op), with their output dtypes and shapes
+ * and their static costs; the edges are the tensors. If a profiler is given, the time, the allocated
+ * memory and the measured cost of each op are included as well.
+ */
+class GraphExporter {
+public:
+    GraphExporter(Graph &graph);
+    virtual ~GraphExporter() = default;
+
+    // Only export the ops needed to compute the targets; by default, the whole graph is exported.
+    void set_targets(const GTensorVec &targets);
+    /* NB: the profiler is not owned by the exporter. */
+    void set_profiler(const GraphProfiler *profiler);
+
+    void dump_dot(std::ostream &out) const;
+    void dump_dot(const std::string &filename) const;
+    void dump_json(std::ostream &out) const;
+    void dump_json(const std::string &filename) const;
+
+protected:
+    struct Node {
+        size_t id;
+        const GraphOp *op;
+        bool backward;
+        // Per execution; measured if profiled, otherwise computed from the graph descs (if they are known).
+        OpCost cost;
+        const GraphProfileSummary *profile;
+    };
+
+    std::vector<Node> nodes_() const;
+    size_t node_id_(const GraphOp *op) const;
+
+    Graph &m_graph;
+    std::vector<const GraphOp *> m_ops;
+    std::unordered_map<const GraphOp *, size_t> m_ids;
+    const GraphProfiler *m_profiler = nullptr;
+    std::vector<GraphProfileSummary> m_profile;
+    std::unordered_map<std::string, size_t> m_profile_index;
+    double m_profile_total = 0;
+};
+
+} /* !namespace ncg */
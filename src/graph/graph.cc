@@ -8,7 +8,11 @@
 #include "graph/tensor.h"
 #include "graph/op.h"
 #include "graph/graph.h"
+#include "graph/ops/elemwise.h"
 #include "graph/ops/grad.h"
+#include "graph/ops/mixed_precision.h"
+#include "graph/ops/netsrc.h"
+#include "graph/profiler.h"
 
 namespace ncg {
 
@@ -43,7 +47,7 @@ void GraphTopoSorter::mark_(const GTensorPtr &t) {
     m_visited.emplace(opi);
 }
 
-Graph::Graph() : m_ops(), m_backproped_tensors() {
+Graph::Graph() : m_ops(), m_op_index(), m_name_index(), m_backproped_tensors(), m_backward_ops() {
     // pass
 }
 
@@ -53,17 +57,69 @@ std::ostringstream &Graph::error(const GraphOp *op) {
     return error;
 }
 
+GOpPtr Graph::add_op(GraphOp *op, OpDescPtr desc, const GTensorVec &inputs) {
+    (*op)(*this, desc, inputs);
+    return register_op_(op);
+}
+
+GOpPtr Graph::register_op_(GraphOp *op) {
+    ncg_assert_msg(ok(), error_str());
+    auto op_ptr = GOpPtr(op);
+    if (op->has_name()) {
+        const auto &name = op->name();
+        ncg_assert_msg(m_name_index.find(name) == m_name_index.end(), "Duplicate op name: " + name + ".");
+        m_name_index.emplace(name, op_ptr);
+    }
+    m_op_index.emplace(op, m_ops.size());
+    m_ops.push_back(op_ptr);
+    return op_ptr;
+}
+
+void Graph::rename_op_(GraphOp *op, const std::string &name) {
+    auto it = m_op_index.find(op);
+    if (it == m_op_index.end()) {
+        // Not registered yet; see register_op_.
+        return;
+    }
+    if (op->has_name() && op->name() == name) {
+        return;
+    }
+    ncg_assert_msg(m_name_index.find(name) == m_name_index.end(), "Duplicate op name: " + name + ".");
+    if (op->has_name()) {
+        m_name_index.erase(op->name());
+    }
+    m_name_index.emplace(name, m_ops[it->second]);
+}
+
 const std::vector<GOpPtr> &Graph::ops() const {
     return m_ops;
 }
 
 GOpPtr Graph::find_op(const std::string &name) {
-    for (auto &op : m_ops) {
-        if (op->name() == name) {
-            return op;
-        }
+    auto it = m_name_index.find(name);
+    if (it != m_name_index.end()) {
+        return it->second;
+    }
+
+    // Auto names are "<op_name>@<address>"; see GraphOp::auto_name.
+    auto pos = name.rfind('@');
+    if (pos == std::string::npos) {
+        return nullptr;
     }
-    return nullptr;
+    auto address = reinterpret_cast<const GraphOp *>(strtoull(name.c_str() + pos + 1, nullptr, 16));
+    auto jt = m_op_index.find(address);
+    if (jt == m_op_index.end()) {
+        return nullptr;
+    }
+    const auto &op = m_ops[jt->second];
+    if (op->has_name() || op->auto_name() != name) {
+        return nullptr;
+    }
+    return op;
+}
+
+bool Graph::is_backward_op(const GraphOp *op) const {
+    return m_backward_ops.find(op) != m_backward_ops.end();
 }
 
 void Graph::backward(GTensorPtr loss) {
@@ -75,15 +131,72 @@ void Graph::backward(GTensorPtr loss) {
     auto sorter = std::make_unique<GraphTopoSorter>(*this);
     sorter->sort({loss});
     const auto &sorted = sorter->sorted();
+    size_t first_backward_op = m_ops.size();
+
+    auto loss_grad = this->op<GOpGradLoss>(nullptr, loss);
+    if (m_mixed_precision != nullptr) {
+        auto loss_scale = find_op(MixedPrecisionLossScaleName)->outputs()[0];
+        if (loss->desc().dtype() != DTypeName::Float32) {
+            loss_scale = this->op<GOpCast>(OpDescPtr(new OpCastDesc(loss->desc().dtype())), loss_scale);
+        }
+        loss_grad = this->op<GOpMul>(nullptr, loss_grad, loss_scale);
+    }
 
-    loss->set_grad(*this, loss, this->op<GOpGradLoss>(nullptr, loss));
+    loss->set_grad(*this, loss, loss_grad);
     for (auto it = sorted.rbegin(); it != sorted.rend(); ++it) {
         (*it)->backward(*this, loss);
     }
+    if (m_mixed_precision != nullptr) {
+        unscale_grads_(loss, sorted);
+    }
+    for (size_t i = first_backward_op; i < m_ops.size(); ++i) {
+        m_backward_ops.emplace(m_ops[i].get());
+    }
 
     m_backproped_tensors.emplace(loss_identifier);
 }
 
+void Graph::enable_mixed_precision(const MixedPrecisionConfig &config) {
+    ncg_assert_msg(is_reduced_precision_dtype(config.compute_dtype), "The compute dtype of the mixed precision must be Float16 or BFloat16.");
+    m_mixed_precision = std::make_unique<MixedPrecisionConfig>(config);
+
+    if (find_op(MixedPrecisionLossScaleName) == nullptr) {
+        make_op<GOpVariable>(MixedPrecisionLossScaleName, OpDescPtr(new GOpVariableDesc(scalar(DTypeName::Float32, config.init_loss_scale))));
+        make_op<GOpVariable>(MixedPrecisionStepsName, OpDescPtr(new GOpVariableDesc(scalar(DTypeName::Int64, 0))));
+    }
+}
+
+const MixedPrecisionConfig *Graph::mixed_precision() const {
+    return m_mixed_precision.get();
+}
+
+void Graph::unscale_grads_(const GTensorPtr &loss, const std::vector<GraphOp *> &sorted) {
+    auto loss_scale = find_op(MixedPrecisionLossScaleName)->outputs()[0];
+    auto steps = find_op(MixedPrecisionStepsName)->outputs()[0];
+
+    GTensorVec variables;
+    GTensorVec inputs{loss_scale, steps};
+    for (auto op : sorted) {
+        if (dynamic_cast<GOpVariable *>(op) == nullptr || op->outputs()[0] == loss_scale) {
+            continue;
+        }
+        auto grad = op->outputs()[0]->grad(loss);
+        if (grad != nullptr && is_float_dtype(grad->desc().dtype())) {
+            variables.push_back(op->outputs()[0]);
+            inputs.push_back(grad);
+        }
+    }
+    if (variables.empty()) {
+        return;
+    }
+
+    auto desc = OpDescPtr(new OpUnscaleGradsDesc(m_mixed_precision->growth_factor, m_mixed_precision->backoff_factor, m_mixed_precision->growth_interval));
+    auto grads = make_op<GOpUnscaleGrads>(desc, inputs)->outputs();
+    for (size_t i = 0; i < variables.size(); ++i) {
+        variables[i]->reset_grad(loss, grads[i]);
+    }
+}
+
 Session::Session(Graph &graph) : m_graph(graph) {
     // pass
 }
@@ -111,6 +224,10 @@ void Session::set_shared_tensor(const GTensorPtr &gtensor, const TensorPtr &tens
     m_shared_tensors[reinterpret_cast<std::uintptr_t>(gtensor.get())] = tensor;
 }
 
+const std::unordered_map<std::uintptr_t, TensorPtr> &Session::shared_tensors() const {
+    return m_shared_tensors;
+}
+
 void Session::save_shared_tensors(std::string filename) {
     NCGPickler pickler(filename);
 
@@ -158,6 +275,12 @@ void GraphForwardContext::feed(const std::string &name, TensorPtr tensor) {
     m_feed_dict.emplace(name, tensor);
 }
 
+void GraphForwardContext::feed(const std::string &name, const SparseTensor &tensor) {
+    feed(name + ":indptr", tensor.indptr());
+    feed(name + ":indices", tensor.indices());
+    feed(name + ":values", tensor.values());
+}
+
 TensorPtr GraphForwardContext::feed_dict(const std::string &name) {
     auto it = m_feed_dict.find(name);
     if (it == m_feed_dict.end()) {
@@ -167,12 +290,20 @@ TensorPtr GraphForwardContext::feed_dict(const std::string &name) {
 }
 
 TensorVec GraphForwardContext::eval(const GTensorVec &targets) {
+    if (m_memory_account != nullptr) {
+        MemoryScope scope(m_memory_account);
+        return eval_(targets);
+    }
+    return eval_(targets);
+}
+
+TensorVec GraphForwardContext::eval_(const GTensorVec &targets) {
     TensorVec outputs;
     auto sorter = std::make_unique<GraphTopoSorter>(m_session.graph());
     sorter->sort(targets);
 
     for (const GraphOp *op: sorter->sorted()) {
-        op->forward(*this);
+        forward_(op);
         if (!ok()) {
             return outputs;
         }
@@ -191,6 +322,28 @@ TensorVec GraphForwardContext::eval(const GTensorVec &targets) {
     return outputs;
 }
 
+void GraphForwardContext::forward_(const GraphOp *op) {
+    std::unique_ptr<MemoryScope> scope;
+    if (m_memory_account != nullptr) {
+        scope = std::make_unique<MemoryScope>(nullptr, op_memory_account_(op));
+    }
+
+    if (m_profiler == nullptr) {
+        op->forward(*this);
+    } else {
+        m_profiler->forward(*this, op);
+    }
+}
+
+const MemoryAccountPtr &GraphForwardContext::op_memory_account_(const GraphOp *op) {
+    auto it = m_op_memory_account_index.find(op);
+    if (it == m_op_memory_account_index.end()) {
+        it = m_op_memory_account_index.emplace(op, m_op_memory_accounts.size()).first;
+        m_op_memory_accounts.emplace_back(std::make_shared<MemoryAccount>(op->name()));
+    }
+    return m_op_memory_accounts[it->second];
+}
+
 TensorPtr GraphForwardContext::tensor(const GTensorPtr &gtensor) {
     auto it = m_storage.find(reinterpret_cast<std::uintptr_t>(gtensor.get()));
     if (it == m_storage.end()) {
@@ -200,10 +353,44 @@ TensorPtr GraphForwardContext::tensor(const GTensorPtr &gtensor) {
     return it->second;
 }
 
+bool GraphForwardContext::has_tensor(const GTensorPtr &gtensor) const {
+    return m_storage.find(reinterpret_cast<std::uintptr_t>(gtensor.get())) != m_storage.end();
+}
+
+GraphProfiler *GraphForwardContext::profiler() const {
+    return m_profiler;
+}
+
+void GraphForwardContext::set_profiler(GraphProfiler *profiler) {
+    m_profiler = profiler;
+}
+
+void GraphForwardContext::enable_memory_tracking(const std::string &name) {
+    if (m_memory_account == nullptr) {
+        m_memory_account = std::make_shared<MemoryAccount>(name);
+    }
+}
+
+const MemoryAccountPtr &GraphForwardContext::memory_account() const {
+    return m_memory_account;
+}
+
+const std::vector<MemoryAccountPtr> &GraphForwardContext::op_memory_accounts() const {
+    return m_op_memory_accounts;
+}
+
 void GraphForwardContext::set_tensor(const GTensorPtr &gtensor, const TensorPtr &tensor) {
     m_storage.emplace(reinterpret_cast<std::uintptr_t>(gtensor.get()), tensor);
 }
 
+bool GraphForwardContext::grad_overflow() const {
+    return m_grad_overflow;
+}
+
+void GraphForwardContext::set_grad_overflow() {
+    m_grad_overflow = true;
+}
+
 std::ostringstream &GraphForwardContext::error(const GraphOp *op) {
     auto &error = RuntimeContext::error();
     // error << op->op_name() << ": ";
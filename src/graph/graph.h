@@ -8,6 +8,9 @@
 #pragma once
 
 #include "core/op.h"
+#include "core/memory.h"
+#include "core/sparse.h"
+#include "graph/mixed_precision.h"
 #include "graph/tensor.h"
 
 #include <cstdint>
@@ -18,6 +21,7 @@ namespace ncg {
 
 class GraphOp;
 class GraphSingleOutputOp;
+class GraphProfiler;
 typedef std::shared_ptr<GraphOp> GOpPtr;
 
 class GraphTopoSorter final {
@@ -45,24 +49,23 @@ public:
 
     virtual void backward(GTensorPtr loss);
 
+    /* Automatic mixed precision for the ops built afterwards and for the next calls to backward(); see graph/mixed_precision.h. */
+    void enable_mixed_precision(const MixedPrecisionConfig &config = MixedPrecisionConfig());
+    // nullptr if not enabled.
+    const MixedPrecisionConfig *mixed_precision() const;
+
     template <typename OpClass>
     GOpPtr make_op(OpDescPtr desc, const TensorVec &inputs) {
         auto op = new OpClass();
         (*op)(*this, desc, inputs);
-        ncg_assert_msg(ok(), error_str());
-        auto op_ptr = GOpPtr(op);
-        m_ops.push_back(op_ptr);
-        return op_ptr;
+        return register_op_(op);
     }
 
     template <typename OpClass, typename... Tensors>
     GOpPtr make_op(OpDescPtr desc, Tensors &&... args) {
         auto op = new OpClass();
         (*op)(*this, desc, {std::forward<Tensors>(args)...});
-        ncg_assert_msg(ok(), error_str());
-        auto op_ptr = GOpPtr(op);
-        m_ops.push_back(op_ptr);
-        return op_ptr;
+        return register_op_(op);
     }
 
     template <typename OpClass, typename... Tensors>
@@ -70,10 +73,7 @@ public:
         auto op = new OpClass();
         op->set_name(name);
         (*op)(*this, desc, inputs);
-        ncg_assert_msg(ok(), error_str());
-        auto op_ptr = GOpPtr(op);
-        m_ops.push_back(op_ptr);
-        return op_ptr;
+        return register_op_(op);
     }
 
     template <typename OpClass, typename... Tensors>
@@ -81,14 +81,21 @@ public:
         auto op = new OpClass();
         op->set_name(name);
         (*op)(*this, desc, {std::forward<Tensors>(args)...});
-        ncg_assert_msg(ok(), error_str());
-        auto op_ptr = GOpPtr(op);
-        m_ops.push_back(op_ptr);
-        return op_ptr;
+        return register_op_(op);
     }
 
+    /* Take the ownership of an op created elsewhere (e.g., by the GraphOpRegistry) and initialize it. */
+    GOpPtr add_op(GraphOp *op, OpDescPtr desc, const GTensorVec &inputs);
+
     const std::vector<GOpPtr> &ops() const;
+    /* O(1), both for the names set explicitly and for the auto names. */
     GOpPtr find_op(const std::string &name);
+    // Whether the op has been created by backward(), i.e., computes gradients.
+    bool is_backward_op(const GraphOp *op) const;
+
+    friend class GraphOp;
+    friend void save_graph(const Graph &graph, NCGPickler &pickler);
+    friend void load_graph(Graph &graph, NCGUnpickler &unpickler);
 
     template <typename OpClass, typename... Tensors>
     typename std::enable_if<std::is_base_of<GraphSingleOutputOp, OpClass>::value, GTensorPtr>::type
@@ -121,8 +128,18 @@ public:
     }
 
 protected:
+    GOpPtr register_op_(GraphOp *op);
+    // Called by GraphOp::set_name; the names of the ops must be unique in the graph.
+    void rename_op_(GraphOp *op, const std::string &name);
+    // Replaces the gradients of the variables by their unscaled values; see GOpUnscaleGrads.
+    void unscale_grads_(const GTensorPtr &loss, const std::vector<GraphOp *> &sorted);
+
     std::vector<GOpPtr> m_ops;
+    std::unordered_map<const GraphOp *, size_t> m_op_index;
+    std::unordered_map<std::string, GOpPtr> m_name_index;
     std::unordered_set<std::uintptr_t> m_backproped_tensors;
+    std::unordered_set<const GraphOp *> m_backward_ops;
+    std::unique_ptr<MixedPrecisionConfig> m_mixed_precision;
 };
 
 class Session {
@@ -136,6 +153,8 @@ public:
     TensorPtr shared_tensor(const GTensorPtr &) const;
     void set_shared_tensor(const GTensorPtr &gtensor, const TensorPtr &tensor);
 
+    const std::unordered_map<std::uintptr_t, TensorPtr> &shared_tensors() const;
+
     void save_shared_tensors(std::string filename);
     void load_shared_tensors(std::string filename);
 
@@ -153,18 +172,44 @@ public:
     const Session &session() const;
 
     void feed(const std::string &name, TensorPtr tensor);
+    // Feeds the three placeholders of G::sparse_placeholder(name, ...).
+    void feed(const std::string &name, const SparseTensor &tensor);
     TensorPtr feed_dict(const std::string &name);
     std::vector<TensorPtr> eval(const GTensorVec &);
 
     TensorPtr tensor(const GTensorPtr &);
+    bool has_tensor(const GTensorPtr &) const;
     void set_tensor(const GTensorPtr &gtensor, const TensorPtr &tensor);
 
+    /* NB: the profiler is not owned by the context; pass nullptr to disable the profiling. */
+    GraphProfiler *profiler() const;
+    void set_profiler(GraphProfiler *profiler);
+
+    /* Charge the storages allocated during eval() to an account of the context and to one account per op. */
+    void enable_memory_tracking(const std::string &name = "GraphForwardContext");
+    const MemoryAccountPtr &memory_account() const;
+    // In the order of the first execution of the ops; the accounts are named after the ops.
+    const std::vector<MemoryAccountPtr> &op_memory_accounts() const;
+
     std::ostringstream &error(const GraphOp *);
 
+    /* Set when the (unscaled) gradients of a mixed-precision step are not finite; the assignments of the step are then skipped. */
+    bool grad_overflow() const;
+    void set_grad_overflow();
+
 protected:
+    TensorVec eval_(const GTensorVec &);
+    void forward_(const GraphOp *op);
+    const MemoryAccountPtr &op_memory_account_(const GraphOp *op);
+
     Session &m_session;
+    GraphProfiler *m_profiler = nullptr;
+    MemoryAccountPtr m_memory_account;
+    std::vector<MemoryAccountPtr> m_op_memory_accounts;
+    std::unordered_map<const GraphOp *, size_t> m_op_memory_account_index;
     std::unordered_map<std::uintptr_t, TensorPtr> m_storage;
     std::unordered_map<std::string, TensorPtr> m_feed_dict;
+    bool m_grad_overflow = false;
 };
 
 void as_default_graph(Graph &);
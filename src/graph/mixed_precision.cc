@@ -0,0 +1,92 @@
+/*
+ * mixed_precision.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "graph/mixed_precision.h"
+#include "graph/graph.h"
+#include "graph/ops/elemwise.h"
+#include "graph/ops/netsrc.h"
+
+namespace ncg {
+
+namespace {
+
+GTensorPtr cast_to(Graph &graph, const GTensorPtr &a, DTypeName dtype) {
+    if (a->desc().dtype() == dtype) {
+        return a;
+    }
+    return graph.op<GOpCast>(OpDescPtr(new OpCastDesc(dtype)), a);
+}
+
+// The widest floating-point dtype of the inputs; two different 16-bit dtypes meet in Float32.
+DTypeName promoted_dtype(const GTensorVec &inputs, bool &mixed) {
+    DTypeName result = DTypeName::Int8;
+    bool found = false;
+    mixed = false;
+    for (const auto &a : inputs) {
+        auto dtype = a->desc().dtype();
+        if (!is_float_dtype(dtype)) continue;
+        if (!found) {
+            result = dtype;
+            found = true;
+        } else if (dtype != result) {
+            mixed = true;
+            if (get_dtype_size(dtype) > get_dtype_size(result)) {
+                result = dtype;
+            } else if (get_dtype_size(dtype) == get_dtype_size(result) && is_reduced_precision_dtype(dtype)) {
+                result = DTypeName::Float32;
+            }
+        }
+    }
+    return result;
+}
+
+} /* !namespace <anonymous> */
+
+float get_loss_scale(Session &session) {
+    auto op = session.graph().find_op(MixedPrecisionLossScaleName);
+    ncg_assert_msg(op != nullptr, "Mixed precision is not enabled for the graph of the session.");
+    const auto &tensor = op->outputs()[0];
+    if (session.is_shared_tensor_initialized(tensor)) {
+        return tocc_scalar<float>(session.shared_tensor(tensor));
+    }
+    return tocc_scalar<float>(op->desc<GOpVariableDesc>().tensor);
+}
+
+GTensorVec mixed_precision_cast(Graph &graph, const GTensorVec &inputs, MixedPrecisionCast policy) {
+    const auto *config = graph.mixed_precision();
+    if (config == nullptr || policy == MixedPrecisionCast::Keep) {
+        return inputs;
+    }
+
+    auto outputs = inputs;
+    if (policy == MixedPrecisionCast::Lower) {
+        for (auto &a : outputs) {
+            if (a->desc().dtype() == DTypeName::Float32) {
+                a = cast_to(graph, a, config->compute_dtype);
+            }
+        }
+    } else if (policy == MixedPrecisionCast::Float32) {
+        for (auto &a : outputs) {
+            if (is_reduced_precision_dtype(a->desc().dtype())) {
+                a = cast_to(graph, a, DTypeName::Float32);
+            }
+        }
+    } else {
+        bool mixed;
+        auto dtype = promoted_dtype(inputs, mixed);
+        if (mixed) {
+            for (auto &a : outputs) {
+                if (is_float_dtype(a->desc().dtype())) {
+                    a = cast_to(graph, a, dtype);
+                }
+            }
+        }
+    }
+    return outputs;
+}
+
+} /* !namespace ncg */
@@ -0,0 +1,59 @@
+/*
+ * mixed_precision.h
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#pragma once
+
+#include "graph/tensor.h"
+
+#include <cstdint>
+
+namespace ncg {
+
+// From graph/graph.h
+class Session;
+
+/*
+ * Automatic mixed precision; see Graph::enable_mixed_precision. The graph builders (G::matmul, G::tanh, ...) cast the
+ * inputs of the ops following the MixedPrecisionCast of each op, so that the model code does not insert any cast. The
+ * variables keep Float32 master values: their gradients come back in Float32 through the backward of the casts.
+ *
+ * Graph::backward multiplies the loss by a dynamic loss scale, so that the small gradients do not flush to zero in
+ * the compute dtype, and divides the gradients of the variables by it (see GOpUnscaleGrads). The updates (GOpAssign)
+ * of a step whose gradients are not finite are skipped and the scale is decreased; it is increased again after
+ * growth_interval steps without overflow.
+ */
+struct MixedPrecisionConfig {
+    // Float16 or BFloat16.
+    DTypeName compute_dtype = DTypeName::Float16;
+    float init_loss_scale = 65536;
+    float growth_factor = 2;
+    float backoff_factor = 0.5;
+    int64_t growth_interval = 2000;
+};
+
+enum class MixedPrecisionCast : int {
+    // Leave the inputs alone (shapes, indexing, min/max, ...).
+    Keep,
+    // Run in the compute dtype: the matmuls and the activations.
+    Lower,
+    // Run in Float32: the ops which over- or underflow easily in 16 bits (exp, log, pow, sums).
+    Float32,
+    // Cast the floating-point inputs to the widest of their dtypes (binary elementwise ops, concat, ...).
+    Promote,
+};
+
+// The variables holding the state of the dynamic loss scaling; created by Graph::enable_mixed_precision.
+const char *const MixedPrecisionLossScaleName = "mixed_precision:loss_scale";
+const char *const MixedPrecisionStepsName = "mixed_precision:steps";
+
+// The current loss scale of the session.
+float get_loss_scale(Session &session);
+
+// Returns the inputs unchanged if the mixed precision is not enabled for the graph.
+GTensorVec mixed_precision_cast(Graph &graph, const GTensorVec &inputs, MixedPrecisionCast policy);
+
+} /* !namespace ncg */
@@ -11,10 +11,42 @@
 
 namespace ncg {
 
+OpCost &OpCost::operator += (const OpCost &rhs) {
+    flops += rhs.flops;
+    bytes_read += rhs.bytes_read;
+    bytes_written += rhs.bytes_written;
+    return *this;
+}
+
+size_t get_desc_memsize(const TensorDesc &desc) {
+    return desc.numel() * get_dtype_size(desc.dtype());
+}
+
+OpCost elemwise_op_cost(const TensorDescVec &inputs, const TensorDescVec &outputs) {
+    OpCost cost;
+    for (const auto &desc : inputs) {
+        cost.bytes_read += get_desc_memsize(desc);
+    }
+    for (const auto &desc : outputs) {
+        cost.flops += desc.numel();
+        cost.bytes_written += get_desc_memsize(desc);
+    }
+    return cost;
+}
+
+OpCost copy_op_cost(const TensorDescVec &inputs, const TensorDescVec &outputs) {
+    OpCost cost;
+    for (const auto &desc : outputs) {
+        cost.bytes_read += get_desc_memsize(desc);
+        cost.bytes_written += get_desc_memsize(desc);
+    }
+    return cost;
+}
+
 GraphOp::GraphOp() :
     m_desc(), m_inputs(), m_outputs(),
     m_initialized(false),
-    m_name(), m_name_initialized(false) {
+    m_name(), m_name_initialized(false), m_graph(nullptr) {
     // Pass
 }
 
@@ -32,10 +64,21 @@ std::string GraphOp::auto_name() const {
 }
 
 void GraphOp::set_name(const std::string &name) {
+    if (m_graph != nullptr) {
+        m_graph->rename_op_(this, name);
+    }
     m_name_initialized = true;
     m_name = name;
 }
 
+bool GraphOp::has_name() const {
+    return m_name_initialized;
+}
+
+const OpDescPtr &GraphOp::desc_ptr() const {
+    return m_desc;
+}
+
 const GTensorVec &GraphOp::inputs() const {
     return m_inputs;
 }
@@ -51,6 +94,7 @@ const GTensorVec &GraphOp::operator () (Graph &graph, OpDescPtr desc, const GTen
 
     ncg_assert_msg(!m_initialized, std::string("Op ") + name() + " initialized twice.");
     m_initialized = true;
+    m_graph = &graph;
     m_desc = desc;
 
     check_inputs(graph, inputs);
@@ -67,6 +111,10 @@ void GraphOp::backward(Graph &graph, GTensorPtr loss) {
     graph.error(this) << "Backward is not implemented for " << op_name() << ".";
 }
 
+OpCost GraphOp::cost(const TensorDescVec &inputs, const TensorDescVec &outputs) const {
+    return elemwise_op_cost(inputs, outputs);
+}
+
 GTensorPtr GraphOp::make_tensor(ssize_t index, const TensorDesc &desc) {
     return GTensorPtr(new GraphTensor(this, index, desc));
 }
@@ -16,6 +16,24 @@
 
 namespace ncg {
 
+/* The work done by one execution of an op. */
+struct OpCost {
+    double flops = 0;
+    double bytes_read = 0;
+    double bytes_written = 0;
+
+    double bytes() const { return bytes_read + bytes_written; }
+    // FLOPs per byte of memory traffic.
+    double intensity() const { return bytes() > 0 ? flops / bytes() : 0; }
+    OpCost &operator += (const OpCost &rhs);
+};
+
+size_t get_desc_memsize(const TensorDesc &desc);
+// One flop per output element; all inputs are read and all outputs are written.
+OpCost elemwise_op_cost(const TensorDescVec &inputs, const TensorDescVec &outputs);
+// No flops; the outputs are copied from (a part of) the inputs.
+OpCost copy_op_cost(const TensorDescVec &inputs, const TensorDescVec &outputs);
+
 class GraphOp {
 public:
     GraphOp();
@@ -25,6 +43,8 @@ public:
     std::string name() const;
     std::string auto_name() const;
     void set_name(const std::string &name);
+    // Whether the name has been set explicitly (i.e., is not the auto_name()).
+    bool has_name() const;
 
     template <typename DescT>
     const DescT &desc() const {
@@ -32,6 +52,8 @@ public:
         ncg_assert(p != nullptr);
         return *p;
     }
+    // nullptr if the op has no desc.
+    const OpDescPtr &desc_ptr() const;
     const GTensorVec &inputs() const;
     const GTensorVec &outputs() const;
 
@@ -44,12 +66,17 @@ public:
     virtual void forward_hook_post(GraphForwardContext &ctx) const {}
     virtual void backward(Graph &graph, GTensorPtr loss);
 
+    /* Static cost model, given the (runtime) descs of the inputs and the outputs. Elementwise by default. */
+    virtual OpCost cost(const TensorDescVec &inputs, const TensorDescVec &outputs) const;
+
     GTensorPtr make_tensor(ssize_t index, const TensorDesc &desc);
     friend std::ostream & operator << (std::ostream &, const GraphOp &);
 
 protected:
     std::string m_name;
     bool m_name_initialized;
+    // The graph the op belongs to, set when the op is initialized.
+    Graph *m_graph;
 
     OpDescPtr m_desc;
     GTensorVec m_inputs;
@@ -67,6 +94,15 @@ protected:
     for (auto &tensor : m_inputs) { tensor->set_grad(graph, loss, nullptr); } \
 }
 
+/* For ops which only produce views or metadata. */
+#define NCG_GOP_DEF_NO_COST_INLINE virtual OpCost cost(const TensorDescVec &inputs, const TensorDescVec &outputs) const { \
+    return OpCost(); \
+}
+
+#define NCG_GOP_DEF_COPY_COST_INLINE virtual OpCost cost(const TensorDescVec &inputs, const TensorDescVec &outputs) const { \
+    return copy_op_cost(inputs, outputs); \
+}
+
 class GraphSingleOutputOp {
     // Pass
 };
@@ -0,0 +1,176 @@
+/*
+ * conv.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "graph/ops/conv.h"
+
+namespace ncg {
+
+namespace {
+
+// One multiply and one add per (output element, input channel, kernel position), for the three conv ops.
+OpCost conv2d_op_cost(const TensorDescVec &inputs, const TensorDescVec &outputs, double nr_outputs, double reduction) {
+    auto cost = elemwise_op_cost(inputs, outputs);
+    cost.flops = 2 * nr_outputs * reduction;
+    return cost;
+}
+
+} /* !namespace <anonymous> */
+
+OpCost GOpConv2d::cost(const TensorDescVec &inputs, const TensorDescVec &outputs) const {
+    const auto &filter = inputs[1];
+    return conv2d_op_cost(inputs, outputs, outputs[0].numel(), filter.shape(1) * filter.shape(2) * filter.shape(3));
+}
+
+void GOpConv2d::backward(Graph &graph, GTensorPtr loss) {
+    const auto &desc = this->template desc<OpConv2dDesc>();
+
+    auto output_grad = m_outputs[0]->grad(loss);
+    if (output_grad == nullptr) {
+        m_inputs[0]->set_grad(graph, loss, nullptr);
+        m_inputs[1]->set_grad(graph, loss, nullptr);
+        return;
+    }
+
+    const auto &input = m_inputs[0]->desc(), &filter = m_inputs[1]->desc();
+    m_inputs[0]->set_grad(graph, loss,
+        graph.op<GOpConv2dBackwardData>(OpDescPtr(new OpConv2dBackwardDataDesc(
+            desc, input.shape(2), input.shape(3)
+        )), m_inputs[1], output_grad)
+    );
+    m_inputs[1]->set_grad(graph, loss,
+        graph.op<GOpConv2dBackwardFilter>(OpDescPtr(new OpConv2dBackwardFilterDesc(
+            desc, filter.shape(2), filter.shape(3)
+        )), m_inputs[0], output_grad)
+    );
+}
+
+OpCost GOpConv2dBackwardData::cost(const TensorDescVec &inputs, const TensorDescVec &outputs) const {
+    const auto &filter = inputs[0];
+    return conv2d_op_cost(inputs, outputs, inputs[1].numel(), filter.shape(1) * filter.shape(2) * filter.shape(3));
+}
+
+// The op is linear in both inputs: <g, BackwardData(filter, dy)> = <Conv2d(g, filter), dy>.
+void GOpConv2dBackwardData::backward(Graph &graph, GTensorPtr loss) {
+    const auto &desc = this->template desc<OpConv2dBackwardDataDesc>();
+
+    auto output_grad = m_outputs[0]->grad(loss);
+    if (output_grad == nullptr) {
+        m_inputs[0]->set_grad(graph, loss, nullptr);
+        m_inputs[1]->set_grad(graph, loss, nullptr);
+        return;
+    }
+
+    OpConv2dDesc conv(desc.stride_h, desc.stride_w, desc.padding_h, desc.padding_w, desc.algorithm);
+    const auto &filter = m_inputs[0]->desc();
+    m_inputs[0]->set_grad(graph, loss,
+        graph.op<GOpConv2dBackwardFilter>(OpDescPtr(new OpConv2dBackwardFilterDesc(
+            conv, filter.shape(2), filter.shape(3)
+        )), output_grad, m_inputs[1])
+    );
+    m_inputs[1]->set_grad(graph, loss,
+        graph.op<GOpConv2d>(OpDescPtr(new OpConv2dDesc(conv)), output_grad, m_inputs[0])
+    );
+}
+
+OpCost GOpConv2dBackwardFilter::cost(const TensorDescVec &inputs, const TensorDescVec &outputs) const {
+    const auto &filter = outputs[0];
+    return conv2d_op_cost(inputs, outputs, inputs[1].numel(), filter.shape(1) * filter.shape(2) * filter.shape(3));
+}
+
+// The op is linear in both inputs: <g, BackwardFilter(input, dy)> = <Conv2d(input, g), dy>.
+void GOpConv2dBackwardFilter::backward(Graph &graph, GTensorPtr loss) {
+    const auto &desc = this->template desc<OpConv2dBackwardFilterDesc>();
+
+    auto output_grad = m_outputs[0]->grad(loss);
+    if (output_grad == nullptr) {
+        m_inputs[0]->set_grad(graph, loss, nullptr);
+        m_inputs[1]->set_grad(graph, loss, nullptr);
+        return;
+    }
+
+    OpConv2dDesc conv(desc.stride_h, desc.stride_w, desc.padding_h, desc.padding_w, desc.algorithm);
+    const auto &input = m_inputs[0]->desc();
+    m_inputs[0]->set_grad(graph, loss,
+        graph.op<GOpConv2dBackwardData>(OpDescPtr(new OpConv2dBackwardDataDesc(
+            conv, input.shape(2), input.shape(3)
+        )), output_grad, m_inputs[1])
+    );
+    m_inputs[1]->set_grad(graph, loss,
+        graph.op<GOpConv2d>(OpDescPtr(new OpConv2dDesc(conv)), m_inputs[0], output_grad)
+    );
+}
+
+// One comparison (or add) per window element.
+OpCost GOpMaxPool2d::cost(const TensorDescVec &inputs, const TensorDescVec &outputs) const {
+    const auto &desc = this->template desc<OpPool2dDesc>();
+    auto cost = elemwise_op_cost(inputs, outputs);
+    cost.flops = outputs[0].numel() * desc.kernel_h * desc.kernel_w;
+    return cost;
+}
+
+void GOpMaxPool2d::backward(Graph &graph, GTensorPtr loss) {
+    auto output_grad = m_outputs[0]->grad(loss);
+    if (output_grad == nullptr) {
+        m_inputs[0]->set_grad(graph, loss, nullptr);
+        return;
+    }
+
+    m_inputs[0]->set_grad(graph, loss,
+        graph.op<GOpMaxPool2dBackward>(OpDescPtr(new OpPool2dDesc(this->template desc<OpPool2dDesc>())), m_inputs[0], output_grad)
+    );
+}
+
+OpCost GOpMaxPool2dBackward::cost(const TensorDescVec &inputs, const TensorDescVec &outputs) const {
+    const auto &desc = this->template desc<OpPool2dDesc>();
+    auto cost = elemwise_op_cost(inputs, outputs);
+    cost.flops = inputs[1].numel() * desc.kernel_h * desc.kernel_w;
+    return cost;
+}
+
+OpCost GOpAvgPool2d::cost(const TensorDescVec &inputs, const TensorDescVec &outputs) const {
+    const auto &desc = this->template desc<OpPool2dDesc>();
+    auto cost = elemwise_op_cost(inputs, outputs);
+    cost.flops = outputs[0].numel() * desc.kernel_h * desc.kernel_w;
+    return cost;
+}
+
+void GOpAvgPool2d::backward(Graph &graph, GTensorPtr loss) {
+    auto output_grad = m_outputs[0]->grad(loss);
+    if (output_grad == nullptr) {
+        m_inputs[0]->set_grad(graph, loss, nullptr);
+        return;
+    }
+
+    const auto &input = m_inputs[0]->desc();
+    m_inputs[0]->set_grad(graph, loss,
+        graph.op<GOpAvgPool2dBackward>(OpDescPtr(new OpAvgPool2dBackwardDesc(
+            this->template desc<OpPool2dDesc>(), input.shape(2), input.shape(3)
+        )), output_grad)
+    );
+}
+
+OpCost GOpAvgPool2dBackward::cost(const TensorDescVec &inputs, const TensorDescVec &outputs) const {
+    const auto &desc = this->template desc<OpAvgPool2dBackwardDesc>();
+    auto cost = elemwise_op_cost(inputs, outputs);
+    cost.flops = inputs[0].numel() * desc.pool.kernel_h * desc.pool.kernel_w;
+    return cost;
+}
+
+// The op is linear, and the adjoint of the adjoint of the average pooling is itself.
+void GOpAvgPool2dBackward::backward(Graph &graph, GTensorPtr loss) {
+    auto output_grad = m_outputs[0]->grad(loss);
+    if (output_grad == nullptr) {
+        m_inputs[0]->set_grad(graph, loss, nullptr);
+        return;
+    }
+
+    m_inputs[0]->set_grad(graph, loss,
+        graph.op<GOpAvgPool2d>(OpDescPtr(new OpPool2dDesc(this->template desc<OpAvgPool2dBackwardDesc>().pool)), output_grad)
+    );
+}
+
+} /* !namespace ncg */
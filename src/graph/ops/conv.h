@@ -0,0 +1,201 @@
+/*
+ * conv.h
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#pragma once
+
+#include "core/tensor_impl.h"
+#include "core/ops/conv.h"
+#include "graph/op.h"
+
+namespace ncg {
+
+class GOpConv2d : public GraphOpWrapper<OpConv2d>, public GraphSingleOutputOp {
+public:
+    NCG_GOP_DEF_NAME(GOpConv2d);
+
+    virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
+        NCG_OP_CHECK_NR_INPUTS(graph, inputs, 2);
+        NCG_OP_CHECK_COMPATIBLE_DTYPE(graph, inputs);
+        NCG_OP_CHECK_CONV_INPUT_DTYPE(graph, inputs, 0);
+        NCG_OP_CHECK_INPUT_DIM(graph, inputs, 0, 4);
+        NCG_OP_CHECK_INPUT_DIM(graph, inputs, 1, 4);
+
+        const auto &desc = this->template desc<OpConv2dDesc>();
+        NCG_OP_CHECK_CONV2D_PARAMS(graph, desc);
+        const auto &input = inputs[0]->desc(), &filter = inputs[1]->desc();
+        if (input.shape(1) != filter.shape(1) || input.shape(2) + 2 * desc.padding_h < filter.shape(2) || input.shape(3) + 2 * desc.padding_w < filter.shape(3)) {
+            graph.error(this) << "Invalid shape: " << input.shape_vec() << " (input) vs. " << filter.shape_vec() << " (filter).";
+        }
+    }
+
+    virtual GTensorVec init_outputs(Graph &graph, const GTensorVec &inputs) {
+        const auto &desc = this->template desc<OpConv2dDesc>();
+        const auto &input = inputs[0]->desc(), &filter = inputs[1]->desc();
+        return {make_tensor(0, TensorDesc(input.dtype(), {
+            input.shape(0), filter.shape(0),
+            conv_impl::Conv2dGeometry::output_size(input.shape(2), filter.shape(2), desc.stride_h, desc.padding_h),
+            conv_impl::Conv2dGeometry::output_size(input.shape(3), filter.shape(3), desc.stride_w, desc.padding_w)
+        }))};
+    }
+
+    virtual OpCost cost(const TensorDescVec &inputs, const TensorDescVec &outputs) const;
+    virtual void backward(Graph &graph, GTensorPtr loss);
+};
+
+class GOpConv2dBackwardData : public GraphOpWrapper<OpConv2dBackwardData>, public GraphSingleOutputOp {
+public:
+    NCG_GOP_DEF_NAME(GOpConv2dBackwardData);
+
+    virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
+        NCG_OP_CHECK_NR_INPUTS(graph, inputs, 2);
+        NCG_OP_CHECK_COMPATIBLE_DTYPE(graph, inputs);
+        NCG_OP_CHECK_CONV_INPUT_DTYPE(graph, inputs, 0);
+        NCG_OP_CHECK_INPUT_DIM(graph, inputs, 0, 4);
+        NCG_OP_CHECK_INPUT_DIM(graph, inputs, 1, 4);
+
+        const auto &desc = this->template desc<OpConv2dBackwardDataDesc>();
+        NCG_OP_CHECK_CONV2D_PARAMS(graph, desc);
+        const auto &filter = inputs[0]->desc(), &grad = inputs[1]->desc();
+        if (grad.shape(1) != filter.shape(0) ||
+                grad.shape(2) != conv_impl::Conv2dGeometry::output_size(desc.input_h, filter.shape(2), desc.stride_h, desc.padding_h) ||
+                grad.shape(3) != conv_impl::Conv2dGeometry::output_size(desc.input_w, filter.shape(3), desc.stride_w, desc.padding_w)) {
+            graph.error(this) << "Invalid shape: " << filter.shape_vec() << " (filter) vs. " << grad.shape_vec() << " (gradient) for an input of "
+                              << desc.input_h << "x" << desc.input_w << ".";
+        }
+    }
+
+    virtual GTensorVec init_outputs(Graph &graph, const GTensorVec &inputs) {
+        const auto &desc = this->template desc<OpConv2dBackwardDataDesc>();
+        const auto &filter = inputs[0]->desc(), &grad = inputs[1]->desc();
+        return {make_tensor(0, TensorDesc(grad.dtype(), {grad.shape(0), filter.shape(1), desc.input_h, desc.input_w}))};
+    }
+
+    virtual OpCost cost(const TensorDescVec &inputs, const TensorDescVec &outputs) const;
+    virtual void backward(Graph &graph, GTensorPtr loss);
+};
+
+class GOpConv2dBackwardFilter : public GraphOpWrapper<OpConv2dBackwardFilter>, public GraphSingleOutputOp {
+public:
+    NCG_GOP_DEF_NAME(GOpConv2dBackwardFilter);
+
+    virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
+        NCG_OP_CHECK_NR_INPUTS(graph, inputs, 2);
+        NCG_OP_CHECK_COMPATIBLE_DTYPE(graph, inputs);
+        NCG_OP_CHECK_CONV_INPUT_DTYPE(graph, inputs, 0);
+        NCG_OP_CHECK_INPUT_DIM(graph, inputs, 0, 4);
+        NCG_OP_CHECK_INPUT_DIM(graph, inputs, 1, 4);
+
+        const auto &desc = this->template desc<OpConv2dBackwardFilterDesc>();
+        NCG_OP_CHECK_CONV2D_PARAMS(graph, desc);
+        const auto &input = inputs[0]->desc(), &grad = inputs[1]->desc();
+        if (grad.shape(0) != input.shape(0) ||
+                grad.shape(2) != conv_impl::Conv2dGeometry::output_size(input.shape(2), desc.kernel_h, desc.stride_h, desc.padding_h) ||
+                grad.shape(3) != conv_impl::Conv2dGeometry::output_size(input.shape(3), desc.kernel_w, desc.stride_w, desc.padding_w)) {
+            graph.error(this) << "Invalid shape: " << input.shape_vec() << " (input) vs. " << grad.shape_vec() << " (gradient) for a filter of "
+                              << desc.kernel_h << "x" << desc.kernel_w << ".";
+        }
+    }
+
+    virtual GTensorVec init_outputs(Graph &graph, const GTensorVec &inputs) {
+        const auto &desc = this->template desc<OpConv2dBackwardFilterDesc>();
+        const auto &input = inputs[0]->desc(), &grad = inputs[1]->desc();
+        return {make_tensor(0, TensorDesc(input.dtype(), {grad.shape(1), input.shape(1), desc.kernel_h, desc.kernel_w}))};
+    }
+
+    virtual OpCost cost(const TensorDescVec &inputs, const TensorDescVec &outputs) const;
+    virtual void backward(Graph &graph, GTensorPtr loss);
+};
+
+class GOpMaxPool2d : public GraphOpWrapper<OpMaxPool2d>, public GraphSingleOutputOp {
+public:
+    NCG_GOP_DEF_NAME(GOpMaxPool2d);
+
+    virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
+        NCG_OP_CHECK_NR_INPUTS(graph, inputs, 1);
+        NCG_OP_CHECK_CONV_INPUT_DTYPE(graph, inputs, 0);
+        const auto &desc = this->template desc<OpPool2dDesc>();
+        NCG_OP_CHECK_POOL2D_INPUT(graph, inputs, 0, desc);
+    }
+
+    virtual GTensorVec init_outputs(Graph &graph, const GTensorVec &inputs) {
+        auto g = this->template desc<OpPool2dDesc>().geometry(inputs[0]->desc());
+        return {make_tensor(0, TensorDesc(inputs[0]->desc().dtype(), {g.N, g.C, g.OH, g.OW}))};
+    }
+
+    virtual OpCost cost(const TensorDescVec &inputs, const TensorDescVec &outputs) const;
+    virtual void backward(Graph &graph, GTensorPtr loss);
+};
+
+// The second-order gradients through a max pooling are not supported (they are zero almost everywhere for the input).
+class GOpMaxPool2dBackward : public GraphOpWrapper<OpMaxPool2dBackward>, public GraphSingleOutputOp {
+public:
+    NCG_GOP_DEF_NAME(GOpMaxPool2dBackward);
+    NCG_GOP_DEF_NO_GRAD_INLINE;
+
+    virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
+        NCG_OP_CHECK_NR_INPUTS(graph, inputs, 2);
+        NCG_OP_CHECK_COMPATIBLE_DTYPE(graph, inputs);
+        NCG_OP_CHECK_CONV_INPUT_DTYPE(graph, inputs, 0);
+        const auto &desc = this->template desc<OpPool2dDesc>();
+        NCG_OP_CHECK_POOL2D_INPUT(graph, inputs, 0, desc);
+    }
+
+    virtual GTensorVec init_outputs(Graph &graph, const GTensorVec &inputs) {
+        return {make_tensor(0, inputs[0]->desc())};
+    }
+
+    virtual OpCost cost(const TensorDescVec &inputs, const TensorDescVec &outputs) const;
+};
+
+class GOpAvgPool2d : public GraphOpWrapper<OpAvgPool2d>, public GraphSingleOutputOp {
+public:
+    NCG_GOP_DEF_NAME(GOpAvgPool2d);
+
+    virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
+        NCG_OP_CHECK_NR_INPUTS(graph, inputs, 1);
+        NCG_OP_CHECK_CONV_INPUT_DTYPE(graph, inputs, 0);
+        const auto &desc = this->template desc<OpPool2dDesc>();
+        NCG_OP_CHECK_POOL2D_INPUT(graph, inputs, 0, desc);
+    }
+
+    virtual GTensorVec init_outputs(Graph &graph, const GTensorVec &inputs) {
+        auto g = this->template desc<OpPool2dDesc>().geometry(inputs[0]->desc());
+        return {make_tensor(0, TensorDesc(inputs[0]->desc().dtype(), {g.N, g.C, g.OH, g.OW}))};
+    }
+
+    virtual OpCost cost(const TensorDescVec &inputs, const TensorDescVec &outputs) const;
+    virtual void backward(Graph &graph, GTensorPtr loss);
+};
+
+class GOpAvgPool2dBackward : public GraphOpWrapper<OpAvgPool2dBackward>, public GraphSingleOutputOp {
+public:
+    NCG_GOP_DEF_NAME(GOpAvgPool2dBackward);
+
+    virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
+        NCG_OP_CHECK_NR_INPUTS(graph, inputs, 1);
+        NCG_OP_CHECK_CONV_INPUT_DTYPE(graph, inputs, 0);
+        NCG_OP_CHECK_INPUT_DIM(graph, inputs, 0, 4);
+
+        const auto &desc = this->template desc<OpAvgPool2dBackwardDesc>();
+        const auto &grad = inputs[0]->desc();
+        auto g = desc.pool.geometry(TensorDesc(grad.dtype(), {grad.shape(0), grad.shape(1), desc.input_h, desc.input_w}));
+        if (grad.shape(2) != g.OH || grad.shape(3) != g.OW) {
+            graph.error(this) << "Invalid shape: " << grad.shape_vec() << " (gradient) for an input of " << desc.input_h << "x" << desc.input_w << ".";
+        }
+    }
+
+    virtual GTensorVec init_outputs(Graph &graph, const GTensorVec &inputs) {
+        const auto &desc = this->template desc<OpAvgPool2dBackwardDesc>();
+        const auto &grad = inputs[0]->desc();
+        return {make_tensor(0, TensorDesc(grad.dtype(), {grad.shape(0), grad.shape(1), desc.input_h, desc.input_w}))};
+    }
+
+    virtual OpCost cost(const TensorDescVec &inputs, const TensorDescVec &outputs) const;
+    virtual void backward(Graph &graph, GTensorPtr loss);
+};
+
+} /* !namespace ncg */
@@ -310,9 +310,8 @@ void GOpMin::backward(Graph &graph, GTensorPtr loss) {
         OpDescPtr(new OpZerosDesc(output_grad->desc().dtype(), output_grad->desc().shape_vec())),
         graph.op<GOpShapeOf>(nullptr, output_grad)
     );
-    m_inputs[0]->set_grad(graph, loss, nullptr);
-    m_inputs[1]->set_grad(graph, loss, graph.op<GOpCond>(nullptr, cond, output_grad, zero_grad));
-    m_inputs[2]->set_grad(graph, loss, graph.op<GOpCond>(nullptr, cond, zero_grad, output_grad));
+    m_inputs[0]->set_grad(graph, loss, graph.op<GOpCond>(nullptr, cond, output_grad, zero_grad));
+    m_inputs[1]->set_grad(graph, loss, graph.op<GOpCond>(nullptr, cond, zero_grad, output_grad));
 }
 
 void GOpMax::backward(Graph &graph, GTensorPtr loss) {
@@ -328,9 +327,8 @@ void GOpMax::backward(Graph &graph, GTensorPtr loss) {
         OpDescPtr(new OpZerosDesc(output_grad->desc().dtype(), output_grad->desc().shape_vec())),
         graph.op<GOpShapeOf>(nullptr, output_grad)
     );
-    m_inputs[0]->set_grad(graph, loss, nullptr);
-    m_inputs[1]->set_grad(graph, loss, graph.op<GOpCond>(nullptr, cond, output_grad, zero_grad));
-    m_inputs[2]->set_grad(graph, loss, graph.op<GOpCond>(nullptr, cond, zero_grad, output_grad));
+    m_inputs[0]->set_grad(graph, loss, graph.op<GOpCond>(nullptr, cond, output_grad, zero_grad));
+    m_inputs[1]->set_grad(graph, loss, graph.op<GOpCond>(nullptr, cond, zero_grad, output_grad));
 }
 
 } /* !namespace ncg */
@@ -35,10 +35,17 @@ public:
 
     virtual GTensorVec init_outputs(Graph &graph, const GTensorVec &inputs) {
         auto dtype = this->template desc<OpCastDesc>().dtype;
-        TensorDesc desc(dtype, inputs[0]->desc().shape_vec());
+        auto desc = inputs[0]->desc().as_contiguous(dtype);
         return {this->make_tensor(0, desc)};
     }
 
+    // A conversion, not an arithmetic op.
+    virtual OpCost cost(const TensorDescVec &inputs, const TensorDescVec &outputs) const {
+        auto cost = elemwise_op_cost(inputs, outputs);
+        cost.flops = 0;
+        return cost;
+    }
+
     virtual void backward(Graph &graph, GTensorPtr loss);
 };
 
@@ -46,10 +53,24 @@ class GOpCond : public GOpElemwiseBase<OpCond>, public GraphSingleOutputOp {
 public:
     NCG_GOP_DEF_NAME(GOpCond);
 
+    // See OpCond::check_inputs: the condition may be a Bool tensor.
     virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
-        GOpElemwiseBase::check_inputs(graph, inputs);
+        NCG_OP_CHECK_NONEMPTY_INPUTS(graph, inputs);
         NCG_OP_CHECK_CTX_CLEAN(graph);
         NCG_OP_CHECK_NR_INPUTS(graph, inputs, 3);
+        NCG_OP_CHECK_COMPATIBLE_SHAPE(graph, inputs);
+
+        DTypeName dtype = inputs[1]->desc().dtype();
+        if (inputs[2]->desc().dtype() != dtype) {
+            graph.error(this) << "The two values must have the same dtype, got "
+                              << get_dtype_name(dtype) << " and " << get_dtype_name(inputs[2]->desc().dtype()) << ".";
+            return;
+        }
+        DTypeName cond_dtype = inputs[0]->desc().dtype();
+        if (cond_dtype != DTypeName::Bool && cond_dtype != dtype) {
+            graph.error(this) << "The condition must be a Bool tensor or have the dtype of the values ("
+                              << get_dtype_name(dtype) << "), got " << get_dtype_name(cond_dtype) << ".";
+        }
     }
 
     virtual GTensorVec init_outputs(Graph &graph, const GTensorVec &inputs) {
@@ -69,7 +90,7 @@ public:
     }
 
     virtual GTensorVec init_outputs(Graph &graph, const GTensorVec &inputs) {
-        TensorDesc desc(inputs[0]->desc().dtype(), inputs[0]->desc().shape_vec());
+        auto desc = inputs[0]->desc().as_contiguous(inputs[0]->desc().dtype());
         return {this->make_tensor(0, desc)};
     }
 };
@@ -83,8 +104,9 @@ public:
         NCG_OP_CHECK_NR_INPUTS(graph, inputs, 2);
     }
 
+    // The comparisons output Bool tensors.
     virtual GTensorVec init_outputs(Graph &graph, const GTensorVec &inputs) {
-        TensorDesc desc(inputs[0]->desc().dtype(), inputs[0]->desc().shape_vec());
+        auto desc = inputs[0]->desc().as_contiguous(OpClass::output_dtype(inputs[0]->desc().dtype()));
         return {this->make_tensor(0, desc)};
     }
 };
@@ -0,0 +1,63 @@
+/*
+ * embedding.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "graph/ops/embedding.h"
+
+namespace ncg {
+
+void GOpEmbedding::backward(Graph &graph, GTensorPtr loss) {
+    m_inputs[1]->set_grad(graph, loss, nullptr);
+
+    auto output_grad = m_outputs[0]->grad(loss);
+    if (output_grad == nullptr) {
+        m_inputs[0]->set_grad(graph, loss, nullptr);
+        return;
+    }
+
+    auto sparse_grad = graph.op<GOpEmbeddingGrad>(nullptr, output_grad, m_inputs[1]);
+    m_inputs[0]->set_grad(graph, loss,
+        graph.op<GOpSparseRowsToDense>(OpDescPtr(new OpSparseRowsToDenseDesc(
+            m_inputs[0]->desc().shape(0)
+        )), sparse_grad[0], sparse_grad[1])
+    );
+}
+
+void GOpSparseRowsToDense::backward(Graph &graph, GTensorPtr loss) {
+    m_inputs[0]->set_grad(graph, loss, nullptr);
+
+    auto output_grad = m_outputs[0]->grad(loss);
+    if (output_grad == nullptr) {
+        m_inputs[1]->set_grad(graph, loss, nullptr);
+        return;
+    }
+    m_inputs[1]->set_grad(graph, loss, graph.op<GOpEmbedding>(nullptr, output_grad, m_inputs[0]));
+}
+
+void GOpAssignAddRows::forward_hook_post(GraphForwardContext &ctx) const {
+    // The gradients of this mixed-precision step overflowed (see GOpUnscaleGrads): skip the update.
+    if (ctx.grad_overflow()) {
+        return;
+    }
+
+    auto value = ctx.session().shared_tensor(m_inputs[0]);
+    // Copy on the first write: the initial value is kept by the GOpVariableDesc, and a storage shared with other
+    // tensors (e.g., views, or a tensor set with Session::set_shared_tensor) must not change under them.
+    const auto &init_value = m_inputs[0]->template owner_op<GOpVariable>()->template desc<GOpVariableDesc>().tensor;
+    if (value == init_value || !value->own_data() || value->storage_use_count() > 1) {
+        value = cast(value, value->desc().dtype());
+    }
+
+    const auto &desc = this->template desc<GOpAssignAddRowsDesc>();
+    if (!add_rows_inplace(value, ctx.tensor(m_inputs[1]), ctx.tensor(m_inputs[2]), desc.alpha)) {
+        ctx.error(this) << "Invalid rows for " << this->op_name() << ": indices " << ctx.tensor(m_inputs[1])->desc().shape_vec()
+                        << " and rows " << ctx.tensor(m_inputs[2])->desc().shape_vec() << " for a variable " << value->desc().shape_vec() << ".";
+        return;
+    }
+    ctx.session().set_shared_tensor(m_inputs[0], value);
+}
+
+} /* !namespace ncg */
@@ -0,0 +1,160 @@
+/*
+ * embedding.h
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#pragma once
+
+#include "core/tensor_impl.h"
+#include "core/ops/embedding.h"
+#include "graph/op.h"
+#include "graph/ops/netsrc.h"
+
+namespace ncg {
+
+/*
+ * The gradient of the table is row-sparse: GOpEmbeddingGrad computes the (indices, rows) pair, and the gradient
+ * registered for the table is a GOpSparseRowsToDense of it, which is only evaluated if something asks for a dense
+ * gradient. G::sgd_update recognizes it and updates the touched rows in place (GOpAssignAddRows).
+ */
+class GOpEmbedding : public GraphOpWrapper<OpEmbedding>, public GraphSingleOutputOp {
+public:
+    NCG_GOP_DEF_NAME(GOpEmbedding);
+    NCG_GOP_DEF_COPY_COST_INLINE;
+
+    virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
+        NCG_OP_CHECK_NR_INPUTS(graph, inputs, 2);
+        NCG_OP_CHECK_INPUT_DIM(graph, inputs, 0, 2);
+        NCG_OP_CHECK_INPUT_DTYPE_INT(graph, inputs, 1);
+    }
+
+    virtual GTensorVec init_outputs(Graph &graph, const GTensorVec &inputs) {
+        auto shape = inputs[1]->desc().shape_vec();
+        shape.push_back(inputs[0]->desc().shape(1));
+        return {make_tensor(0, TensorDesc(inputs[0]->desc().dtype(), shape))};
+    }
+
+    virtual void backward(Graph &graph, GTensorPtr loss);
+};
+
+class GOpEmbeddingGrad : public GraphOpWrapper<OpEmbeddingGrad> {
+public:
+    NCG_GOP_DEF_NAME(GOpEmbeddingGrad);
+    NCG_GOP_DEF_NO_GRAD_INLINE;
+
+    virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
+        NCG_OP_CHECK_NR_INPUTS(graph, inputs, 2);
+        NCG_OP_CHECK_INPUT_DTYPE_INT(graph, inputs, 1);
+        NCG_OP_CHECK_INPUT_DIM(graph, inputs, 0, inputs[1]->desc().dim() + 1);
+    }
+
+    // The number of distinct indices is only known at run time; the static shapes are for the case without repeats.
+    virtual GTensorVec init_outputs(Graph &graph, const GTensorVec &inputs) {
+        ssize_t n = inputs[1]->desc().numel(), D = inputs[0]->desc().shape(inputs[0]->desc().dim() - 1);
+        return {
+            make_tensor(0, TensorDesc(DTypeName::Int64, {n})),
+            make_tensor(1, TensorDesc(inputs[0]->desc().dtype(), {n, D}))
+        };
+    }
+
+    // One add per gradient element.
+    virtual OpCost cost(const TensorDescVec &inputs, const TensorDescVec &outputs) const {
+        auto cost = elemwise_op_cost(inputs, outputs);
+        cost.flops = inputs[0].numel();
+        return cost;
+    }
+};
+
+class GOpSparseRowsToDense : public GraphOpWrapper<OpSparseRowsToDense>, public GraphSingleOutputOp {
+public:
+    NCG_GOP_DEF_NAME(GOpSparseRowsToDense);
+    NCG_GOP_DEF_COPY_COST_INLINE;
+
+    virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
+        NCG_OP_CHECK_NR_INPUTS(graph, inputs, 2);
+        NCG_OP_CHECK_INPUT_DTYPE_INT(graph, inputs, 0);
+        NCG_OP_CHECK_INPUT_DIM(graph, inputs, 0, 1);
+        NCG_OP_CHECK_INPUT_DIM(graph, inputs, 1, 2);
+    }
+
+    virtual GTensorVec init_outputs(Graph &graph, const GTensorVec &inputs) {
+        ssize_t nr_rows = this->template desc<OpSparseRowsToDenseDesc>().nr_rows;
+        return {make_tensor(0, TensorDesc(inputs[1]->desc().dtype(), {nr_rows, inputs[1]->desc().shape(1)}))};
+    }
+
+    virtual void backward(Graph &graph, GTensorPtr loss);
+};
+
+class GOpAssignAddRowsDesc : public OpDesc {
+public:
+    GOpAssignAddRowsDesc() : alpha(1) {}
+    GOpAssignAddRowsDesc(double alpha) : alpha(alpha) {}
+    virtual ~GOpAssignAddRowsDesc() = default;
+
+    virtual void pickle(NCGPickler &pickler) const {
+        int64_t bits;
+        memcpy(&bits, &alpha, sizeof(bits));
+        pickler.write(bits);
+    }
+    virtual void unpickle(NCGUnpickler &unpickler) {
+        int64_t bits = unpickler.read_int64();
+        memcpy(&alpha, &bits, sizeof(alpha));
+    }
+
+    double alpha;
+};
+
+/*
+ * variable[indices[u], :] += alpha * rows[u, :], in place in the Session storage of the variable: the other rows
+ * are neither read nor written. Like GOpAssign, the update happens after the forward of all the ops of the
+ * evaluation, and is skipped if the gradients of a mixed-precision step overflowed.
+ */
+class GOpAssignAddRows : public GraphOp, public GraphSingleOutputOp {
+public:
+    NCG_GOP_DEF_NAME(GOpAssignAddRows);
+    NCG_GOP_DEF_NO_GRAD_INLINE;
+
+    virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
+        NCG_OP_CHECK_NR_INPUTS(graph, inputs, 3);
+        NCG_OP_CHECK_INPUT_DIM(graph, inputs, 0, 2);
+        NCG_OP_CHECK_INPUT_DTYPE_INT(graph, inputs, 1);
+        NCG_OP_CHECK_INPUT_DIM(graph, inputs, 1, 1);
+        NCG_OP_CHECK_INPUT_DIM(graph, inputs, 2, 2);
+
+        if (inputs[0]->template owner_op<GOpVariable>() == nullptr) {
+            graph.error(this) << "The first input to " << this->op_name() << " must be a variable.";
+            return;
+        }
+        if (!is_float_dtype(inputs[0]->desc().dtype()) || inputs[0]->desc().dtype() != inputs[2]->desc().dtype()) {
+            graph.error(this) << this->op_name() << " requires floating-point rows of the dtype of the variable, got "
+                              << get_dtype_name(inputs[2]->desc().dtype()) << " for a " << get_dtype_name(inputs[0]->desc().dtype()) << " variable.";
+            return;
+        }
+        if (inputs[0]->desc().shape(1) != inputs[2]->desc().shape(1)) {
+            graph.error(this) << "Invalid shape: " << inputs[0]->desc().shape_vec() << " (variable) vs. " << inputs[2]->desc().shape_vec() << " (rows).";
+        }
+    }
+
+    virtual GTensorVec init_outputs(Graph &graph, const GTensorVec &inputs) {
+        return {make_tensor(0, TensorDesc(inputs[0]->desc().dtype(), {}))};
+    }
+
+    // Reads the rows and the touched rows of the variable, and writes the latter.
+    virtual OpCost cost(const TensorDescVec &inputs, const TensorDescVec &outputs) const {
+        OpCost cost;
+        cost.flops = 2 * inputs[2].numel();
+        cost.bytes_read = get_desc_memsize(inputs[1]) + 2 * get_desc_memsize(inputs[2]);
+        cost.bytes_written = get_desc_memsize(inputs[2]);
+        return cost;
+    }
+
+    virtual void forward(GraphForwardContext &ctx) const {
+        ctx.set_tensor(m_outputs[0], ctx.tensor(m_inputs[2]));
+    }
+
+    virtual void forward_hook_post(GraphForwardContext &ctx) const;
+};
+
+} /* !namespace ncg */
@@ -15,6 +15,7 @@ namespace ncg {
 class GOpGradLoss : public GraphOp, public GraphSingleOutputOp {
 public:
     NCG_GOP_DEF_NAME(GOpGradLoss);
+    NCG_GOP_DEF_NO_COST_INLINE;
 
     virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
         NCG_OP_CHECK_NR_INPUTS(graph, inputs, 1);
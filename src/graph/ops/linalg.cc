@@ -9,6 +9,16 @@
 
 namespace ncg {
 
+OpCost GOpMatMul::cost(const TensorDescVec &inputs, const TensorDescVec &outputs) const {
+    const auto &desc = this->template desc<OpMatMulDesc>();
+    double K = !desc.transpose_a ? inputs[0].shape(1) : inputs[0].shape(0);
+
+    // One multiply and one add per (n, m, k).
+    auto cost = elemwise_op_cost(inputs, outputs);
+    cost.flops = 2 * K * outputs[0].numel();
+    return cost;
+}
+
 void GOpMatMul::backward(Graph &graph, GTensorPtr loss) {
     const auto &desc = this->template desc<OpMatMulDesc>();
 
@@ -22,6 +22,10 @@ public:
         NCG_OP_CHECK_COMPATIBLE_DTYPE(graph, inputs);
         NCG_OP_CHECK_INPUT_DIM(graph, inputs, 0, 2);
         NCG_OP_CHECK_INPUT_DIM(graph, inputs, 1, 2);
+        if (is_int8_dtype(inputs[0]->desc().dtype())) {
+            graph.error(this) << "GOpMatMul does not support 8-bit inputs (the products overflow the output dtype); use G::quantized_matmul instead.";
+            return;
+        }
 
         const auto &desc = this->template desc<OpMatMulDesc>();
         ssize_t k1 = !desc.transpose_a ? inputs[0]->desc().shape(1) : inputs[0]->desc().shape(0);
@@ -40,6 +44,7 @@ public:
         return {make_tensor(0, TensorDesc(inputs[0]->desc().dtype(), {N, M}))};
     }
 
+    virtual OpCost cost(const TensorDescVec &inputs, const TensorDescVec &outputs) const;
     virtual void backward(Graph &graph, GTensorPtr loss);
 };
 
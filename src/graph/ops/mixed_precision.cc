@@ -0,0 +1,108 @@
+/*
+ * mixed_precision.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "graph/ops/mixed_precision.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace ncg {
+
+namespace {
+
+/* Fixed-size blocks, so that the loop vectorizes at -O2 (see half.cc). */
+const size_t UnscaleBlock = 16;
+
+// dst = src * multiplier; returns whether all the results are finite.
+bool unscale_array(const float *src, float *dst, size_t n, float multiplier) {
+    uint32_t non_finite = 0;
+    size_t i = 0;
+    for (; i + UnscaleBlock <= n; i += UnscaleBlock) {
+        // Through a local block, so that the compiler does not have to check the aliasing of src and dst.
+        float block[UnscaleBlock];
+        for (size_t j = 0; j < UnscaleBlock; ++j) {
+            block[j] = src[i + j] * multiplier;
+            non_finite |= static_cast<uint32_t>((float_as_bits(block[j]) & 0x7f800000u) == 0x7f800000u);
+        }
+        memcpy(dst + i, block, sizeof(block));
+    }
+    for (; i < n; ++i) {
+        dst[i] = src[i] * multiplier;
+        non_finite |= static_cast<uint32_t>((float_as_bits(dst[i]) & 0x7f800000u) == 0x7f800000u);
+    }
+    return non_finite == 0;
+}
+
+} /* !namespace <anonymous> */
+
+void GOpUnscaleGrads::check_inputs(Graph &graph, const GTensorVec &inputs) {
+    if (inputs.size() < 2) {
+        graph.error(this) << "GOpUnscaleGrads requires the loss scale and the step counter as inputs.";
+        return;
+    }
+    NCG_OP_CHECK_INPUT_DTYPE(graph, inputs, 0, Float32);
+    NCG_OP_CHECK_INPUT_SCALAR(graph, inputs, 0);
+    NCG_OP_CHECK_INPUT_DTYPE(graph, inputs, 1, Int64);
+    NCG_OP_CHECK_INPUT_SCALAR(graph, inputs, 1);
+    for (size_t i = 2; i < inputs.size(); ++i) {
+        if (inputs[i]->desc().dtype() != DTypeName::Float32) {
+            graph.error(this) << "GOpUnscaleGrads requires Float32 gradients (i.e., Float32 master weights), but got " << get_dtype_name(inputs[i]->desc().dtype()) << ".";
+            return;
+        }
+    }
+}
+
+GTensorVec GOpUnscaleGrads::init_outputs(Graph &graph, const GTensorVec &inputs) {
+    GTensorVec outputs;
+    for (size_t i = 2; i < inputs.size(); ++i) {
+        outputs.push_back(make_tensor(i - 2, inputs[i]->desc().as_contiguous(DTypeName::Float32)));
+    }
+    return outputs;
+}
+
+void GOpUnscaleGrads::forward(GraphForwardContext &ctx) const {
+    float multiplier = 1.0f / tocc_scalar<float>(ctx.tensor(m_inputs[0]));
+
+    bool finite = true;
+    for (size_t i = 2; i < m_inputs.size(); ++i) {
+        auto grad = ctx.tensor(m_inputs[i]);
+        if (!grad->desc().is_contiguous()) {
+            grad = cast(grad, DTypeName::Float32);
+        }
+        auto output = empty_like(grad->desc(), DTypeName::Float32);
+        finite &= unscale_array(
+            grad->as<DTypeName::Float32>()->data_ptr(), output->as<DTypeName::Float32>()->mutable_data_ptr(),
+            grad->desc().numel(), multiplier
+        );
+        ctx.set_tensor(m_outputs[i - 2], output);
+    }
+
+    if (!finite) {
+        ctx.set_grad_overflow();
+    }
+}
+
+void GOpUnscaleGrads::forward_hook_post(GraphForwardContext &ctx) const {
+    const auto &desc = this->template desc<OpUnscaleGradsDesc>();
+    float scale = tocc_scalar<float>(ctx.tensor(m_inputs[0]));
+    int64_t steps = tocc_scalar<int64_t>(ctx.tensor(m_inputs[1]));
+
+    if (ctx.grad_overflow()) {
+        scale *= desc.backoff_factor;
+        steps = 0;
+    } else if (++steps >= desc.growth_interval) {
+        if (std::isfinite(scale * desc.growth_factor)) {
+            scale *= desc.growth_factor;
+        }
+        steps = 0;
+    }
+
+    ctx.session().set_shared_tensor(m_inputs[0], scalar(DTypeName::Float32, scale));
+    ctx.session().set_shared_tensor(m_inputs[1], scalar(DTypeName::Int64, steps));
+}
+
+} /* !namespace ncg */
@@ -0,0 +1,57 @@
+/*
+ * mixed_precision.h
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#pragma once
+
+#include "core/half.h"
+#include "core/tensor_impl.h"
+#include "graph/op.h"
+
+namespace ncg {
+
+class OpUnscaleGradsDesc : public OpDesc {
+public:
+    OpUnscaleGradsDesc() {}
+    OpUnscaleGradsDesc(float growth_factor, float backoff_factor, int64_t growth_interval)
+        : growth_factor(growth_factor), backoff_factor(backoff_factor), growth_interval(growth_interval) {}
+    virtual ~OpUnscaleGradsDesc() = default;
+
+    virtual void pickle(NCGPickler &pickler) const {
+        pickler.write(static_cast<int64_t>(float_as_bits(growth_factor)));
+        pickler.write(static_cast<int64_t>(float_as_bits(backoff_factor)));
+        pickler.write(growth_interval);
+    }
+    virtual void unpickle(NCGUnpickler &unpickler) {
+        growth_factor = bits_as_float(static_cast<uint32_t>(unpickler.read_int64()));
+        backoff_factor = bits_as_float(static_cast<uint32_t>(unpickler.read_int64()));
+        growth_interval = unpickler.read_int64();
+    }
+
+    float growth_factor = 2;
+    float backoff_factor = 0.5;
+    int64_t growth_interval = 2000;
+};
+
+/*
+ * Inputs: the loss scale (a Float32 scalar variable), the number of steps since its last change (an Int64 scalar
+ * variable) and the (scaled) gradients of the variables, all Float32. Outputs: the gradients divided by the loss
+ * scale. Non-finite gradients mark the step as overflowed (see GraphForwardContext::grad_overflow); after the step,
+ * the loss scale is updated in the session (see MixedPrecisionConfig).
+ */
+class GOpUnscaleGrads : public GraphOp {
+public:
+    NCG_GOP_DEF_NAME(GOpUnscaleGrads);
+
+    virtual void check_inputs(Graph &graph, const GTensorVec &inputs);
+    virtual GTensorVec init_outputs(Graph &graph, const GTensorVec &inputs);
+    virtual void forward(GraphForwardContext &ctx) const;
+    virtual void forward_hook_post(GraphForwardContext &ctx) const;
+
+    NCG_GOP_DEF_NO_GRAD_INLINE;
+};
+
+} /* !namespace ncg */
@@ -18,6 +18,7 @@ public:
     }
 
     NCG_GOP_DEF_NO_GRAD_INLINE;
+    NCG_GOP_DEF_NO_COST_INLINE;
 };
 
 class GOpPlaceholderDesc : public OpDesc {
@@ -26,6 +27,13 @@ public:
     GOpPlaceholderDesc(DTypeName dtype, const ShapeVec &shape) : desc(dtype, shape) {}
     virtual ~GOpPlaceholderDesc() = default;
 
+    virtual void pickle(NCGPickler &pickler) const {
+        desc.pickle(pickler);
+    }
+    virtual void unpickle(NCGUnpickler &unpickler) {
+        desc = TensorDesc(unpickler);
+    }
+
     TensorDesc desc;
 };
 
@@ -51,6 +59,13 @@ public:
     GOpConstantDesc(const TensorPtr &tensor) : tensor(tensor) {}
     virtual ~GOpConstantDesc() = default;
 
+    virtual void pickle(NCGPickler &pickler) const {
+        tensor->pickle(pickler);
+    }
+    virtual void unpickle(NCGUnpickler &unpickler) {
+        tensor = ::ncg::tensor(unpickler);
+    }
+
     TensorPtr tensor;
 };
 
@@ -72,6 +87,13 @@ public:
     GOpVariableDesc(const TensorPtr &tensor) : tensor(tensor) {}
     virtual ~GOpVariableDesc() = default;
 
+    virtual void pickle(NCGPickler &pickler) const {
+        tensor->pickle(pickler);
+    }
+    virtual void unpickle(NCGUnpickler &unpickler) {
+        tensor = ::ncg::tensor(unpickler);
+    }
+
     TensorPtr tensor;
 };
 
@@ -102,6 +124,13 @@ public:
         }
     }
 
+    // Only the filling of the output.
+    virtual OpCost cost(const TensorDescVec &inputs, const TensorDescVec &outputs) const {
+        OpCost cost;
+        cost.bytes_written = get_desc_memsize(outputs[0]);
+        return cost;
+    }
+
     NCG_GOP_DEF_NO_GRAD_INLINE;
 };
 
@@ -111,6 +140,13 @@ public:
     OpZerosDesc(DTypeName dtype, const ShapeVec &shape) : desc(dtype, shape) {}
     virtual ~OpZerosDesc() = default;
 
+    virtual void pickle(NCGPickler &pickler) const {
+        desc.pickle(pickler);
+    }
+    virtual void unpickle(NCGUnpickler &unpickler) {
+        desc = TensorDesc(unpickler);
+    }
+
     TensorDesc desc;
 };
 
@@ -142,12 +178,19 @@ public:
     OpOnesDesc(DTypeName dtype, const ShapeVec &shape) : desc(dtype, shape) {}
     virtual ~OpOnesDesc() = default;
 
+    virtual void pickle(NCGPickler &pickler) const {
+        desc.pickle(pickler);
+    }
+    virtual void unpickle(NCGUnpickler &unpickler) {
+        desc = TensorDesc(unpickler);
+    }
+
     TensorDesc desc;
 };
 
 class GOpOnes: public GraphNetSrcOpDynamicShape {
 public:
-    NCG_GOP_DEF_NAME(GOpZeros);
+    NCG_GOP_DEF_NAME(GOpOnes);
 
     virtual GTensorVec init_outputs(Graph &graph, const GTensorVec &inputs) {
         return {make_tensor(0, this->template desc<OpOnesDesc>().desc)};
@@ -0,0 +1,19 @@
+/*
+ * quantize.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "graph/ops/quantize.h"
+
+namespace ncg {
+
+OpCost GOpQuantizedMatMul::cost(const TensorDescVec &inputs, const TensorDescVec &outputs) const {
+    // One multiply and one add per (n, m, k), as for GOpMatMul.
+    auto cost = elemwise_op_cost(inputs, outputs);
+    cost.flops = 2.0 * inputs[0].shape(1) * outputs[0].numel();
+    return cost;
+}
+
+} /* !namespace ncg */
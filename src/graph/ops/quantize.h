@@ -0,0 +1,89 @@
+/*
+ * quantize.h
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#pragma once
+
+#include "core/tensor_impl.h"
+#include "core/ops/quantize.h"
+#include "graph/op.h"
+
+namespace ncg {
+
+/* The quantized ops are for inference only: they have no gradients. */
+
+class GOpQuantize : public GraphOpWrapper<OpQuantize>, public GraphSingleOutputOp {
+public:
+    NCG_GOP_DEF_NAME(GOpQuantize);
+
+    virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
+        NCG_OP_CHECK_NR_INPUTS(graph, inputs, 1);
+        if (!is_float_dtype(inputs[0]->desc().dtype())) {
+            graph.error(this) << "GOpQuantize requires a floating-point input, but got " << get_dtype_name(inputs[0]->desc().dtype()) << ".";
+        }
+    }
+
+    virtual GTensorVec init_outputs(Graph &graph, const GTensorVec &inputs) {
+        return {make_tensor(0, inputs[0]->desc().as_contiguous(DTypeName::Int8))};
+    }
+
+    NCG_GOP_DEF_NO_GRAD_INLINE;
+};
+
+class GOpDequantize : public GraphOpWrapper<OpDequantize>, public GraphSingleOutputOp {
+public:
+    NCG_GOP_DEF_NAME(GOpDequantize);
+
+    virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
+        NCG_OP_CHECK_NR_INPUTS(graph, inputs, 1);
+        auto dtype = inputs[0]->desc().dtype();
+        if (dtype != DTypeName::Int8 && dtype != DTypeName::Int32) {
+            graph.error(this) << "GOpDequantize requires an Int8 or Int32 input, but got " << get_dtype_name(dtype) << ".";
+        }
+    }
+
+    virtual GTensorVec init_outputs(Graph &graph, const GTensorVec &inputs) {
+        return {make_tensor(0, inputs[0]->desc().as_contiguous(DTypeName::Float32))};
+    }
+
+    NCG_GOP_DEF_NO_GRAD_INLINE;
+};
+
+class GOpQuantizedMatMul : public GraphOpWrapper<OpQuantizedMatMul>, public GraphSingleOutputOp {
+public:
+    NCG_GOP_DEF_NAME(GOpQuantizedMatMul);
+
+    virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
+        NCG_OP_CHECK_NR_INPUTS2(graph, inputs, 2, 3);
+        NCG_OP_CHECK_INPUT_DTYPE(graph, inputs, 0, Int8);
+        NCG_OP_CHECK_INPUT_DTYPE(graph, inputs, 1, Int8);
+        NCG_OP_CHECK_INPUT_DIM(graph, inputs, 0, 2);
+        NCG_OP_CHECK_INPUT_DIM(graph, inputs, 1, 2);
+
+        const auto &desc = this->template desc<OpQuantizedMatMulDesc>();
+        ssize_t k2 = !desc.transpose_b ? inputs[1]->desc().shape(0) : inputs[1]->desc().shape(1);
+        if (inputs[0]->desc().shape(1) != k2) {
+            graph.error(this) << "Invalid shape: " << inputs[0]->desc().shape_vec() << " vs. " << inputs[1]->desc().shape_vec() << ".";
+            return;
+        }
+        if (inputs.size() == 3) {
+            NCG_OP_CHECK_INPUT_DTYPE(graph, inputs, 2, Int32);
+            NCG_OP_CHECK_INPUT_VECTOR(graph, inputs, 2);
+        }
+    }
+
+    virtual GTensorVec init_outputs(Graph &graph, const GTensorVec &inputs) {
+        const auto &desc = this->template desc<OpQuantizedMatMulDesc>();
+        ssize_t N = inputs[0]->desc().shape(0);
+        ssize_t M = !desc.transpose_b ? inputs[1]->desc().shape(1) : inputs[1]->desc().shape(0);
+        return {make_tensor(0, TensorDesc(desc.dtype, {N, M}))};
+    }
+
+    virtual OpCost cost(const TensorDescVec &inputs, const TensorDescVec &outputs) const;
+    NCG_GOP_DEF_NO_GRAD_INLINE;
+};
+
+} /* !namespace ncg */
@@ -21,6 +21,13 @@ public:
         NCG_OP_CHECK_NR_INPUTS(graph, inputs, 1);
         NCG_OP_CHECK_INPUT_DIM_GEQ(graph, inputs, 0, desc.axis);
     }
+
+    // One flop per input element.
+    virtual OpCost cost(const TensorDescVec &inputs, const TensorDescVec &outputs) const {
+        auto cost = elemwise_op_cost(inputs, outputs);
+        cost.flops = inputs[0].numel();
+        return cost;
+    }
 };
 
 template <typename OpClass>
@@ -70,7 +77,7 @@ public:
 #define DEF_GOP_REDUCE(name, type_id) \
 class GOpReduce##name : public GOpReduceType##type_id##Base<OpReduce##name> { \
 public: \
-    NCG_GOP_DEF_NAME(GOp##name); \
+    NCG_GOP_DEF_NAME(GOpReduce##name); \
     virtual void backward(Graph &graph, GTensorPtr loss); \
 }
 
@@ -15,6 +15,7 @@ namespace ncg {
 class GOpShapeOf : public GraphOp, public GraphSingleOutputOp {
 public:
     NCG_GOP_DEF_NAME(GOpShapeOf);
+    NCG_GOP_DEF_NO_COST_INLINE;
 
     virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
         NCG_OP_CHECK_NR_INPUTS(graph, inputs, 1);
@@ -39,12 +40,20 @@ public:
     OpShapeOfIndexDesc(ssize_t axis) : axis(axis) {}
     virtual ~OpShapeOfIndexDesc() = default;
 
+    virtual void pickle(NCGPickler &pickler) const {
+        pickler.write(static_cast<int64_t>(axis));
+    }
+    virtual void unpickle(NCGUnpickler &unpickler) {
+        axis = static_cast<ssize_t>(unpickler.read_int64());
+    }
+
     ssize_t axis;
 };
 
 class GOpShapeOfIndex : public GraphOp, public GraphSingleOutputOp {
 public:
     NCG_GOP_DEF_NAME(GOpShapeOfIndex);
+    NCG_GOP_DEF_NO_COST_INLINE;
 
     virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
         NCG_OP_CHECK_NR_INPUTS(graph, inputs, 1);
@@ -74,6 +83,7 @@ public:
 class GOpShapeConcat : public GraphOp, public GraphSingleOutputOp {
 public:
     NCG_GOP_DEF_NAME(GOpShapeConcat);
+    NCG_GOP_DEF_NO_COST_INLINE;
 
     virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
         NCG_OP_CHECK_NONEMPTY_INPUTS(graph, inputs);
@@ -127,6 +137,7 @@ public:
 class GOpReshape : public GraphOp, public GraphSingleOutputOp {
 public:
     NCG_GOP_DEF_NAME(GOpReshape);
+    NCG_GOP_DEF_NO_COST_INLINE;
 
     virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
         NCG_OP_CHECK_NR_INPUTS2(graph, inputs, 1, 2);
@@ -167,6 +178,7 @@ public:
 class GOpPermute : public GraphOp, public GraphSingleOutputOp {
 public:
     NCG_GOP_DEF_NAME(GOpPermute);
+    NCG_GOP_DEF_NO_COST_INLINE;
 
     virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
         NCG_OP_CHECK_NR_INPUTS(graph, inputs, 1);
@@ -198,6 +210,7 @@ public:
 class GOpExpand : public GraphOp, public GraphSingleOutputOp {
 public:
     NCG_GOP_DEF_NAME(GOpExpand);
+    NCG_GOP_DEF_NO_COST_INLINE;
 
     virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
         NCG_OP_CHECK_NR_INPUTS2(graph, inputs, 1, 2);
@@ -238,6 +251,7 @@ public:
 class GOpSqueeze : public GraphOpWrapper<OpSqueeze>, public GraphSingleOutputOp {
 public:
     NCG_GOP_DEF_NAME(GOpSqueeze);
+    NCG_GOP_DEF_NO_COST_INLINE;
 
     virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
         NCG_OP_CHECK_NR_INPUTS(graph, inputs, 1);
@@ -265,6 +279,7 @@ public:
 class GOpUnsqueeze : public GraphOpWrapper<OpUnsqueeze>, public GraphSingleOutputOp {
 public:
     NCG_GOP_DEF_NAME(GOpUnsqueeze);
+    NCG_GOP_DEF_NO_COST_INLINE;
 
     virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
         NCG_OP_CHECK_NR_INPUTS(graph, inputs, 1);
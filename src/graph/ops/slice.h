@@ -16,6 +16,7 @@ namespace ncg {
 class GOpConcat : public GraphOpWrapper<OpConcat>, public GraphSingleOutputOp {
 public:
     NCG_GOP_DEF_NAME(GopConcat);
+    NCG_GOP_DEF_COPY_COST_INLINE;
 
     virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
         NCG_OP_CHECK_NONEMPTY_INPUTS(graph, inputs);
@@ -41,6 +42,7 @@ public:
 class GOpSplit: public GraphOp {
 public:
     NCG_GOP_DEF_NAME(GopSplit);
+    NCG_GOP_DEF_COPY_COST_INLINE;
 
     virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
         NCG_OP_CHECK_NR_INPUTS2(graph, inputs, 1, 2);
@@ -63,7 +65,6 @@ public:
             auto shape = input->desc().shape_vec();
             shape[axis] = splits[i];
             TensorDesc desc(input->desc().dtype(), shape);
-            desc.shape(axis) = splits[i];
             outputs[i] = make_tensor(i, desc);
         }
         return outputs;
@@ -96,6 +97,7 @@ public:
 class GOpNarrow : public GraphOp, public GraphSingleOutputOp {
 public:
     NCG_GOP_DEF_NAME(GOpNarrow);
+    NCG_GOP_DEF_NO_COST_INLINE;
 
     virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
         NCG_OP_CHECK_NR_INPUTS2(graph, inputs, 1, 3);
@@ -146,6 +148,7 @@ public:
 class GOpNarrowBackward : public GraphOp, public GraphSingleOutputOp {
 public:
     NCG_GOP_DEF_NAME(GOpNarrowBackward);
+    NCG_GOP_DEF_COPY_COST_INLINE;
 
     virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
         NCG_OP_CHECK_NR_INPUTS2(graph, inputs, 1, 3);
@@ -196,6 +199,7 @@ public:
 class GOpIndexSelect : public GraphOpWrapper<OpIndexSelect>, public GraphSingleOutputOp {
 public:
     NCG_GOP_DEF_NAME(GopIndexSelect);
+    NCG_GOP_DEF_COPY_COST_INLINE;
 
     virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
         NCG_OP_CHECK_NR_INPUTS(graph, inputs, 2);
@@ -218,6 +222,7 @@ public:
 class GOpIndexSelectBackward : public GraphOp, public GraphSingleOutputOp {
 public:
     NCG_GOP_DEF_NAME(GopIndexSelectBackward);
+    NCG_GOP_DEF_COPY_COST_INLINE;
 
     virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
         NCG_OP_CHECK_NR_INPUTS2(graph, inputs, 2, 3);
@@ -268,6 +273,7 @@ public:
 class GOpGather : public GraphOpWrapper<OpGather>, public GraphSingleOutputOp {
 public:
     NCG_GOP_DEF_NAME(GopGather);
+    NCG_GOP_DEF_COPY_COST_INLINE;
 
     virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
         NCG_OP_CHECK_NR_INPUTS(graph, inputs, 2);
@@ -290,6 +296,7 @@ public:
 class GOpGatherBackward : public GraphOp, public GraphSingleOutputOp {
 public:
     NCG_GOP_DEF_NAME(GopGatherBackward);
+    NCG_GOP_DEF_COPY_COST_INLINE;
 
     virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
         NCG_OP_CHECK_NR_INPUTS2(graph, inputs, 2, 3);
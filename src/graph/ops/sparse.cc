@@ -0,0 +1,41 @@
+/*
+ * sparse.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "graph/ops/sparse.h"
+
+namespace ncg {
+
+OpCost GOpSparseMatMul::cost(const TensorDescVec &inputs, const TensorDescVec &outputs) const {
+    // One multiply and one add per (non-zero, output column); the static number of non-zeros is the one of the
+    // placeholder, so the estimates are only exact at run time (e.g., in the profiler).
+    auto cost = elemwise_op_cost(inputs, outputs);
+    cost.flops = 2.0 * inputs[2].numel() * outputs[0].shape(1);
+    return cost;
+}
+
+void GOpSparseMatMul::backward(Graph &graph, GTensorPtr loss) {
+    const auto &desc = this->template desc<OpSparseMatMulDesc>();
+
+    m_inputs[0]->set_grad(graph, loss, nullptr);
+    m_inputs[1]->set_grad(graph, loss, nullptr);
+    m_inputs[2]->set_grad(graph, loss, nullptr);
+
+    auto output_grad = m_outputs[0]->grad(loss);
+    if (output_grad == nullptr) {
+        m_inputs[3]->set_grad(graph, loss, nullptr);
+        return;
+    }
+
+    // d(a @ b) / db = a^T @ output_grad, which is again a sparse product.
+    m_inputs[3]->set_grad(graph, loss,
+        graph.op<GOpSparseMatMul>(OpDescPtr(new OpSparseMatMulDesc(
+            desc.rows, desc.cols, !desc.transpose_a
+        )), m_inputs[0], m_inputs[1], m_inputs[2], output_grad)
+    );
+}
+
+} /* !namespace ncg */
@@ -0,0 +1,60 @@
+/*
+ * sparse.h
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#pragma once
+
+#include "core/tensor_impl.h"
+#include "core/ops/sparse.h"
+#include "graph/op.h"
+
+namespace ncg {
+
+/*
+ * The inputs are (indptr, indices, values) of a CSR matrix (see G::sparse_placeholder) and a dense b. Only b gets
+ * a gradient: the sparse operand is an input of the network, not a parameter.
+ */
+class GOpSparseMatMul : public GraphOpWrapper<OpSparseMatMul>, public GraphSingleOutputOp {
+public:
+    NCG_GOP_DEF_NAME(GOpSparseMatMul);
+
+    virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
+        NCG_OP_CHECK_NR_INPUTS(graph, inputs, 4);
+        NCG_OP_CHECK_INPUT_VECTOR(graph, inputs, 0);
+        NCG_OP_CHECK_INPUT_VECTOR(graph, inputs, 1);
+        NCG_OP_CHECK_INPUT_VECTOR(graph, inputs, 2);
+        NCG_OP_CHECK_INPUT_DTYPE(graph, inputs, 0, Int64);
+        NCG_OP_CHECK_INPUT_DTYPE(graph, inputs, 1, Int64);
+        NCG_OP_CHECK_INPUT_DTYPE_FLOAT(graph, inputs, 3);
+        NCG_OP_CHECK_INPUT_DIM(graph, inputs, 3, 2);
+        if (inputs[2]->desc().dtype() != inputs[3]->desc().dtype()) {
+            graph.error(this) << "The sparse values and the dense operand must have the same dtype, got "
+                              << get_dtype_name(inputs[2]->desc().dtype()) << " and " << get_dtype_name(inputs[3]->desc().dtype()) << ".";
+            return;
+        }
+
+        const auto &desc = this->template desc<OpSparseMatMulDesc>();
+        if (inputs[0]->desc().shape(0) != desc.rows + 1) {
+            graph.error(this) << "Invalid sparse tensor: " << desc.rows + 1 << " row pointers expected, got " << inputs[0]->desc().shape(0) << ".";
+            return;
+        }
+        ssize_t k = !desc.transpose_a ? desc.cols : desc.rows;
+        if (inputs[3]->desc().shape(0) != k) {
+            graph.error(this) << "Invalid shape: " << ShapeVec{desc.rows, desc.cols} << " (sparse) vs. " << inputs[3]->desc().shape_vec() << ".";
+        }
+    }
+
+    virtual GTensorVec init_outputs(Graph &graph, const GTensorVec &inputs) {
+        const auto &desc = this->template desc<OpSparseMatMulDesc>();
+        ssize_t N = !desc.transpose_a ? desc.rows : desc.cols;
+        return {make_tensor(0, TensorDesc(inputs[3]->desc().dtype(), {N, inputs[3]->desc().shape(1)}))};
+    }
+
+    virtual OpCost cost(const TensorDescVec &inputs, const TensorDescVec &outputs) const;
+    virtual void backward(Graph &graph, GTensorPtr loss);
+};
+
+} /* !namespace ncg */
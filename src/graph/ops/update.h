@@ -15,6 +15,7 @@ namespace ncg {
 class GOpAssign : public GraphOp, public GraphSingleOutputOp {
 public:
     NCG_GOP_DEF_NAME(GOpAssign);
+    NCG_GOP_DEF_NO_COST_INLINE;
 
     virtual void check_inputs(Graph &graph, const GTensorVec &inputs) {
         NCG_OP_CHECK_NR_INPUTS(graph, inputs, 2);
@@ -38,6 +39,10 @@ public:
     }
 
     virtual void forward_hook_post(GraphForwardContext &ctx) const {
+        // The gradients of this mixed-precision step overflowed (see GOpUnscaleGrads): skip the update.
+        if (ctx.grad_overflow()) {
+            return;
+        }
         auto new_variable = ctx.tensor(m_inputs[1]);
         ctx.session().set_shared_tensor(m_inputs[0], new_variable);
     }
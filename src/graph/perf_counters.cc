@@ -0,0 +1,144 @@
+/*
+ * perf_counters.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "graph/perf_counters.h"
+
+#ifdef __linux__
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace ncg {
+
+const char *get_perf_counter_name(PerfCounter counter) {
+    switch (counter) {
+        case PerfCounter::Cycles: return "cycles";
+        case PerfCounter::Instructions: return "instructions";
+        case PerfCounter::CacheMisses: return "cache-misses";
+        case PerfCounter::BranchMisses: return "branch-misses";
+    }
+    return "unknown";
+}
+
+PerfCounterValues &PerfCounterValues::operator += (const PerfCounterValues &rhs) {
+    for (size_t i = 0; i < PerfNrCounters; ++i) {
+        values[i] += rhs.values[i];
+    }
+    valid |= rhs.valid;
+    return *this;
+}
+
+#ifdef __linux__
+
+namespace {
+
+const uint64_t PerfEventConfigs[PerfNrCounters] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+int perf_event_open(uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // Count the threads spawned by the kernels (parallel_for) too; their counts are summed into ours.
+    attr.inherit = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+} /* !namespace <anonymous> */
+
+PerfCounterGroup::PerfCounterGroup() : m_error() {
+    int last_errno = 0;
+    for (size_t i = 0; i < PerfNrCounters; ++i) {
+        m_fds[i] = perf_event_open(PerfEventConfigs[i]);
+        if (m_fds[i] < 0) last_errno = errno;
+    }
+    if (!available()) {
+        m_error = std::string("perf_event_open failed: ") + strerror(last_errno);
+    }
+}
+
+PerfCounterGroup::~PerfCounterGroup() {
+    for (size_t i = 0; i < PerfNrCounters; ++i) {
+        if (m_fds[i] >= 0) close(m_fds[i]);
+    }
+}
+
+bool PerfCounterGroup::available() const {
+    for (size_t i = 0; i < PerfNrCounters; ++i) {
+        if (m_fds[i] >= 0) return true;
+    }
+    return false;
+}
+
+void PerfCounterGroup::start() {
+    for (size_t i = 0; i < PerfNrCounters; ++i) {
+        if (m_fds[i] < 0) continue;
+        ioctl(m_fds[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(m_fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+PerfCounterValues PerfCounterGroup::stop() {
+    for (size_t i = 0; i < PerfNrCounters; ++i) {
+        if (m_fds[i] >= 0) ioctl(m_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+
+    PerfCounterValues result;
+    for (size_t i = 0; i < PerfNrCounters; ++i) {
+        if (m_fds[i] < 0) continue;
+
+        // {value, time_enabled, time_running}; scale the value if the counter was multiplexed.
+        uint64_t data[3];
+        if (read(m_fds[i], data, sizeof(data)) != sizeof(data) || data[2] == 0) continue;
+        result.values[i] = data[2] < data[1] ? static_cast<uint64_t>(static_cast<double>(data[0]) * data[1] / data[2]) : data[0];
+        result.valid |= 1u << i;
+    }
+    return result;
+}
+
+#else  // __linux__
+
+PerfCounterGroup::PerfCounterGroup() : m_error("hardware performance counters are only supported on Linux") {
+    for (size_t i = 0; i < PerfNrCounters; ++i) m_fds[i] = -1;
+}
+
+PerfCounterGroup::~PerfCounterGroup() {
+    // Pass
+}
+
+bool PerfCounterGroup::available() const {
+    return false;
+}
+
+void PerfCounterGroup::start() {
+    // Pass
+}
+
+PerfCounterValues PerfCounterGroup::stop() {
+    return PerfCounterValues();
+}
+
+#endif  // __linux__
+
+const std::string &PerfCounterGroup::error() const {
+    return m_error;
+}
+
+} /* !namespace ncg */
@@ -0,0 +1,64 @@
+/*
+ * perf_counters.h
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#pragma once
+
+#include "core/common.h"
+
+#include <cstdint>
+#include <string>
+
+namespace ncg {
+
+enum class PerfCounter : int {
+    Cycles = 0,
+    Instructions = 1,
+    CacheMisses = 2,
+    BranchMisses = 3,
+};
+
+const size_t PerfNrCounters = 4;
+
+const char *get_perf_counter_name(PerfCounter counter);
+
+struct PerfCounterValues {
+    uint64_t values[PerfNrCounters] = {0, 0, 0, 0};
+    // Bitmask of the counters which could be read.
+    uint32_t valid = 0;
+
+    bool has(PerfCounter counter) const { return valid & (1u << static_cast<int>(counter)); }
+    uint64_t operator [] (PerfCounter counter) const { return values[static_cast<int>(counter)]; }
+    PerfCounterValues &operator += (const PerfCounterValues &rhs);
+};
+
+/*
+ * Hardware counters of the calling thread and of the threads it spawns while the counters are open, e.g.
+ * the workers of parallel_for (user space only), based on perf_event_open(2). Opening the
+ * counters fails gracefully (e.g., on non-Linux systems, in containers, or with a restrictive
+ * /proc/sys/kernel/perf_event_paranoid): available() returns false and error() tells why. Counters
+ * which are not supported by the CPU are skipped individually.
+ */
+class PerfCounterGroup {
+public:
+    PerfCounterGroup();
+    virtual ~PerfCounterGroup();
+
+    PerfCounterGroup(const PerfCounterGroup &) = delete;
+    PerfCounterGroup(PerfCounterGroup &&) = delete;
+
+    bool available() const;
+    const std::string &error() const;
+
+    void start();
+    PerfCounterValues stop();
+
+protected:
+    int m_fds[PerfNrCounters];
+    std::string m_error;
+};
+
+} /* !namespace ncg */
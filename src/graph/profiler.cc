@@ -0,0 +1,243 @@
+/*
+ * profiler.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "graph/profiler.h"
+#include "graph/graph.h"
+#include "graph/op.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <unordered_map>
+
+namespace ncg {
+
+namespace {
+
+void write_json_shapes(std::ostream &out, const std::vector<ShapeVec> &shapes) {
+    out << '[';
+    for (size_t i = 0; i < shapes.size(); ++i) {
+        out << (i == 0 ? "[" : ", [");
+        for (size_t j = 0; j < shapes[i].size(); ++j) {
+            out << (j == 0 ? "" : ", ") << shapes[i][j];
+        }
+        out << ']';
+    }
+    out << ']';
+}
+
+template <typename KeyFunc>
+std::vector<GraphProfileSummary> summarize(const std::vector<GraphProfileEvent> &events, KeyFunc key_func) {
+    std::unordered_map<std::string, size_t> index;
+    std::vector<GraphProfileSummary> summaries;
+
+    for (const auto &event : events) {
+        const std::string &key = key_func(event);
+        auto it = index.find(key);
+        if (it == index.end()) {
+            it = index.emplace(key, summaries.size()).first;
+            summaries.emplace_back();
+            summaries.back().key = key;
+            summaries.back().min = event.duration;
+            summaries.back().max = event.duration;
+        }
+
+        auto &summary = summaries[it->second];
+        summary.count += 1;
+        summary.total += event.duration;
+        summary.min = std::min(summary.min, event.duration);
+        summary.max = std::max(summary.max, event.duration);
+        summary.allocated_bytes += event.allocated_bytes;
+        summary.output_numel += event.output_numel;
+        summary.counters += event.counters;
+        summary.cost += event.cost;
+    }
+
+    std::stable_sort(summaries.begin(), summaries.end(), [](const GraphProfileSummary &a, const GraphProfileSummary &b) {
+        return a.total > b.total;
+    });
+    return summaries;
+}
+
+const size_t ProfileMaxPrint = 20;
+
+void print_summaries(std::ostream &out, const std::string &title, const std::vector<GraphProfileSummary> &summaries) {
+    out << title << ":" << std::endl;
+    out << "  " << std::left << std::setw(40) << "key" << std::right
+        << std::setw(8) << "count" << std::setw(12) << "total(ms)" << std::setw(12) << "mean(us)"
+        << std::setw(12) << "min(us)" << std::setw(12) << "max(us)" << std::setw(12) << "alloc(KB)" << std::endl;
+    for (size_t i = 0; i < std::min(summaries.size(), ProfileMaxPrint); ++i) {
+        const auto &s = summaries[i];
+        out << "  " << std::left << std::setw(40) << s.key << std::right
+            << std::setw(8) << s.count << std::setw(12) << s.total / 1000 << std::setw(12) << s.mean()
+            << std::setw(12) << s.min << std::setw(12) << s.max << std::setw(12) << s.allocated_bytes / 1024.0 << std::endl;
+    }
+    if (summaries.size() > ProfileMaxPrint) {
+        out << "  ... (" << summaries.size() - ProfileMaxPrint << " more)" << std::endl;
+    }
+}
+
+void print_counter_summaries(std::ostream &out, const std::string &title, const std::vector<GraphProfileSummary> &summaries) {
+    out << title << ":" << std::endl;
+    out << "  " << std::left << std::setw(40) << "key" << std::right
+        << std::setw(14) << "Mcycles" << std::setw(8) << "IPC"
+        << std::setw(20) << "cache-misses/elem" << std::setw(20) << "branch-misses/elem" << std::endl;
+    for (size_t i = 0; i < std::min(summaries.size(), ProfileMaxPrint); ++i) {
+        const auto &s = summaries[i];
+        out << "  " << std::left << std::setw(40) << s.key << std::right
+            << std::setw(14) << s.counters[PerfCounter::Cycles] / 1e6 << std::setw(8) << s.ipc()
+            << std::setw(20) << s.per_element(PerfCounter::CacheMisses) << std::setw(20) << s.per_element(PerfCounter::BranchMisses) << std::endl;
+    }
+}
+
+} /* !namespace <anonymous> */
+
+double GraphProfileSummary::ipc() const {
+    if (!counters.has(PerfCounter::Cycles) || !counters.has(PerfCounter::Instructions) || counters[PerfCounter::Cycles] == 0) {
+        return 0;
+    }
+    return static_cast<double>(counters[PerfCounter::Instructions]) / counters[PerfCounter::Cycles];
+}
+
+double GraphProfileSummary::per_element(PerfCounter counter) const {
+    if (!counters.has(counter) || output_numel == 0) {
+        return 0;
+    }
+    return static_cast<double>(counters[counter]) / output_numel;
+}
+
+double GraphProfileSummary::gflops() const {
+    return total > 0 ? cost.flops / (total * 1e3) : 0;
+}
+
+double GraphProfileSummary::gbytes_per_second() const {
+    return total > 0 ? cost.bytes() / (total * 1e3) : 0;
+}
+
+GraphProfiler::GraphProfiler() : m_start(std::chrono::steady_clock::now()), m_events() {
+    // Pass
+}
+
+void GraphProfiler::forward(GraphForwardContext &ctx, const GraphOp *op) {
+    GraphProfileEvent event;
+    event.op_name = op->op_name();
+    event.name = op->name();
+    TensorDescVec input_descs;
+    for (const auto &gtensor : op->inputs()) {
+        input_descs.emplace_back(ctx.tensor(gtensor)->desc());
+        event.input_shapes.emplace_back(input_descs.back().shape_vec());
+    }
+
+    size_t allocated_bytes = tensor_storage_allocated_bytes();
+    event.start = now_();
+    if (m_perf_counters != nullptr) {
+        m_perf_counters->start();
+        op->forward(ctx);
+        event.counters = m_perf_counters->stop();
+    } else {
+        op->forward(ctx);
+    }
+    event.duration = now_() - event.start;
+    event.allocated_bytes = tensor_storage_allocated_bytes() - allocated_bytes;
+
+    if (ctx.is_error()) {
+        return;
+    }
+    event.output_numel = 0;
+    TensorDescVec output_descs;
+    for (const auto &gtensor : op->outputs()) {
+        if (ctx.has_tensor(gtensor)) {
+            output_descs.emplace_back(ctx.tensor(gtensor)->desc());
+            event.output_shapes.emplace_back(output_descs.back().shape_vec());
+            event.output_numel += output_descs.back().numel();
+        } else {
+            event.output_shapes.emplace_back();
+        }
+    }
+    if (output_descs.size() == op->outputs().size()) {
+        event.cost = op->cost(input_descs, output_descs);
+    }
+    m_events.emplace_back(std::move(event));
+}
+
+void GraphProfiler::reset() {
+    m_start = std::chrono::steady_clock::now();
+    m_events.clear();
+}
+
+bool GraphProfiler::enable_perf_counters() {
+    if (m_perf_counters == nullptr) {
+        m_perf_counters = std::make_unique<PerfCounterGroup>();
+    }
+    return m_perf_counters->available();
+}
+
+const PerfCounterGroup *GraphProfiler::perf_counters() const {
+    return m_perf_counters.get();
+}
+
+const std::vector<GraphProfileEvent> &GraphProfiler::events() const {
+    return m_events;
+}
+
+std::vector<GraphProfileSummary> GraphProfiler::summary_by_op_type() const {
+    return summarize(m_events, [](const GraphProfileEvent &event) -> const std::string & { return event.op_name; });
+}
+
+std::vector<GraphProfileSummary> GraphProfiler::summary_by_name() const {
+    return summarize(m_events, [](const GraphProfileEvent &event) -> const std::string & { return event.name; });
+}
+
+void GraphProfiler::dump_chrome_trace(std::ostream &out) const {
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    for (size_t i = 0; i < m_events.size(); ++i) {
+        const auto &event = m_events[i];
+        out << (i == 0 ? "\n" : ",\n");
+        out << "{\"name\": "; write_json_string(out, event.name);
+        out << ", \"cat\": "; write_json_string(out, event.op_name);
+        out << std::fixed << std::setprecision(3);
+        out << ", \"ph\": \"X\", \"pid\": 0, \"tid\": 0, \"ts\": " << event.start << ", \"dur\": " << event.duration;
+        out << std::defaultfloat;
+        out << ", \"args\": {\"inputs\": "; write_json_shapes(out, event.input_shapes);
+        out << ", \"outputs\": "; write_json_shapes(out, event.output_shapes);
+        out << ", \"allocated_bytes\": " << event.allocated_bytes;
+        out << ", \"flops\": " << event.cost.flops << ", \"bytes\": " << event.cost.bytes();
+        for (size_t j = 0; j < PerfNrCounters; ++j) {
+            auto counter = static_cast<PerfCounter>(j);
+            if (event.counters.has(counter)) out << ", \"" << get_perf_counter_name(counter) << "\": " << event.counters[counter];
+        }
+        out << "}}";
+    }
+    out << "\n]}" << std::endl;
+}
+
+void GraphProfiler::dump_chrome_trace(const std::string &filename) const {
+    std::ofstream out(filename);
+    ncg_assert_msg(out.good(), "cannot open " + filename);
+    dump_chrome_trace(out);
+}
+
+double GraphProfiler::now_() const {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - m_start).count();
+}
+
+std::ostream &operator << (std::ostream &out, const GraphProfiler &profiler) {
+    out << std::fixed << std::setprecision(2);
+    print_summaries(out, "Per op type", profiler.summary_by_op_type());
+    print_summaries(out, "Per op", profiler.summary_by_name());
+    if (profiler.perf_counters() != nullptr) {
+        if (profiler.perf_counters()->available()) {
+            print_counter_summaries(out, "Hardware counters per op type", profiler.summary_by_op_type());
+        } else {
+            out << "Hardware counters unavailable: " << profiler.perf_counters()->error() << std::endl;
+        }
+    }
+    out << std::defaultfloat;
+    return out;
+}
+
+} /* !namespace ncg */
@@ -0,0 +1,95 @@
+/*
+ * profiler.h
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#pragma once
+
+#include "core/tensor.h"
+#include "graph/op.h"
+#include "graph/perf_counters.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace ncg {
+
+class GraphOp;
+class GraphForwardContext;
+
+struct GraphProfileEvent {
+    std::string op_name;
+    std::string name;
+    // Both in microseconds; start is relative to the creation (or the last reset) of the profiler.
+    double start;
+    double duration;
+    std::vector<ShapeVec> input_shapes;
+    std::vector<ShapeVec> output_shapes;
+    size_t output_numel;
+    size_t allocated_bytes;
+    // Only filled if the profiler has hardware counters enabled.
+    PerfCounterValues counters;
+    // GraphOp::cost for the runtime shapes.
+    OpCost cost;
+};
+
+struct GraphProfileSummary {
+    std::string key;
+    size_t count = 0;
+    double total = 0;
+    double min = 0;
+    double max = 0;
+    size_t allocated_bytes = 0;
+    size_t output_numel = 0;
+    PerfCounterValues counters;
+    OpCost cost;
+
+    double mean() const { return count > 0 ? total / count : 0; }
+    double ipc() const;
+    // Counter value per output element.
+    double per_element(PerfCounter counter) const;
+    // Achieved throughput over the total time.
+    double gflops() const;
+    double gbytes_per_second() const;
+};
+
+/*
+ * Records every GraphOp::forward call of the contexts it is attached to (see GraphForwardContext::set_profiler).
+ * A context without a profiler does not pay anything but a null-pointer check per op.
+ */
+class GraphProfiler {
+public:
+    GraphProfiler();
+    virtual ~GraphProfiler() = default;
+
+    void forward(GraphForwardContext &ctx, const GraphOp *op);
+    void reset();
+
+    /* Sample hardware counters (see PerfCounterGroup) around each op; returns false if they are unavailable. */
+    bool enable_perf_counters();
+    // nullptr if not enabled.
+    const PerfCounterGroup *perf_counters() const;
+
+    const std::vector<GraphProfileEvent> &events() const;
+    // Sorted by decreasing total time.
+    std::vector<GraphProfileSummary> summary_by_op_type() const;
+    std::vector<GraphProfileSummary> summary_by_name() const;
+
+    // Chrome trace event format, viewable in chrome://tracing or Perfetto.
+    void dump_chrome_trace(std::ostream &out) const;
+    void dump_chrome_trace(const std::string &filename) const;
+
+    friend std::ostream &operator << (std::ostream &out, const GraphProfiler &profiler);
+
+protected:
+    double now_() const;
+
+    std::chrono::steady_clock::time_point m_start;
+    std::vector<GraphProfileEvent> m_events;
+    std::unique_ptr<PerfCounterGroup> m_perf_counters;
+};
+
+} /* !namespace ncg */
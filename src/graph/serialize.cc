@@ -0,0 +1,301 @@
+/*
+ * serialize.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "graph/serialize.h"
+#include "graph/ops/conv.h"
+#include "graph/ops/elemwise.h"
+#include "graph/ops/embedding.h"
+#include "graph/ops/grad.h"
+#include "graph/ops/linalg.h"
+#include "graph/ops/mixed_precision.h"
+#include "graph/ops/netsrc.h"
+#include "graph/ops/quantize.h"
+#include "graph/ops/reduction.h"
+#include "graph/ops/shape.h"
+#include "graph/ops/slice.h"
+#include "graph/ops/sparse.h"
+#include "graph/ops/update.h"
+
+#include <typeinfo>
+
+namespace ncg {
+
+namespace {
+
+const char *GraphPickleMagic = "NCGGraph";
+const int64_t GraphPickleVersion = 1;
+
+struct GraphTensorRef {
+    int64_t op;
+    int64_t index;
+};
+
+class GraphPickleContext {
+public:
+    GraphPickleContext(const Graph &graph) {
+        for (size_t i = 0; i < graph.ops().size(); ++i) {
+            m_op_index.emplace(graph.ops()[i].get(), i);
+        }
+    }
+
+    int64_t op_index(const GraphOp *op) const {
+        auto it = m_op_index.find(op);
+        ncg_assert_msg(it != m_op_index.end(), "the tensor does not belong to the graph");
+        return static_cast<int64_t>(it->second);
+    }
+
+    // Null tensors are written as op -1.
+    void write_tensor(NCGPickler &pickler, const GraphTensor *tensor) const {
+        if (tensor == nullptr) {
+            pickler.write(static_cast<int64_t>(-1));
+            pickler.write(static_cast<int64_t>(0));
+            return;
+        }
+        pickler.write(op_index(tensor->owner_op()));
+        pickler.write(static_cast<int64_t>(tensor->owner_op_index()));
+    }
+
+protected:
+    std::unordered_map<const GraphOp *, size_t> m_op_index;
+};
+
+GTensorPtr read_tensor(NCGUnpickler &unpickler, const Graph &graph) {
+    int64_t op = unpickler.read_int64();
+    int64_t index = unpickler.read_int64();
+    if (op < 0) {
+        return nullptr;
+    }
+    ncg_assert_msg(op < static_cast<int64_t>(graph.ops().size()), "invalid graph pickle: dangling edge");
+    const auto &outputs = graph.ops()[op]->outputs();
+    ncg_assert_msg(index >= 0 && index < static_cast<int64_t>(outputs.size()), "invalid graph pickle: dangling edge");
+    return outputs[index];
+}
+
+} /* !namespace <anonymous> */
+
+GraphOpRegistry::GraphOpRegistry() : m_entries() {
+    // Pass
+}
+
+void GraphOpRegistry::register_op(const std::string &op_name, OpFactory op_factory, DescFactory desc_factory) {
+    ncg_assert_msg(m_entries.find(op_name) == m_entries.end(), "op " + op_name + " registered twice");
+    m_entries.emplace(op_name, Entry{op_factory, desc_factory});
+}
+
+bool GraphOpRegistry::has_op(const std::string &op_name) const {
+    return m_entries.find(op_name) != m_entries.end();
+}
+
+GraphOp *GraphOpRegistry::make_op(const std::string &op_name) const {
+    return entry_(op_name).op_factory();
+}
+
+OpDescPtr GraphOpRegistry::make_desc(const std::string &op_name) const {
+    return OpDescPtr(entry_(op_name).desc_factory());
+}
+
+const GraphOpRegistry::Entry &GraphOpRegistry::entry_(const std::string &op_name) const {
+    auto it = m_entries.find(op_name);
+    ncg_assert_msg(it != m_entries.end(), "op " + op_name + " is not registered");
+    return it->second;
+}
+
+GraphOpRegistry &get_graph_op_registry() {
+    static GraphOpRegistry *registry = []() {
+        auto registry = new GraphOpRegistry();
+
+        registry->register_op<GOpCast, OpCastDesc>();
+        registry->register_op<GOpCond, OpDesc>();
+#define REGISTER_ELEMWISE(name) registry->register_op<GOp##name, OpDesc>()
+        REGISTER_ELEMWISE(Neg); REGISTER_ELEMWISE(Sin); REGISTER_ELEMWISE(Cos); REGISTER_ELEMWISE(Tan);
+        REGISTER_ELEMWISE(Log); REGISTER_ELEMWISE(Exp); REGISTER_ELEMWISE(Tanh); REGISTER_ELEMWISE(Sigmoid);
+        REGISTER_ELEMWISE(Reciprocal);
+        REGISTER_ELEMWISE(Add); REGISTER_ELEMWISE(Sub); REGISTER_ELEMWISE(Mul); REGISTER_ELEMWISE(Div);
+        REGISTER_ELEMWISE(Ge); REGISTER_ELEMWISE(Le); REGISTER_ELEMWISE(Geq); REGISTER_ELEMWISE(Leq);
+        REGISTER_ELEMWISE(Eq); REGISTER_ELEMWISE(Neq); REGISTER_ELEMWISE(Pow); REGISTER_ELEMWISE(Min);
+        REGISTER_ELEMWISE(Max);
+#undef REGISTER_ELEMWISE
+
+        registry->register_op<GOpGradLoss, OpDesc>();
+        registry->register_op<GOpMatMul, OpMatMulDesc>();
+
+        registry->register_op<GOpQuantize, OpQuantizeDesc>();
+        registry->register_op<GOpDequantize, OpDesc>();
+        registry->register_op<GOpQuantizedMatMul, OpQuantizedMatMulDesc>();
+
+        registry->register_op<GOpSparseMatMul, OpSparseMatMulDesc>();
+
+        registry->register_op<GOpEmbedding, OpDesc>();
+        registry->register_op<GOpEmbeddingGrad, OpDesc>();
+        registry->register_op<GOpSparseRowsToDense, OpSparseRowsToDenseDesc>();
+
+        registry->register_op<GOpConv2d, OpConv2dDesc>();
+        registry->register_op<GOpConv2dBackwardData, OpConv2dBackwardDataDesc>();
+        registry->register_op<GOpConv2dBackwardFilter, OpConv2dBackwardFilterDesc>();
+        registry->register_op<GOpMaxPool2d, OpPool2dDesc>();
+        registry->register_op<GOpMaxPool2dBackward, OpPool2dDesc>();
+        registry->register_op<GOpAvgPool2d, OpPool2dDesc>();
+        registry->register_op<GOpAvgPool2dBackward, OpAvgPool2dBackwardDesc>();
+
+        registry->register_op<GOpPlaceholder, GOpPlaceholderDesc>();
+        registry->register_op<GOpConstant, GOpConstantDesc>();
+        registry->register_op<GOpVariable, GOpVariableDesc>();
+        registry->register_op<GOpZeros, OpZerosDesc>();
+        registry->register_op<GOpOnes, OpOnesDesc>();
+
+        registry->register_op<GOpReduceMin, OpReduceDesc>();
+        registry->register_op<GOpReduceMax, OpReduceDesc>();
+        registry->register_op<GOpReduceSum, OpReduceDesc>();
+        registry->register_op<GOpReduceMean, OpReduceDesc>();
+
+        registry->register_op<GOpShapeOf, OpDesc>();
+        registry->register_op<GOpShapeOfIndex, OpShapeOfIndexDesc>();
+        registry->register_op<GOpShapeConcat, OpDesc>();
+        registry->register_op<GOpReshape, OpReshapeDesc>();
+        registry->register_op<GOpPermute, OpPermuteDesc>();
+        registry->register_op<GOpExpand, OpExpandDesc>();
+        registry->register_op<GOpSqueeze, OpSqueezeDesc>();
+        registry->register_op<GOpUnsqueeze, OpUnsqueezeDesc>();
+
+        registry->register_op<GOpConcat, OpConcatDesc>();
+        registry->register_op<GOpSplit, OpSplitDesc>();
+        registry->register_op<GOpNarrow, OpNarrowDesc>();
+        registry->register_op<GOpNarrowBackward, OpNarrowBackwardDesc>();
+        registry->register_op<GOpIndexSelect, OpIndexSelectDesc>();
+        registry->register_op<GOpIndexSelectBackward, OpIndexSelectBackwardDesc>();
+        registry->register_op<GOpGather, OpGatherDesc>();
+        registry->register_op<GOpGatherBackward, OpGatherBackwardDesc>();
+
+        registry->register_op<GOpAssign, OpDesc>();
+        registry->register_op<GOpAssignAddRows, GOpAssignAddRowsDesc>();
+        registry->register_op<GOpUnscaleGrads, OpUnscaleGradsDesc>();
+        return registry;
+    }();
+    return *registry;
+}
+
+void save_graph(const Graph &graph, NCGPickler &pickler) {
+    const auto &registry = get_graph_op_registry();
+    GraphPickleContext ctx(graph);
+
+    pickler.write(std::string(GraphPickleMagic));
+    pickler.write(GraphPickleVersion);
+
+    pickler.write(static_cast<int64_t>(graph.ops().size()));
+    for (const auto &op : graph.ops()) {
+        std::string op_name = op->op_name();
+        ncg_assert_msg(registry.has_op(op_name), "op " + op_name + " is not registered");
+        pickler.write(op_name);
+        pickler.write(static_cast<int64_t>(op->has_name()));
+        if (op->has_name()) {
+            pickler.write(op->name());
+        }
+
+        pickler.write(static_cast<int64_t>(op->inputs().size()));
+        for (const auto &input : op->inputs()) {
+            ctx.write_tensor(pickler, input.get());
+        }
+
+        const auto &desc = op->desc_ptr();
+        pickler.write(static_cast<int64_t>(desc != nullptr));
+        if (desc != nullptr) {
+            auto expected = registry.make_desc(op_name);
+            ncg_assert_msg(typeid(*desc) == typeid(*expected), "op " + op_name + " has a desc of an unregistered type");
+            desc->pickle(pickler);
+        }
+    }
+
+    // The gradients, in the order of the ops, so that the loading is deterministic.
+    int64_t nr_grads = 0;
+    for (const auto &op : graph.ops()) {
+        for (const auto &output : op->outputs()) nr_grads += output->grads().size();
+    }
+    pickler.write(nr_grads);
+    for (const auto &op : graph.ops()) {
+        for (const auto &output : op->outputs()) {
+            for (const auto &it : output->grads()) {
+                ctx.write_tensor(pickler, output.get());
+                ctx.write_tensor(pickler, reinterpret_cast<const GraphTensor *>(it.first));
+                ctx.write_tensor(pickler, it.second.get());
+            }
+        }
+    }
+
+    pickler.write(static_cast<int64_t>(graph.m_backproped_tensors.size()));
+    for (const auto &loss : graph.m_backproped_tensors) {
+        ctx.write_tensor(pickler, reinterpret_cast<const GraphTensor *>(loss));
+    }
+    pickler.write(static_cast<int64_t>(graph.m_backward_ops.size()));
+    for (const auto &op : graph.m_backward_ops) {
+        pickler.write(ctx.op_index(op));
+    }
+}
+
+void save_graph(const Graph &graph, const std::string &filename) {
+    NCGPickler pickler(filename, NCGPickleChecksum);
+    save_graph(graph, pickler);
+    pickler.close();
+}
+
+void load_graph(Graph &graph, NCGUnpickler &unpickler) {
+    const auto &registry = get_graph_op_registry();
+    ncg_assert_msg(graph.ops().size() == 0, "graphs can only be loaded into an empty graph");
+
+    ncg_assert_msg(unpickler.read_string() == GraphPickleMagic, "not a graph pickle");
+    ncg_assert_msg(unpickler.read_int64() <= GraphPickleVersion, "unsupported graph pickle version");
+
+    int64_t nr_ops = unpickler.read_int64();
+    graph.m_ops.reserve(nr_ops);
+    for (int64_t i = 0; i < nr_ops; ++i) {
+        std::string op_name = unpickler.read_string();
+        std::unique_ptr<GraphOp> op(registry.make_op(op_name));
+        if (unpickler.read_int64()) {
+            op->set_name(unpickler.read_string());
+        }
+
+        GTensorVec inputs(unpickler.read_int64());
+        for (auto &input : inputs) {
+            input = read_tensor(unpickler, graph);
+            ncg_assert_msg(input != nullptr, "invalid graph pickle: null input");
+        }
+
+        OpDescPtr desc;
+        if (unpickler.read_int64()) {
+            desc = registry.make_desc(op_name);
+            desc->unpickle(unpickler);
+        }
+        graph.add_op(op.release(), desc, inputs);
+    }
+
+    int64_t nr_grads = unpickler.read_int64();
+    for (int64_t i = 0; i < nr_grads; ++i) {
+        auto tensor = read_tensor(unpickler, graph);
+        auto loss = read_tensor(unpickler, graph);
+        auto grad = read_tensor(unpickler, graph);
+        tensor->set_grad(graph, loss, grad);
+    }
+
+    int64_t nr_backproped_tensors = unpickler.read_int64();
+    for (int64_t i = 0; i < nr_backproped_tensors; ++i) {
+        auto loss = read_tensor(unpickler, graph);
+        graph.m_backproped_tensors.emplace(reinterpret_cast<std::uintptr_t>(loss.get()));
+    }
+    int64_t nr_backward_ops = unpickler.read_int64();
+    for (int64_t i = 0; i < nr_backward_ops; ++i) {
+        int64_t op = unpickler.read_int64();
+        ncg_assert_msg(op >= 0 && op < nr_ops, "invalid graph pickle: unknown op");
+        graph.m_backward_ops.emplace(graph.m_ops[op].get());
+    }
+}
+
+void load_graph(Graph &graph, const std::string &filename) {
+    NCGUnpickler unpickler(filename);
+    load_graph(graph, unpickler);
+    unpickler.close();
+}
+
+} /* !namespace ncg */
@@ -0,0 +1,70 @@
+/*
+ * serialize.h
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#pragma once
+
+#include "core/pickle.h"
+#include "graph/graph.h"
+#include "graph/op.h"
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+namespace ncg {
+
+/*
+ * Creates GraphOps and their descs by op_name(), to load saved graphs. All the built-in ops are registered;
+ * other ops must be registered (with NCG_GOP_REGISTER or register_op) before loading a graph using them.
+ */
+class GraphOpRegistry {
+public:
+    typedef std::function<GraphOp *()> OpFactory;
+    typedef std::function<OpDesc *()> DescFactory;
+
+    GraphOpRegistry();
+    virtual ~GraphOpRegistry() = default;
+
+    // For ops which are always created without a desc, use OpDesc as the DescClass.
+    template <typename OpClass, typename DescClass = OpDesc>
+    void register_op() {
+        register_op(OpClass().op_name(), []() { return new OpClass(); }, []() { return new DescClass(); });
+    }
+    void register_op(const std::string &op_name, OpFactory op_factory, DescFactory desc_factory);
+
+    bool has_op(const std::string &op_name) const;
+    GraphOp *make_op(const std::string &op_name) const;
+    OpDescPtr make_desc(const std::string &op_name) const;
+
+protected:
+    struct Entry {
+        OpFactory op_factory;
+        DescFactory desc_factory;
+    };
+
+    const Entry &entry_(const std::string &op_name) const;
+
+    std::unordered_map<std::string, Entry> m_entries;
+};
+
+GraphOpRegistry &get_graph_op_registry();
+
+#define NCG_GOP_REGISTER(op_class, desc_class) \
+    static bool __ncg_gop_registered_##op_class = (::ncg::get_graph_op_registry().register_op<op_class, desc_class>(), true)
+
+/*
+ * Save the ops (types, names, descs, including the values of constants and the initial values of
+ * variables), the edges and the gradients computed by Graph::backward, so that a process can load a
+ * graph instead of rebuilding it. The current values of the variables are saved by the Session.
+ */
+void save_graph(const Graph &graph, NCGPickler &pickler);
+void save_graph(const Graph &graph, const std::string &filename);
+// The graph must be empty.
+void load_graph(Graph &graph, NCGUnpickler &unpickler);
+void load_graph(Graph &graph, const std::string &filename);
+
+} /* !namespace ncg */
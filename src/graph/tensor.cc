@@ -8,13 +8,18 @@
 #include "graph/tensor.h"
 
 #include "graph/op.h"
+#include "graph/mixed_precision.h"
+#include "graph/ops/conv.h"
 #include "graph/ops/elemwise.h"
+#include "graph/ops/embedding.h"
 #include "graph/ops/grad.h"
 #include "graph/ops/linalg.h"
 #include "graph/ops/netsrc.h"
+#include "graph/ops/quantize.h"
 #include "graph/ops/reduction.h"
 #include "graph/ops/shape.h"
 #include "graph/ops/slice.h"
+#include "graph/ops/sparse.h"
 #include "graph/ops/update.h"
 
 #include <algorithm>
@@ -53,6 +58,10 @@ GTensorPtr GraphTensor::grad(GTensorPtr loss) const {
     return it->second;
 }
 
+const std::unordered_map<std::uintptr_t, GTensorPtr> &GraphTensor::grads() const {
+    return m_grads;
+}
+
 void GraphTensor::set_grad(Graph &graph, GTensorPtr loss, GTensorPtr grad) {
     auto tensor = loss.get();
     std::uintptr_t tpi = reinterpret_cast<std::uintptr_t>(tensor);
@@ -71,6 +80,10 @@ void GraphTensor::set_grad(Graph &graph, GTensorPtr loss, GTensorPtr grad) {
     }
 }
 
+void GraphTensor::reset_grad(GTensorPtr loss, GTensorPtr grad) {
+    m_grads[reinterpret_cast<std::uintptr_t>(loss.get())] = grad;
+}
+
 std::ostream & operator << (std::ostream &out, const GraphTensor &tensor) {
     out << "GTensor(op=" << tensor.m_owner_op->name() << ", op_type=" << tensor.m_owner_op->op_name() << ", index=" << tensor.m_owner_op_index << ", desc=" << tensor.m_desc << ")";
     return out;
@@ -149,48 +162,62 @@ GTensorPtr cast(GTensorPtr a, DTypeName dtype) {
 
 GTensorPtr cond(GTensorPtr a, GTensorPtr b, GTensorPtr c) {
     Graph &g = get_default_graph();
-    return g.op<GOpCond>(nullptr, auto_broadcast(g, {a, b, c}));
+    auto bc = mixed_precision_cast(g, {b, c}, MixedPrecisionCast::Promote);
+    return g.op<GOpCond>(nullptr, auto_broadcast(g, {a, bc[0], bc[1]}));
 }
 
-#define NCG_GOP_DEF_UNRAY_FUNC(op_name, gop_name) GTensorPtr op_name(GTensorPtr a) { \
+// The last argument is the cast of the inputs under the mixed precision; see graph/mixed_precision.h.
+#define NCG_GOP_DEF_UNRAY_FUNC(op_name, gop_name, cast) GTensorPtr op_name(GTensorPtr a) { \
     Graph &g = get_default_graph(); \
-    return g.op<GOp##gop_name>(nullptr, a); \
+    return g.op<GOp##gop_name>(nullptr, mixed_precision_cast(g, {a}, MixedPrecisionCast::cast)); \
 }
 
-NCG_GOP_DEF_UNRAY_FUNC(neg, Neg);
-NCG_GOP_DEF_UNRAY_FUNC(sin, Sin);
-NCG_GOP_DEF_UNRAY_FUNC(cos, Cos);
-NCG_GOP_DEF_UNRAY_FUNC(tan, Tan);
-NCG_GOP_DEF_UNRAY_FUNC(log, Log);
-NCG_GOP_DEF_UNRAY_FUNC(exp, Exp);
-NCG_GOP_DEF_UNRAY_FUNC(tanh, Tanh);
-NCG_GOP_DEF_UNRAY_FUNC(sigmoid, Sigmoid);
-NCG_GOP_DEF_UNRAY_FUNC(reciprocal, Reciprocal);
+NCG_GOP_DEF_UNRAY_FUNC(neg, Neg, Keep);
+NCG_GOP_DEF_UNRAY_FUNC(sin, Sin, Keep);
+NCG_GOP_DEF_UNRAY_FUNC(cos, Cos, Keep);
+NCG_GOP_DEF_UNRAY_FUNC(tan, Tan, Keep);
+NCG_GOP_DEF_UNRAY_FUNC(log, Log, Float32);
+NCG_GOP_DEF_UNRAY_FUNC(exp, Exp, Float32);
+NCG_GOP_DEF_UNRAY_FUNC(tanh, Tanh, Lower);
+NCG_GOP_DEF_UNRAY_FUNC(sigmoid, Sigmoid, Lower);
+NCG_GOP_DEF_UNRAY_FUNC(reciprocal, Reciprocal, Float32);
 
-#define NCG_GOP_DEF_BINARY_FUNC(op_name, gop_name) GTensorPtr op_name(GTensorPtr a, GTensorPtr b) { \
+#define NCG_GOP_DEF_BINARY_FUNC(op_name, gop_name, cast) GTensorPtr op_name(GTensorPtr a, GTensorPtr b) { \
     Graph &g = get_default_graph(); \
-    return g.op<GOp##gop_name>(nullptr, auto_broadcast(g, {a, b})); \
-}
-
-NCG_GOP_DEF_BINARY_FUNC(add, Add);
-NCG_GOP_DEF_BINARY_FUNC(sub, Sub);
-NCG_GOP_DEF_BINARY_FUNC(mul, Mul);
-NCG_GOP_DEF_BINARY_FUNC(div, Div);
-NCG_GOP_DEF_BINARY_FUNC(ge, Ge);
-NCG_GOP_DEF_BINARY_FUNC(le, Le);
-NCG_GOP_DEF_BINARY_FUNC(geq, Geq);
-NCG_GOP_DEF_BINARY_FUNC(leq, Leq);
-NCG_GOP_DEF_BINARY_FUNC(eq, Eq);
-NCG_GOP_DEF_BINARY_FUNC(neq, Neq);
-NCG_GOP_DEF_BINARY_FUNC(pow, Pow);
-NCG_GOP_DEF_BINARY_FUNC(min, Min);
-NCG_GOP_DEF_BINARY_FUNC(max, Max);
+    return g.op<GOp##gop_name>(nullptr, auto_broadcast(g, mixed_precision_cast(g, {a, b}, MixedPrecisionCast::cast))); \
+}
+
+NCG_GOP_DEF_BINARY_FUNC(add, Add, Promote);
+NCG_GOP_DEF_BINARY_FUNC(sub, Sub, Promote);
+NCG_GOP_DEF_BINARY_FUNC(mul, Mul, Promote);
+NCG_GOP_DEF_BINARY_FUNC(div, Div, Promote);
+NCG_GOP_DEF_BINARY_FUNC(ge, Ge, Promote);
+NCG_GOP_DEF_BINARY_FUNC(le, Le, Promote);
+NCG_GOP_DEF_BINARY_FUNC(geq, Geq, Promote);
+NCG_GOP_DEF_BINARY_FUNC(leq, Leq, Promote);
+NCG_GOP_DEF_BINARY_FUNC(eq, Eq, Promote);
+NCG_GOP_DEF_BINARY_FUNC(neq, Neq, Promote);
+NCG_GOP_DEF_BINARY_FUNC(pow, Pow, Float32);
+NCG_GOP_DEF_BINARY_FUNC(min, Min, Promote);
+NCG_GOP_DEF_BINARY_FUNC(max, Max, Promote);
 
 GTensorPtr placeholder(std::string name, const ShapeVec &shape, DTypeName dtype) {
     Graph &g = get_default_graph();
     return g.op<GOpPlaceholder>(name, OpDescPtr(new ::ncg::GOpPlaceholderDesc(dtype, shape)));
 }
 
+GSparseTensor sparse_placeholder(std::string name, const ShapeVec &shape, DTypeName dtype) {
+    ncg_assert_msg(shape.size() == 2, "A sparse tensor must be 2-D.");
+    Graph &g = get_default_graph();
+    // The static shape of the indices and the values is empty: the number of non-zeros is only known at run time.
+    GSparseTensor a;
+    a.shape = shape;
+    a.indptr = g.op<GOpPlaceholder>(name + ":indptr", OpDescPtr(new ::ncg::GOpPlaceholderDesc(DTypeName::Int64, {shape[0] + 1})));
+    a.indices = g.op<GOpPlaceholder>(name + ":indices", OpDescPtr(new ::ncg::GOpPlaceholderDesc(DTypeName::Int64, {0})));
+    a.values = g.op<GOpPlaceholder>(name + ":values", OpDescPtr(new ::ncg::GOpPlaceholderDesc(dtype, {0})));
+    return a;
+}
+
 GTensorPtr constant(TensorPtr value) {
     Graph &g = get_default_graph();
     return g.op<GOpConstant>(OpDescPtr(new ::ncg::GOpConstantDesc(value)));
@@ -198,6 +225,10 @@ GTensorPtr constant(TensorPtr value) {
 
 GTensorPtr variable(std::string name, TensorPtr init_value) {
     Graph &g = get_default_graph();
+    // The master values of the mixed precision are Float32.
+    if (g.mixed_precision() != nullptr && is_reduced_precision_dtype(init_value->desc().dtype())) {
+        init_value = init_value.float32();
+    }
     return g.op<GOpVariable>(name, OpDescPtr(new ::ncg::GOpVariableDesc(init_value)));
 }
 
@@ -213,14 +244,57 @@ GTensorPtr ones(const ShapeVec &shape, DTypeName dtype) {
 
 GTensorPtr matmul(GTensorPtr a, GTensorPtr b, bool transpose_a, bool transpose_b) {
     Graph &g = get_default_graph();
-    return g.op<GOpMatMul>(OpDescPtr(new ::ncg::OpMatMulDesc(transpose_a, transpose_b)), a, b);
+    return g.op<GOpMatMul>(OpDescPtr(new ::ncg::OpMatMulDesc(transpose_a, transpose_b)), mixed_precision_cast(g, {a, b}, MixedPrecisionCast::Lower));
+}
+
+GTensorPtr sparse_matmul(const GSparseTensor &a, GTensorPtr b, bool transpose_a) {
+    Graph &g = get_default_graph();
+    // No mixed-precision cast: the sparse kernels are Float32 and Float64 only.
+    return g.op<GOpSparseMatMul>(
+        OpDescPtr(new ::ncg::OpSparseMatMulDesc(a.shape[0], a.shape[1], transpose_a)),
+        a.indptr, a.indices, a.values, b
+    );
+}
+
+GTensorPtr quantize(GTensorPtr a, const QuantizationParams &params) {
+    Graph &g = get_default_graph();
+    return g.op<GOpQuantize>(OpDescPtr(new ::ncg::OpQuantizeDesc(params)), a);
+}
+
+GTensorPtr dequantize(GTensorPtr a) {
+    Graph &g = get_default_graph();
+    return g.op<GOpDequantize>(nullptr, a);
+}
+
+GTensorPtr quantized_matmul(GTensorPtr a, GTensorPtr b, GTensorPtr bias, DTypeName dtype, const QuantizationParams &output, bool transpose_b) {
+    Graph &g = get_default_graph();
+    auto desc = OpDescPtr(new ::ncg::OpQuantizedMatMulDesc(dtype, output, transpose_b));
+    if (bias != nullptr) {
+        return g.op<GOpQuantizedMatMul>(desc, a, b, bias);
+    }
+    return g.op<GOpQuantizedMatMul>(desc, a, b);
 }
 
 GTensorPtr assign(GTensorPtr a, GTensorPtr b) {
     Graph &g = get_default_graph();
+    // Updates computed in the compute dtype go back to the master value.
+    if (g.mixed_precision() != nullptr && is_float_dtype(b->desc().dtype()) && b->desc().dtype() != a->desc().dtype()) {
+        b = g.op<GOpCast>(OpDescPtr(new ::ncg::OpCastDesc(a->desc().dtype())), b);
+    }
     return g.op<GOpAssign>(nullptr, a, b);
 }
 
+GTensorPtr sgd_update(GTensorPtr variable, GTensorPtr grad, double lr) {
+    Graph &g = get_default_graph();
+    auto sparse_grad = grad->template owner_op<GOpSparseRowsToDense>();
+    if (sparse_grad != nullptr && grad->desc().dtype() == variable->desc().dtype()) {
+        // The dense gradient is never evaluated: the update reads the (indices, rows) it is made of.
+        const auto &inputs = sparse_grad->inputs();
+        return g.op<GOpAssignAddRows>(OpDescPtr(new ::ncg::GOpAssignAddRowsDesc(-lr)), variable, inputs[0], inputs[1]);
+    }
+    return assign(variable, variable - grad * static_cast<float>(lr));
+}
+
 GTensorVec reduce_min(GTensorPtr a, ssize_t axis, bool keepdims) {
     Graph &g = get_default_graph();
     return g.op<GOpReduceMin>(OpDescPtr(new ::ncg::OpReduceDesc(axis, keepdims)), a);
@@ -233,12 +307,12 @@ GTensorVec reduce_max(GTensorPtr a, ssize_t axis, bool keepdims) {
 
 GTensorPtr reduce_sum(GTensorPtr a, ssize_t axis, bool keepdims) {
     Graph &g = get_default_graph();
-    return g.op<GOpReduceSum>(OpDescPtr(new ::ncg::OpReduceDesc(axis, keepdims)), a);
+    return g.op<GOpReduceSum>(OpDescPtr(new ::ncg::OpReduceDesc(axis, keepdims)), mixed_precision_cast(g, {a}, MixedPrecisionCast::Float32));
 }
 
 GTensorPtr reduce_mean(GTensorPtr a, ssize_t axis, bool keepdims) {
     Graph &g = get_default_graph();
-    return g.op<GOpReduceMean>(OpDescPtr(new ::ncg::OpReduceDesc(axis, keepdims)), a);
+    return g.op<GOpReduceMean>(OpDescPtr(new ::ncg::OpReduceDesc(axis, keepdims)), mixed_precision_cast(g, {a}, MixedPrecisionCast::Float32));
 }
 
 GTensorPtr reshape(GTensorPtr a, const ShapeVec &shape) {
@@ -283,7 +357,7 @@ GTensorPtr shape_cat(const GTensorVec &a) {
 
 GTensorPtr concat(const GTensorVec &a, ssize_t axis) {
     Graph &g = get_default_graph();
-    return g.op<GOpConcat>(OpDescPtr(new ::ncg::OpConcatDesc(axis)), a);
+    return g.op<GOpConcat>(OpDescPtr(new ::ncg::OpConcatDesc(axis)), mixed_precision_cast(g, a, MixedPrecisionCast::Promote));
 }
 
 GTensorVec split(GTensorPtr a, ssize_t axis, const ShapeVec &splits) {
@@ -306,6 +380,27 @@ GTensorPtr gather(GTensorPtr a, ssize_t axis, GTensorPtr b) {
     return g.op<GOpGather>(OpDescPtr(new ::ncg::OpGatherDesc(axis)), a, b);
 }
 
+GTensorPtr embedding(GTensorPtr table, GTensorPtr indices) {
+    Graph &g = get_default_graph();
+    // No mixed-precision cast: a cast of the table would read all of it.
+    return g.op<GOpEmbedding>(nullptr, table, indices);
+}
+
+GTensorPtr conv2d(GTensorPtr input, GTensorPtr filter, ssize_t stride, ssize_t padding, Conv2dAlgorithm algorithm) {
+    Graph &g = get_default_graph();
+    return g.op<GOpConv2d>(OpDescPtr(new ::ncg::OpConv2dDesc(stride, stride, padding, padding, algorithm)), mixed_precision_cast(g, {input, filter}, MixedPrecisionCast::Lower));
+}
+
+GTensorPtr max_pool2d(GTensorPtr input, ssize_t kernel, ssize_t stride, ssize_t padding) {
+    Graph &g = get_default_graph();
+    return g.op<GOpMaxPool2d>(OpDescPtr(new ::ncg::OpPool2dDesc(kernel, kernel, stride, stride, padding, padding)), mixed_precision_cast(g, {input}, MixedPrecisionCast::Keep));
+}
+
+GTensorPtr avg_pool2d(GTensorPtr input, ssize_t kernel, ssize_t stride, ssize_t padding) {
+    Graph &g = get_default_graph();
+    return g.op<GOpAvgPool2d>(OpDescPtr(new ::ncg::OpPool2dDesc(kernel, kernel, stride, stride, padding, padding)), mixed_precision_cast(g, {input}, MixedPrecisionCast::Keep));
+}
+
 } /* !namespace G */
 
 GTensorPtr GTensorPtr::eq(const GTensorPtr &rhs) const {
@@ -332,6 +427,9 @@ NCG_GOP_DEF_CAST_OPERATOR(int64, Int64);
 NCG_GOP_DEF_CAST_OPERATOR(uint64, UInt64);
 NCG_GOP_DEF_CAST_OPERATOR(float32, Float32);
 NCG_GOP_DEF_CAST_OPERATOR(float64, Float64);
+NCG_GOP_DEF_CAST_OPERATOR(float16, Float16);
+NCG_GOP_DEF_CAST_OPERATOR(bfloat16, BFloat16);
+NCG_GOP_DEF_CAST_OPERATOR(boolean, Bool);
 
 GTensorVec GTensorPtr::min(ssize_t axis, bool keepdims) const {
     return G::reduce_min(*this, axis, keepdims);
@@ -53,6 +53,9 @@ public:
     GTensorPtr uint64() const;
     GTensorPtr float32() const;
     GTensorPtr float64() const;
+    GTensorPtr float16() const;
+    GTensorPtr bfloat16() const;
+    GTensorPtr boolean() const;
 
     std::vector<GTensorPtr> min(ssize_t axis, bool keepdims=false) const;
     std::vector<GTensorPtr> max(ssize_t axis, bool keepdims=false) const;
@@ -152,6 +155,10 @@ public:
 
     GTensorPtr grad(GTensorPtr loss) const;
     void set_grad(Graph &graph, GTensorPtr loss, GTensorPtr grad);
+    // Replaces the (accumulated) gradient instead of adding to it.
+    void reset_grad(GTensorPtr loss, GTensorPtr grad);
+    // Indexed by the address of the loss tensor.
+    const std::unordered_map<std::uintptr_t, GTensorPtr> &grads() const;
 
     friend std::ostream & operator << (std::ostream &, const GraphTensor &);
 
@@ -163,14 +170,23 @@ protected:
     std::unordered_map<std::uintptr_t, GTensorPtr> m_grads;
 };
 
+/*
+ * The three arrays of a CSR matrix in a graph (see SparseTensor); made by G::sparse_placeholder and consumed by
+ * G::sparse_matmul.
+ */
+struct GSparseTensor {
+    ShapeVec shape;
+    GTensorPtr indptr, indices, values;
+};
+
 namespace G {
 
 GTensorVec auto_broadcast(Graph &graph, const GTensorVec &a);
 GTensorVec auto_broadcast(const GTensorVec &a);
 
 // elemwise::misc
-GTensorPtr cast(TensorPtr a, DTypeName dtype);
-GTensorPtr cond(TensorPtr a, TensorPtr b, TensorPtr c);
+GTensorPtr cast(GTensorPtr a, DTypeName dtype);
+GTensorPtr cond(GTensorPtr a, GTensorPtr b, GTensorPtr c);
 
 // elemwise::unary
 GTensorPtr neg(GTensorPtr a);
@@ -199,6 +215,8 @@ GTensorPtr max(GTensorPtr a, GTensorPtr b);
 
 // netsrc
 GTensorPtr placeholder(std::string name, const ShapeVec &shape, DTypeName dtype=DTypeName::Float32);
+// Fed with GraphForwardContext::feed(name, SparseTensor); the number of non-zeros may change from feed to feed.
+GSparseTensor sparse_placeholder(std::string name, const ShapeVec &shape, DTypeName dtype=DTypeName::Float32);
 GTensorPtr constant(TensorPtr value);
 GTensorPtr variable(std::string name, TensorPtr init_value);
 GTensorPtr zeros(const ShapeVec &shape, DTypeName dtype=DTypeName::Float32);
@@ -207,8 +225,20 @@ GTensorPtr ones(const ShapeVec &shape, DTypeName dtype=DTypeName::Float32);
 // linalg
 GTensorPtr matmul(GTensorPtr a, GTensorPtr b, bool transpose_a=false, bool transpose_b=false);
 
+// sparse
+GTensorPtr sparse_matmul(const GSparseTensor &a, GTensorPtr b, bool transpose_a=false);
+
+// quantize
+GTensorPtr quantize(GTensorPtr a, const QuantizationParams &params);
+GTensorPtr dequantize(GTensorPtr a);
+// bias can be nullptr; see OpQuantizedMatMul.
+GTensorPtr quantized_matmul(GTensorPtr a, GTensorPtr b, GTensorPtr bias, DTypeName dtype, const QuantizationParams &output=QuantizationParams(), bool transpose_b=false);
+
 // update
 GTensorPtr assign(GTensorPtr a, GTensorPtr b);
+// variable - lr * grad. In place on the touched rows if grad is the row-sparse gradient of a table only used by
+// G::embedding (see GOpAssignAddRows); a G::assign otherwise.
+GTensorPtr sgd_update(GTensorPtr variable, GTensorPtr grad, double lr);
 
 // reduce
 GTensorVec reduce_min(GTensorPtr a, ssize_t axis, bool keepdims=false);
@@ -235,6 +265,15 @@ GTensorPtr narrow(GTensorPtr a, ssize_t axis, ssize_t start, ssize_t length);
 GTensorPtr index_select(GTensorPtr a, ssize_t axis, GTensorPtr b);
 GTensorPtr gather(GTensorPtr a, ssize_t axis, GTensorPtr b);
 
+// embedding
+GTensorPtr embedding(GTensorPtr table, GTensorPtr indices);
+
+// conv
+// input {N, C, H, W}, filter {O, C, KH, KW}; see ::ncg::conv2d.
+GTensorPtr conv2d(GTensorPtr input, GTensorPtr filter, ssize_t stride=1, ssize_t padding=0, Conv2dAlgorithm algorithm=Conv2dAlgorithm::Auto);
+GTensorPtr max_pool2d(GTensorPtr input, ssize_t kernel, ssize_t stride, ssize_t padding=0);
+GTensorPtr avg_pool2d(GTensorPtr input, ssize_t kernel, ssize_t stride, ssize_t padding=0);
+
 } /* !namespace graph */
 
 } /* !namespace ncg */
@@ -8,4 +8,5 @@
 #include "core.h"
 #include "graph.h"
 #include "nn.h"
+#include "data.h"
 
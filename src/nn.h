@@ -6,3 +6,4 @@
  */
 
 #include "nn/ops.h"
+#include "nn/quantize.h"
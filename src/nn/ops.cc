@@ -14,11 +14,33 @@ namespace ncg {
 namespace G {
 
 GTensorPtr linear(std::string name, GTensorPtr x, ssize_t output_dim, std::mt19937 &rng, double stddev) {
-    auto W = variable(name + ":W", ::ncg::rand_normal(rng, x->desc().dtype(), {x->desc().shape(1), output_dim}, 0, stddev));
-    auto b = variable(name + ":b", ::ncg::zeros(x->desc().dtype(), {output_dim}));
+    // The parameters of a 16-bit input (e.g., under the mixed precision) are kept in Float32.
+    auto dtype = is_reduced_precision_dtype(x->desc().dtype()) ? DTypeName::Float32 : x->desc().dtype();
+    auto W = variable(name + ":W", ::ncg::rand_normal(rng, dtype, {x->desc().shape(1), output_dim}, 0, stddev));
+    auto b = variable(name + ":b", ::ncg::zeros(dtype, {output_dim}));
     return matmul(x, W) + b.unsqueeze(0);
 }
 
+GTensorPtr linear(std::string name, const GSparseTensor &x, ssize_t output_dim, std::mt19937 &rng, double stddev) {
+    auto dtype = x.values->desc().dtype();
+    auto W = variable(name + ":W", ::ncg::rand_normal(rng, dtype, {x.shape[1], output_dim}, 0, stddev));
+    auto b = variable(name + ":b", ::ncg::zeros(dtype, {output_dim}));
+    return sparse_matmul(x, W) + b.unsqueeze(0);
+}
+
+GTensorPtr embedding(std::string name, GTensorPtr indices, ssize_t nr_rows, ssize_t dim, std::mt19937 &rng, double stddev) {
+    auto table = variable(name + ":table", ::ncg::rand_normal(rng, DTypeName::Float32, {nr_rows, dim}, 0, stddev));
+    return embedding(table, indices);
+}
+
+GTensorPtr conv2d(std::string name, GTensorPtr x, ssize_t output_channels, ssize_t kernel, ssize_t stride, ssize_t padding, std::mt19937 &rng, double stddev) {
+    // As in G::linear, the parameters of a 16-bit input are kept in Float32.
+    auto dtype = is_reduced_precision_dtype(x->desc().dtype()) ? DTypeName::Float32 : x->desc().dtype();
+    auto W = variable(name + ":W", ::ncg::rand_normal(rng, dtype, {output_channels, x->desc().shape(1), kernel, kernel}, 0, stddev));
+    auto b = variable(name + ":b", ::ncg::zeros(dtype, {output_channels}));
+    return conv2d(x, W, stride, padding) + b.reshape({1, output_channels, 1, 1});
+}
+
 GTensorPtr softmax(GTensorPtr logits, ssize_t axis) {
     if (axis < 0) axis += logits->desc().dim();
 
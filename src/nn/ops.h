@@ -16,6 +16,12 @@ namespace ncg {
 namespace G {
 
 GTensorPtr linear(std::string name, GTensorPtr x, ssize_t output_dim, std::mt19937 &rng, double stddev=0.01);
+// The same layer on a sparse input (see G::sparse_placeholder); only the rows of W hit by the non-zeros are used.
+GTensorPtr linear(std::string name, const GSparseTensor &x, ssize_t output_dim, std::mt19937 &rng, double stddev=0.01);
+// A {nr_rows, dim} table variable looked up with G::embedding; train it with G::sgd_update for the sparse updates.
+GTensorPtr embedding(std::string name, GTensorPtr indices, ssize_t nr_rows, ssize_t dim, std::mt19937 &rng, double stddev=0.01);
+// A {output_channels, C, kernel, kernel} filter ":W" and a bias ":b" per output channel, on an NCHW input.
+GTensorPtr conv2d(std::string name, GTensorPtr x, ssize_t output_channels, ssize_t kernel, ssize_t stride, ssize_t padding, std::mt19937 &rng, double stddev=0.01);
 GTensorPtr softmax(GTensorPtr logits, ssize_t axis);
 GTensorPtr xent_sparse(GTensorPtr probs, GTensorPtr indices, ssize_t axis);
 
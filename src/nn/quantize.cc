@@ -0,0 +1,138 @@
+/*
+ * quantize.cc
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "nn/quantize.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+
+namespace ncg {
+
+namespace {
+
+bool is_linear_layer(const GraphOp *op) {
+    auto matmul = dynamic_cast<const GOpMatMul *>(op);
+    if (matmul == nullptr) {
+        return false;
+    }
+    const auto &desc = matmul->template desc<OpMatMulDesc>();
+    const auto &W = op->inputs()[1];
+    return !desc.transpose_a && !desc.transpose_b &&
+        op->inputs()[0]->desc().dtype() == DTypeName::Float32 && W->desc().dtype() == DTypeName::Float32 &&
+        dynamic_cast<const GOpVariable *>(W->owner_op()) != nullptr;
+}
+
+// Contiguous Float32 values.
+const float *float_data(TensorPtr &tensor) {
+    if (tensor->desc().dtype() != DTypeName::Float32 || !tensor->desc().is_contiguous()) {
+        tensor = cast(tensor, DTypeName::Float32);
+    }
+    return tensor->template as<DTypeName::Float32>()->data_ptr();
+}
+
+} /* !namespace <anonymous> */
+
+Int8Calibrator::Int8Calibrator(Graph &graph, const GTensorVec &targets) : m_graph(graph), m_targets(targets), m_nr_batches(0) {
+    GraphTopoSorter sorter(graph);
+    sorter.sort(targets);
+    for (auto op : sorter.sorted()) {
+        if (is_linear_layer(op)) {
+            m_layers.emplace_back(op);
+        }
+    }
+    m_min.resize(m_layers.size(), std::numeric_limits<float>::max());
+    m_max.resize(m_layers.size(), std::numeric_limits<float>::lowest());
+}
+
+const std::vector<GraphOp *> &Int8Calibrator::layers() const {
+    return m_layers;
+}
+
+void Int8Calibrator::observe(GraphForwardContext &ctx) {
+    GTensorVec inputs;
+    for (auto op : m_layers) {
+        inputs.emplace_back(op->inputs()[0]);
+    }
+    auto values = ctx.eval(inputs);
+    ncg_assert_msg(ctx.ok(), ctx.error_str());
+
+    for (size_t i = 0; i < m_layers.size(); ++i) {
+        const float *data = float_data(values[i]);
+        auto range = std::minmax_element(data, data + values[i]->desc().numel());
+        m_min[i] = std::min(m_min[i], *range.first);
+        m_max[i] = std::max(m_max[i], *range.second);
+    }
+    ++m_nr_batches;
+}
+
+QuantizationParams Int8Calibrator::input_params(size_t layer) const {
+    ncg_assert_msg(m_nr_batches > 0, "Int8Calibrator: observe() must be called before converting the graph.");
+    return QuantizationParams::from_range(m_min[layer], m_max[layer]);
+}
+
+GTensorVec Int8Calibrator::convert(Session &session) {
+    std::unordered_map<const GraphTensor *, GTensorPtr> mapping;
+    auto map_tensor = [&mapping](const GTensorPtr &t) {
+        auto it = mapping.find(t.get());
+        return it != mapping.end() ? it->second : t;
+    };
+
+    GraphTopoSorter sorter(m_graph);
+    sorter.sort(m_targets);
+    for (auto op : sorter.sorted()) {
+        auto layer = std::find(m_layers.begin(), m_layers.end(), op);
+        if (layer != m_layers.end()) {
+            const auto &W = op->inputs()[1];
+            auto W_value = session.is_shared_tensor_initialized(W) ?
+                session.shared_tensor(W) : W->owner_op()->template desc<GOpVariableDesc>().tensor;
+
+            const float *W_data = float_data(W_value);
+            float absmax = 0;
+            for (ssize_t i = 0; i < W_value->desc().numel(); ++i) {
+                absmax = std::max(absmax, std::fabs(W_data[i]));
+            }
+            auto W_quantized = quantize(W_value.permute({1, 0}), QuantizationParams::symmetric(absmax));
+
+            auto x = m_graph.op<GOpQuantize>(OpDescPtr(new OpQuantizeDesc(input_params(layer - m_layers.begin()))), map_tensor(op->inputs()[0]));
+            auto output = m_graph.op<GOpQuantizedMatMul>(
+                OpDescPtr(new OpQuantizedMatMulDesc(DTypeName::Float32, QuantizationParams(), true)),
+                x, m_graph.op<GOpConstant>(OpDescPtr(new GOpConstantDesc(W_quantized)))
+            );
+            mapping.emplace(op->outputs()[0].get(), output);
+            continue;
+        }
+
+        GTensorVec inputs;
+        bool changed = false;
+        for (const auto &input : op->inputs()) {
+            inputs.emplace_back(map_tensor(input));
+            changed |= inputs.back() != input;
+        }
+        if (!changed) {
+            continue;
+        }
+
+        auto new_op = m_graph.add_op(get_graph_op_registry().make_op(op->op_name()), op->desc_ptr(), inputs);
+        for (size_t i = 0; i < op->outputs().size(); ++i) {
+            mapping.emplace(op->outputs()[i].get(), new_op->outputs()[i]);
+        }
+    }
+
+    GTensorVec outputs;
+    for (const auto &t : m_targets) {
+        outputs.emplace_back(map_tensor(t));
+    }
+    return outputs;
+}
+
+GTensorVec Int8Calibrator::convert() {
+    return convert(get_default_session());
+}
+
+} /* !namespace ncg */
@@ -0,0 +1,49 @@
+/*
+ * quantize.h
+ * Copyright (C) 2019
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#pragma once
+
+#include "core.h"
+#include "graph.h"
+
+#include <vector>
+
+namespace ncg {
+
+/*
+ * Post-training int8 quantization of the linear layers (see G::linear) of a trained graph, for inference. The layers
+ * are the GOpMatMuls whose rhs is a Float32 variable. Feed calibration batches to observe(), which records the ranges
+ * of the inputs of the layers; convert() then rebuilds the targets in the same graph:
+ *   - the weights are quantized symmetrically (one scale per tensor) into Int8 constants, stored transposed;
+ *   - the inputs are quantized with the observed ranges, and the products are accumulated in int32 and dequantized
+ *     by GOpQuantizedMatMul;
+ *   - the other ops (e.g., the biases and the activations) are cloned, and stay in float.
+ * The float ops are left untouched, so that both versions can be evaluated side by side.
+ */
+class Int8Calibrator {
+public:
+    Int8Calibrator(Graph &graph, const GTensorVec &targets);
+    virtual ~Int8Calibrator() = default;
+
+    const std::vector<GraphOp *> &layers() const;
+    // Evaluates the inputs of the layers on the batch fed to ctx.
+    void observe(GraphForwardContext &ctx);
+    QuantizationParams input_params(size_t layer) const;
+
+    // The weights are read from the session (i.e., the trained values).
+    GTensorVec convert(Session &session);
+    GTensorVec convert();
+
+protected:
+    Graph &m_graph;
+    GTensorVec m_targets;
+    std::vector<GraphOp *> m_layers;
+    std::vector<float> m_min, m_max;
+    size_t m_nr_batches;
+};
+
+} /* !namespace ncg */